@@ -0,0 +1,142 @@
+//***************************************************************************************
+// BenchUtil.h
+//
+// Timing, camera and mesh helpers shared by the headless benchmarks and tests
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "Vertex.h"
+
+namespace BenchUtil
+{
+	// Median wall time of aRuns calls of aBody in milliseconds, after one warm up call
+	template<typename BodyFunc>
+	double MedianMs(int aRuns, BodyFunc&& aBody)
+	{
+		aBody();
+		std::vector<double> Times;
+		Times.reserve(aRuns);
+		for (int i = 0; i < aRuns; i++)
+		{
+			auto Start = std::chrono::steady_clock::now();
+			aBody();
+			Times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count());
+		}
+		std::nth_element(Times.begin(), Times.begin() + Times.size() / 2, Times.end());
+		return Times[Times.size() / 2];
+	}
+
+	// Deterministic xorshift generator so runs are comparable across machines
+	struct Random
+	{
+		std::uint64_t State = 0x9E3779B97F4A7C15ull;
+
+		std::uint64_t Next()
+		{
+			State ^= State << 13;
+			State ^= State >> 7;
+			State ^= State << 17;
+			return State;
+		}
+		// Uniform in [aMin, aMax)
+		float Range(float aMin, float aMax)
+		{
+			return aMin + (aMax - aMin) * static_cast<float>(Next() >> 40) * (1.0f / 16777216.0f);
+		}
+	};
+
+	// View * Proj of a left handed camera in the row vector convention of the renderer (p * View * Proj)
+	inline DirectX::XMFLOAT4X4 LookAtPerspective(const DirectX::XMFLOAT3& aEye, const DirectX::XMFLOAT3& aTarget,
+		float aFovY, float aAspect, float aNear, float aFar)
+	{
+		auto Normalize = [](DirectX::XMFLOAT3 V)
+		{
+			float InvLength = 1.0f / std::sqrt(V.x * V.x + V.y * V.y + V.z * V.z);
+			return DirectX::XMFLOAT3(V.x * InvLength, V.y * InvLength, V.z * InvLength);
+		};
+		auto Cross = [](const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B)
+		{
+			return DirectX::XMFLOAT3(A.y * B.z - A.z * B.y, A.z * B.x - A.x * B.z, A.x * B.y - A.y * B.x);
+		};
+		auto Dot = [](const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B) { return A.x * B.x + A.y * B.y + A.z * B.z; };
+
+		DirectX::XMFLOAT3 Z = Normalize(DirectX::XMFLOAT3(aTarget.x - aEye.x, aTarget.y - aEye.y, aTarget.z - aEye.z));
+		DirectX::XMFLOAT3 X = Normalize(Cross(DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f), Z));
+		DirectX::XMFLOAT3 Y = Cross(Z, X);
+		DirectX::XMFLOAT4X4 View(
+			X.x, Y.x, Z.x, 0.0f,
+			X.y, Y.y, Z.y, 0.0f,
+			X.z, Y.z, Z.z, 0.0f,
+			-Dot(X, aEye), -Dot(Y, aEye), -Dot(Z, aEye), 1.0f);
+
+		float YScale = 1.0f / std::tan(aFovY * 0.5f);
+		float Range = aFar / (aFar - aNear);
+		DirectX::XMFLOAT4X4 Proj(
+			YScale / aAspect, 0.0f, 0.0f, 0.0f,
+			0.0f, YScale, 0.0f, 0.0f,
+			0.0f, 0.0f, Range, 1.0f,
+			0.0f, 0.0f, -Range * aNear, 0.0f);
+
+		DirectX::XMFLOAT4X4 ViewProj;
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++)
+				ViewProj.m[r][c] = View.m[r][0] * Proj.m[0][c] + View.m[r][1] * Proj.m[1][c] + View.m[r][2] * Proj.m[2][c] + View.m[r][3] * Proj.m[3][c];
+		return ViewProj;
+	}
+
+	// Sphere of aStacks x aSlices quads with a bumpy radius, so simplification has curvature to preserve.
+	// Like GeometryGenerator the first and last column share positions, a UV seam, and the poles are single
+	// rows of coincident vertices. Appends to aVertices and aIndices, indices relative to the first new vertex.
+	inline void AppendBumpySphere(std::uint32_t aStacks, std::uint32_t aSlices, float aRadius, const DirectX::XMFLOAT3& aCenter,
+		std::vector<Vertex>& aVertices, std::vector<std::uint32_t>& aIndices)
+	{
+		const float Pi = 3.14159265f;
+		for (std::uint32_t Stack = 0; Stack <= aStacks; Stack++)
+		{
+			float Phi = Pi * Stack / aStacks;
+			for (std::uint32_t Slice = 0; Slice <= aSlices; Slice++)
+			{
+				float Theta = 2.0f * Pi * (Slice % aSlices) / aSlices;
+				DirectX::XMFLOAT3 Normal(std::sin(Phi) * std::cos(Theta), std::cos(Phi), std::sin(Phi) * std::sin(Theta));
+				float Radius = aRadius * (1.0f + 0.05f * std::sin(5.0f * Theta) * std::sin(7.0f * Phi));
+				aVertices.emplace_back(
+					aCenter.x + Normal.x * Radius, aCenter.y + Normal.y * Radius, aCenter.z + Normal.z * Radius,
+					float(Slice) / aSlices, float(Stack) / aStacks,
+					Normal.x, Normal.y, Normal.z,
+					-std::sin(Theta), 0.0f, std::cos(Theta));
+			}
+		}
+
+		// Clockwise seen from outside, the front face winding of the renderer
+		std::uint32_t RowSize = aSlices + 1;
+		for (std::uint32_t Stack = 0; Stack < aStacks; Stack++)
+		{
+			for (std::uint32_t Slice = 0; Slice < aSlices; Slice++)
+			{
+				std::uint32_t A = Stack * RowSize + Slice, B = A + 1, C = A + RowSize, D = C + 1;
+				// The pole quads have one degenerate triangle
+				if (Stack != 0)
+					aIndices.insert(aIndices.end(), { A, B, C });
+				if (Stack != aStacks - 1)
+					aIndices.insert(aIndices.end(), { C, B, D });
+			}
+		}
+	}
+
+	inline volatile std::uint64_t Sink = 0;
+
+	// Keeps the optimizer from discarding a result
+	template<typename T>
+	void Consume(const T& aValue)
+	{
+		Sink = Sink + static_cast<std::uint64_t>(aValue);
+	}
+}
@@ -0,0 +1,100 @@
+//***************************************************************************************
+// ClusterCullerBench.cpp
+//
+// MeshletBuilder build time and ClusterCuller throughput on dense single submesh meshes
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "ClusterCuller.h"
+#include "MeshletBuilder.h"
+#include <initializer_list>
+
+namespace
+{
+	const float Pi = 3.14159265f;
+	const float FovY = 0.25f * Pi;
+	const float ViewportHeight = 1080.0f;
+	const int ViewCount = 64;
+
+	const DirectX::XMFLOAT4X4 Identity(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	// Culls the meshlets of the unit sphere from ViewCount eyes orbiting at aDistance, looking at a point aLookOffset
+	// in front of the center, and prints the time per view and the share of meshlets each test culled
+	void CullViews(const char* aName, const std::vector<Meshlet>& aMeshlets, size_t aIndexCount, float aDistance,
+		float aLookOffset, float aMinProjectedSize)
+	{
+		ClusterCuller Culler;
+		Culler.SetMinProjectedSize(aMinProjectedSize);
+		std::vector<ClusterCuller::IndexRange> Ranges;
+		size_t VisibleIndices = 0;
+		size_t RangeCount = 0;
+
+		double TotalMs = 0.0;
+		size_t Culled[3] = {};
+		for (int View = 0; View < ViewCount; View++)
+		{
+			float Angle = 2.0f * Pi * View / ViewCount;
+			DirectX::XMFLOAT3 Eye(aDistance * std::cos(Angle), 0.3f * aDistance * std::sin(3.0f * Angle), aDistance * std::sin(Angle));
+			DirectX::XMFLOAT3 Target(Eye.x * aLookOffset / aDistance, Eye.y * aLookOffset / aDistance, Eye.z * aLookOffset / aDistance);
+			Culler.SetView(BenchUtil::LookAtPerspective(Eye, Target, FovY, 16.0f / 9.0f, 0.05f, 1000.0f), Eye,
+				ViewportHeight / (2.0f * std::tan(0.5f * FovY)));
+
+			TotalMs += BenchUtil::MedianMs(5, [&]()
+			{
+				Ranges.clear();
+				Culler.Cull(aMeshlets.data(), aMeshlets.size(), Identity, 0, Ranges);
+			});
+
+			// One more cull for the counters of this view alone
+			Culler.ResetCounters();
+			Ranges.clear();
+			Culler.Cull(aMeshlets.data(), aMeshlets.size(), Identity, 0, Ranges);
+			Culled[0] += Culler.GetFrustumCulledCount();
+			Culled[1] += Culler.GetBackfaceCulledCount();
+			Culled[2] += Culler.GetSmallCulledCount();
+			RangeCount += Ranges.size();
+			for (const ClusterCuller::IndexRange& Range : Ranges)
+				VisibleIndices += Range.IndexCount;
+		}
+
+		double Meshlets = double(aMeshlets.size()) * ViewCount;
+		std::printf("    %-6s | cull %8.3f us/view | %5.1f%% triangles drawn in %6.1f ranges | meshlets culled: frustum %5.1f%%, backface %5.1f%%, small %5.1f%%\n",
+			aName, 1000.0 * TotalMs / ViewCount, 100.0 * VisibleIndices / (double(aIndexCount) * ViewCount),
+			double(RangeCount) / ViewCount, 100.0 * Culled[0] / Meshlets, 100.0 * Culled[1] / Meshlets, 100.0 * Culled[2] / Meshlets);
+	}
+}
+
+int main()
+{
+	// Dense meshes of the scanned kind that motivated per cluster culling
+	for (std::uint32_t Segments : { 64u, 128u, 256u })
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<std::uint32_t> Indices;
+		BenchUtil::AppendBumpySphere(Segments, Segments * 2, 1.0f, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), Vertices, Indices);
+
+		std::vector<std::uint32_t> Reordered;
+		std::vector<Meshlet> Meshlets;
+		double BuildMs = BenchUtil::MedianMs(3, [&]()
+		{
+			Reordered = Indices;
+			Meshlets = MeshletBuilder::Build(Vertices.data(), Vertices.size(), Reordered.data(), Reordered.size());
+		});
+
+		size_t ClusterVertices = 0;
+		for (const Meshlet& Cluster : Meshlets)
+			ClusterVertices += Cluster.VertexCount;
+		std::printf("%8zu triangles | %6zu meshlets, %.1f triangles and %.1f vertices each | build %8.2f ms\n",
+			Indices.size() / 3, Meshlets.size(), Indices.size() / 3.0 / Meshlets.size(), double(ClusterVertices) / Meshlets.size(), BuildMs);
+
+		// Whole mesh in view, a close up filling the screen and a distant view culling small clusters
+		CullViews("orbit", Meshlets, Indices.size(), 3.0f, 0.0f, 0.0f);
+		CullViews("close", Meshlets, Indices.size(), 1.3f, 1.0f, 0.0f);
+		CullViews("far", Meshlets, Indices.size(), 60.0f, 0.0f, 4.0f);
+	}
+	return 0;
+}
@@ -0,0 +1,69 @@
+//***************************************************************************************
+// FrustumCullerBench.cpp
+//
+// FrustumCuller over 100k world space boxes against a scalar per-box reference
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "FrustumCuller.h"
+#include <cmath>
+
+namespace
+{
+	// One box at a time from an array of BoundingBox, what culling the item list would look like without SoA streams
+	size_t CullScalar(const DirectX::XMFLOAT4* aPlanes, const std::vector<DirectX::BoundingBox>& aBoxes, std::vector<std::uint8_t>& aVisibility)
+	{
+		size_t Visible = 0;
+		for (size_t i = 0; i < aBoxes.size(); i++)
+		{
+			const DirectX::BoundingBox& Box = aBoxes[i];
+			bool bInside = true;
+			for (int p = 0; p < 6 && bInside; p++)
+			{
+				const DirectX::XMFLOAT4& P = aPlanes[p];
+				float Distance = P.x * Box.Center.x + P.y * Box.Center.y + P.z * Box.Center.z + P.w;
+				float Radius = std::fabs(P.x) * Box.Extents.x + std::fabs(P.y) * Box.Extents.y + std::fabs(P.z) * Box.Extents.z;
+				bInside = Distance + Radius >= 0.0f;
+			}
+			aVisibility[i] = bInside ? 1 : 0;
+			Visible += bInside;
+		}
+		return Visible;
+	}
+}
+
+int main()
+{
+	const size_t BoxCount = 100000;
+	BenchUtil::Random Rng;
+	SceneStore::WorldBoundsStreams Streams;
+	std::vector<DirectX::BoundingBox> Boxes(BoxCount);
+	for (size_t i = 0; i < BoxCount; i++)
+	{
+		DirectX::XMFLOAT3 Center(Rng.Range(-500.0f, 500.0f), Rng.Range(-20.0f, 20.0f), Rng.Range(-500.0f, 500.0f));
+		float Half = Rng.Range(0.1f, 4.0f);
+		Boxes[i] = DirectX::BoundingBox(Center, DirectX::XMFLOAT3(Half, Half, Half));
+		Streams.CenterX.push_back(Center.x);
+		Streams.CenterY.push_back(Center.y);
+		Streams.CenterZ.push_back(Center.z);
+		Streams.ExtentX.push_back(Half);
+		Streams.ExtentY.push_back(Half);
+		Streams.ExtentZ.push_back(Half);
+	}
+
+	FrustumCuller Culler;
+	Culler.SetViewProj(BenchUtil::LookAtPerspective(DirectX::XMFLOAT3(0.0f, 5.0f, -50.0f), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f),
+		0.25f * 3.14159265f, 16.0f / 9.0f, 1.0f, 1000.0f));
+	std::vector<std::uint8_t> ScalarVisibility(BoxCount);
+
+	double SimdMs = BenchUtil::MedianMs(51, [&]() { BenchUtil::Consume(Culler.Cull(Streams)); });
+	double ScalarMs = BenchUtil::MedianMs(51, [&]() { BenchUtil::Consume(CullScalar(Culler.GetPlanes(), Boxes, ScalarVisibility)); });
+
+	size_t Mismatches = 0;
+	for (size_t i = 0; i < BoxCount; i++)
+		Mismatches += Culler.IsVisible(i) != (ScalarVisibility[i] != 0);
+
+	std::printf("%zu boxes, %zu visible | SSE %7.3f ms (%6.1f Mboxes/s), scalar %7.3f ms (%5.2fx) | %zu mismatches\n",
+		BoxCount, Culler.GetVisibleCount(), SimdMs, BoxCount / SimdMs / 1000.0, ScalarMs, ScalarMs / SimdMs, Mismatches);
+	return Mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+//***************************************************************************************
+// MeshSimplifierBench.cpp
+//
+// LOD chain generation with MeshSimplifier: time and error per level, serial and across submeshes
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "MeshSimplifier.h"
+#include "ParallelFor.h"
+#include <thread>
+
+namespace
+{
+	struct Submesh
+	{
+		size_t FirstVertex = 0;
+		size_t VertexCount = 0;
+		size_t StartIndex = 0;
+		size_t IndexCount = 0;
+	};
+
+	const float TriangleRatios[] = { 0.5f, 0.25f, 0.1f };
+	const size_t LevelCount = sizeof(TriangleRatios) / sizeof(TriangleRatios[0]);
+
+	// One simplification per level and submesh, the job layout of ModelImporter::GenerateLods
+	void GenerateChain(const std::vector<Vertex>& aVertices, const std::vector<std::uint32_t>& aIndices,
+		const std::vector<Submesh>& aSubmeshes, bool bParallel, std::vector<MeshSimplifier::Result>& aOutResults)
+	{
+		aOutResults.assign(LevelCount * aSubmeshes.size(), {});
+		auto Body = [&](size_t aBegin, size_t aEnd)
+		{
+			for (size_t Job = aBegin; Job < aEnd; Job++)
+			{
+				const Submesh& Mesh = aSubmeshes[Job % aSubmeshes.size()];
+				size_t TargetIndexCount = size_t(Mesh.IndexCount * TriangleRatios[Job / aSubmeshes.size()]) / 3 * 3;
+				aOutResults[Job] = MeshSimplifier::Simplify(&aVertices[Mesh.FirstVertex], Mesh.VertexCount,
+					&aIndices[Mesh.StartIndex], Mesh.IndexCount, TargetIndexCount);
+			}
+		};
+		if (bParallel)
+			ParallelFor(aOutResults.size(), 1, Body);
+		else
+			Body(0, aOutResults.size());
+	}
+}
+
+int main()
+{
+	std::printf("Hardware threads: %u\n", std::thread::hardware_concurrency());
+
+	// A model of several sphere submeshes, the source triangle counts of the imported props
+	for (std::uint32_t Segments : { 16u, 32u, 64u })
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<std::uint32_t> Indices;
+		std::vector<Submesh> Submeshes;
+		for (int i = 0; i < 8; i++)
+		{
+			Submesh Mesh;
+			Mesh.FirstVertex = Vertices.size();
+			Mesh.StartIndex = Indices.size();
+			BenchUtil::AppendBumpySphere(Segments, Segments * 2, 1.0f, DirectX::XMFLOAT3(3.0f * i, 0.0f, 0.0f), Vertices, Indices);
+			Mesh.VertexCount = Vertices.size() - Mesh.FirstVertex;
+			Mesh.IndexCount = Indices.size() - Mesh.StartIndex;
+			Submeshes.push_back(Mesh);
+		}
+
+		std::vector<MeshSimplifier::Result> Serial, Parallel;
+		double SerialMs = BenchUtil::MedianMs(3, [&]() { GenerateChain(Vertices, Indices, Submeshes, false, Serial); });
+		double ParallelMs = BenchUtil::MedianMs(3, [&]() { GenerateChain(Vertices, Indices, Submeshes, true, Parallel); });
+
+		size_t Mismatches = 0;
+		for (size_t Job = 0; Job < Serial.size(); Job++)
+			Mismatches += Serial[Job].Indices != Parallel[Job].Indices;
+
+		std::printf("%8zu triangles in %zu submeshes | chain serial %9.2f ms, parallel %9.2f ms (%.2fx)%s\n",
+			Indices.size() / 3, Submeshes.size(), SerialMs, ParallelMs, SerialMs / ParallelMs,
+			Mismatches ? " | PARALLEL RESULTS DIFFER" : "");
+		for (size_t Level = 0; Level < LevelCount; Level++)
+		{
+			size_t Triangles = 0;
+			float Error = 0.0f;
+			for (size_t i = 0; i < Submeshes.size(); i++)
+			{
+				const MeshSimplifier::Result& Result = Serial[Level * Submeshes.size() + i];
+				Triangles += Result.Indices.size() / 3;
+				Error = std::max(Error, Result.Error);
+			}
+			std::printf("    LOD%zu ratio %.2f | %8zu triangles (%.3f of source), max error %.5f\n",
+				Level + 1, TriangleRatios[Level], Triangles, double(Triangles) / (Indices.size() / 3), Error);
+		}
+	}
+	return 0;
+}
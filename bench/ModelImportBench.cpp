@@ -0,0 +1,80 @@
+//***************************************************************************************
+// ModelImportBench.cpp
+//
+// Import time and peak memory of ModelImporter::LoadModel on the bundled FBX files.
+// Windows only, ModelImporter needs the D3D12 headers and assimp. It has not been built or run on
+// such a host yet, so no results from it have been recorded.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "ModelImporter.h"
+#include <initializer_list>
+#include <psapi.h>
+
+namespace
+{
+	struct MemoryUse
+	{
+		double WorkingSetMB = 0.0;
+		double PeakWorkingSetMB = 0.0;
+	};
+
+	MemoryUse GetMemoryUse()
+	{
+		PROCESS_MEMORY_COUNTERS Counters = {};
+		::GetProcessMemoryInfo(::GetCurrentProcess(), &Counters, sizeof(Counters));
+		return { Counters.WorkingSetSize / (1024.0 * 1024.0), Counters.PeakWorkingSetSize / (1024.0 * 1024.0) };
+	}
+
+	double GetMeshMB(const ModelImporter::ModelData& aModel)
+	{
+		size_t Bytes = aModel.Vertices.size() * sizeof(Vertex) + aModel.Indices16.size() * sizeof(std::uint16_t)
+			+ aModel.Indices32.size() * sizeof(std::uint32_t);
+		return Bytes / (1024.0 * 1024.0);
+	}
+}
+
+// Imports the given model files, or the bundled ones. The peak working set is a high water mark of the
+// process, pass a single file to read the peak of that file alone.
+int main(int argc, char** argv)
+{
+	std::vector<std::string> Paths;
+	for (int i = 1; i < argc; i++)
+		Paths.push_back(argv[i]);
+	if (Paths.empty())
+	{
+		for (const char* Path : { "Assets/Models/SMG/M24_R_Low_Poly_Version_fbx.fbx", "Assets/Models/Body.fbx",
+			"Assets/Models/Skull/skull_high.fbx", "Assets/Models/Skull/skull_low.fbx", "Assets/Models/Skull/skull_s.fbx",
+			"Assets/Models/Cross/cross_low.fbx" })
+			Paths.push_back(std::string(ASSET_ROOT) + Path);
+	}
+
+	MemoryUse Baseline = GetMemoryUse();
+	std::printf("Baseline working set %.1f MB\n", Baseline.WorkingSetMB);
+	for (const std::string& Path : Paths)
+	{
+		// The first load is measured for memory, the timed runs reuse nothing but the file cache
+		MemoryUse Before = GetMemoryUse();
+		ModelImporter::ModelData Model;
+		if (!ModelImporter::LoadModel(Path, Model))
+		{
+			std::printf("%s: failed to load\n", Path.c_str());
+			continue;
+		}
+		MemoryUse After = GetMemoryUse();
+
+		double LoadMs = BenchUtil::MedianMs(3, [&]()
+		{
+			ModelImporter::ModelData Reloaded;
+			ModelImporter::LoadModel(Path, Reloaded);
+			BenchUtil::Consume(Reloaded.Vertices.size());
+		});
+
+		size_t IndexCount = Model.Use32BitIndices ? Model.Indices32.size() : Model.Indices16.size();
+		std::printf("%-60s | %8zu vertices, %9zu indices, %7.2f MB mesh | load %8.2f ms | peak working set %7.1f MB (+%.1f MB over the working set before)\n",
+			Path.c_str(), Model.Vertices.size(), IndexCount, GetMeshMB(Model), LoadMs, After.PeakWorkingSetMB,
+			After.PeakWorkingSetMB - Before.WorkingSetMB);
+	}
+	ModelImporter::Cleanup();
+	return 0;
+}
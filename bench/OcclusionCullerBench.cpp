@@ -0,0 +1,82 @@
+//***************************************************************************************
+// OcclusionCullerBench.cpp
+//
+// OcclusionCuller rasterization and box test throughput on a synthetic city block scene
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "OcclusionCuller.h"
+
+namespace
+{
+	// Closed box of 12 triangles, the shape of most large occluders (walls, buildings)
+	struct BoxMesh
+	{
+		DirectX::XMFLOAT3 Positions[8];
+		std::uint16_t Indices[36] = {
+			0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6, 0, 4, 5, 0, 5, 1,
+			3, 2, 6, 3, 6, 7, 0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2 };
+
+		BoxMesh()
+		{
+			for (int i = 0; i < 8; i++)
+				Positions[i] = DirectX::XMFLOAT3((i & 1) ^ ((i >> 1) & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f);
+		}
+	};
+
+	DirectX::XMFLOAT4X4 ScaleTranslation(float aScaleX, float aScaleY, float aScaleZ, float aX, float aY, float aZ)
+	{
+		return DirectX::XMFLOAT4X4(
+			aScaleX, 0.0f, 0.0f, 0.0f,
+			0.0f, aScaleY, 0.0f, 0.0f,
+			0.0f, 0.0f, aScaleZ, 0.0f,
+			aX, aY, aZ, 1.0f);
+	}
+}
+
+int main()
+{
+	// Buildings on a grid in front of the camera are the occluders, small props between and behind them the boxes
+	BenchUtil::Random Rng;
+	BoxMesh Box;
+	std::vector<DirectX::XMFLOAT4X4> Buildings;
+	for (int z = 0; z < 8; z++)
+		for (int x = -4; x < 4; x++)
+			Buildings.push_back(ScaleTranslation(12.0f, Rng.Range(10.0f, 40.0f), 12.0f, x * 20.0f + 10.0f, 0.0f, 30.0f + z * 20.0f));
+
+	const size_t PropCount = 100000;
+	SceneStore::WorldBoundsStreams Props;
+	for (size_t i = 0; i < PropCount; i++)
+	{
+		Props.CenterX.push_back(Rng.Range(-80.0f, 80.0f));
+		Props.CenterY.push_back(Rng.Range(0.0f, 5.0f));
+		Props.CenterZ.push_back(Rng.Range(20.0f, 200.0f));
+		Props.ExtentX.push_back(0.5f);
+		Props.ExtentY.push_back(0.5f);
+		Props.ExtentZ.push_back(0.5f);
+	}
+	std::vector<std::uint8_t> InVisibility(PropCount, 1);
+
+	DirectX::XMFLOAT4X4 ViewProj = BenchUtil::LookAtPerspective(DirectX::XMFLOAT3(0.0f, 3.0f, 0.0f), DirectX::XMFLOAT3(0.0f, 3.0f, 1.0f),
+		0.25f * 3.14159265f, 16.0f / 9.0f, 0.5f, 500.0f);
+
+	for (std::uint32_t Width : { 128u, 256u, 512u })
+	{
+		OcclusionCuller Culler;
+		Culler.Resize(Width, Width * 9 / 16);
+		double RasterMs = BenchUtil::MedianMs(51, [&]()
+		{
+			Culler.BeginFrame(ViewProj);
+			for (const DirectX::XMFLOAT4X4& World : Buildings)
+				Culler.RasterizeOccluder(Box.Positions, sizeof(DirectX::XMFLOAT3), 8, Box.Indices, false, 36, 0, World);
+			Culler.EndOccluders();
+		});
+		size_t Triangles = Culler.GetRasterizedTriangleCount();
+		double TestMs = BenchUtil::MedianMs(21, [&]() { BenchUtil::Consume(Culler.Cull(Props, InVisibility)); });
+
+		std::printf("%3ux%-3u | raster %zu triangles %.3f ms (%.2f Mtris/s) | test %zu boxes %.3f ms (%.1f Mboxes/s), %.1f%% occluded\n",
+			Culler.GetWidth(), Culler.GetHeight(), Triangles, RasterMs, Triangles / RasterMs / 1000.0,
+			PropCount, TestMs, PropCount / TestMs / 1000.0, 100.0 * Culler.GetOccludedCount() / PropCount);
+	}
+	return 0;
+}
@@ -0,0 +1,146 @@
+//***************************************************************************************
+// ParallelImportBench.cpp
+//
+// Scaling of the CPU phase of model import over worker threads, checked against serial imports
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "ParallelFor.h"
+#include <thread>
+
+namespace
+{
+	struct Submesh
+	{
+		size_t FirstVertex = 0;
+		size_t VertexCount = 0;
+		size_t StartIndex = 0;
+		size_t IndexCount = 0;
+	};
+
+	struct Model
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<std::uint32_t> Indices;
+		std::vector<Submesh> Submeshes;
+	};
+
+	// Output of the processing steps BuildGeometryResource runs on every import
+	struct ImportResult
+	{
+		std::vector<std::uint32_t> Indices;
+		std::vector<std::vector<std::uint32_t>> LodIndices;
+		std::vector<Meshlet> Meshlets;
+
+		bool operator==(const ImportResult& aOther) const
+		{
+			if (Indices != aOther.Indices || LodIndices != aOther.LodIndices || Meshlets.size() != aOther.Meshlets.size())
+				return false;
+			for (size_t i = 0; i < Meshlets.size(); i++)
+				if (Meshlets[i].IndexStart != aOther.Meshlets[i].IndexStart || Meshlets[i].IndexCount != aOther.Meshlets[i].IndexCount)
+					return false;
+			return true;
+		}
+	};
+
+	// The per submesh loops of OptimizeModel, GenerateLods and BuildMeshlets, each a ParallelFor like in ModelImporter
+	ImportResult Import(const Model& aModel)
+	{
+		ImportResult Result;
+		Result.Indices = aModel.Indices;
+		ParallelFor(aModel.Submeshes.size(), 1, [&](size_t aBegin, size_t aEnd)
+		{
+			for (size_t i = aBegin; i < aEnd; i++)
+			{
+				const Submesh& Mesh = aModel.Submeshes[i];
+				MeshOptimizer::OptimizeVertexCache(&Result.Indices[Mesh.StartIndex], Mesh.IndexCount, Mesh.VertexCount);
+			}
+		});
+
+		Result.LodIndices.resize(aModel.Submeshes.size());
+		ParallelFor(aModel.Submeshes.size(), 1, [&](size_t aBegin, size_t aEnd)
+		{
+			for (size_t i = aBegin; i < aEnd; i++)
+			{
+				const Submesh& Mesh = aModel.Submeshes[i];
+				Result.LodIndices[i] = MeshSimplifier::Simplify(&aModel.Vertices[Mesh.FirstVertex], Mesh.VertexCount,
+					&Result.Indices[Mesh.StartIndex], Mesh.IndexCount, Mesh.IndexCount / 4 / 3 * 3).Indices;
+			}
+		});
+
+		std::vector<std::vector<Meshlet>> SubmeshMeshlets(aModel.Submeshes.size());
+		ParallelFor(aModel.Submeshes.size(), 1, [&](size_t aBegin, size_t aEnd)
+		{
+			for (size_t i = aBegin; i < aEnd; i++)
+			{
+				const Submesh& Mesh = aModel.Submeshes[i];
+				SubmeshMeshlets[i] = MeshletBuilder::Build(&aModel.Vertices[Mesh.FirstVertex], Mesh.VertexCount,
+					&Result.Indices[Mesh.StartIndex], Mesh.IndexCount);
+			}
+		});
+		for (const std::vector<Meshlet>& Meshlets : SubmeshMeshlets)
+			Result.Meshlets.insert(Result.Meshlets.end(), Meshlets.begin(), Meshlets.end());
+		return Result;
+	}
+}
+
+int main()
+{
+	unsigned HardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::printf("Hardware threads: %u\n", HardwareThreads);
+
+	// Six models of uneven size like the bundled set, from a few to many submeshes
+	std::vector<Model> Models(6);
+	for (size_t m = 0; m < Models.size(); m++)
+	{
+		Model& Target = Models[m];
+		std::uint32_t Segments = 12 + 6 * std::uint32_t(m);
+		for (size_t s = 0; s < 2 + m; s++)
+		{
+			Submesh Mesh;
+			Mesh.FirstVertex = Target.Vertices.size();
+			Mesh.StartIndex = Target.Indices.size();
+			BenchUtil::AppendBumpySphere(Segments, Segments * 2, 1.0f, DirectX::XMFLOAT3(3.0f * s, 0.0f, 0.0f), Target.Vertices, Target.Indices);
+			Mesh.VertexCount = Target.Vertices.size() - Mesh.FirstVertex;
+			Mesh.IndexCount = Target.Indices.size() - Mesh.StartIndex;
+			Target.Submeshes.push_back(Mesh);
+		}
+	}
+
+	// One model after another, each using the cores for its own submeshes
+	std::vector<ImportResult> Serial(Models.size());
+	double SerialMs = BenchUtil::MedianMs(3, [&]()
+	{
+		for (size_t m = 0; m < Models.size(); m++)
+			Serial[m] = Import(Models[m]);
+	});
+	std::printf("serial imports     | %9.2f ms\n", SerialMs);
+
+	// Models on import workers, whose nested submesh loops then run inline. At least four workers, so small
+	// hosts still compare concurrent imports with serial ones.
+	unsigned MaxThreads = std::max(HardwareThreads, 4u);
+	for (unsigned Threads = 1; ; Threads = std::min(Threads * 2, MaxThreads))
+	{
+		std::vector<ImportResult> Concurrent(Models.size());
+		double ConcurrentMs = BenchUtil::MedianMs(3, [&]()
+		{
+			ParallelFor(Models.size(), 1, [&](size_t aBegin, size_t aEnd)
+			{
+				for (size_t m = aBegin; m < aEnd; m++)
+					Concurrent[m] = Import(Models[m]);
+			}, Threads);
+		});
+
+		size_t Mismatches = 0;
+		for (size_t m = 0; m < Models.size(); m++)
+			Mismatches += !(Concurrent[m] == Serial[m]);
+		std::printf("%2u import threads   | %9.2f ms (%.2fx serial)%s\n", Threads, ConcurrentMs, SerialMs / ConcurrentMs,
+			Mismatches ? " | RESULTS DIFFER FROM SERIAL IMPORTS" : "");
+		if (Threads == MaxThreads)
+			break;
+	}
+	return 0;
+}
@@ -0,0 +1,79 @@
+//***************************************************************************************
+// RenderQueueBench.cpp
+//
+// RenderQueue radix sort time at 10k to 1M entries and the state changes it saves
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "RenderQueue.h"
+#include <algorithm>
+
+namespace
+{
+	// PSO, mesh and material transitions between consecutive keys
+	size_t CountStateChanges(const std::vector<std::uint64_t>& aKeys)
+	{
+		size_t Changes = aKeys.empty() ? 0 : 3;
+		for (size_t i = 1; i < aKeys.size(); i++)
+		{
+			Changes += RenderQueue::GetPso(aKeys[i]) != RenderQueue::GetPso(aKeys[i - 1]);
+			Changes += RenderQueue::GetMesh(aKeys[i]) != RenderQueue::GetMesh(aKeys[i - 1]);
+			Changes += RenderQueue::GetMaterial(aKeys[i]) != RenderQueue::GetMaterial(aKeys[i - 1]);
+		}
+		return Changes;
+	}
+
+	void Run(size_t aCount)
+	{
+		// Items are pushed layer by layer like QueueRenderLayers does, in scene order inside a layer
+		BenchUtil::Random Rng;
+		std::vector<std::uint64_t> SubmittedKeys(aCount);
+		const std::uint32_t Layers = 4;
+		for (size_t i = 0; i < aCount; i++)
+		{
+			std::uint32_t Bucket = static_cast<std::uint32_t>(i * Layers / aCount);
+			std::uint32_t Mesh = static_cast<std::uint32_t>(Rng.Next() % 256);
+			std::uint32_t Material = static_cast<std::uint32_t>(Rng.Next() % 64);
+			std::uint32_t Depth = RenderQueue::QuantizeDepth(Rng.Range(0.0f, 1000.0f), 1000.0f);
+			SubmittedKeys[i] = RenderQueue::MakeKey(Bucket, Bucket % 3, Mesh, Material, Depth);
+		}
+
+		RenderQueue Queue;
+		Queue.Reserve(aCount);
+		auto Refill = [&]()
+		{
+			Queue.Clear();
+			for (size_t i = 0; i < aCount; i++)
+				Queue.Push(SubmittedKeys[i], static_cast<std::uint32_t>(i));
+		};
+
+		const int Runs = aCount >= 1000000 ? 9 : 31;
+		double RefillMs = BenchUtil::MedianMs(Runs, Refill);
+		double RadixMs = BenchUtil::MedianMs(Runs, [&]() { Refill(); Queue.Sort(); }) - RefillMs;
+
+		std::vector<std::pair<std::uint64_t, std::uint32_t>> Pairs(aCount);
+		double StdSortMs = BenchUtil::MedianMs(Runs, [&]()
+		{
+			for (size_t i = 0; i < aCount; i++)
+				Pairs[i] = { SubmittedKeys[i], static_cast<std::uint32_t>(i) };
+			std::sort(Pairs.begin(), Pairs.end());
+		}) - RefillMs;
+
+		Refill();
+		Queue.Sort();
+		bool bSorted = std::is_sorted(Queue.GetKeys().begin(), Queue.GetKeys().end());
+		size_t SubmittedChanges = CountStateChanges(SubmittedKeys);
+		size_t SortedChanges = CountStateChanges(Queue.GetKeys());
+
+		std::printf("%8zu keys | radix %8.3f ms, std::sort %8.3f ms | state changes: submitted %8zu, sorted %6zu, saved %8zu%s\n",
+			aCount, RadixMs, StdSortMs, SubmittedChanges, SortedChanges, SubmittedChanges - SortedChanges,
+			bSorted ? "" : " NOT SORTED");
+	}
+}
+
+int main()
+{
+	for (size_t Count : { size_t(10000), size_t(100000), size_t(1000000) })
+		Run(Count);
+	return 0;
+}
@@ -0,0 +1,143 @@
+//***************************************************************************************
+// SceneBVHBench.cpp
+//
+// SceneBVH at 100k items: build, cost per moved object, frustum queries and batched rays
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "FrustumCuller.h"
+#include "SceneBVH.h"
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	const size_t ItemCount = 100000;
+	const float WorldHalfSize = 500.0f;
+
+	DirectX::BoundingBox GetBox(const SceneStore::WorldBoundsStreams& aBounds, size_t aItem)
+	{
+		return DirectX::BoundingBox(
+			DirectX::XMFLOAT3(aBounds.CenterX[aItem], aBounds.CenterY[aItem], aBounds.CenterZ[aItem]),
+			DirectX::XMFLOAT3(aBounds.ExtentX[aItem], aBounds.ExtentY[aItem], aBounds.ExtentZ[aItem]));
+	}
+
+	// Keeps moved items inside the world without piling them up on its border
+	float Wrap(float aCoordinate)
+	{
+		if (aCoordinate > WorldHalfSize)
+			return aCoordinate - 2.0f * WorldHalfSize;
+		if (aCoordinate < -WorldHalfSize)
+			return aCoordinate + 2.0f * WorldHalfSize;
+		return aCoordinate;
+	}
+
+	// Moves aMoveCount random items by up to aDistance and returns the nanoseconds per moved item
+	double TimeMoves(SceneBVH& aTree, SceneStore::WorldBoundsStreams& aBounds, BenchUtil::Random& aRng, size_t aMoveCount, float aDistance,
+		size_t& aOutTreeChanges)
+	{
+		aOutTreeChanges = 0;
+		auto Start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < aMoveCount; i++)
+		{
+			size_t Item = aRng.Next() % ItemCount;
+			aBounds.CenterX[Item] = Wrap(aBounds.CenterX[Item] + aRng.Range(-aDistance, aDistance));
+			aBounds.CenterZ[Item] = Wrap(aBounds.CenterZ[Item] + aRng.Range(-aDistance, aDistance));
+			aOutTreeChanges += aTree.Update(static_cast<SceneBVH::ItemId>(Item), GetBox(aBounds, Item));
+		}
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count() / aMoveCount;
+	}
+}
+
+int main()
+{
+	BenchUtil::Random Rng;
+	SceneStore::WorldBoundsStreams Bounds;
+	for (size_t i = 0; i < ItemCount; i++)
+	{
+		float Half = Rng.Range(0.2f, 3.0f);
+		Bounds.CenterX.push_back(Rng.Range(-WorldHalfSize, WorldHalfSize));
+		Bounds.CenterY.push_back(Rng.Range(-10.0f, 10.0f));
+		Bounds.CenterZ.push_back(Rng.Range(-WorldHalfSize, WorldHalfSize));
+		Bounds.ExtentX.push_back(Half);
+		Bounds.ExtentY.push_back(Half);
+		Bounds.ExtentZ.push_back(Half);
+	}
+
+	SceneBVH Tree;
+	double BuildMs = BenchUtil::MedianMs(5, [&]() { Tree.Build(Bounds); });
+	std::printf("Build %zu items: %.2f ms, depth %u, SAH cost %.1f\n", ItemCount, BuildMs, Tree.GetDepth(), Tree.GetSahCost());
+
+	const size_t MoveCount = 100000;
+	for (float Distance : { 0.05f, 1.0f, 10.0f, WorldHalfSize })
+	{
+		size_t TreeChanges = 0;
+		double NsPerMove = TimeMoves(Tree, Bounds, Rng, MoveCount, Distance, TreeChanges);
+		std::printf("Moves up to %7.2f units: %7.1f ns per moved item, %5.1f%% re-inserted\n",
+			Distance, NsPerMove, 100.0 * TreeChanges / MoveCount);
+	}
+	std::printf("After the moves: depth %u, SAH cost %.1f\n", Tree.GetDepth(), Tree.GetSahCost());
+
+	// Frustum query against testing every box
+	FrustumCuller Culler;
+	Culler.SetViewProj(BenchUtil::LookAtPerspective(DirectX::XMFLOAT3(0.0f, 20.0f, -WorldHalfSize), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f),
+		0.25f * 3.14159265f, 16.0f / 9.0f, 1.0f, 300.0f));
+	std::vector<SceneBVH::ItemId> Candidates;
+	double QueryMs = BenchUtil::MedianMs(21, [&]() { Candidates.clear(); Tree.QueryFrustum(Culler.GetPlanes(), Candidates); });
+	double FlatMs = BenchUtil::MedianMs(21, [&]() { BenchUtil::Consume(Culler.Cull(Bounds)); });
+	std::printf("Frustum: BVH query %.3f ms (%zu candidates), flat SSE cull %.3f ms (%zu visible)\n",
+		QueryMs, Candidates.size(), FlatMs, Culler.GetVisibleCount());
+
+	// Rays from above into the scene, the hit test intersects the exact item box
+	const size_t RayCount = 100000;
+	std::vector<SceneBVH::Ray> Rays(RayCount);
+	for (SceneBVH::Ray& Ray : Rays)
+	{
+		Ray.Origin = DirectX::XMFLOAT3(Rng.Range(-WorldHalfSize, WorldHalfSize), 50.0f, Rng.Range(-WorldHalfSize, WorldHalfSize));
+		Ray.Direction = DirectX::XMFLOAT3(Rng.Range(-0.2f, 0.2f), -1.0f, Rng.Range(-0.2f, 0.2f));
+	}
+	auto HitBox = [&](SceneBVH::ItemId aItem, float& aDistance, const SceneBVH::Ray& aRay)
+	{
+		const float Origin[3] = { aRay.Origin.x, aRay.Origin.y, aRay.Origin.z };
+		const float Direction[3] = { aRay.Direction.x, aRay.Direction.y, aRay.Direction.z };
+		const float Center[3] = { Bounds.CenterX[aItem], Bounds.CenterY[aItem], Bounds.CenterZ[aItem] };
+		const float Extent[3] = { Bounds.ExtentX[aItem], Bounds.ExtentY[aItem], Bounds.ExtentZ[aItem] };
+		float Enter = 0.0f;
+		float Exit = aDistance;
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			float InvDirection = 1.0f / (Direction[Axis] != 0.0f ? Direction[Axis] : 1e-30f);
+			float T0 = (Center[Axis] - Extent[Axis] - Origin[Axis]) * InvDirection;
+			float T1 = (Center[Axis] + Extent[Axis] - Origin[Axis]) * InvDirection;
+			Enter = std::fmax(Enter, std::fmin(T0, T1));
+			Exit = std::fmin(Exit, std::fmax(T0, T1));
+		}
+		if (Enter > Exit)
+			return false;
+		aDistance = Enter;
+		return true;
+	};
+	std::vector<SceneBVH::RayHit> Hits(RayCount);
+	double SerialMs = BenchUtil::MedianMs(5, [&]()
+	{
+		for (size_t i = 0; i < RayCount; i++)
+			Hits[i] = Tree.Raycast(Rays[i], [&](SceneBVH::ItemId aItem, float& aDistance) { return HitBox(aItem, aDistance, Rays[i]); });
+	});
+	std::vector<SceneBVH::RayHit> BatchHits(RayCount);
+	double BatchMs = BenchUtil::MedianMs(5, [&]()
+	{
+		Tree.RaycastBatch(Rays.data(), RayCount, BatchHits.data(), [&](size_t aRay, SceneBVH::ItemId aItem, float& aDistance)
+		{
+			return HitBox(aItem, aDistance, Rays[aRay]);
+		});
+	});
+	size_t Mismatches = 0;
+	for (size_t i = 0; i < RayCount; i++)
+		Mismatches += Hits[i].Item != BatchHits[i].Item;
+	size_t HitCount = 0;
+	for (const SceneBVH::RayHit& Hit : Hits)
+		HitCount += Hit.Item != SceneStore::InvalidItem;
+	std::printf("Rays: %zu rays, %zu hits | serial %.2f ms, RaycastBatch %.2f ms (%.2fx) | %zu mismatches\n",
+		RayCount, HitCount, SerialMs, BatchMs, SerialMs / BatchMs, Mismatches);
+	return Mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+//***************************************************************************************
+// SceneStoreBench.cpp
+//
+// Per-frame loops over SceneStore against the previous vector<unique_ptr<RenderItem>> layout
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "SceneStore.h"
+#include <cmath>
+#include <memory>
+#include <string>
+
+namespace
+{
+	// Layout of ShapesApp::RenderItem before SceneStore
+	struct LegacyRenderItem
+	{
+		std::string Name;
+		DirectX::XMFLOAT4X4 World;
+		std::uint32_t ObjConstBufferIndex = 0;
+		void* MeshGeometryRef = nullptr;
+		void* MaterialRef = nullptr;
+		DirectX::BoundingBox Bounds;
+		std::uint32_t IndexCount = 0;
+		std::uint32_t IndexStartLocation = 0;
+		std::uint32_t VertexStartLocation = 0;
+	};
+
+	DirectX::XMFLOAT4X4 Translation(float aX, float aY, float aZ)
+	{
+		return DirectX::XMFLOAT4X4(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			aX, aY, aZ, 1.0f);
+	}
+
+	void Transpose(const DirectX::XMFLOAT4X4& aIn, DirectX::XMFLOAT4X4& aOut)
+	{
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++)
+				aOut.m[c][r] = aIn.m[r][c];
+	}
+
+	// World space center x of a local box, the culling input the legacy layout recomputes every frame
+	float WorldCenterX(const DirectX::XMFLOAT4X4& M, const DirectX::BoundingBox& aBox)
+	{
+		const DirectX::XMFLOAT3& C = aBox.Center;
+		return C.x * M._11 + C.y * M._21 + C.z * M._31 + M._41;
+	}
+
+	void Run(size_t aItemCount)
+	{
+		BenchUtil::Random Rng;
+		SceneStore Store(1, 3);
+		Store.Reserve(aItemCount);
+		std::vector<std::unique_ptr<LegacyRenderItem>> Legacy;
+		// The app allocates names, materials and geometry between items, so nodes do not end up adjacent
+		std::vector<std::unique_ptr<char[]>> Interleaved;
+		DirectX::BoundingBox Box(DirectX::XMFLOAT3(0.0f, 0.5f, 0.0f), DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f));
+		for (size_t i = 0; i < aItemCount; i++)
+		{
+			DirectX::XMFLOAT4X4 World = Translation(Rng.Range(-500.0f, 500.0f), 0.0f, Rng.Range(-500.0f, 500.0f));
+			std::string Name = "Item" + std::to_string(i);
+			SceneStore::DrawArgs Args;
+			Args.IndexCount = 36;
+			Store.AddItem(Name, 0, World, Box, Args, static_cast<std::uint32_t>(i % 8));
+
+			auto Item = std::make_unique<LegacyRenderItem>();
+			Item->Name = Name;
+			Item->World = World;
+			Item->Bounds = Box;
+			Item->IndexCount = 36;
+			Legacy.push_back(std::move(Item));
+			Interleaved.emplace_back(new char[16 + Rng.Next() % 256]);
+		}
+
+		std::vector<DirectX::XMFLOAT4X4> Uploaded(aItemCount);
+		const int Runs = aItemCount >= 100000 ? 15 : 51;
+
+		double LegacyUploadMs = BenchUtil::MedianMs(Runs, [&]()
+		{
+			for (size_t i = 0; i < Legacy.size(); i++)
+				Transpose(Legacy[i]->World, Uploaded[i]);
+			BenchUtil::Consume(Uploaded.back()._41);
+		});
+		double StoreUploadMs = BenchUtil::MedianMs(Runs, [&]()
+		{
+			const std::vector<DirectX::XMFLOAT4X4>& Worlds = Store.GetWorlds();
+			for (size_t i = 0; i < Worlds.size(); i++)
+				Transpose(Worlds[i], Uploaded[i]);
+			BenchUtil::Consume(Uploaded.back()._41);
+		});
+
+		double LegacyBoundsMs = BenchUtil::MedianMs(Runs, [&]()
+		{
+			size_t Visible = 0;
+			for (const auto& Item : Legacy)
+				Visible += WorldCenterX(Item->World, Item->Bounds) > 0.0f;
+			BenchUtil::Consume(Visible);
+		});
+		double StoreBoundsMs = BenchUtil::MedianMs(Runs, [&]()
+		{
+			const std::vector<float>& CenterX = Store.GetAllWorldBounds().CenterX;
+			size_t Visible = 0;
+			for (float X : CenterX)
+				Visible += X > 0.0f;
+			BenchUtil::Consume(Visible);
+		});
+
+		std::printf("%7zu items | upload: legacy %8.3f ms, store %8.3f ms (%5.2fx) | bounds: legacy %8.3f ms, store %8.3f ms (%5.2fx)\n",
+			aItemCount, LegacyUploadMs, StoreUploadMs, LegacyUploadMs / StoreUploadMs,
+			LegacyBoundsMs, StoreBoundsMs, LegacyBoundsMs / StoreBoundsMs);
+	}
+}
+
+int main()
+{
+	for (size_t ItemCount : { size_t(1000), size_t(10000), size_t(100000) })
+		Run(ItemCount);
+	return 0;
+}
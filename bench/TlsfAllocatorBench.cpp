@@ -0,0 +1,106 @@
+//***************************************************************************************
+// TlsfAllocatorBench.cpp
+//
+// TlsfAllocator against RangeAllocator under allocation churn at growing live allocation counts
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "RangeAllocator.h"
+#include "TlsfAllocator.h"
+#include <chrono>
+#include <initializer_list>
+
+namespace
+{
+	// Resource sized requests: buffers of 256 bytes up to textures of 2 MB, 64 KB aligned when large like
+	// D3D12 placed resources. About 128 KB on average.
+	struct Request
+	{
+		std::uint64_t Size = 0;
+		std::uint64_t Alignment = 1;
+	};
+
+	Request MakeRequest(BenchUtil::Random& aRng)
+	{
+		std::uint64_t Size = std::uint64_t(256) << (aRng.Next() % 12);
+		Size += aRng.Next() % Size;
+		return { Size, Size >= 65536 ? 65536u : 256u };
+	}
+
+	struct TlsfAdapter
+	{
+		using Handle = TlsfAllocator::Allocation;
+		TlsfAllocator Allocator;
+
+		explicit TlsfAdapter(std::uint64_t aCapacity) : Allocator(aCapacity) {}
+		Handle Allocate(const Request& aRequest) { return Allocator.Allocate(aRequest.Size, aRequest.Alignment); }
+		static bool IsValid(const Handle& aHandle) { return aHandle.IsValid(); }
+		void Free(const Handle& aHandle) { Allocator.Free(aHandle); }
+		float GetFragmentation() const { return Allocator.GetFragmentation(); }
+	};
+
+	struct RangeAdapter
+	{
+		using Handle = std::uint64_t;
+		RangeAllocator Allocator;
+
+		explicit RangeAdapter(std::uint64_t aCapacity) : Allocator(aCapacity) {}
+		Handle Allocate(const Request& aRequest) { return Allocator.Allocate(aRequest.Size, aRequest.Alignment); }
+		static bool IsValid(Handle aHandle) { return aHandle != RangeAllocator::InvalidOffset; }
+		void Free(Handle aHandle) { Allocator.Free(aHandle); }
+		float GetFragmentation() const
+		{
+			std::uint64_t FreeSize = Allocator.GetFreeSize();
+			return FreeSize > 0 ? 1.0f - float(Allocator.GetLargestFreeRange()) / float(FreeSize) : 0.0f;
+		}
+	};
+
+	struct Result
+	{
+		double NsPerPair = 0.0;
+		size_t Failures = 0;
+		float Fragmentation = 0.0f;
+	};
+
+	// Fills the allocator with aLiveCount allocations, then frees a random one and allocates a new one aChurn times
+	template<typename Adapter>
+	Result Churn(std::uint64_t aCapacity, size_t aLiveCount, size_t aChurn)
+	{
+		Adapter Heap(aCapacity);
+		BenchUtil::Random Rng;
+		std::vector<typename Adapter::Handle> Live;
+		Live.reserve(aLiveCount);
+		while (Live.size() < aLiveCount)
+			Live.push_back(Heap.Allocate(MakeRequest(Rng)));
+
+		Result Out;
+		auto Start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < aChurn; i++)
+		{
+			typename Adapter::Handle& Slot = Live[Rng.Next() % Live.size()];
+			if (Adapter::IsValid(Slot))
+				Heap.Free(Slot);
+			Slot = Heap.Allocate(MakeRequest(Rng));
+			Out.Failures += !Adapter::IsValid(Slot);
+		}
+		Out.NsPerPair = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count() / aChurn;
+		Out.Fragmentation = Heap.GetFragmentation();
+		return Out;
+	}
+}
+
+int main()
+{
+	const size_t ChurnCount = 200000;
+	for (size_t LiveCount : { 1000u, 10000u, 100000u })
+	{
+		// 1.5 times the average live size, a heap running fairly full like a budgeted GPU heap
+		std::uint64_t Capacity = LiveCount * 192ull * 1024ull;
+		Result Tlsf = Churn<TlsfAdapter>(Capacity, LiveCount, ChurnCount);
+		Result Range = Churn<RangeAdapter>(Capacity, LiveCount, ChurnCount);
+		std::printf("%7zu live | TLSF %7.1f ns per free + allocate, %5zu failed, fragmentation %.3f"
+			" | RangeAllocator %7.1f ns, %5zu failed, fragmentation %.3f\n",
+			LiveCount, Tlsf.NsPerPair, Tlsf.Failures, Tlsf.Fragmentation, Range.NsPerPair, Range.Failures, Range.Fragmentation);
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+//***************************************************************************************
+// TriangleBVHBench.cpp
+//
+// TriangleBVH build time and closest hit picking cost up to a 1M triangle scan sized mesh, against the
+// linear triangle loop Pick used before
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "TriangleBVH.h"
+#include <chrono>
+#include <initializer_list>
+
+namespace
+{
+	// The loop of the old Pick: every triangle, Moller-Trumbore, closest distance kept
+	float IntersectLinear(const std::vector<Vertex>& aVertices, const std::vector<std::uint32_t>& aIndices,
+		const DirectX::XMFLOAT3& aOrigin, const DirectX::XMFLOAT3& aDirection)
+	{
+		float Closest = FLT_MAX;
+		for (size_t i = 0; i + 3 <= aIndices.size(); i += 3)
+		{
+			const DirectX::XMFLOAT3& V0 = aVertices[aIndices[i]].Position;
+			const DirectX::XMFLOAT3& V1 = aVertices[aIndices[i + 1]].Position;
+			const DirectX::XMFLOAT3& V2 = aVertices[aIndices[i + 2]].Position;
+			float E1[3] = { V1.x - V0.x, V1.y - V0.y, V1.z - V0.z };
+			float E2[3] = { V2.x - V0.x, V2.y - V0.y, V2.z - V0.z };
+			float P[3] = { aDirection.y * E2[2] - aDirection.z * E2[1], aDirection.z * E2[0] - aDirection.x * E2[2], aDirection.x * E2[1] - aDirection.y * E2[0] };
+			float Det = E1[0] * P[0] + E1[1] * P[1] + E1[2] * P[2];
+			if (Det == 0.0f)
+				continue;
+			float InvDet = 1.0f / Det;
+			float T[3] = { aOrigin.x - V0.x, aOrigin.y - V0.y, aOrigin.z - V0.z };
+			float U = (T[0] * P[0] + T[1] * P[1] + T[2] * P[2]) * InvDet;
+			if (U < 0.0f || U > 1.0f)
+				continue;
+			float Q[3] = { T[1] * E1[2] - T[2] * E1[1], T[2] * E1[0] - T[0] * E1[2], T[0] * E1[1] - T[1] * E1[0] };
+			float V = (aDirection.x * Q[0] + aDirection.y * Q[1] + aDirection.z * Q[2]) * InvDet;
+			if (V < 0.0f || U + V > 1.0f)
+				continue;
+			float Distance = (E2[0] * Q[0] + E2[1] * Q[1] + E2[2] * Q[2]) * InvDet;
+			if (Distance > 0.0f && Distance < Closest)
+				Closest = Distance;
+		}
+		return Closest;
+	}
+
+	struct Ray
+	{
+		DirectX::XMFLOAT3 Origin;
+		DirectX::XMFLOAT3 Direction;
+	};
+
+	// Mouse picks from a camera 4 units away, about three in five over the mesh
+	std::vector<Ray> MakeRays(size_t aCount)
+	{
+		BenchUtil::Random Rng;
+		std::vector<Ray> Rays;
+		for (size_t i = 0; i < aCount; i++)
+		{
+			DirectX::XMFLOAT3 Origin(0.0f, 0.0f, -4.0f);
+			DirectX::XMFLOAT3 Target(Rng.Range(-1.2f, 1.2f), Rng.Range(-1.2f, 1.2f), 0.0f);
+			Rays.push_back({ Origin, { Target.x - Origin.x, Target.y - Origin.y, Target.z - Origin.z } });
+		}
+		return Rays;
+	}
+}
+
+int main()
+{
+	const std::vector<Ray> Rays = MakeRays(20000);
+	for (std::uint32_t Stacks : { 64u, 256u, 512u })
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<std::uint32_t> Indices;
+		BenchUtil::AppendBumpySphere(Stacks, Stacks * 2, 1.0f, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), Vertices, Indices);
+		// Read at the width the importer would choose
+		bool b32BitIndices = Vertices.size() > 65535;
+		std::vector<std::uint16_t> Indices16(Indices.begin(), Indices.end());
+		const void* IndexData = b32BitIndices ? static_cast<const void*>(Indices.data()) : static_cast<const void*>(Indices16.data());
+
+		TriangleBVH Bvh;
+		double BuildMs = BenchUtil::MedianMs(3, [&]()
+		{
+			Bvh.Build(&Vertices[0].Position, sizeof(Vertex), Vertices.size(), IndexData, b32BitIndices,
+				static_cast<std::uint32_t>(Indices.size()), 0);
+		});
+
+		// Every query timed alone, picking is one ray per click so the worst one matters
+		std::vector<double> QueryUs;
+		size_t Hits = 0;
+		for (const Ray& R : Rays)
+		{
+			TriangleBVH::Hit Hit;
+			auto Start = std::chrono::steady_clock::now();
+			bool bHit = Bvh.Intersect(R.Origin, R.Direction, Hit);
+			QueryUs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Start).count());
+			Hits += bHit;
+		}
+		std::sort(QueryUs.begin(), QueryUs.end());
+		double MeanUs = 0.0;
+		for (double Us : QueryUs)
+			MeanUs += Us;
+		MeanUs /= QueryUs.size();
+
+		// A few rays are enough for the linear loop
+		double LinearMs = BenchUtil::MedianMs(5, [&]()
+		{
+			BenchUtil::Consume(IntersectLinear(Vertices, Indices, Rays[0].Origin, Rays[0].Direction) < FLT_MAX);
+		});
+
+		std::printf("%8zu triangles, %2d bit indices | build %8.2f ms, %7zu nodes | pick mean %6.2f us, p99 %6.2f us, max %7.2f us,"
+			" %4.1f%% hit | linear %8.3f ms\n",
+			Indices.size() / 3, b32BitIndices ? 32 : 16, BuildMs, Bvh.GetNodeCount(), MeanUs, QueryUs[QueryUs.size() * 99 / 100],
+			QueryUs.back(), 100.0 * Hits / Rays.size(), LinearMs);
+	}
+	return 0;
+}
@@ -0,0 +1,166 @@
+#include "CascadedShadows.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	DirectX::XMFLOAT3 Normalize(const DirectX::XMFLOAT3& aVector)
+	{
+		float Length = std::sqrt(aVector.x * aVector.x + aVector.y * aVector.y + aVector.z * aVector.z);
+		return DirectX::XMFLOAT3(aVector.x / Length, aVector.y / Length, aVector.z / Length);
+	}
+
+	DirectX::XMFLOAT3 Cross(const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B)
+	{
+		return DirectX::XMFLOAT3(A.y * B.z - A.z * B.y, A.z * B.x - A.x * B.z, A.x * B.y - A.y * B.x);
+	}
+
+	float Dot(const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B)
+	{
+		return A.x * B.x + A.y * B.y + A.z * B.z;
+	}
+
+	DirectX::XMFLOAT4X4 Multiply(const DirectX::XMFLOAT4X4& A, const DirectX::XMFLOAT4X4& B)
+	{
+		DirectX::XMFLOAT4X4 Result;
+		for (int Row = 0; Row < 4; Row++)
+		{
+			for (int Col = 0; Col < 4; Col++)
+			{
+				Result.m[Row][Col] = A.m[Row][0] * B.m[0][Col] + A.m[Row][1] * B.m[1][Col]
+					+ A.m[Row][2] * B.m[2][Col] + A.m[Row][3] * B.m[3][Col];
+			}
+		}
+		return Result;
+	}
+
+	DirectX::XMFLOAT4X4 MakeMatrix(float a11, float a12, float a13, float a14, float a21, float a22, float a23, float a24,
+		float a31, float a32, float a33, float a34, float a41, float a42, float a43, float a44)
+	{
+		DirectX::XMFLOAT4X4 Result;
+		Result.m[0][0] = a11; Result.m[0][1] = a12; Result.m[0][2] = a13; Result.m[0][3] = a14;
+		Result.m[1][0] = a21; Result.m[1][1] = a22; Result.m[1][2] = a23; Result.m[1][3] = a24;
+		Result.m[2][0] = a31; Result.m[2][1] = a32; Result.m[2][2] = a33; Result.m[2][3] = a34;
+		Result.m[3][0] = a41; Result.m[3][1] = a42; Result.m[3][2] = a43; Result.m[3][3] = a44;
+		return Result;
+	}
+}
+
+void CascadedShadows::ComputeSplits(float aNear, float aFar, std::uint32_t aCount, float aLambda, float* aOutSplits)
+{
+	assert(aCount > 0 && aNear > 0.0f && aFar > aNear);
+	aOutSplits[0] = aNear;
+	for (std::uint32_t i = 1; i < aCount; i++)
+	{
+		float Fraction = (float)i / (float)aCount;
+		float LogSplit = aNear * std::pow(aFar / aNear, Fraction);
+		float UniformSplit = aNear + (aFar - aNear) * Fraction;
+		aOutSplits[i] = aLambda * LogSplit + (1.0f - aLambda) * UniformSplit;
+	}
+	aOutSplits[aCount] = aFar;
+}
+
+void CascadedShadows::ComputeSliceSphere(const CameraFrustum& aCamera, float aSliceNear, float aSliceFar,
+	DirectX::XMFLOAT3& aOutCenter, float& aOutRadius)
+{
+	// Corners at depth z lie z * K away from the view axis. The center c on the axis is equidistant to the
+	// near and far corners: (c - n)^2 + (n K)^2 = (f - c)^2 + (f K)^2  =>  c = (n + f)(1 + K^2) / 2
+	float TanY = std::tan(aCamera.FovY * 0.5f);
+	float TanX = TanY * aCamera.Aspect;
+	float KSq = TanX * TanX + TanY * TanY;
+
+	float CenterDepth = 0.5f * (aSliceNear + aSliceFar) * (1.0f + KSq);
+	if (CenterDepth > aSliceFar)
+		CenterDepth = aSliceFar;	// Wide slices: the far cap alone bounds the slice
+	aOutRadius = std::sqrt((aSliceFar - CenterDepth) * (aSliceFar - CenterDepth) + aSliceFar * aSliceFar * KSq);
+
+	aOutCenter.x = aCamera.Position.x + aCamera.Look.x * CenterDepth;
+	aOutCenter.y = aCamera.Position.y + aCamera.Look.y * CenterDepth;
+	aOutCenter.z = aCamera.Position.z + aCamera.Look.z * CenterDepth;
+}
+
+void CascadedShadows::SetSettings(const Settings& aSettings)
+{
+	assert(aSettings.CascadeCount > 0 && aSettings.CascadeCount <= MaxCascades && "Invalid cascade count");
+	assert(aSettings.Resolution > 0);
+	CurrentSettings = aSettings;
+	for (bool& bCascadeFitted : bFitted)
+		bCascadeFitted = false;
+}
+
+void CascadedShadows::Update(const CameraFrustum& aCamera, const DirectX::XMFLOAT3& aLightDirection)
+{
+	const std::uint32_t CascadeCount = CurrentSettings.CascadeCount;
+	float Splits[MaxCascades + 1];
+	float FarZ = std::min(aCamera.FarZ, CurrentSettings.MaxShadowDistance);
+	ComputeSplits(aCamera.NearZ, std::max(FarZ, aCamera.NearZ * 2.0f), CascadeCount, CurrentSettings.SplitLambda, Splits);
+
+	// The light basis only depends on the light direction, so moving the camera only translates
+	// the projections and texel snapping keeps them on the same texel grid
+	DirectX::XMFLOAT3 LightZ = Normalize(aLightDirection);
+	bool bSameLight = LightZ.x == FittedLightDirection.x && LightZ.y == FittedLightDirection.y && LightZ.z == FittedLightDirection.z;
+	FittedLightDirection = LightZ;
+	DirectX::XMFLOAT3 WorldUp = std::fabs(LightZ.y) > 0.99f ? DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f) : DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+	DirectX::XMFLOAT3 LightX = Normalize(Cross(WorldUp, LightZ));
+	DirectX::XMFLOAT3 LightY = Cross(LightZ, LightX);
+	DirectX::XMFLOAT4X4 LightView = MakeMatrix(
+		LightX.x, LightY.x, LightZ.x, 0.0f,
+		LightX.y, LightY.y, LightZ.y, 0.0f,
+		LightX.z, LightY.z, LightZ.z, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	// NDC [-1,+1]^2 to texture space [0,1]^2
+	const DirectX::XMFLOAT4X4 NdcToTexture = MakeMatrix(
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, -0.5f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.5f, 0.5f, 0.0f, 1.0f);
+
+	for (std::uint32_t i = 0; i < CascadeCount; i++)
+	{
+		Cascade& Current = Cascades[i];
+		Current.SplitNear = Splits[i];
+		Current.SplitFar = Splits[i + 1];
+
+		DirectX::XMFLOAT3 SliceCenter;
+		float SliceRadius;
+		ComputeSliceSphere(aCamera, Current.SplitNear, Current.SplitFar, SliceCenter, SliceRadius);
+		// Quantized so float noise in the fit cannot change the texel size between frames
+		float Radius = std::ceil(SliceRadius * (1.0f + CurrentSettings.RefitSlack) * 16.0f) / 16.0f;
+
+		// Keep the current projection while it has the same size and still contains the slice
+		if (bFitted[i] && bSameLight && Radius == Current.SphereRadius)
+		{
+			DirectX::XMFLOAT3 Offset(SliceCenter.x - Current.SphereCenter.x, SliceCenter.y - Current.SphereCenter.y,
+				SliceCenter.z - Current.SphereCenter.z);
+			if (std::sqrt(Dot(Offset, Offset)) + SliceRadius <= Radius)
+				continue;
+		}
+		bFitted[i] = true;
+		Current.SphereCenter = SliceCenter;
+		Current.SphereRadius = Radius;
+
+		float TexelSize = 2.0f * Radius / (float)CurrentSettings.Resolution;
+		float CenterX = std::floor(Dot(Current.SphereCenter, LightX) / TexelSize) * TexelSize;
+		float CenterY = std::floor(Dot(Current.SphereCenter, LightY) / TexelSize) * TexelSize;
+		float CenterZ = Dot(Current.SphereCenter, LightZ);
+
+		float Left = CenterX - Radius;
+		float Right = CenterX + Radius;
+		float Bottom = CenterY - Radius;
+		float Top = CenterY + Radius;
+		float Near = CenterZ - Radius - CurrentSettings.CasterMargin;
+		float Far = CenterZ + Radius;
+
+		// Same layout as XMMatrixOrthographicOffCenterLH
+		Current.View = LightView;
+		Current.Proj = MakeMatrix(
+			2.0f / (Right - Left), 0.0f, 0.0f, 0.0f,
+			0.0f, 2.0f / (Top - Bottom), 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f / (Far - Near), 0.0f,
+			(Left + Right) / (Left - Right), (Top + Bottom) / (Bottom - Top), Near / (Near - Far), 1.0f);
+		Current.ViewProj = Multiply(Current.View, Current.Proj);
+		Current.ShadowTransform = Multiply(Current.ViewProj, NdcToTexture);
+	}
+}
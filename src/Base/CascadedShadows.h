@@ -0,0 +1,74 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+
+// Cascaded shadow map fitting for a directional light.
+// The camera frustum is partitioned with the practical split scheme (a blend of uniform and logarithmic
+// splits). Every cascade is fitted to the bounding sphere of its frustum slice, so its size does not change
+// when the camera rotates, and the projection is snapped to shadow map texels so cascades do not shimmer
+// while the camera moves. Fitted cascades are kept while they still contain their slice.
+class CascadedShadows
+{
+public:
+	static constexpr std::uint32_t MaxCascades = 4;	// Matches MAX_CASCADES in CommonBuffer.hlsl
+
+	struct Settings
+	{
+		std::uint32_t CascadeCount = 3;
+		float SplitLambda = 0.75f;			// 0 = uniform splits, 1 = logarithmic splits
+		float MaxShadowDistance = 60.0f;	// Shadows end here even if the camera sees farther
+		float CasterMargin = 40.0f;			// Pulls every cascade's near plane toward the light
+		std::uint32_t Resolution = 2048;
+		// Extra cascade radius: a cascade keeps its projection while its slice stays inside, so the
+		// cached static shadow layer survives small camera moves
+		float RefitSlack = 0.15f;
+	};
+
+	// World space camera frustum, basis vectors must be orthonormal
+	struct CameraFrustum
+	{
+		DirectX::XMFLOAT3 Position;
+		DirectX::XMFLOAT3 Right;
+		DirectX::XMFLOAT3 Up;
+		DirectX::XMFLOAT3 Look;
+		float FovY;
+		float Aspect;
+		float NearZ;
+		float FarZ;
+	};
+
+	// Row vector matrices (p * View * Proj), transpose before uploading to shaders
+	struct Cascade
+	{
+		DirectX::XMFLOAT4X4 View;
+		DirectX::XMFLOAT4X4 Proj;
+		DirectX::XMFLOAT4X4 ViewProj;
+		DirectX::XMFLOAT4X4 ShadowTransform;	// World to shadow map texture space, z = light depth
+		DirectX::XMFLOAT3 SphereCenter;
+		float SphereRadius;
+		float SplitNear;
+		float SplitFar;
+	};
+
+	// Writes aCount + 1 distances: aOutSplits[0] = aNear, aOutSplits[aCount] = aFar
+	static void ComputeSplits(float aNear, float aFar, std::uint32_t aCount, float aLambda, float* aOutSplits);
+	// Smallest sphere centered on the view axis containing the frustum slice [aSliceNear, aSliceFar]
+	static void ComputeSliceSphere(const CameraFrustum& aCamera, float aSliceNear, float aSliceFar,
+		DirectX::XMFLOAT3& aOutCenter, float& aOutRadius);
+
+	void SetSettings(const Settings& aSettings);
+	const Settings& GetSettings() const { return CurrentSettings; }
+
+	// aLightDirection is the direction the light travels in. A cascade is only refitted when its
+	// slice leaves it or the light direction changes.
+	void Update(const CameraFrustum& aCamera, const DirectX::XMFLOAT3& aLightDirection);
+
+	std::uint32_t GetCascadeCount() const { return CurrentSettings.CascadeCount; }
+	const Cascade& GetCascade(std::uint32_t aIndex) const { return Cascades[aIndex]; }
+
+private:
+	Settings CurrentSettings;
+	Cascade Cascades[MaxCascades] = {};
+	bool bFitted[MaxCascades] = {};
+	DirectX::XMFLOAT3 FittedLightDirection = { 0.0f, 0.0f, 0.0f };
+};
@@ -0,0 +1,155 @@
+#include "ClusterCuller.h"
+#include "FrustumCuller.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <xmmintrin.h>
+
+void ClusterCuller::SetView(const DirectX::XMFLOAT4X4& aViewProj, const DirectX::XMFLOAT3& aEye, float aProjectionScale)
+{
+	FrustumCuller PlaneSource;
+	PlaneSource.SetViewProj(aViewProj);
+	std::copy(PlaneSource.GetPlanes(), PlaneSource.GetPlanes() + 6, Planes);
+	Eye = aEye;
+	ProjectionScale = aProjectionScale;
+}
+
+void ClusterCuller::ResetCounters()
+{
+	TestedCount = 0;
+	FrustumCulledCount = 0;
+	BackfaceCulledCount = 0;
+	SmallCulledCount = 0;
+}
+
+size_t ClusterCuller::Cull(const Meshlet* aMeshlets, size_t aCount, const DirectX::XMFLOAT4X4& aWorld, std::uint32_t aIndexBase,
+	std::vector<IndexRange>& aOutRanges)
+{
+	const DirectX::XMFLOAT4X4& M = aWorld;
+	// Row lengths are the scales along the local axes, the largest bounds the scaled radius
+	float ScaleSqX = M._11 * M._11 + M._12 * M._12 + M._13 * M._13;
+	float ScaleSqY = M._21 * M._21 + M._22 * M._22 + M._23 * M._23;
+	float ScaleSqZ = M._31 * M._31 + M._32 * M._32 + M._33 * M._33;
+	float MaxScale = std::sqrt(std::max({ ScaleSqX, ScaleSqY, ScaleSqZ }));
+	float MinScale = std::sqrt(std::min({ ScaleSqX, ScaleSqY, ScaleSqZ }));
+	float Determinant = M._11 * (M._22 * M._33 - M._23 * M._32) - M._12 * (M._21 * M._33 - M._23 * M._31)
+		+ M._13 * (M._21 * M._32 - M._22 * M._31);
+	// Cones stay cones only under rotation and uniform scale, a mirror also swaps the front faces
+	const bool bTestCones = bBackfaceCulling && Determinant > 0.0f && MaxScale <= MinScale * 1.01f;
+	const bool bTestSize = MinProjectedSize > 0.0f && ProjectionScale > 0.0f;
+
+	__m128 PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		PlaneX[p] = _mm_set1_ps(Planes[p].x);
+		PlaneY[p] = _mm_set1_ps(Planes[p].y);
+		PlaneZ[p] = _mm_set1_ps(Planes[p].z);
+		PlaneW[p] = _mm_set1_ps(Planes[p].w);
+	}
+	const __m128 M11 = _mm_set1_ps(M._11), M12 = _mm_set1_ps(M._12), M13 = _mm_set1_ps(M._13);
+	const __m128 M21 = _mm_set1_ps(M._21), M22 = _mm_set1_ps(M._22), M23 = _mm_set1_ps(M._23);
+	const __m128 M31 = _mm_set1_ps(M._31), M32 = _mm_set1_ps(M._32), M33 = _mm_set1_ps(M._33);
+	const __m128 M41 = _mm_set1_ps(M._41), M42 = _mm_set1_ps(M._42), M43 = _mm_set1_ps(M._43);
+	const __m128 RadiusScale = _mm_set1_ps(MaxScale);
+	// The axis only went through a rotation and the uniform scale, dividing by it keeps it unit length
+	const __m128 AxisScale = _mm_set1_ps(MaxScale > 0.0f ? 1.0f / MaxScale : 0.0f);
+	const __m128 EyeX = _mm_set1_ps(Eye.x);
+	const __m128 EyeY = _mm_set1_ps(Eye.y);
+	const __m128 EyeZ = _mm_set1_ps(Eye.z);
+	const __m128 One = _mm_set1_ps(1.0f);
+	const __m128 MinSizeSq = _mm_set1_ps(MinProjectedSize * MinProjectedSize);
+	const __m128 DiameterScaleSq = _mm_set1_ps(4.0f * ProjectionScale * ProjectionScale);
+
+	const size_t FirstRange = aOutRanges.size();
+	size_t VisibleCount = 0;
+	for (size_t i = 0; i < aCount; i += 4)
+	{
+		// The last group is padded with empty meshlets whose lanes are masked out
+		const Meshlet* Group = aMeshlets + i;
+		Meshlet Tail[4];
+		size_t LaneCount = std::min<size_t>(4, aCount - i);
+		if (LaneCount < 4)
+		{
+			std::copy(Group, Group + LaneCount, Tail);
+			Group = Tail;
+		}
+
+		// Rows of four meshlets become lanes of x, y, z and w
+		__m128 CenterX = _mm_loadu_ps(&Group[0].Sphere.x);
+		__m128 CenterY = _mm_loadu_ps(&Group[1].Sphere.x);
+		__m128 CenterZ = _mm_loadu_ps(&Group[2].Sphere.x);
+		__m128 Radius = _mm_loadu_ps(&Group[3].Sphere.x);
+		_MM_TRANSPOSE4_PS(CenterX, CenterY, CenterZ, Radius);
+
+		__m128 WorldX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(CenterX, M11), _mm_mul_ps(CenterY, M21)), _mm_add_ps(_mm_mul_ps(CenterZ, M31), M41));
+		__m128 WorldY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(CenterX, M12), _mm_mul_ps(CenterY, M22)), _mm_add_ps(_mm_mul_ps(CenterZ, M32), M42));
+		__m128 WorldZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(CenterX, M13), _mm_mul_ps(CenterY, M23)), _mm_add_ps(_mm_mul_ps(CenterZ, M33), M43));
+		Radius = _mm_mul_ps(Radius, RadiusScale);
+		__m128 NegRadius = _mm_sub_ps(_mm_setzero_ps(), Radius);
+
+		// Sphere fully behind any plane: dist(center) < -radius
+		__m128 FrustumCulled = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 Distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(PlaneX[p], WorldX), _mm_mul_ps(PlaneY[p], WorldY)),
+				_mm_add_ps(_mm_mul_ps(PlaneZ[p], WorldZ), PlaneW[p]));
+			FrustumCulled = _mm_or_ps(FrustumCulled, _mm_cmplt_ps(Distance, NegRadius));
+		}
+
+		__m128 DeltaX = _mm_sub_ps(WorldX, EyeX);
+		__m128 DeltaY = _mm_sub_ps(WorldY, EyeY);
+		__m128 DeltaZ = _mm_sub_ps(WorldZ, EyeZ);
+		__m128 DistanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(DeltaX, DeltaX), _mm_mul_ps(DeltaY, DeltaY)), _mm_mul_ps(DeltaZ, DeltaZ));
+
+		__m128 BackfaceCulled = _mm_setzero_ps();
+		if (bTestCones)
+		{
+			__m128 AxisX = _mm_loadu_ps(&Group[0].Cone.x);
+			__m128 AxisY = _mm_loadu_ps(&Group[1].Cone.x);
+			__m128 AxisZ = _mm_loadu_ps(&Group[2].Cone.x);
+			__m128 Cutoff = _mm_loadu_ps(&Group[3].Cone.x);
+			_MM_TRANSPOSE4_PS(AxisX, AxisY, AxisZ, Cutoff);
+			__m128 WorldAxisX = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(AxisX, M11), _mm_mul_ps(AxisY, M21)), _mm_mul_ps(AxisZ, M31)), AxisScale);
+			__m128 WorldAxisY = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(AxisX, M12), _mm_mul_ps(AxisY, M22)), _mm_mul_ps(AxisZ, M32)), AxisScale);
+			__m128 WorldAxisZ = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(AxisX, M13), _mm_mul_ps(AxisY, M23)), _mm_mul_ps(AxisZ, M33)), AxisScale);
+
+			// Every triangle faces away from the eye: dot(C - E, Axis) >= Cutoff * |C - E| + radius
+			__m128 AxisDot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(DeltaX, WorldAxisX), _mm_mul_ps(DeltaY, WorldAxisY)), _mm_mul_ps(DeltaZ, WorldAxisZ));
+			__m128 Limit = _mm_add_ps(_mm_mul_ps(Cutoff, _mm_sqrt_ps(DistanceSq)), Radius);
+			BackfaceCulled = _mm_and_ps(_mm_cmpge_ps(AxisDot, Limit), _mm_cmplt_ps(Cutoff, One));
+		}
+
+		__m128 SmallCulled = _mm_setzero_ps();
+		if (bTestSize)
+		{
+			// Projected diameter 2 * r * scale / d below the threshold, compared squared
+			SmallCulled = _mm_cmplt_ps(_mm_mul_ps(DiameterScaleSq, _mm_mul_ps(Radius, Radius)), _mm_mul_ps(MinSizeSq, DistanceSq));
+		}
+
+		int LaneMask = (1 << LaneCount) - 1;
+		int FrustumMask = _mm_movemask_ps(FrustumCulled) & LaneMask;
+		int BackfaceMask = _mm_movemask_ps(BackfaceCulled) & LaneMask & ~FrustumMask;
+		int SmallMask = _mm_movemask_ps(SmallCulled) & LaneMask & ~FrustumMask & ~BackfaceMask;
+		int VisibleMask = LaneMask & ~(FrustumMask | BackfaceMask | SmallMask);
+
+		TestedCount += LaneCount;
+		FrustumCulledCount += std::popcount(unsigned(FrustumMask));
+		BackfaceCulledCount += std::popcount(unsigned(BackfaceMask));
+		SmallCulledCount += std::popcount(unsigned(SmallMask));
+
+		for (size_t Lane = 0; Lane < LaneCount; Lane++)
+		{
+			if (!((VisibleMask >> Lane) & 1))
+				continue;
+			VisibleCount++;
+			const Meshlet& Cluster = Group[Lane];
+			std::uint32_t Start = aIndexBase + Cluster.IndexStart;
+			// Meshlets are stored back to back, visible neighbours become one draw
+			if (aOutRanges.size() > FirstRange && aOutRanges.back().IndexStart + aOutRanges.back().IndexCount == Start)
+				aOutRanges.back().IndexCount += Cluster.IndexCount;
+			else
+				aOutRanges.push_back({ Start, Cluster.IndexCount });
+		}
+	}
+	return VisibleCount;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../Utility/MeshletBuilder.h"
+
+// Culls the meshlets of a drawn submesh against a view, four meshlets per SSE iteration: bounding spheres
+// outside the frustum, normal cones facing away from the eye and spheres below a projected size. The
+// surviving meshlets are emitted as index ranges, neighbours merged, to be drawn directly or written as
+// indirect arguments.
+class ClusterCuller
+{
+public:
+	struct IndexRange
+	{
+		std::uint32_t IndexStart = 0;
+		std::uint32_t IndexCount = 0;
+	};
+
+	// aViewProj uses the CPU side row vector convention (p * View * Proj), see FrustumCuller::SetViewProj.
+	// aProjectionScale = viewport height / (2 * tan(FovY / 2)), only needed by SetMinProjectedSize.
+	void SetView(const DirectX::XMFLOAT4X4& aViewProj, const DirectX::XMFLOAT3& aEye, float aProjectionScale);
+	// Clusters whose projected diameter is below aMinProjectedSize pixels are culled, zero disables the test
+	void SetMinProjectedSize(float aMinProjectedSize) { MinProjectedSize = aMinProjectedSize; }
+	// Only valid for pipelines culling back faces with clockwise front faces
+	void SetBackfaceCulling(bool bEnable) { bBackfaceCulling = bEnable; }
+
+	// Appends the index ranges of the visible meshlets, offset by aIndexBase (the StartIndexLocation of the
+	// submesh), to aOutRanges. aWorld places the meshlet bounds, the cone test is skipped for non uniform
+	// scales and mirrors. Returns the number of visible meshlets.
+	size_t Cull(const Meshlet* aMeshlets, size_t aCount, const DirectX::XMFLOAT4X4& aWorld, std::uint32_t aIndexBase,
+		std::vector<IndexRange>& aOutRanges);
+
+	// Counters summed over the Cull calls since the last reset
+	void ResetCounters();
+	size_t GetTestedCount() const { return TestedCount; }
+	size_t GetFrustumCulledCount() const { return FrustumCulledCount; }
+	size_t GetBackfaceCulledCount() const { return BackfaceCulledCount; }
+	size_t GetSmallCulledCount() const { return SmallCulledCount; }
+
+private:
+	// Normalized, pointing inside, see FrustumCuller
+	DirectX::XMFLOAT4 Planes[6] = {};
+	DirectX::XMFLOAT3 Eye = { 0.0f, 0.0f, 0.0f };
+	float ProjectionScale = 0.0f;
+	float MinProjectedSize = 0.0f;
+	bool bBackfaceCulling = true;
+
+	size_t TestedCount = 0;
+	size_t FrustumCulledCount = 0;
+	size_t BackfaceCulledCount = 0;
+	size_t SmallCulledCount = 0;
+};
@@ -1,36 +1,41 @@
 #include "CubeMapRT.h"
 
 
-CubeMapRT::CubeMapRT(ID3D12Device* aDxDevice, UINT aWidth, UINT aHeight, DXGI_FORMAT aRtFormat, DXGI_FORMAT aDsFormat)
+CubeMapRT::CubeMapRT(ID3D12Device* aDxDevice, GpuMemoryAllocator* aAllocator, UINT aWidth, UINT aHeight, DXGI_FORMAT aRtFormat, DXGI_FORMAT aDsFormat, UINT aCubeCount)
 {
 	DxDevice = aDxDevice;
+	Allocator = aAllocator;
 	Width = aWidth;
 	Height = aHeight;
+	CubeCount = aCubeCount;
 	RtFormat = aRtFormat;
 	DsFormat = aDsFormat;
 
 	BuildResource();
 }
 
-void CubeMapRT::BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE aSrvCpuHandle, CD3DX12_CPU_DESCRIPTOR_HANDLE aRtvCpuHandle[6],
-	CD3DX12_CPU_DESCRIPTOR_HANDLE aDsvCpuHandle)
+void CubeMapRT::BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE aSrvCpuHandle, CD3DX12_CPU_DESCRIPTOR_HANDLE aRtvCpuHandle,
+	UINT aRtvDescriptorSize, CD3DX12_CPU_DESCRIPTOR_HANDLE aDsvCpuHandle)
 {
 	SrvCpuHandle = aSrvCpuHandle;
-	std::copy(aRtvCpuHandle, aRtvCpuHandle + 6, std::begin(RtvCpuHandle));
 	DsvCpuHandle = aDsvCpuHandle;
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC SrvDesc;
 	SrvDesc.Format	= RtFormat;
-	SrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+	SrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBEARRAY;
 	SrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	SrvDesc.TextureCube.MipLevels = 1;
-	SrvDesc.TextureCube.MostDetailedMip = 0;
-	SrvDesc.TextureCube.ResourceMinLODClamp = 0;
+	SrvDesc.TextureCubeArray.MipLevels = 1;
+	SrvDesc.TextureCubeArray.MostDetailedMip = 0;
+	SrvDesc.TextureCubeArray.First2DArrayFace = 0;
+	SrvDesc.TextureCubeArray.NumCubes = CubeCount;
+	SrvDesc.TextureCubeArray.ResourceMinLODClamp = 0;
 	DxDevice->CreateShaderResourceView(RtResource.Get(), &SrvDesc, SrvCpuHandle);
 
 	//RT for each cube faces
-	for (int i = 0; i < 6; i++)
+	RtvCpuHandles.clear();
+	for (UINT i = 0; i < 6 * CubeCount; i++)
 	{
+		RtvCpuHandles.push_back(CD3DX12_CPU_DESCRIPTOR_HANDLE(aRtvCpuHandle, i, aRtvDescriptorSize));
 		D3D12_RENDER_TARGET_VIEW_DESC RtDesc;
 		RtDesc.Format = RtFormat;
 		RtDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2DARRAY;
@@ -39,7 +44,7 @@ void CubeMapRT::BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE aSrvCpuHandle, CD
 		RtDesc.Texture2DArray.MipSlice = 0;
 		RtDesc.Texture2DArray.PlaneSlice = 0;
 
-		DxDevice->CreateRenderTargetView(RtResource.Get(), &RtDesc, RtvCpuHandle[i]);
+		DxDevice->CreateRenderTargetView(RtResource.Get(), &RtDesc, RtvCpuHandles[i]);
 	}
 
 	D3D12_DEPTH_STENCIL_VIEW_DESC DsvDesc;
@@ -70,9 +75,10 @@ CD3DX12_CPU_DESCRIPTOR_HANDLE CubeMapRT::GetDsvCpuHandle() const
 	return DsvCpuHandle;
 }
 
-CD3DX12_CPU_DESCRIPTOR_HANDLE CubeMapRT::GetRtvCpuHandle(size_t Index)
+CD3DX12_CPU_DESCRIPTOR_HANDLE CubeMapRT::GetRtvCpuHandle(size_t aFace, UINT aCube)
 {
-	return RtvCpuHandle[Index];
+	assert(aFace < 6 && aCube < CubeCount && "Cube map face out of range");
+	return RtvCpuHandles[aCube * 6 + aFace];
 }
 
 D3D12_VIEWPORT CubeMapRT::GetViewport() const
@@ -93,13 +99,12 @@ void CubeMapRT::BuildResource()
 	RtvResDesc.Alignment = 0;
 	RtvResDesc.Width = Width;
 	RtvResDesc.Height = Height;
-	RtvResDesc.DepthOrArraySize = 6;
+	RtvResDesc.DepthOrArraySize = (UINT16)(6 * CubeCount);
 	RtvResDesc.MipLevels = 1;
 	RtvResDesc.Format = RtFormat;
 	RtvResDesc.SampleDesc = { 1,0 };
 	RtvResDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 	RtvResDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
-	auto HeapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
 
 	D3D12_CLEAR_VALUE RtvClearValue;
 	RtvClearValue.Format = RtFormat;
@@ -108,8 +113,8 @@ void CubeMapRT::BuildResource()
 	RtvClearValue.Color[2] = 0.0f;
 	RtvClearValue.Color[3] = 1.0f;
 
-	ThrowIfFailed(DxDevice->CreateCommittedResource(&HeapProperty, D3D12_HEAP_FLAG_NONE, &RtvResDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ, &RtvClearValue, IID_PPV_ARGS(&RtResource)) );
+	ThrowIfFailed(Allocator->CreateResource(D3D12_HEAP_TYPE_DEFAULT, RtvResDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ, &RtvClearValue, RtResource) );
 	
 	D3D12_RESOURCE_DESC DsvResDesc = RtvResDesc;
 	DsvResDesc.DepthOrArraySize = 1;
@@ -119,6 +124,6 @@ void CubeMapRT::BuildResource()
 	DsvClearDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
 	DsvClearDesc.DepthStencil = { 1,0 };
 
-	ThrowIfFailed(DxDevice->CreateCommittedResource(&HeapProperty, D3D12_HEAP_FLAG_NONE, &DsvResDesc,
-		D3D12_RESOURCE_STATE_COMMON, &DsvClearDesc, IID_PPV_ARGS(&DepthResource)) );
+	ThrowIfFailed(Allocator->CreateResource(D3D12_HEAP_TYPE_DEFAULT, DsvResDesc,
+		D3D12_RESOURCE_STATE_COMMON, &DsvClearDesc, DepthResource) );
 }
\ No newline at end of file
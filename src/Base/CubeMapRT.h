@@ -1,23 +1,27 @@
 #pragma once
 #include "../Utility/d3dUtil.h"
+#include "../Utility/GpuMemoryAllocator.h"
 
 class CubeMapRT
 {
 public:
 	CubeMapRT() = delete;
-	CubeMapRT(ID3D12Device* aDxDevice, UINT aWidth, UINT aHeight, DXGI_FORMAT aRtFormat, DXGI_FORMAT aDsFormat);
+	// aCubeCount cubes sampled as a TextureCubeArray, faces share one depth buffer
+	CubeMapRT(ID3D12Device* aDxDevice, GpuMemoryAllocator* aAllocator, UINT aWidth, UINT aHeight, DXGI_FORMAT aRtFormat, DXGI_FORMAT aDsFormat, UINT aCubeCount = 1);
 	CubeMapRT(const CubeMapRT& CubeRT) = delete;
 	CubeMapRT& operator=(const CubeMapRT CubeRT) = delete;
 
-	void BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE aSrvCpuHandle, CD3DX12_CPU_DESCRIPTOR_HANDLE aRtvCpuHandle[6],
-		CD3DX12_CPU_DESCRIPTOR_HANDLE aDsvCpuHandle);
+	// aRtvCpuHandle is the first of 6 * CubeCount consecutive RTV heap slots
+	void BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE aSrvCpuHandle, CD3DX12_CPU_DESCRIPTOR_HANDLE aRtvCpuHandle,
+		UINT aRtvDescriptorSize, CD3DX12_CPU_DESCRIPTOR_HANDLE aDsvCpuHandle);
 	void BuildResource();
 	ID3D12Resource* GetRtResourcePtr();
 	ID3D12Resource* GetDsResourcePtr();
 
 	CD3DX12_CPU_DESCRIPTOR_HANDLE GetSrvCpuHandle() const;
 	CD3DX12_CPU_DESCRIPTOR_HANDLE GetDsvCpuHandle() const;
-	CD3DX12_CPU_DESCRIPTOR_HANDLE GetRtvCpuHandle(size_t Index);
+	CD3DX12_CPU_DESCRIPTOR_HANDLE GetRtvCpuHandle(size_t aFace, UINT aCube = 0);
+	UINT GetCubeCount() const { return CubeCount; }
 	D3D12_VIEWPORT GetViewport() const;
 	RECT GetRect() const;
 	
@@ -25,12 +29,14 @@ private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> RtResource;
 	Microsoft::WRL::ComPtr<ID3D12Resource> DepthResource;
 	ID3D12Device* DxDevice;
+	GpuMemoryAllocator* Allocator;
 	UINT Width;
 	UINT Height;
+	UINT CubeCount;
 	DXGI_FORMAT RtFormat;
 	DXGI_FORMAT DsFormat;
 
 	CD3DX12_CPU_DESCRIPTOR_HANDLE SrvCpuHandle; 
-	CD3DX12_CPU_DESCRIPTOR_HANDLE RtvCpuHandle[6];
+	std::vector<CD3DX12_CPU_DESCRIPTOR_HANDLE> RtvCpuHandles;	// Cube * 6 + Face
 	CD3DX12_CPU_DESCRIPTOR_HANDLE DsvCpuHandle;
 };
\ No newline at end of file
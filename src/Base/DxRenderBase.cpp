@@ -112,12 +112,11 @@ void DxRenderBase::OnResize()
 	OptClear.Format = DepthStencilFormat;
 	OptClear.DepthStencil.Depth = 1.0f;
 	OptClear.DepthStencil.Stencil = 0;
-	auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-	ThrowIfFailed(DxDevice3D->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
-		&DepthStencilDesc,
+	ThrowIfFailed(GpuMemory->CreateResource(D3D12_HEAP_TYPE_DEFAULT,
+		DepthStencilDesc,
 		D3D12_RESOURCE_STATE_COMMON,
 		&OptClear,
-		IID_PPV_ARGS(DepthBuffer.GetAddressOf())
+		DepthBuffer
 	));
 	D3D12_DEPTH_STENCIL_VIEW_DESC DsvDesc;
 	DsvDesc.Flags = D3D12_DSV_FLAG_NONE;
@@ -302,6 +301,11 @@ bool DxRenderBase::InitDirect3D()
         ThrowIfFailed(D3D12CreateDevice(GpuSoftAdapter.Get(), D3D_FEATURE_LEVEL_12_0, IID_PPV_ARGS(&DxDevice3D)));
 	}
 
+	// The adapter only feeds budget queries, the allocator works without it
+	Microsoft::WRL::ComPtr<IDXGIAdapter3> Adapter;
+	DxgiFactory->EnumAdapterByLuid(DxDevice3D->GetAdapterLuid(), IID_PPV_ARGS(&Adapter));
+	GpuMemory = std::make_unique<GpuMemoryAllocator>(DxDevice3D.Get(), Adapter.Get());
+
 	ThrowIfFailed(DxDevice3D->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&Fence)));
 	CbvSrvUavDescriptorSize = DxDevice3D->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	RtvDescriptorSize = DxDevice3D->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
@@ -1,5 +1,6 @@
 #pragma once
 #include "../Utility/d3dUtil.h"
+#include "../Utility/GpuMemoryAllocator.h"
 #include "GameTime.h"
 
 #pragma comment(lib, "d3d12.lib")
@@ -31,6 +32,8 @@ protected:
     
 	Microsoft::WRL::ComPtr<IDXGIFactory4> DxgiFactory;
 	Microsoft::WRL::ComPtr<ID3D12Device> DxDevice3D;
+	// Places every resource of the renderer, declared early to outlive them
+	std::unique_ptr<GpuMemoryAllocator> GpuMemory;
 	Microsoft::WRL::ComPtr<IDXGISwapChain> SwapChain;
 	Microsoft::WRL::ComPtr<ID3D12CommandQueue> CommandQueue;
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CommandAlloc;
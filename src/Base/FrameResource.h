@@ -1,11 +1,11 @@
 #pragma once
 #include "UploadBuffer.h"
 
-template<typename PassConstBufferStruct, typename ObjConstBufferStruct , typename MatConstBufferStruct>
+template<typename PassConstBufferStruct, typename InstanceStruct , typename MaterialStruct>
 class FrameResource
 {
 public:
-	FrameResource(ID3D12Device* Device3D, UINT PassCount, UINT ObjCount, UINT MatCount);
+	FrameResource(ID3D12Device* Device3D, GpuMemoryAllocator* Allocator, UINT PassCount, UINT InstanceCount, UINT InstanceIndexCount, UINT MatCount, UINT ClusterDrawCount);
 	FrameResource(const FrameResource& FResource) = delete;
 	FrameResource& operator=(const FrameResource& FResource) = delete;
 	~FrameResource() = default;
@@ -13,18 +13,22 @@ public:
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CommandAlloc;
 	UINT64 FenceValue{0};
 	std::unique_ptr<UploadBuffer<PassConstBufferStruct>> PassConstBufferRes;
-	std::unique_ptr<UploadBuffer<ObjConstBufferStruct>> ObjConstBufferRes;
-	std::unique_ptr<UploadBuffer<MatConstBufferStruct>> MatConstBufferRes;
+	std::unique_ptr<UploadBuffer<InstanceStruct>> InstanceBufferRes;		// Structured buffer, one element per render item
+	std::unique_ptr<UploadBuffer<UINT>> InstanceIndexBufferRes;			// Render item ids of every instanced draw, rebuilt each frame
+	std::unique_ptr<UploadBuffer<MaterialStruct>> MaterialBufferRes;	// Structured buffer, one element per material
+	std::unique_ptr<UploadBuffer<D3D12_DRAW_INDEXED_ARGUMENTS>> ClusterDrawArgsRes;	// ExecuteIndirect arguments of the visible meshlet ranges
 };
 
 
-template<typename PassConstBufferStruct, typename ObjConstBufferStruct, typename MatConstBufferStruct>
-inline FrameResource<PassConstBufferStruct,ObjConstBufferStruct,MatConstBufferStruct>::FrameResource(ID3D12Device* Device3D,
-	UINT PassCount, UINT ObjCount, UINT MatCount)
+template<typename PassConstBufferStruct, typename InstanceStruct, typename MaterialStruct>
+inline FrameResource<PassConstBufferStruct,InstanceStruct,MaterialStruct>::FrameResource(ID3D12Device* Device3D, GpuMemoryAllocator* Allocator,
+	UINT PassCount, UINT InstanceCount, UINT InstanceIndexCount, UINT MatCount, UINT ClusterDrawCount)
 {
 	Device3D->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&CommandAlloc));
 
-	PassConstBufferRes = std::make_unique<UploadBuffer<PassConstBufferStruct>>(Device3D, PassCount, true);
-	ObjConstBufferRes = std::make_unique<UploadBuffer<ObjConstBufferStruct>>(Device3D, ObjCount, true);
-	MatConstBufferRes = std::make_unique<UploadBuffer<MatConstBufferStruct>>(Device3D, MatCount, true);
+	PassConstBufferRes = std::make_unique<UploadBuffer<PassConstBufferStruct>>(Allocator, PassCount, true);
+	InstanceBufferRes = std::make_unique<UploadBuffer<InstanceStruct>>(Allocator, InstanceCount, false);
+	InstanceIndexBufferRes = std::make_unique<UploadBuffer<UINT>>(Allocator, InstanceIndexCount, false);
+	MaterialBufferRes = std::make_unique<UploadBuffer<MaterialStruct>>(Allocator, MatCount, false);
+	ClusterDrawArgsRes = std::make_unique<UploadBuffer<D3D12_DRAW_INDEXED_ARGUMENTS>>(Allocator, ClusterDrawCount, false);
 }
@@ -0,0 +1,197 @@
+#include "FrustumCuller.h"
+#include <cassert>
+#include <cmath>
+#include <xmmintrin.h>
+
+void FrustumCuller::SetViewProj(const DirectX::XMFLOAT4X4& aViewProj, bool bInfiniteNear)
+{
+	// Gribb-Hartmann extraction with D3D clip space (0 <= z <= w)
+	const DirectX::XMFLOAT4X4& M = aViewProj;
+	Planes[0] = { M._14 + M._11, M._24 + M._21, M._34 + M._31, M._44 + M._41 };	// Left
+	Planes[1] = { M._14 - M._11, M._24 - M._21, M._34 - M._31, M._44 - M._41 };	// Right
+	Planes[2] = { M._14 + M._12, M._24 + M._22, M._34 + M._32, M._44 + M._42 };	// Bottom
+	Planes[3] = { M._14 - M._12, M._24 - M._22, M._34 - M._32, M._44 - M._42 };	// Top
+	Planes[4] = { M._13, M._23, M._33, M._43 };									// Near
+	Planes[5] = { M._14 - M._13, M._24 - M._23, M._34 - M._33, M._44 - M._43 };	// Far
+
+	for (auto& Plane : Planes)
+	{
+		float Length = std::sqrt(Plane.x * Plane.x + Plane.y * Plane.y + Plane.z * Plane.z);
+		if (Length > 0.0f)
+		{
+			Plane.x /= Length;
+			Plane.y /= Length;
+			Plane.z /= Length;
+			Plane.w /= Length;
+		}
+	}
+
+	if (bInfiniteNear)
+		Planes[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+}
+
+void FrustumCuller::SetBox(const DirectX::XMFLOAT3& aCenter, const DirectX::XMFLOAT3& aExtents)
+{
+	Planes[0] = { 1.0f, 0.0f, 0.0f, aExtents.x - aCenter.x };
+	Planes[1] = { -1.0f, 0.0f, 0.0f, aExtents.x + aCenter.x };
+	Planes[2] = { 0.0f, 1.0f, 0.0f, aExtents.y - aCenter.y };
+	Planes[3] = { 0.0f, -1.0f, 0.0f, aExtents.y + aCenter.y };
+	Planes[4] = { 0.0f, 0.0f, 1.0f, aExtents.z - aCenter.z };
+	Planes[5] = { 0.0f, 0.0f, -1.0f, aExtents.z + aCenter.z };
+}
+
+void FrustumCuller::SetSweep(const DirectX::XMFLOAT3& aDirection, float aLength)
+{
+	SweepDirection = aDirection;
+	SweepLength = aLength;
+}
+
+void FrustumCuller::ClearSweep()
+{
+	SweepLength = 0.0f;
+}
+
+void FrustumCuller::SetRangeLimits(const DirectX::XMFLOAT3& aOrigin, float aMaxDistance, float aMinProjectedSize, float aProjectionScale)
+{
+	RangeOrigin = aOrigin;
+	MaxDistance = aMaxDistance;
+	MinProjectedSize = aMinProjectedSize;
+	ProjectionScale = aProjectionScale;
+}
+
+void FrustumCuller::ClearRangeLimits()
+{
+	MaxDistance = 0.0f;
+	MinProjectedSize = 0.0f;
+}
+
+size_t FrustumCuller::Cull(const SceneStore::WorldBoundsStreams& aBounds)
+{
+	return Cull(aBounds.CenterX.data(), aBounds.CenterY.data(), aBounds.CenterZ.data(),
+		aBounds.ExtentX.data(), aBounds.ExtentY.data(), aBounds.ExtentZ.data(), aBounds.CenterX.size());
+}
+
+size_t FrustumCuller::Cull(const float* aCenterX, const float* aCenterY, const float* aCenterZ,
+	const float* aExtentX, const float* aExtentY, const float* aExtentZ, size_t aCount)
+{
+	Visibility.resize(aCount);
+	VisibleCount = 0;
+
+	__m128 PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+	__m128 AbsPlaneX[6], AbsPlaneY[6], AbsPlaneZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		PlaneX[p] = _mm_set1_ps(Planes[p].x);
+		PlaneY[p] = _mm_set1_ps(Planes[p].y);
+		PlaneZ[p] = _mm_set1_ps(Planes[p].z);
+		PlaneW[p] = _mm_set1_ps(Planes[p].w + GetSweepOffset(Planes[p]));
+		AbsPlaneX[p] = _mm_set1_ps(std::fabs(Planes[p].x));
+		AbsPlaneY[p] = _mm_set1_ps(std::fabs(Planes[p].y));
+		AbsPlaneZ[p] = _mm_set1_ps(std::fabs(Planes[p].z));
+	}
+	const __m128 Zero = _mm_setzero_ps();
+
+	const bool bTestDistance = MaxDistance > 0.0f;
+	const bool bTestSize = MinProjectedSize > 0.0f && ProjectionScale > 0.0f;
+	const __m128 OriginX = _mm_set1_ps(RangeOrigin.x);
+	const __m128 OriginY = _mm_set1_ps(RangeOrigin.y);
+	const __m128 OriginZ = _mm_set1_ps(RangeOrigin.z);
+	const __m128 MaxDistanceV = _mm_set1_ps(MaxDistance);
+	const __m128 MinSizeSq = _mm_set1_ps(MinProjectedSize * MinProjectedSize);
+	const __m128 DiameterScaleSq = _mm_set1_ps(4.0f * ProjectionScale * ProjectionScale);
+
+	size_t i = 0;
+	for (; i + 4 <= aCount; i += 4)
+	{
+		__m128 CenterX = _mm_loadu_ps(aCenterX + i);
+		__m128 CenterY = _mm_loadu_ps(aCenterY + i);
+		__m128 CenterZ = _mm_loadu_ps(aCenterZ + i);
+		__m128 ExtentX = _mm_loadu_ps(aExtentX + i);
+		__m128 ExtentY = _mm_loadu_ps(aExtentY + i);
+		__m128 ExtentZ = _mm_loadu_ps(aExtentZ + i);
+
+		// A box is outside once it lies fully behind any plane: dist(center) + projected radius < 0
+		__m128 Outside = Zero;
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 Distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(PlaneX[p], CenterX), _mm_mul_ps(PlaneY[p], CenterY)),
+				_mm_add_ps(_mm_mul_ps(PlaneZ[p], CenterZ), PlaneW[p]));
+			__m128 Radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(AbsPlaneX[p], ExtentX), _mm_mul_ps(AbsPlaneY[p], ExtentY)),
+				_mm_mul_ps(AbsPlaneZ[p], ExtentZ));
+			Outside = _mm_or_ps(Outside, _mm_cmplt_ps(_mm_add_ps(Distance, Radius), Zero));
+		}
+
+		if (bTestDistance || bTestSize)
+		{
+			__m128 DeltaX = _mm_sub_ps(CenterX, OriginX);
+			__m128 DeltaY = _mm_sub_ps(CenterY, OriginY);
+			__m128 DeltaZ = _mm_sub_ps(CenterZ, OriginZ);
+			__m128 DistanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(DeltaX, DeltaX), _mm_mul_ps(DeltaY, DeltaY)), _mm_mul_ps(DeltaZ, DeltaZ));
+			__m128 RadiusSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ExtentX, ExtentX), _mm_mul_ps(ExtentY, ExtentY)), _mm_mul_ps(ExtentZ, ExtentZ));
+			if (bTestDistance)
+			{
+				// Sphere entirely beyond the range: distance > MaxDistance + radius
+				__m128 Limit = _mm_add_ps(MaxDistanceV, _mm_sqrt_ps(RadiusSq));
+				Outside = _mm_or_ps(Outside, _mm_cmpgt_ps(DistanceSq, _mm_mul_ps(Limit, Limit)));
+			}
+			if (bTestSize)
+			{
+				// Projected diameter 2 * r * scale / d below the threshold, compared squared
+				Outside = _mm_or_ps(Outside, _mm_cmplt_ps(_mm_mul_ps(DiameterScaleSq, RadiusSq), _mm_mul_ps(MinSizeSq, DistanceSq)));
+			}
+		}
+
+		int VisibleMask = ~_mm_movemask_ps(Outside) & 0xF;
+		for (int Lane = 0; Lane < 4; Lane++)
+		{
+			std::uint8_t bVisible = (VisibleMask >> Lane) & 1;
+			Visibility[i + Lane] = bVisible;
+			VisibleCount += bVisible;
+		}
+	}
+
+	for (; i < aCount; i++)
+	{
+		std::uint8_t bVisible = IsBoxVisible(aCenterX[i], aCenterY[i], aCenterZ[i], aExtentX[i], aExtentY[i], aExtentZ[i]) ? 1 : 0;
+		Visibility[i] = bVisible;
+		VisibleCount += bVisible;
+	}
+	return VisibleCount;
+}
+
+float FrustumCuller::GetSweepOffset(const DirectX::XMFLOAT4& aPlane) const
+{
+	// The plane distance changes linearly along the sweep, so the swept box is outside
+	// only if both its start and end are: max(d, d + offset) = d + max(0, offset)
+	float Offset = SweepLength * (aPlane.x * SweepDirection.x + aPlane.y * SweepDirection.y + aPlane.z * SweepDirection.z);
+	return Offset > 0.0f ? Offset : 0.0f;
+}
+
+bool FrustumCuller::IsBoxVisible(float aCenterX, float aCenterY, float aCenterZ, float aExtentX, float aExtentY, float aExtentZ) const
+{
+	for (const auto& Plane : Planes)
+	{
+		float Distance = Plane.x * aCenterX + Plane.y * aCenterY + Plane.z * aCenterZ + Plane.w + GetSweepOffset(Plane);
+		float Radius = std::fabs(Plane.x) * aExtentX + std::fabs(Plane.y) * aExtentY + std::fabs(Plane.z) * aExtentZ;
+		if (Distance + Radius < 0.0f)
+			return false;
+	}
+
+	float DeltaX = aCenterX - RangeOrigin.x;
+	float DeltaY = aCenterY - RangeOrigin.y;
+	float DeltaZ = aCenterZ - RangeOrigin.z;
+	float DistanceSq = DeltaX * DeltaX + DeltaY * DeltaY + DeltaZ * DeltaZ;
+	float RadiusSq = aExtentX * aExtentX + aExtentY * aExtentY + aExtentZ * aExtentZ;
+	if (MaxDistance > 0.0f)
+	{
+		float Limit = MaxDistance + std::sqrt(RadiusSq);
+		if (DistanceSq > Limit * Limit)
+			return false;
+	}
+	if (MinProjectedSize > 0.0f && ProjectionScale > 0.0f)
+	{
+		if (4.0f * ProjectionScale * ProjectionScale * RadiusSq < MinProjectedSize * MinProjectedSize * DistanceSq)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "SceneStore.h"
+
+// Tests world space AABBs against the six planes of a view-projection, four boxes per SSE iteration.
+// Boxes are read from SoA streams (SceneStore::WorldBoundsStreams) and the result is one visibility
+// byte per box, consumed while building the render queue of the pass.
+class FrustumCuller
+{
+public:
+	// aViewProj uses the CPU side row vector convention (p * View * Proj), not the transposed shader copy.
+	// bInfiniteNear drops the near plane, e.g. to keep shadow casters between a light and its volume.
+	void SetViewProj(const DirectX::XMFLOAT4X4& aViewProj, bool bInfiniteNear = false);
+	// Uses the six faces of a world space box as planes
+	void SetBox(const DirectX::XMFLOAT3& aCenter, const DirectX::XMFLOAT3& aExtents);
+	const DirectX::XMFLOAT4* GetPlanes() const { return Planes; }
+
+	// Optional tests run together with the planes, on the bounding sphere of each box:
+	// boxes farther than aMaxDistance from aOrigin, or whose projected diameter is below aMinProjectedSize
+	// (aProjectionScale = viewport height / (2 * tan(FovY / 2))) are culled. A zero limit disables its test.
+	void SetRangeLimits(const DirectX::XMFLOAT3& aOrigin, float aMaxDistance, float aMinProjectedSize, float aProjectionScale);
+	void ClearRangeLimits();
+
+	// Tests every box swept by aLength along aDirection instead of the box itself, so a box is kept when
+	// any point of its path intersects the volume (e.g. a caster whose shadow reaches the camera frustum)
+	void SetSweep(const DirectX::XMFLOAT3& aDirection, float aLength);
+	void ClearSweep();
+
+	// Returns the number of visible boxes
+	size_t Cull(const SceneStore::WorldBoundsStreams& aBounds);
+	size_t Cull(const float* aCenterX, const float* aCenterY, const float* aCenterZ,
+		const float* aExtentX, const float* aExtentY, const float* aExtentZ, size_t aCount);
+
+	bool IsVisible(size_t aIndex) const { return Visibility[aIndex] != 0; }
+	const std::vector<std::uint8_t>& GetVisibility() const { return Visibility; }
+	size_t GetVisibleCount() const { return VisibleCount; }
+	size_t GetTestedCount() const { return Visibility.size(); }
+
+private:
+	float GetSweepOffset(const DirectX::XMFLOAT4& aPlane) const;
+	bool IsBoxVisible(float aCenterX, float aCenterY, float aCenterZ, float aExtentX, float aExtentY, float aExtentZ) const;
+
+	// Normalized, pointing inside: dot(N, P) + W >= 0 for points inside the frustum
+	DirectX::XMFLOAT4 Planes[6] = {};
+	DirectX::XMFLOAT3 RangeOrigin = { 0.0f, 0.0f, 0.0f };
+	float MaxDistance = 0.0f;
+	float MinProjectedSize = 0.0f;
+	float ProjectionScale = 0.0f;
+	DirectX::XMFLOAT3 SweepDirection = { 0.0f, 0.0f, 0.0f };
+	float SweepLength = 0.0f;
+	std::vector<std::uint8_t> Visibility;
+	size_t VisibleCount = 0;
+};
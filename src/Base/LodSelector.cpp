@@ -0,0 +1,118 @@
+#include "LodSelector.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+LodSelector::GroupId LodSelector::AddGroup(const std::vector<float>& aScreenSizes)
+{
+	assert(std::is_sorted(aScreenSizes.rbegin(), aScreenSizes.rend()) && "LOD screen sizes must be descending");
+	GroupId Id = static_cast<GroupId>(Groups.size());
+	Groups.push_back({ static_cast<std::uint32_t>(ScreenSizes.size()), static_cast<std::uint32_t>(aScreenSizes.size()) });
+	ScreenSizes.insert(ScreenSizes.end(), aScreenSizes.begin(), aScreenSizes.end());
+	return Id;
+}
+
+void LodSelector::AddItem(ItemId aItem, GroupId aGroup, const std::vector<SceneStore::DrawArgs>& aLevels)
+{
+	assert(aGroup < Groups.size() && "Invalid LOD group");
+	assert(aLevels.size() == GetLevelCount(aGroup) && "One draw argument per level expected");
+	if (aItem >= ItemSlots.size())
+		ItemSlots.resize(size_t(aItem) + 1, -1);
+	assert(ItemSlots[aItem] < 0 && "Item already has a LOD group");
+
+	ItemSlots[aItem] = static_cast<std::int32_t>(Items.size());
+	Items.push_back(aItem);
+	ItemGroups.push_back(aGroup);
+	ItemLevels.push_back(0);
+	FirstItemLevel.push_back(static_cast<std::uint32_t>(LevelDrawArgs.size()));
+	LevelDrawArgs.insert(LevelDrawArgs.end(), aLevels.begin(), aLevels.end());
+}
+
+void LodSelector::RemoveItem(ItemId aItem)
+{
+	if (aItem >= ItemSlots.size() || ItemSlots[aItem] < 0)
+		return;
+	size_t Slot = static_cast<size_t>(ItemSlots[aItem]);
+	ItemSlots[aItem] = -1;
+
+	// Close the gap in LevelDrawArgs, the items stored after it move down
+	std::uint32_t First = FirstItemLevel[Slot];
+	std::uint32_t LevelCount = GetLevelCount(ItemGroups[Slot]);
+	LevelDrawArgs.erase(LevelDrawArgs.begin() + First, LevelDrawArgs.begin() + First + LevelCount);
+	for (std::uint32_t& FirstLevel : FirstItemLevel)
+	{
+		if (FirstLevel > First)
+			FirstLevel -= LevelCount;
+	}
+
+	// The last item takes the slot
+	size_t Last = Items.size() - 1;
+	if (Slot != Last)
+	{
+		Items[Slot] = Items[Last];
+		ItemGroups[Slot] = ItemGroups[Last];
+		ItemLevels[Slot] = ItemLevels[Last];
+		FirstItemLevel[Slot] = FirstItemLevel[Last];
+		ItemSlots[Items[Slot]] = static_cast<std::int32_t>(Slot);
+	}
+	Items.pop_back();
+	ItemGroups.pop_back();
+	ItemLevels.pop_back();
+	FirstItemLevel.pop_back();
+	ChangedItems.erase(std::remove(ChangedItems.begin(), ChangedItems.end(), aItem), ChangedItems.end());
+}
+
+std::uint32_t LodSelector::GetLevel(ItemId aItem) const
+{
+	if (aItem >= ItemSlots.size() || ItemSlots[aItem] < 0)
+		return 0;
+	return ItemLevels[ItemSlots[aItem]];
+}
+
+std::uint32_t LodSelector::GetLevelForSize(GroupId aGroup, float aSize) const
+{
+	const Group& LodGroup = Groups[aGroup];
+	std::uint32_t Level = 0;
+	while (Level < LodGroup.SizeCount && aSize < ScreenSizes[LodGroup.FirstSize + Level])
+		Level++;
+	return Level;
+}
+
+size_t LodSelector::Select(SceneStore& aScene, const DirectX::XMFLOAT3& aEye, float aProjectionScale)
+{
+	ChangedItems.clear();
+	const auto& WorldBounds = aScene.GetAllWorldBounds();
+	float SizeScale = aProjectionScale * std::exp2(-Bias);
+	float Finer = 1.0f + Hysteresis;
+	float Coarser = 1.0f - Hysteresis;
+
+	for (size_t i = 0; i < Items.size(); i++)
+	{
+		ItemId Item = Items[i];
+		float ToCenterX = WorldBounds.CenterX[Item] - aEye.x;
+		float ToCenterY = WorldBounds.CenterY[Item] - aEye.y;
+		float ToCenterZ = WorldBounds.CenterZ[Item] - aEye.z;
+		float Radius = std::sqrt(WorldBounds.ExtentX[Item] * WorldBounds.ExtentX[Item] + WorldBounds.ExtentY[Item] * WorldBounds.ExtentY[Item]
+			+ WorldBounds.ExtentZ[Item] * WorldBounds.ExtentZ[Item]);
+		float Distance = std::sqrt(ToCenterX * ToCenterX + ToCenterY * ToCenterY + ToCenterZ * ToCenterZ);
+		// Eye inside the sphere counts as covering the whole view
+		float Size = Distance > Radius ? Radius * SizeScale / Distance : FLT_MAX;
+
+		// Step one level at a time while the size is past the hysteresis band of the current level
+		const Group& LodGroup = Groups[ItemGroups[i]];
+		const float* Thresholds = &ScreenSizes[LodGroup.FirstSize];
+		std::uint32_t Level = ItemLevels[i];
+		while (Level > 0 && Size >= Thresholds[Level - 1] * Finer)
+			Level--;
+		while (Level < LodGroup.SizeCount && Size < Thresholds[Level] * Coarser)
+			Level++;
+		if (Level == ItemLevels[i])
+			continue;
+
+		ItemLevels[i] = Level;
+		aScene.SetDrawArgs(Item, LevelDrawArgs[FirstItemLevel[i] + Level]);
+		ChangedItems.push_back(Item);
+	}
+	return ChangedItems.size();
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "SceneStore.h"
+
+// Picks a level of detail for every registered item from the projected size of its bounding sphere, the
+// sphere's diameter over the view height, and swaps the item's draw arguments in the SceneStore.
+// A group lists the smallest size at which each level but the last is still drawn. Hysteresis keeps an
+// item on its level until the size is a fraction past the threshold, so items near it do not flicker
+// between levels every frame; the bias scales every size by 2^-Bias, positive values favour coarser levels.
+class LodSelector
+{
+public:
+	using ItemId = SceneStore::ItemId;
+	using GroupId = std::uint32_t;
+
+	// aScreenSizes is descending, level i is drawn while the size is at least aScreenSizes[i] and the last
+	// level below the last size. The group has aScreenSizes.size() + 1 levels.
+	GroupId AddGroup(const std::vector<float>& aScreenSizes);
+	std::uint32_t GetLevelCount(GroupId aGroup) const { return Groups[aGroup].SizeCount + 1; }
+	// aLevels holds the item's draw arguments of every level of the group, finest first. Starts at level 0.
+	void AddItem(ItemId aItem, GroupId aGroup, const std::vector<SceneStore::DrawArgs>& aLevels);
+	// Forgets the item, its draw arguments in the SceneStore stay at its current level. Ignored for items
+	// without a group.
+	void RemoveItem(ItemId aItem);
+	size_t GetItemCount() const { return Items.size(); }
+
+	void SetHysteresis(float aFraction) { Hysteresis = aFraction; }
+	float GetHysteresis() const { return Hysteresis; }
+	void SetBias(float aBias) { Bias = aBias; }
+	float GetBias() const { return Bias; }
+
+	// aProjectionScale is the projection's y scale, cot(FovY / 2). Swaps the draw arguments of the items
+	// whose level changed and returns how many did, see GetChangedItems.
+	size_t Select(SceneStore& aScene, const DirectX::XMFLOAT3& aEye, float aProjectionScale);
+	const std::vector<ItemId>& GetChangedItems() const { return ChangedItems; }
+
+	// Level of an item, 0 for items without a group
+	std::uint32_t GetLevel(ItemId aItem) const;
+	// Level the thresholds alone pick for aSize, ignoring hysteresis and bias
+	std::uint32_t GetLevelForSize(GroupId aGroup, float aSize) const;
+
+private:
+	struct Group
+	{
+		std::uint32_t FirstSize;
+		std::uint32_t SizeCount;
+	};
+
+	std::vector<float> ScreenSizes;				// Thresholds of every group, see Group
+	std::vector<Group> Groups;
+	// Registered items, SoA
+	std::vector<ItemId> Items;
+	std::vector<GroupId> ItemGroups;
+	std::vector<std::uint32_t> ItemLevels;
+	std::vector<std::uint32_t> FirstItemLevel;	// Into LevelDrawArgs, GetLevelCount entries per item
+	std::vector<SceneStore::DrawArgs> LevelDrawArgs;
+	std::vector<std::int32_t> ItemSlots;		// ItemId -> index in Items, -1 if not registered
+	std::vector<ItemId> ChangedItems;
+	float Hysteresis = 0.1f;
+	float Bias = 0.0f;
+};
@@ -0,0 +1,393 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <xmmintrin.h>
+
+namespace
+{
+	// Boxes covering at most this many pixels are tested against the depth buffer itself instead of the HiZ
+	constexpr std::uint32_t MaxPixelTestArea = 256;
+	constexpr float MinClipW = 1e-5f;
+
+	void LoadMatrix(const DirectX::XMFLOAT4X4& aMatrix, float aOut[16])
+	{
+		for (int Row = 0; Row < 4; Row++)
+			for (int Column = 0; Column < 4; Column++)
+				aOut[Row * 4 + Column] = aMatrix.m[Row][Column];
+	}
+
+	void MultiplyMatrices(const float A[16], const float B[16], float aOut[16])
+	{
+		for (int Row = 0; Row < 4; Row++)
+			for (int Column = 0; Column < 4; Column++)
+			{
+				float Sum = 0.0f;
+				for (int k = 0; k < 4; k++)
+					Sum += A[Row * 4 + k] * B[k * 4 + Column];
+				aOut[Row * 4 + Column] = Sum;
+			}
+	}
+}
+
+void OcclusionCuller::Resize(std::uint32_t aWidth, std::uint32_t aHeight)
+{
+	assert(aWidth > 0 && aHeight > 0);
+	TilesX = (aWidth + TileSize - 1) / TileSize;
+	TilesY = (aHeight + TileSize - 1) / TileSize;
+	Width = TilesX * TileSize;
+	Height = TilesY * TileSize;
+	Depth.assign(size_t(Width) * Height, 1.0f);
+
+	HiZ.clear();
+	HiZWidths.clear();
+	HiZHeights.clear();
+	std::uint32_t LevelWidth = TilesX;
+	std::uint32_t LevelHeight = TilesY;
+	while (true)
+	{
+		HiZ.emplace_back(size_t(LevelWidth) * LevelHeight, 1.0f);
+		HiZWidths.push_back(LevelWidth);
+		HiZHeights.push_back(LevelHeight);
+		if (LevelWidth == 1 && LevelHeight == 1)
+			break;
+		LevelWidth = (LevelWidth + 1) / 2;
+		LevelHeight = (LevelHeight + 1) / 2;
+	}
+}
+
+void OcclusionCuller::BeginFrame(const DirectX::XMFLOAT4X4& aViewProj)
+{
+	assert(Width > 0 && "OcclusionCuller::Resize must be called first");
+	LoadMatrix(aViewProj, ViewProj);
+	std::fill(Depth.begin(), Depth.end(), 1.0f);
+	for (auto& Level : HiZ)
+		std::fill(Level.begin(), Level.end(), 1.0f);
+	RasterizedTriangles = 0;
+}
+
+void OcclusionCuller::Transform(const float aPosition[3], const float aMatrix[16], float aClip[4]) const
+{
+	for (int Column = 0; Column < 4; Column++)
+		aClip[Column] = aPosition[0] * aMatrix[Column] + aPosition[1] * aMatrix[4 + Column] + aPosition[2] * aMatrix[8 + Column] + aMatrix[12 + Column];
+}
+
+OcclusionCuller::ScreenVertex OcclusionCuller::ToScreen(const float aClip[4]) const
+{
+	float InvW = 1.0f / aClip[3];
+	return { (aClip[0] * InvW * 0.5f + 0.5f) * float(Width), (0.5f - aClip[1] * InvW * 0.5f) * float(Height), aClip[2] * InvW };
+}
+
+void OcclusionCuller::RasterizeOccluder(const void* aPositions, size_t aPositionStride, size_t aVertexCount, const void* aIndices,
+	bool b32BitIndices, std::uint32_t aIndexCount, std::int32_t aBaseVertex, const DirectX::XMFLOAT4X4& aWorld)
+{
+	float World[16];
+	float WorldViewProj[16];
+	LoadMatrix(aWorld, World);
+	MultiplyMatrices(World, ViewProj, WorldViewProj);
+
+	const std::uint8_t* Positions = static_cast<const std::uint8_t*>(aPositions);
+	for (std::uint32_t Triangle = 0; Triangle + 2 < aIndexCount; Triangle += 3)
+	{
+		float Clip[3][4];
+		bool bValid = true;
+		for (std::uint32_t Corner = 0; Corner < 3; Corner++)
+		{
+			std::int64_t Index = aBaseVertex + std::int64_t(b32BitIndices
+				? static_cast<const std::uint32_t*>(aIndices)[Triangle + Corner]
+				: static_cast<const std::uint16_t*>(aIndices)[Triangle + Corner]);
+			if (Index < 0 || size_t(Index) >= aVertexCount)
+			{
+				bValid = false;
+				break;
+			}
+			Transform(reinterpret_cast<const float*>(Positions + size_t(Index) * aPositionStride), WorldViewProj, Clip[Corner]);
+		}
+		if (!bValid)
+			continue;
+
+		// Clip against the near plane (z >= 0), which leaves a triangle or a quad
+		float Polygon[4][4];
+		int PolygonSize = 0;
+		for (int Corner = 0; Corner < 3; Corner++)
+		{
+			const float* A = Clip[Corner];
+			const float* B = Clip[(Corner + 1) % 3];
+			bool bInsideA = A[2] >= 0.0f;
+			bool bInsideB = B[2] >= 0.0f;
+			if (bInsideA)
+				std::copy(A, A + 4, Polygon[PolygonSize++]);
+			if (bInsideA != bInsideB)
+			{
+				float t = A[2] / (A[2] - B[2]);
+				for (int i = 0; i < 4; i++)
+					Polygon[PolygonSize][i] = A[i] + (B[i] - A[i]) * t;
+				Polygon[PolygonSize++][2] = 0.0f;
+			}
+		}
+		if (PolygonSize < 3)
+			continue;
+
+		ScreenVertex Screen[4];
+		for (int i = 0; i < PolygonSize; i++)
+		{
+			if (Polygon[i][3] < MinClipW)
+			{
+				bValid = false;
+				break;
+			}
+			Screen[i] = ToScreen(Polygon[i]);
+		}
+		if (!bValid)
+			continue;
+
+		RasterizeTriangle(Screen[0], Screen[1], Screen[2]);
+		if (PolygonSize == 4)
+			RasterizeTriangle(Screen[0], Screen[2], Screen[3]);
+		RasterizedTriangles++;
+	}
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenVertex& aV0, const ScreenVertex& aV1, const ScreenVertex& aV2)
+{
+	float Area = (aV1.X - aV0.X) * (aV2.Y - aV0.Y) - (aV1.Y - aV0.Y) * (aV2.X - aV0.X);
+	if (std::fabs(Area) < 1e-8f)
+		return;
+	// Both windings are rasterized, the edge functions are made positive inside
+	const ScreenVertex& V0 = aV0;
+	const ScreenVertex& V1 = Area > 0.0f ? aV1 : aV2;
+	const ScreenVertex& V2 = Area > 0.0f ? aV2 : aV1;
+	Area = std::fabs(Area);
+
+	// Pixels whose center lies inside the triangle's bounds
+	float MinX = std::min({ V0.X, V1.X, V2.X });
+	float MaxX = std::max({ V0.X, V1.X, V2.X });
+	float MinY = std::min({ V0.Y, V1.Y, V2.Y });
+	float MaxY = std::max({ V0.Y, V1.Y, V2.Y });
+	if (MaxX < 0.5f || MaxY < 0.5f || MinX > float(Width) - 0.5f || MinY > float(Height) - 0.5f)
+		return;
+	std::int32_t PixelX0 = std::max(0, std::int32_t(std::ceil(MinX - 0.5f)));
+	std::int32_t PixelX1 = std::min(std::int32_t(Width) - 1, std::int32_t(std::floor(MaxX - 0.5f)));
+	std::int32_t PixelY0 = std::max(0, std::int32_t(std::ceil(MinY - 0.5f)));
+	std::int32_t PixelY1 = std::min(std::int32_t(Height) - 1, std::int32_t(std::floor(MaxY - 0.5f)));
+	if (PixelX0 > PixelX1 || PixelY0 > PixelY1)
+		return;
+
+	// Edge i is A * x + B * y + C, the edge from vertex i to the next one
+	const ScreenVertex* Vertices[3] = { &V0, &V1, &V2 };
+	float EdgeA[3], EdgeB[3], EdgeC[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const ScreenVertex& From = *Vertices[i];
+		const ScreenVertex& To = *Vertices[(i + 1) % 3];
+		EdgeA[i] = From.Y - To.Y;
+		EdgeB[i] = To.X - From.X;
+		EdgeC[i] = -(EdgeA[i] * From.X + EdgeB[i] * From.Y);
+	}
+
+	// Depth plane z = ZC + ZDx * x + ZDy * y, raised to the farthest depth within the pixel
+	float ZDx = ((V1.Z - V0.Z) * (V2.Y - V0.Y) - (V2.Z - V0.Z) * (V1.Y - V0.Y)) / Area;
+	float ZDy = ((V2.Z - V0.Z) * (V1.X - V0.X) - (V1.Z - V0.Z) * (V2.X - V0.X)) / Area;
+	float ZC = V0.Z - ZDx * V0.X - ZDy * V0.Y + 0.5f * (std::fabs(ZDx) + std::fabs(ZDy));
+
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 Offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 A[3], B[3], C[3];
+	for (int i = 0; i < 3; i++)
+	{
+		A[i] = _mm_set1_ps(EdgeA[i]);
+		B[i] = _mm_set1_ps(EdgeB[i]);
+		C[i] = _mm_set1_ps(EdgeC[i]);
+	}
+	const __m128 ZX = _mm_set1_ps(ZDx);
+	const __m128 ZY = _mm_set1_ps(ZDy);
+	const __m128 ZConstant = _mm_set1_ps(ZC);
+
+	std::uint32_t TileX0 = std::uint32_t(PixelX0) / TileSize, TileX1 = std::uint32_t(PixelX1) / TileSize;
+	std::uint32_t TileY0 = std::uint32_t(PixelY0) / TileSize, TileY1 = std::uint32_t(PixelY1) / TileSize;
+	for (std::uint32_t TileY = TileY0; TileY <= TileY1; TileY++)
+	{
+		for (std::uint32_t TileX = TileX0; TileX <= TileX1; TileX++)
+		{
+			// Edge values at the tile's corner pixel centers: all negative for one edge rejects the tile,
+			// all positive for every edge means the tile is fully covered
+			float CornerX0 = float(TileX * TileSize) + 0.5f, CornerX1 = CornerX0 + float(TileSize - 1);
+			float CornerY0 = float(TileY * TileSize) + 0.5f, CornerY1 = CornerY0 + float(TileSize - 1);
+			bool bRejected = false;
+			bool bCovered = true;
+			for (int i = 0; i < 3 && !bRejected; i++)
+			{
+				float E00 = EdgeA[i] * CornerX0 + EdgeB[i] * CornerY0 + EdgeC[i];
+				float E10 = EdgeA[i] * CornerX1 + EdgeB[i] * CornerY0 + EdgeC[i];
+				float E01 = EdgeA[i] * CornerX0 + EdgeB[i] * CornerY1 + EdgeC[i];
+				float E11 = EdgeA[i] * CornerX1 + EdgeB[i] * CornerY1 + EdgeC[i];
+				bRejected = std::max({ E00, E10, E01, E11 }) < 0.0f;
+				bCovered = bCovered && std::min({ E00, E10, E01, E11 }) >= 0.0f;
+			}
+			if (bRejected)
+				continue;
+
+			std::uint32_t RowBegin = bCovered ? TileY * TileSize : std::max(TileY * TileSize, std::uint32_t(PixelY0));
+			std::uint32_t RowEnd = bCovered ? (TileY + 1) * TileSize : std::min((TileY + 1) * TileSize, std::uint32_t(PixelY1) + 1);
+			for (std::uint32_t Y = RowBegin; Y < RowEnd; Y++)
+			{
+				float* Row = &Depth[size_t(Y) * Width];
+				__m128 PixelY = _mm_set1_ps(float(Y) + 0.5f);
+				__m128 RowZ = _mm_add_ps(ZConstant, _mm_mul_ps(ZY, PixelY));
+				for (std::uint32_t X = TileX * TileSize; X < (TileX + 1) * TileSize; X += 4)
+				{
+					__m128 PixelX = _mm_add_ps(_mm_set1_ps(float(X)), Offsets);
+					__m128 Z = _mm_max_ps(_mm_add_ps(RowZ, _mm_mul_ps(ZX, PixelX)), Zero);
+					__m128 Old = _mm_loadu_ps(Row + X);
+					__m128 New = _mm_min_ps(Old, Z);
+					if (!bCovered)
+					{
+						__m128 Inside = _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(A[0], PixelX), _mm_mul_ps(B[0], PixelY)), C[0]), Zero);
+						for (int i = 1; i < 3; i++)
+							Inside = _mm_and_ps(Inside, _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(A[i], PixelX), _mm_mul_ps(B[i], PixelY)), C[i]), Zero));
+						New = _mm_or_ps(_mm_and_ps(Inside, New), _mm_andnot_ps(Inside, Old));
+					}
+					_mm_storeu_ps(Row + X, New);
+				}
+			}
+		}
+	}
+}
+
+void OcclusionCuller::EndOccluders()
+{
+	std::vector<float>& Tiles = HiZ[0];
+	for (std::uint32_t TileY = 0; TileY < TilesY; TileY++)
+	{
+		for (std::uint32_t TileX = 0; TileX < TilesX; TileX++)
+		{
+			__m128 Max = _mm_setzero_ps();
+			for (std::uint32_t Y = TileY * TileSize; Y < (TileY + 1) * TileSize; Y++)
+			{
+				const float* Row = &Depth[size_t(Y) * Width + TileX * TileSize];
+				Max = _mm_max_ps(Max, _mm_max_ps(_mm_loadu_ps(Row), _mm_loadu_ps(Row + 4)));
+			}
+			Max = _mm_max_ps(Max, _mm_movehl_ps(Max, Max));
+			Max = _mm_max_ss(Max, _mm_shuffle_ps(Max, Max, _MM_SHUFFLE(1, 1, 1, 1)));
+			Tiles[size_t(TileY) * TilesX + TileX] = _mm_cvtss_f32(Max);
+		}
+	}
+
+	for (size_t Level = 1; Level < HiZ.size(); Level++)
+	{
+		const std::vector<float>& Source = HiZ[Level - 1];
+		std::uint32_t SourceWidth = HiZWidths[Level - 1];
+		std::uint32_t SourceHeight = HiZHeights[Level - 1];
+		for (std::uint32_t Y = 0; Y < HiZHeights[Level]; Y++)
+		{
+			for (std::uint32_t X = 0; X < HiZWidths[Level]; X++)
+			{
+				std::uint32_t X1 = std::min(X * 2 + 1, SourceWidth - 1);
+				std::uint32_t Y1 = std::min(Y * 2 + 1, SourceHeight - 1);
+				HiZ[Level][size_t(Y) * HiZWidths[Level] + X] = std::max(
+					std::max(Source[size_t(Y * 2) * SourceWidth + X * 2], Source[size_t(Y * 2) * SourceWidth + X1]),
+					std::max(Source[size_t(Y1) * SourceWidth + X * 2], Source[size_t(Y1) * SourceWidth + X1]));
+			}
+		}
+	}
+}
+
+float OcclusionCuller::GetMaxDepth(std::uint32_t aLevel, std::uint32_t aX0, std::uint32_t aY0, std::uint32_t aX1, std::uint32_t aY1) const
+{
+	const std::vector<float>& Level = HiZ[aLevel];
+	float Max = 0.0f;
+	for (std::uint32_t Y = aY0; Y <= aY1; Y++)
+		for (std::uint32_t X = aX0; X <= aX1; X++)
+			Max = std::max(Max, Level[size_t(Y) * HiZWidths[aLevel] + X]);
+	return Max;
+}
+
+bool OcclusionCuller::IsBoxVisible(const DirectX::XMFLOAT3& aCenter, const DirectX::XMFLOAT3& aExtents) const
+{
+	if (RasterizedTriangles == 0)
+		return true;
+
+	// Corners are the projected center plus or minus the projected extent axes
+	const float Center[3] = { aCenter.x, aCenter.y, aCenter.z };
+	float ClipCenter[4];
+	Transform(Center, ViewProj, ClipCenter);
+	float Axes[3][4];
+	const float Extents[3] = { aExtents.x, aExtents.y, aExtents.z };
+	for (int Axis = 0; Axis < 3; Axis++)
+		for (int i = 0; i < 4; i++)
+			Axes[Axis][i] = ViewProj[Axis * 4 + i] * Extents[Axis];
+
+	float MinX = FLT_MAX, MaxX = -FLT_MAX, MinY = FLT_MAX, MaxY = -FLT_MAX, MinZ = FLT_MAX;
+	for (int Corner = 0; Corner < 8; Corner++)
+	{
+		float Clip[4];
+		for (int i = 0; i < 4; i++)
+		{
+			Clip[i] = ClipCenter[i];
+			for (int Axis = 0; Axis < 3; Axis++)
+				Clip[i] += (Corner & (1 << Axis)) ? Axes[Axis][i] : -Axes[Axis][i];
+		}
+		// Boxes reaching the near plane cannot be occluded
+		if (Clip[2] < 0.0f || Clip[3] < MinClipW)
+			return true;
+		ScreenVertex Screen = ToScreen(Clip);
+		MinX = std::min(MinX, Screen.X);
+		MaxX = std::max(MaxX, Screen.X);
+		MinY = std::min(MinY, Screen.Y);
+		MaxY = std::max(MaxY, Screen.Y);
+		MinZ = std::min(MinZ, Screen.Z);
+	}
+
+	// Every pixel the rectangle touches plus a one pixel border: occluders are sampled at pixel centers, so
+	// the box may show through the uncovered part of a silhouette pixel, next to an uncovered neighbour.
+	// Boxes off screen are left to the frustum test.
+	if (MaxX < 0.0f || MaxY < 0.0f || MinX >= float(Width) || MinY >= float(Height))
+		return true;
+	std::uint32_t PixelX0 = std::uint32_t(std::max(0.0f, MinX - 1.0f));
+	std::uint32_t PixelX1 = std::uint32_t(std::min(float(Width - 1), MaxX + 1.0f));
+	std::uint32_t PixelY0 = std::uint32_t(std::max(0.0f, MinY - 1.0f));
+	std::uint32_t PixelY1 = std::uint32_t(std::min(float(Height - 1), MaxY + 1.0f));
+
+	if ((PixelX1 - PixelX0 + 1) * (PixelY1 - PixelY0 + 1) <= MaxPixelTestArea)
+	{
+		for (std::uint32_t Y = PixelY0; Y <= PixelY1; Y++)
+		{
+			const float* Row = &Depth[size_t(Y) * Width];
+			for (std::uint32_t X = PixelX0; X <= PixelX1; X++)
+				if (MinZ <= Row[X])
+					return true;
+		}
+		return false;
+	}
+
+	// Coarsest level where the rectangle spans at most 2x2 cells
+	std::uint32_t TileX0 = PixelX0 / TileSize, TileX1 = PixelX1 / TileSize;
+	std::uint32_t TileY0 = PixelY0 / TileSize, TileY1 = PixelY1 / TileSize;
+	std::uint32_t Level = 0;
+	while (Level + 1 < HiZ.size() && ((TileX1 >> Level) - (TileX0 >> Level) > 1 || (TileY1 >> Level) - (TileY0 >> Level) > 1))
+		Level++;
+	return MinZ <= GetMaxDepth(Level, TileX0 >> Level, TileY0 >> Level, TileX1 >> Level, TileY1 >> Level);
+}
+
+size_t OcclusionCuller::Cull(const SceneStore::WorldBoundsStreams& aBounds, const std::vector<std::uint8_t>& aInVisibility)
+{
+	size_t Count = aBounds.CenterX.size();
+	assert(aInVisibility.size() >= Count);
+	Visibility.assign(Count, 0);
+	OccludedCount = 0;
+	size_t VisibleCount = 0;
+	for (size_t i = 0; i < Count; i++)
+	{
+		if (!aInVisibility[i])
+			continue;
+		if (IsBoxVisible({ aBounds.CenterX[i], aBounds.CenterY[i], aBounds.CenterZ[i] }, { aBounds.ExtentX[i], aBounds.ExtentY[i], aBounds.ExtentZ[i] }))
+		{
+			Visibility[i] = 1;
+			VisibleCount++;
+		}
+		else
+			OccludedCount++;
+	}
+	return VisibleCount;
+}
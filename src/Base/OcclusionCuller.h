@@ -0,0 +1,68 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "SceneStore.h"
+
+// Software occlusion culling on the CPU.
+// A few large occluders are rasterized into a low resolution depth buffer (D3D depth, 0 near, 1 far),
+// four pixels per SSE iteration and 8x8 pixel tile at a time: tiles outside a triangle are skipped and
+// tiles it fully covers need no edge tests. A max depth hierarchy (HiZ) is built over the tiles, then
+// boxes are tested by projecting them and comparing their nearest depth with the farthest occluder depth
+// of the HiZ cells under their screen rectangle.
+class OcclusionCuller
+{
+public:
+	static constexpr std::uint32_t TileSize = 8;
+
+	// Both sizes are rounded up to a multiple of TileSize
+	void Resize(std::uint32_t aWidth, std::uint32_t aHeight);
+	std::uint32_t GetWidth() const { return Width; }
+	std::uint32_t GetHeight() const { return Height; }
+
+	// Clears the depth buffer. aViewProj uses the CPU side row vector convention (p * View * Proj).
+	void BeginFrame(const DirectX::XMFLOAT4X4& aViewProj);
+	// Rasterizes aIndexCount indices (16 or 32 bits wide, offset by aBaseVertex) of local space positions
+	// aPositionStride bytes apart, transformed by aWorld. Both triangle sides are occluders.
+	void RasterizeOccluder(const void* aPositions, size_t aPositionStride, size_t aVertexCount, const void* aIndices,
+		bool b32BitIndices, std::uint32_t aIndexCount, std::int32_t aBaseVertex, const DirectX::XMFLOAT4X4& aWorld);
+	// Builds the HiZ, call once every occluder of the frame has been rasterized
+	void EndOccluders();
+
+	// Conservative: boxes crossing the near plane or not fully behind occluders are visible
+	bool IsBoxVisible(const DirectX::XMFLOAT3& aCenter, const DirectX::XMFLOAT3& aExtents) const;
+	// Tests the boxes whose aInVisibility byte is set, the others stay invisible. Returns the number of
+	// visible boxes.
+	size_t Cull(const SceneStore::WorldBoundsStreams& aBounds, const std::vector<std::uint8_t>& aInVisibility);
+	bool IsVisible(size_t aIndex) const { return Visibility[aIndex] != 0; }
+	const std::vector<std::uint8_t>& GetVisibility() const { return Visibility; }
+	size_t GetOccludedCount() const { return OccludedCount; }
+
+	size_t GetRasterizedTriangleCount() const { return RasterizedTriangles; }
+	const std::vector<float>& GetDepth() const { return Depth; }
+
+private:
+	struct ScreenVertex
+	{
+		float X, Y, Z;
+	};
+
+	void RasterizeTriangle(const ScreenVertex& aV0, const ScreenVertex& aV1, const ScreenVertex& aV2);
+	ScreenVertex ToScreen(const float aClip[4]) const;
+	void Transform(const float aPosition[3], const float aMatrix[16], float aClip[4]) const;
+	float GetMaxDepth(std::uint32_t aLevel, std::uint32_t aX0, std::uint32_t aY0, std::uint32_t aX1, std::uint32_t aY1) const;
+
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+	std::uint32_t TilesX = 0;
+	std::uint32_t TilesY = 0;
+	float ViewProj[16] = {};
+	std::vector<float> Depth;						// Width * Height, row major
+	// Level 0 holds the max depth of every tile, each further level the max of 2x2 cells of the previous
+	std::vector<std::vector<float>> HiZ;
+	std::vector<std::uint32_t> HiZWidths, HiZHeights;
+	std::vector<std::uint8_t> Visibility;
+	size_t OccludedCount = 0;
+	size_t RasterizedTriangles = 0;
+};
@@ -0,0 +1,177 @@
+#include "ProbeLookup.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	// Keeps the grid small for sparse probe layouts
+	constexpr std::int64_t MaxCells = 1 << 16;
+
+	float GetComponent(const DirectX::XMFLOAT3& aVector, int aAxis)
+	{
+		return aAxis == 0 ? aVector.x : (aAxis == 1 ? aVector.y : aVector.z);
+	}
+
+	float DistanceSq(const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B)
+	{
+		float DX = A.x - B.x, DY = A.y - B.y, DZ = A.z - B.z;
+		return DX * DX + DY * DY + DZ * DZ;
+	}
+}
+
+void ProbeLookup::Build(const std::vector<Probe>& aProbes, float aCellSize)
+{
+	Probes = aProbes;
+	CellStarts.clear();
+	CellProbes.clear();
+	if (Probes.empty())
+		return;
+
+	float Min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float Max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	float MaxRadius = 0.0f;
+	for (const Probe& Current : Probes)
+	{
+		assert(Current.InfluenceRadius > 0.0f && "Probe lookup needs bounded influences");
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			Min[Axis] = std::min(Min[Axis], GetComponent(Current.Center, Axis) - Current.InfluenceRadius);
+			Max[Axis] = std::max(Max[Axis], GetComponent(Current.Center, Axis) + Current.InfluenceRadius);
+		}
+		MaxRadius = std::max(MaxRadius, Current.InfluenceRadius);
+	}
+
+	CellSize = aCellSize > 0.0f ? aCellSize : 2.0f * MaxRadius;
+	for (;;)
+	{
+		std::int64_t Total = 1;
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			CellCounts[Axis] = std::max(1, (std::int32_t)std::ceil((Max[Axis] - Min[Axis]) / CellSize));
+			Total *= CellCounts[Axis];
+		}
+		if (Total <= MaxCells)
+			break;
+		CellSize *= 2.0f;
+	}
+	GridMin = DirectX::XMFLOAT3(Min[0], Min[1], Min[2]);
+
+	// Counting sort of the probe references into the cells their influence box overlaps
+	size_t CellCount = (size_t)CellCounts[0] * CellCounts[1] * CellCounts[2];
+	std::vector<std::uint32_t> Counts(CellCount + 1, 0);
+	for (int Pass = 0; Pass < 2; Pass++)
+	{
+		if (Pass == 1)
+		{
+			CellStarts.assign(CellCount + 1, 0);
+			for (size_t Cell = 0; Cell < CellCount; Cell++)
+				CellStarts[Cell + 1] = CellStarts[Cell] + Counts[Cell];
+			CellProbes.resize(CellStarts[CellCount]);
+			std::copy(CellStarts.begin(), CellStarts.end() - 1, Counts.begin());
+		}
+
+		for (std::uint32_t Index = 0; Index < Probes.size(); Index++)
+		{
+			const Probe& Current = Probes[Index];
+			std::int32_t Lo[3], Hi[3];
+			for (int Axis = 0; Axis < 3; Axis++)
+			{
+				Lo[Axis] = GetCellCoord(GetComponent(Current.Center, Axis) - Current.InfluenceRadius, Axis);
+				Hi[Axis] = GetCellCoord(GetComponent(Current.Center, Axis) + Current.InfluenceRadius, Axis);
+			}
+			for (std::int32_t Z = Lo[2]; Z <= Hi[2]; Z++)
+				for (std::int32_t Y = Lo[1]; Y <= Hi[1]; Y++)
+					for (std::int32_t X = Lo[0]; X <= Hi[0]; X++)
+					{
+						size_t Cell = ((size_t)Z * CellCounts[1] + Y) * CellCounts[0] + X;
+						if (Pass == 0)
+							Counts[Cell]++;
+						else
+							CellProbes[Counts[Cell]++] = Index;
+					}
+		}
+	}
+}
+
+ProbeLookup::Assignment ProbeLookup::Find(const DirectX::XMFLOAT3& aPosition) const
+{
+	Assignment Result;
+	if (Probes.empty())
+		return Result;
+
+	std::int32_t Coord[3];
+	bool bInsideGrid = true;
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		float Local = (GetComponent(aPosition, Axis) - GetComponent(GridMin, Axis)) / CellSize;
+		bInsideGrid &= Local >= 0.0f && Local < (float)CellCounts[Axis];
+		Coord[Axis] = GetCellCoord(GetComponent(aPosition, Axis), Axis);
+	}
+
+	// Influence weight: 1 at the probe center, 0 on its influence sphere
+	float BestWeights[2] = { 0.0f, 0.0f };
+	std::uint32_t BestProbes[2] = { UINT32_MAX, UINT32_MAX };
+	if (bInsideGrid)
+	{
+		size_t Cell = ((size_t)Coord[2] * CellCounts[1] + Coord[1]) * CellCounts[0] + Coord[0];
+		for (std::uint32_t i = CellStarts[Cell]; i < CellStarts[Cell + 1]; i++)
+		{
+			const Probe& Current = Probes[CellProbes[i]];
+			float Weight = 1.0f - std::sqrt(DistanceSq(aPosition, Current.Center)) / Current.InfluenceRadius;
+			if (Weight <= BestWeights[1])
+				continue;
+			if (Weight > BestWeights[0])
+			{
+				BestWeights[1] = BestWeights[0];
+				BestProbes[1] = BestProbes[0];
+				BestWeights[0] = Weight;
+				BestProbes[0] = CellProbes[i];
+			}
+			else
+			{
+				BestWeights[1] = Weight;
+				BestProbes[1] = CellProbes[i];
+			}
+		}
+	}
+
+	if (BestProbes[0] == UINT32_MAX)
+	{
+		Result.Probes[0] = Result.Probes[1] = GetNearestProbe(aPosition);
+		return Result;
+	}
+	Result.Probes[0] = BestProbes[0];
+	if (BestProbes[1] == UINT32_MAX)
+	{
+		Result.Probes[1] = BestProbes[0];
+		return Result;
+	}
+	Result.Probes[1] = BestProbes[1];
+	Result.Blend = BestWeights[1] / (BestWeights[0] + BestWeights[1]);
+	return Result;
+}
+
+std::int32_t ProbeLookup::GetCellCoord(float aValue, int aAxis) const
+{
+	std::int32_t Coord = (std::int32_t)std::floor((aValue - GetComponent(GridMin, aAxis)) / CellSize);
+	return std::clamp(Coord, 0, CellCounts[aAxis] - 1);
+}
+
+std::uint32_t ProbeLookup::GetNearestProbe(const DirectX::XMFLOAT3& aPosition) const
+{
+	// Outside every influence, rare enough for a linear scan
+	std::uint32_t Nearest = 0;
+	float NearestDistSq = FLT_MAX;
+	for (std::uint32_t i = 0; i < Probes.size(); i++)
+	{
+		float DistSq = DistanceSq(aPosition, Probes[i].Center);
+		if (DistSq < NearestDistSq)
+		{
+			NearestDistSq = DistSq;
+			Nearest = i;
+		}
+	}
+	return Nearest;
+}
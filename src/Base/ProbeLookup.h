@@ -0,0 +1,45 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Finds the reflection probes to sample at a world position.
+// Probes are binned into a uniform grid by their influence spheres, so a lookup only visits the probes
+// of one cell. The two closest probes whose influence contains the position are blended by how deep
+// the position lies inside each sphere; outside every influence the nearest probe is used alone.
+class ProbeLookup
+{
+public:
+	struct Probe
+	{
+		DirectX::XMFLOAT3 Center;
+		float InfluenceRadius;
+	};
+
+	// Probes[1] is sampled with weight Blend, Probes[0] with 1 - Blend. Both are equal for a single probe.
+	struct Assignment
+	{
+		std::uint32_t Probes[2] = { 0, 0 };
+		float Blend = 0.0f;
+	};
+
+	// aCellSize 0 picks the largest influence diameter
+	void Build(const std::vector<Probe>& aProbes, float aCellSize = 0.0f);
+	Assignment Find(const DirectX::XMFLOAT3& aPosition) const;
+
+	size_t GetProbeCount() const { return Probes.size(); }
+	bool IsEmpty() const { return Probes.empty(); }
+
+private:
+	std::int32_t GetCellCoord(float aValue, int aAxis) const;
+	std::uint32_t GetNearestProbe(const DirectX::XMFLOAT3& aPosition) const;
+
+	std::vector<Probe> Probes;
+	float CellSize = 1.0f;
+	DirectX::XMFLOAT3 GridMin = { 0.0f, 0.0f, 0.0f };
+	std::int32_t CellCounts[3] = { 0, 0, 0 };
+	// Cell -> [CellStarts[Cell], CellStarts[Cell + 1]) range of CellProbes
+	std::vector<std::uint32_t> CellStarts;
+	std::vector<std::uint32_t> CellProbes;
+};
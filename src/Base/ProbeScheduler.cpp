@@ -0,0 +1,137 @@
+#include "ProbeScheduler.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+ProbeScheduler::ProbeScheduler(std::int32_t aFramesInFlight)
+	: FramesInFlight(aFramesInFlight)
+{
+}
+
+ProbeScheduler::ProbeId ProbeScheduler::AddProbe(const ProbeDesc& aDesc)
+{
+	Probe NewProbe;
+	NewProbe.Desc = aDesc;
+	NewProbe.NumFramesConstantsDirty = FramesInFlight;
+	Probes.push_back(NewProbe);
+	return static_cast<ProbeId>(Probes.size() - 1);
+}
+
+void ProbeScheduler::SetProbeCenter(ProbeId aProbe, const DirectX::XMFLOAT3& aCenter)
+{
+	assert(aProbe < Probes.size() && "Invalid probe");
+	Probe& Current = Probes[aProbe];
+	if (Current.Desc.Center.x == aCenter.x && Current.Desc.Center.y == aCenter.y && Current.Desc.Center.z == aCenter.z)
+		return;
+	Current.Desc.Center = aCenter;
+	InvalidateProbe(aProbe);
+	InvalidatePassConstants(aProbe);
+}
+
+void ProbeScheduler::SetPolicy(ProbeId aProbe, UpdatePolicy aPolicy, std::uint32_t aFacesPerFrame)
+{
+	assert(aProbe < Probes.size() && "Invalid probe");
+	Probes[aProbe].Desc.Policy = aPolicy;
+	Probes[aProbe].Desc.FacesPerFrame = aFacesPerFrame;
+}
+
+void ProbeScheduler::InvalidateProbe(ProbeId aProbe)
+{
+	assert(aProbe < Probes.size() && "Invalid probe");
+	Probes[aProbe].DirtyFaces = AllFaces;
+}
+
+void ProbeScheduler::InvalidateBounds(const DirectX::BoundingBox& aWorldBounds)
+{
+	for (Probe& Current : Probes)
+	{
+		if (Current.DirtyFaces == AllFaces)
+			continue;
+
+		DirectX::XMFLOAT3 Center(aWorldBounds.Center.x - Current.Desc.Center.x, aWorldBounds.Center.y - Current.Desc.Center.y,
+			aWorldBounds.Center.z - Current.Desc.Center.z);
+		const DirectX::XMFLOAT3& Extents = aWorldBounds.Extents;
+
+		// Same test as the range limit of the probe's culling: skip boxes entirely outside the influence sphere
+		float Radius = Current.Desc.InfluenceRadius;
+		if (Radius > 0.0f)
+		{
+			float DX = std::max(std::fabs(Center.x) - Extents.x, 0.0f);
+			float DY = std::max(std::fabs(Center.y) - Extents.y, 0.0f);
+			float DZ = std::max(std::fabs(Center.z) - Extents.z, 0.0f);
+			if (DX * DX + DY * DY + DZ * DZ > Radius * Radius)
+				continue;
+		}
+		Current.DirtyFaces |= GetVisibleFaces(Center, Extents);
+	}
+}
+
+const std::vector<ProbeScheduler::FaceUpdate>& ProbeScheduler::ScheduleFrame()
+{
+	Scheduled.clear();
+	if (Probes.empty())
+		return Scheduled;
+
+	// Time slicing keeps Always probes cycling through their faces
+	for (Probe& Current : Probes)
+	{
+		if (Current.Desc.Policy != UpdatePolicy::Always)
+			continue;
+		std::uint32_t Faces = std::min(Current.Desc.FacesPerFrame, FaceCount);
+		for (std::uint32_t i = 0; i < Faces; i++)
+			Current.DirtyFaces |= (std::uint8_t)(1u << ((Current.NextFace + i) % FaceCount));
+	}
+
+	// Probes take turns to go first so a small budget is shared fairly
+	size_t Budget = FaceBudget > 0 ? FaceBudget : SIZE_MAX;
+	std::uint32_t ProbeCount = GetProbeCount();
+	for (std::uint32_t k = 0; k < ProbeCount && Scheduled.size() < Budget; k++)
+	{
+		ProbeId Id = (NextProbe + k) % ProbeCount;
+		Probe& Current = Probes[Id];
+		std::uint32_t FirstFace = Current.NextFace;
+		for (std::uint32_t i = 0; i < FaceCount && Scheduled.size() < Budget; i++)
+		{
+			std::uint32_t Face = (FirstFace + i) % FaceCount;
+			if (!((Current.DirtyFaces >> Face) & 1u))
+				continue;
+			Current.DirtyFaces &= (std::uint8_t)~(1u << Face);
+			Current.NextFace = (Face + 1) % FaceCount;
+			Scheduled.push_back({ Id, Face });
+		}
+	}
+	NextProbe = (NextProbe + 1) % ProbeCount;
+	return Scheduled;
+}
+
+void ProbeScheduler::ConsumePassConstantsDirty(ProbeId aProbe)
+{
+	assert(aProbe < Probes.size() && "Invalid probe");
+	if (Probes[aProbe].NumFramesConstantsDirty > 0)
+		Probes[aProbe].NumFramesConstantsDirty--;
+}
+
+std::uint8_t ProbeScheduler::GetVisibleFaces(const DirectX::XMFLOAT3& aCenter, const DirectX::XMFLOAT3& aExtents)
+{
+	// The face looking along +-axis K sees the points with +-P[K] >= |P[J]| for both other axes J.
+	// Testing the four bounding half spaces separately is conservative, never misses a face.
+	const float C[3] = { aCenter.x, aCenter.y, aCenter.z };
+	const float E[3] = { aExtents.x, aExtents.y, aExtents.z };
+	std::uint8_t Faces = 0;
+	for (std::uint32_t Face = 0; Face < FaceCount; Face++)
+	{
+		int K = Face / 2;
+		float Sign = (Face & 1) ? -1.0f : 1.0f;
+		bool bVisible = true;
+		for (int J = 0; J < 3 && bVisible; J++)
+		{
+			if (J == K)
+				continue;
+			float Reach = E[K] + E[J];
+			bVisible = Sign * C[K] - C[J] + Reach >= 0.0f && Sign * C[K] + C[J] + Reach >= 0.0f;
+		}
+		if (bVisible)
+			Faces |= (std::uint8_t)(1u << Face);
+	}
+	return Faces;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+// Decides which reflection probe cube faces are re-rendered each frame.
+// Every face carries a dirty bit. Always probes additionally refresh FacesPerFrame faces round robin
+// (time slicing), OnChange probes only render faces invalidated by a moved item within their influence
+// sphere, and the total number of faces rendered in a frame is capped by a global budget; faces over
+// budget stay dirty for the next frames.
+// Probe pass constants are tracked separately, they only have to be rewritten when the probe moves.
+// Faces are in D3D cube map order: +X, -X, +Y, -Y, +Z, -Z.
+class ProbeScheduler
+{
+public:
+	using ProbeId = std::uint32_t;
+	static constexpr std::uint32_t FaceCount = 6;
+
+	enum class UpdatePolicy
+	{
+		Always,		// Content not tracked by invalidation (animated materials, sky) stays fresh
+		OnChange
+	};
+
+	struct ProbeDesc
+	{
+		DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+		float InfluenceRadius = 0.0f;		// 0 means the whole scene
+		UpdatePolicy Policy = UpdatePolicy::OnChange;
+		std::uint32_t FacesPerFrame = 1;	// Always probes only
+	};
+
+	struct FaceUpdate
+	{
+		ProbeId Probe;
+		std::uint32_t Face;
+	};
+
+	// aFramesInFlight is the number of frame resources holding a copy of the pass constants
+	explicit ProbeScheduler(std::int32_t aFramesInFlight);
+
+	// New probes start with every face dirty
+	ProbeId AddProbe(const ProbeDesc& aDesc);
+	const ProbeDesc& GetProbe(ProbeId aProbe) const { return Probes[aProbe].Desc; }
+	// Invalidates all faces and the pass constants
+	void SetProbeCenter(ProbeId aProbe, const DirectX::XMFLOAT3& aCenter);
+	void SetPolicy(ProbeId aProbe, UpdatePolicy aPolicy, std::uint32_t aFacesPerFrame);
+	std::uint32_t GetProbeCount() const { return static_cast<std::uint32_t>(Probes.size()); }
+
+	// Maximum number of faces rendered per frame over all probes, 0 means unlimited
+	void SetFaceBudget(std::uint32_t aFaceBudget) { FaceBudget = aFaceBudget; }
+	std::uint32_t GetFaceBudget() const { return FaceBudget; }
+
+	void InvalidateProbe(ProbeId aProbe);
+	// Invalidates the faces, of every probe whose influence sphere it touches, that can see the box
+	void InvalidateBounds(const DirectX::BoundingBox& aWorldBounds);
+	bool IsFaceDirty(ProbeId aProbe, std::uint32_t aFace) const { return (Probes[aProbe].DirtyFaces >> aFace) & 1u; }
+
+	// Picks the faces to render this frame and marks them clean
+	const std::vector<FaceUpdate>& ScheduleFrame();
+	const std::vector<FaceUpdate>& GetScheduledFaces() const { return Scheduled; }
+
+	// True while the frame resource being recorded still holds outdated pass constants for the probe,
+	// call ConsumePassConstantsDirty once they have been written
+	bool ArePassConstantsDirty(ProbeId aProbe) const { return Probes[aProbe].NumFramesConstantsDirty > 0; }
+	void ConsumePassConstantsDirty(ProbeId aProbe);
+	void InvalidatePassConstants(ProbeId aProbe) { Probes[aProbe].NumFramesConstantsDirty = FramesInFlight; }
+
+private:
+	static constexpr std::uint8_t AllFaces = (1u << FaceCount) - 1;
+
+	struct Probe
+	{
+		ProbeDesc Desc;
+		std::uint8_t DirtyFaces = AllFaces;
+		std::uint32_t NextFace = 0;		// Round robin cursor
+		std::int32_t NumFramesConstantsDirty = 0;
+	};
+
+	// Faces whose 90 degree view pyramid may contain part of the box, relative to the probe center
+	static std::uint8_t GetVisibleFaces(const DirectX::XMFLOAT3& aCenter, const DirectX::XMFLOAT3& aExtents);
+
+	std::vector<Probe> Probes;
+	std::vector<FaceUpdate> Scheduled;
+	std::uint32_t FaceBudget = 1;
+	std::uint32_t NextProbe = 0;
+	std::int32_t FramesInFlight;
+};
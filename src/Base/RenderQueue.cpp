@@ -0,0 +1,120 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <utility>
+
+std::uint64_t RenderQueue::MakeKey(std::uint32_t aBucket, std::uint32_t aPso, std::uint32_t aMesh, std::uint32_t aMaterial, std::uint32_t aDepth)
+{
+	assert(aBucket < (1u << BucketBits) && "Render queue bucket out of range");
+	assert(aPso < (1u << PsoBits) && "Render queue PSO id out of range");
+	assert(aMesh < (1u << MeshBits) - 1 && "Render queue mesh id out of range");
+	assert(aMaterial < (1u << MaterialBits) && "Render queue material index out of range");
+	assert(aDepth < (1u << DepthBits) && "Render queue depth out of range");
+	if (aBucket >= (1u << BucketBits) || aPso >= (1u << PsoBits) || aMesh >= (1u << MeshBits) - 1)
+		return InvalidKey;
+	aMaterial = std::min(aMaterial, (1u << MaterialBits) - 1);
+	aDepth = std::min(aDepth, (1u << DepthBits) - 1);
+
+	std::uint64_t Key = aBucket;
+	Key = (Key << PsoBits) | aPso;
+	Key = (Key << MeshBits) | aMesh;
+	Key = (Key << MaterialBits) | aMaterial;
+	Key = (Key << DepthBits) | aDepth;
+	return Key;
+}
+
+std::uint32_t RenderQueue::QuantizeDepth(float aDepth, float aMaxDepth)
+{
+	const std::uint32_t MaxValue = (1u << DepthBits) - 1;
+	if (!(aDepth > 0.0f) || aMaxDepth <= 0.0f)
+		return 0;
+	if (aDepth >= aMaxDepth)
+		return MaxValue;
+	return (std::uint32_t)(aDepth / aMaxDepth * (float)MaxValue);
+}
+
+void RenderQueue::Clear()
+{
+	Keys.clear();
+	Items.clear();
+}
+
+void RenderQueue::Reserve(size_t aCount)
+{
+	Keys.reserve(aCount);
+	Items.reserve(aCount);
+	ScratchKeys.reserve(aCount);
+	ScratchItems.reserve(aCount);
+}
+
+void RenderQueue::Push(std::uint64_t aKey, std::uint32_t aItem)
+{
+	Keys.push_back(aKey);
+	Items.push_back(aItem);
+}
+
+void RenderQueue::Sort()
+{
+	auto StartTime = std::chrono::high_resolution_clock::now();
+
+	const size_t Count = Keys.size();
+	if (Count > 1)
+	{
+		ScratchKeys.resize(Count);
+		ScratchItems.resize(Count);
+
+		// Histograms of all eight digits are built in a single pass over the keys
+		std::array<std::array<std::uint32_t, 256>, 8> Histograms = {};
+		for (std::uint64_t Key : Keys)
+		{
+			for (int Digit = 0; Digit < 8; Digit++)
+				Histograms[Digit][(Key >> (Digit * 8)) & 0xFF]++;
+		}
+
+		std::uint64_t* SrcKeys = Keys.data();
+		std::uint32_t* SrcItems = Items.data();
+		std::uint64_t* DstKeys = ScratchKeys.data();
+		std::uint32_t* DstItems = ScratchItems.data();
+		bool bSortedInScratch = false;
+
+		for (int Digit = 0; Digit < 8; Digit++)
+		{
+			auto& Histogram = Histograms[Digit];
+			const int Shift = Digit * 8;
+
+			// Every key shares this digit, the pass would only copy
+			if (Histogram[(SrcKeys[0] >> Shift) & 0xFF] == Count)
+				continue;
+
+			std::uint32_t Offset = 0;
+			for (auto& Bin : Histogram)
+			{
+				std::uint32_t BinCount = Bin;
+				Bin = Offset;
+				Offset += BinCount;
+			}
+
+			for (size_t i = 0; i < Count; i++)
+			{
+				std::uint32_t Dst = Histogram[(SrcKeys[i] >> Shift) & 0xFF]++;
+				DstKeys[Dst] = SrcKeys[i];
+				DstItems[Dst] = SrcItems[i];
+			}
+
+			std::swap(SrcKeys, DstKeys);
+			std::swap(SrcItems, DstItems);
+			bSortedInScratch = !bSortedInScratch;
+		}
+
+		if (bSortedInScratch)
+		{
+			Keys.swap(ScratchKeys);
+			Items.swap(ScratchItems);
+		}
+	}
+
+	auto EndTime = std::chrono::high_resolution_clock::now();
+	LastSortMilliseconds = std::chrono::duration<double, std::milli>(EndTime - StartTime).count();
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-pass list of draw entries ordered by a 64-bit sort key.
+// Key layout, most significant bits first:
+//   [63..60] Bucket   - draw order of the layer inside the pass
+//   [59..52] Pso      - pipeline state id
+//   [51..32] Mesh     - SceneStore mesh id (geometry + submesh range)
+//   [31..20] Material - material table index
+//   [19..0]  Depth    - quantized view depth, front to back
+// Mesh sits above material because materials are fetched per instance from the material table,
+// so only a mesh change breaks an instanced draw.
+// Entries are sorted with an LSD radix sort over 8-bit digits; digits shared by every key are skipped.
+class RenderQueue
+{
+public:
+	static constexpr std::uint32_t BucketBits = 4;
+	static constexpr std::uint32_t PsoBits = 8;
+	static constexpr std::uint32_t MeshBits = 20;
+	static constexpr std::uint32_t MaterialBits = 12;
+	static constexpr std::uint32_t DepthBits = 20;
+
+	// Never returned for a valid entry: the all ones mesh id is reserved
+	static constexpr std::uint64_t InvalidKey = UINT64_MAX;
+
+	// Fields that don't fit assert. In release builds the material and depth, which only order entries, are clamped;
+	// a bucket, PSO or mesh id out of range would draw with the wrong state and gives InvalidKey instead.
+	static std::uint64_t MakeKey(std::uint32_t aBucket, std::uint32_t aPso, std::uint32_t aMesh, std::uint32_t aMaterial, std::uint32_t aDepth);
+	// Maps [0, aMaxDepth] to [0, 2^DepthBits - 1], values outside are clamped
+	static std::uint32_t QuantizeDepth(float aDepth, float aMaxDepth);
+
+	static std::uint32_t GetBucket(std::uint64_t aKey) { return (std::uint32_t)(aKey >> (64 - BucketBits)); }
+	static std::uint32_t GetPso(std::uint64_t aKey) { return (std::uint32_t)(aKey >> (MeshBits + MaterialBits + DepthBits)) & ((1u << PsoBits) - 1); }
+	static std::uint32_t GetMesh(std::uint64_t aKey) { return (std::uint32_t)(aKey >> (MaterialBits + DepthBits)) & ((1u << MeshBits) - 1); }
+	static std::uint32_t GetMaterial(std::uint64_t aKey) { return (std::uint32_t)(aKey >> DepthBits) & ((1u << MaterialBits) - 1); }
+	// Bucket, PSO and mesh; consecutive entries with the same batch key can share one instanced draw
+	static std::uint64_t GetBatchKey(std::uint64_t aKey) { return aKey >> (MaterialBits + DepthBits); }
+
+	void Clear();
+	void Reserve(size_t aCount);
+	void Push(std::uint64_t aKey, std::uint32_t aItem);
+	void Sort();
+
+	size_t GetSize() const { return Keys.size(); }
+	bool IsEmpty() const { return Keys.empty(); }
+	const std::vector<std::uint64_t>& GetKeys() const { return Keys; }
+	const std::vector<std::uint32_t>& GetItems() const { return Items; }
+	double GetLastSortMilliseconds() const { return LastSortMilliseconds; }
+
+private:
+	std::vector<std::uint64_t> Keys;
+	std::vector<std::uint32_t> Items;
+	std::vector<std::uint64_t> ScratchKeys;
+	std::vector<std::uint32_t> ScratchItems;
+	double LastSortMilliseconds = 0.0;
+};
@@ -0,0 +1,501 @@
+#include "SceneBVH.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+struct SceneBVH::BuildInput
+{
+	std::vector<float> BoxMin, BoxMax, Centroids;	// 3 floats per item
+};
+
+void SceneBVH::Build(const SceneStore::WorldBoundsStreams& aBounds)
+{
+	Clear();
+	size_t Count = aBounds.CenterX.size();
+	ItemLeaves.assign(Count, NullNode);
+	if (Count == 0)
+		return;
+
+	BuildInput Input;
+	Input.BoxMin.resize(Count * 3);
+	Input.BoxMax.resize(Count * 3);
+	Input.Centroids.resize(Count * 3);
+	const std::vector<float>* Centers[3] = { &aBounds.CenterX, &aBounds.CenterY, &aBounds.CenterZ };
+	const std::vector<float>* Extents[3] = { &aBounds.ExtentX, &aBounds.ExtentY, &aBounds.ExtentZ };
+	std::vector<ItemId> Items(Count);
+	for (size_t i = 0; i < Count; i++)
+	{
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			float Center = (*Centers[Axis])[i];
+			float Extent = (*Extents[Axis])[i] + Margin;
+			Input.BoxMin[i * 3 + Axis] = Center - Extent;
+			Input.BoxMax[i * 3 + Axis] = Center + Extent;
+			Input.Centroids[i * 3 + Axis] = Center;
+		}
+		Items[i] = static_cast<ItemId>(i);
+	}
+
+	Nodes.reserve(Count * 2);
+	Root = BuildRange(Input, Items, 0, Count, NullNode);
+	ItemCount = Count;
+}
+
+bool SceneBVH::Update(ItemId aItem, const DirectX::BoundingBox& aWorldBounds)
+{
+	if (aItem >= ItemLeaves.size())
+		ItemLeaves.resize(aItem + 1, NullNode);
+
+	std::int32_t Leaf = ItemLeaves[aItem];
+	if (Leaf == NullNode)
+	{
+		Leaf = AllocateNode();
+		Nodes[Leaf].Item = aItem;
+		SetLeafBox(Leaf, aWorldBounds);
+		InsertLeaf(Leaf);
+		ItemLeaves[aItem] = Leaf;
+		ItemCount++;
+		return true;
+	}
+
+	// Still inside the enlarged box, and the box is not much larger than it needs to be
+	const Node& Current = Nodes[Leaf];
+	const float Center[3] = { aWorldBounds.Center.x, aWorldBounds.Center.y, aWorldBounds.Center.z };
+	const float Extent[3] = { aWorldBounds.Extents.x, aWorldBounds.Extents.y, aWorldBounds.Extents.z };
+	bool bContained = true;
+	float NeededMin[3], NeededMax[3];
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		NeededMin[Axis] = Center[Axis] - Extent[Axis] - Margin;
+		NeededMax[Axis] = Center[Axis] + Extent[Axis] + Margin;
+		bContained &= Center[Axis] - Extent[Axis] >= Current.Min[Axis] && Center[Axis] + Extent[Axis] <= Current.Max[Axis];
+	}
+	if (bContained && GetHalfArea(NeededMin, NeededMax) * 4.0f >= GetHalfArea(Current.Min, Current.Max))
+		return false;
+
+	RemoveLeaf(Leaf);
+	SetLeafBox(Leaf, aWorldBounds);
+	InsertLeaf(Leaf);
+	return true;
+}
+
+void SceneBVH::Remove(ItemId aItem)
+{
+	if (aItem >= ItemLeaves.size() || ItemLeaves[aItem] == NullNode)
+		return;
+	std::int32_t Leaf = ItemLeaves[aItem];
+	RemoveLeaf(Leaf);
+	FreeNode(Leaf);
+	ItemLeaves[aItem] = NullNode;
+	ItemCount--;
+}
+
+void SceneBVH::Clear()
+{
+	Nodes.clear();
+	FreeNodes.clear();
+	ItemLeaves.clear();
+	Root = NullNode;
+	ItemCount = 0;
+}
+
+std::uint32_t SceneBVH::GetDepth() const
+{
+	if (Root == NullNode)
+		return 0;
+	std::uint32_t MaxDepth = 0;
+	std::vector<std::pair<std::int32_t, std::uint32_t>> Stack = { { Root, 1u } };
+	while (!Stack.empty())
+	{
+		auto [Index, Depth] = Stack.back();
+		Stack.pop_back();
+		MaxDepth = std::max(MaxDepth, Depth);
+		if (!Nodes[Index].IsLeaf())
+		{
+			Stack.push_back({ Nodes[Index].Children[0], Depth + 1 });
+			Stack.push_back({ Nodes[Index].Children[1], Depth + 1 });
+		}
+	}
+	return MaxDepth;
+}
+
+float SceneBVH::GetSahCost() const
+{
+	if (Root == NullNode)
+		return 0.0f;
+	float RootArea = GetHalfArea(Nodes[Root].Min, Nodes[Root].Max);
+	if (RootArea <= 0.0f)
+		return 0.0f;
+
+	float Total = 0.0f;
+	std::vector<std::int32_t> Stack = { Root };
+	while (!Stack.empty())
+	{
+		const Node& Current = Nodes[Stack.back()];
+		Stack.pop_back();
+		if (Current.IsLeaf())
+			continue;
+		Total += GetHalfArea(Current.Min, Current.Max);
+		Stack.push_back(Current.Children[0]);
+		Stack.push_back(Current.Children[1]);
+	}
+	return Total / RootArea;
+}
+
+void SceneBVH::QueryFrustum(const DirectX::XMFLOAT4 aPlanes[6], std::vector<ItemId>& aItems) const
+{
+	if (Root == NullNode)
+		return;
+
+	// Subtrees entirely inside every plane are collected without further tests
+	std::vector<std::pair<std::int32_t, bool>> Stack = { { Root, false } };
+	while (!Stack.empty())
+	{
+		auto [Index, bInside] = Stack.back();
+		Stack.pop_back();
+		const Node& Current = Nodes[Index];
+		if (!bInside)
+		{
+			bInside = true;
+			bool bOutside = false;
+			for (int p = 0; p < 6 && !bOutside; p++)
+			{
+				const DirectX::XMFLOAT4& Plane = aPlanes[p];
+				float CX = (Current.Min[0] + Current.Max[0]) * 0.5f, EX = (Current.Max[0] - Current.Min[0]) * 0.5f;
+				float CY = (Current.Min[1] + Current.Max[1]) * 0.5f, EY = (Current.Max[1] - Current.Min[1]) * 0.5f;
+				float CZ = (Current.Min[2] + Current.Max[2]) * 0.5f, EZ = (Current.Max[2] - Current.Min[2]) * 0.5f;
+				float Distance = Plane.x * CX + Plane.y * CY + Plane.z * CZ + Plane.w;
+				float Radius = std::fabs(Plane.x) * EX + std::fabs(Plane.y) * EY + std::fabs(Plane.z) * EZ;
+				bOutside = Distance + Radius < 0.0f;
+				bInside &= Distance - Radius >= 0.0f;
+			}
+			if (bOutside)
+				continue;
+		}
+
+		if (Current.IsLeaf())
+			aItems.push_back(Current.Item);
+		else
+		{
+			Stack.push_back({ Current.Children[0], bInside });
+			Stack.push_back({ Current.Children[1], bInside });
+		}
+	}
+}
+
+void SceneBVH::QuerySphere(const DirectX::XMFLOAT3& aCenter, float aRadius, std::vector<ItemId>& aItems) const
+{
+	if (Root == NullNode)
+		return;
+
+	const float Center[3] = { aCenter.x, aCenter.y, aCenter.z };
+	std::vector<std::int32_t> Stack = { Root };
+	while (!Stack.empty())
+	{
+		const Node& Current = Nodes[Stack.back()];
+		Stack.pop_back();
+		float DistSq = 0.0f;
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			float D = std::max(std::max(Current.Min[Axis] - Center[Axis], Center[Axis] - Current.Max[Axis]), 0.0f);
+			DistSq += D * D;
+		}
+		if (DistSq > aRadius * aRadius)
+			continue;
+
+		if (Current.IsLeaf())
+			aItems.push_back(Current.Item);
+		else
+		{
+			Stack.push_back(Current.Children[0]);
+			Stack.push_back(Current.Children[1]);
+		}
+	}
+}
+
+std::int32_t SceneBVH::AllocateNode()
+{
+	std::int32_t Index;
+	if (!FreeNodes.empty())
+	{
+		Index = FreeNodes.back();
+		FreeNodes.pop_back();
+	}
+	else
+	{
+		Index = static_cast<std::int32_t>(Nodes.size());
+		Nodes.emplace_back();
+	}
+	Nodes[Index] = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, NullNode, { NullNode, NullNode }, SceneStore::InvalidItem };
+	return Index;
+}
+
+void SceneBVH::FreeNode(std::int32_t aNode)
+{
+	FreeNodes.push_back(aNode);
+}
+
+std::int32_t SceneBVH::BuildRange(const BuildInput& aInput, std::vector<ItemId>& aItems, size_t aBegin, size_t aEnd, std::int32_t aParent)
+{
+	std::int32_t Index = AllocateNode();
+	Nodes[Index].Parent = aParent;
+	if (aEnd - aBegin == 1)
+	{
+		ItemId Item = aItems[aBegin];
+		Nodes[Index].Item = Item;
+		std::copy(&aInput.BoxMin[Item * 3], &aInput.BoxMin[Item * 3] + 3, Nodes[Index].Min);
+		std::copy(&aInput.BoxMax[Item * 3], &aInput.BoxMax[Item * 3] + 3, Nodes[Index].Max);
+		ItemLeaves[Item] = Index;
+		return Index;
+	}
+
+	float CentroidMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, CentroidMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t i = aBegin; i < aEnd; i++)
+	{
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			float C = aInput.Centroids[aItems[i] * 3 + Axis];
+			CentroidMin[Axis] = std::min(CentroidMin[Axis], C);
+			CentroidMax[Axis] = std::max(CentroidMax[Axis], C);
+		}
+	}
+
+	// Binned SAH over the centroid bounds, the cheapest boundary between two bins of any axis wins
+	float BestCost = FLT_MAX;
+	int BestAxis = -1;
+	std::uint32_t BestSplit = 0;
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		float Extent = CentroidMax[Axis] - CentroidMin[Axis];
+		if (Extent <= 0.0f)
+			continue;
+
+		float BinMin[BinCount][3], BinMax[BinCount][3];
+		std::uint32_t BinCounts[BinCount] = {};
+		for (std::uint32_t Bin = 0; Bin < BinCount; Bin++)
+			for (int k = 0; k < 3; k++)
+			{
+				BinMin[Bin][k] = FLT_MAX;
+				BinMax[Bin][k] = -FLT_MAX;
+			}
+		float Scale = BinCount / Extent;
+		for (size_t i = aBegin; i < aEnd; i++)
+		{
+			ItemId Item = aItems[i];
+			std::uint32_t Bin = std::min(BinCount - 1, (std::uint32_t)((aInput.Centroids[Item * 3 + Axis] - CentroidMin[Axis]) * Scale));
+			BinCounts[Bin]++;
+			for (int k = 0; k < 3; k++)
+			{
+				BinMin[Bin][k] = std::min(BinMin[Bin][k], aInput.BoxMin[Item * 3 + k]);
+				BinMax[Bin][k] = std::max(BinMax[Bin][k], aInput.BoxMax[Item * 3 + k]);
+			}
+		}
+
+		float RightCosts[BinCount] = {};
+		float RightMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, RightMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		std::uint32_t RightCount = 0;
+		for (std::uint32_t Bin = BinCount - 1; Bin > 0; Bin--)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				RightMin[k] = std::min(RightMin[k], BinMin[Bin][k]);
+				RightMax[k] = std::max(RightMax[k], BinMax[Bin][k]);
+			}
+			RightCount += BinCounts[Bin];
+			RightCosts[Bin] = RightCount > 0 ? RightCount * GetHalfArea(RightMin, RightMax) : 0.0f;
+		}
+		float LeftMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, LeftMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		std::uint32_t LeftCount = 0;
+		for (std::uint32_t Split = 1; Split < BinCount; Split++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				LeftMin[k] = std::min(LeftMin[k], BinMin[Split - 1][k]);
+				LeftMax[k] = std::max(LeftMax[k], BinMax[Split - 1][k]);
+			}
+			LeftCount += BinCounts[Split - 1];
+			if (LeftCount == 0 || LeftCount == aEnd - aBegin)
+				continue;
+			float Cost = LeftCount * GetHalfArea(LeftMin, LeftMax) + RightCosts[Split];
+			if (Cost < BestCost)
+			{
+				BestCost = Cost;
+				BestAxis = Axis;
+				BestSplit = Split;
+			}
+		}
+	}
+
+	size_t Middle;
+	if (BestAxis >= 0)
+	{
+		float Scale = BinCount / (CentroidMax[BestAxis] - CentroidMin[BestAxis]);
+		auto It = std::partition(aItems.begin() + aBegin, aItems.begin() + aEnd, [&](ItemId aItem)
+		{
+			std::uint32_t Bin = std::min(BinCount - 1, (std::uint32_t)((aInput.Centroids[aItem * 3 + BestAxis] - CentroidMin[BestAxis]) * Scale));
+			return Bin < BestSplit;
+		});
+		Middle = It - aItems.begin();
+	}
+	else
+	{
+		// Every centroid is the same point, any split is as good
+		Middle = (aBegin + aEnd) / 2;
+	}
+
+	std::int32_t Left = BuildRange(aInput, aItems, aBegin, Middle, Index);
+	std::int32_t Right = BuildRange(aInput, aItems, Middle, aEnd, Index);
+	Node& Current = Nodes[Index];
+	Current.Children[0] = Left;
+	Current.Children[1] = Right;
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		Current.Min[Axis] = std::min(Nodes[Left].Min[Axis], Nodes[Right].Min[Axis]);
+		Current.Max[Axis] = std::max(Nodes[Left].Max[Axis], Nodes[Right].Max[Axis]);
+	}
+	return Index;
+}
+
+void SceneBVH::InsertLeaf(std::int32_t aLeaf)
+{
+	if (Root == NullNode)
+	{
+		Root = aLeaf;
+		Nodes[aLeaf].Parent = NullNode;
+		return;
+	}
+
+	// Greedy SAH descent: stop at the node where pairing with the leaf is cheaper than pushing it further
+	// down, counting the growth every ancestor inherits
+	std::int32_t Sibling = Root;
+	while (!Nodes[Sibling].IsLeaf())
+	{
+		const Node& Current = Nodes[Sibling];
+		float Area = GetHalfArea(Current.Min, Current.Max);
+		float Combined = GetUnionHalfArea(Current, Nodes[aLeaf]);
+		float Cost = 2.0f * Combined;
+		float Inheritance = 2.0f * (Combined - Area);
+
+		float ChildCosts[2];
+		for (int i = 0; i < 2; i++)
+		{
+			const Node& Child = Nodes[Current.Children[i]];
+			float Union = GetUnionHalfArea(Child, Nodes[aLeaf]);
+			ChildCosts[i] = (Child.IsLeaf() ? Union : Union - GetHalfArea(Child.Min, Child.Max)) + Inheritance;
+		}
+		if (Cost < ChildCosts[0] && Cost < ChildCosts[1])
+			break;
+		Sibling = ChildCosts[0] <= ChildCosts[1] ? Current.Children[0] : Current.Children[1];
+	}
+
+	std::int32_t OldParent = Nodes[Sibling].Parent;
+	std::int32_t NewParent = AllocateNode();
+	Node& Parent = Nodes[NewParent];
+	Parent.Parent = OldParent;
+	Parent.Children[0] = Sibling;
+	Parent.Children[1] = aLeaf;
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		Parent.Min[Axis] = std::min(Nodes[Sibling].Min[Axis], Nodes[aLeaf].Min[Axis]);
+		Parent.Max[Axis] = std::max(Nodes[Sibling].Max[Axis], Nodes[aLeaf].Max[Axis]);
+	}
+	if (OldParent != NullNode)
+	{
+		Node& Grand = Nodes[OldParent];
+		Grand.Children[Grand.Children[0] == Sibling ? 0 : 1] = NewParent;
+	}
+	else
+		Root = NewParent;
+	Nodes[Sibling].Parent = NewParent;
+	Nodes[aLeaf].Parent = NewParent;
+	RefitAncestors(OldParent);
+}
+
+void SceneBVH::RemoveLeaf(std::int32_t aLeaf)
+{
+	if (aLeaf == Root)
+	{
+		Root = NullNode;
+		return;
+	}
+
+	std::int32_t Parent = Nodes[aLeaf].Parent;
+	std::int32_t GrandParent = Nodes[Parent].Parent;
+	std::int32_t Sibling = Nodes[Parent].Children[0] == aLeaf ? Nodes[Parent].Children[1] : Nodes[Parent].Children[0];
+	Nodes[Sibling].Parent = GrandParent;
+	if (GrandParent != NullNode)
+	{
+		Node& Grand = Nodes[GrandParent];
+		Grand.Children[Grand.Children[0] == Parent ? 0 : 1] = Sibling;
+	}
+	else
+		Root = Sibling;
+	FreeNode(Parent);
+	Nodes[aLeaf].Parent = NullNode;
+	RefitAncestors(GrandParent);
+}
+
+void SceneBVH::RefitAncestors(std::int32_t aNode)
+{
+	// Stops at the first ancestor whose box does not change, the ones above depend only on it
+	while (aNode != NullNode)
+	{
+		Node& Current = Nodes[aNode];
+		const Node& Left = Nodes[Current.Children[0]];
+		const Node& Right = Nodes[Current.Children[1]];
+		bool bChanged = false;
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			float Min = std::min(Left.Min[Axis], Right.Min[Axis]);
+			float Max = std::max(Left.Max[Axis], Right.Max[Axis]);
+			bChanged |= Min != Current.Min[Axis] || Max != Current.Max[Axis];
+			Current.Min[Axis] = Min;
+			Current.Max[Axis] = Max;
+		}
+		if (!bChanged)
+			break;
+		aNode = Current.Parent;
+	}
+}
+
+void SceneBVH::SetLeafBox(std::int32_t aLeaf, const DirectX::BoundingBox& aWorldBounds)
+{
+	Node& Leaf = Nodes[aLeaf];
+	const float Center[3] = { aWorldBounds.Center.x, aWorldBounds.Center.y, aWorldBounds.Center.z };
+	const float Extent[3] = { aWorldBounds.Extents.x, aWorldBounds.Extents.y, aWorldBounds.Extents.z };
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		Leaf.Min[Axis] = Center[Axis] - Extent[Axis] - Margin;
+		Leaf.Max[Axis] = Center[Axis] + Extent[Axis] + Margin;
+	}
+}
+
+float SceneBVH::GetHalfArea(const float aMin[3], const float aMax[3])
+{
+	float DX = aMax[0] - aMin[0], DY = aMax[1] - aMin[1], DZ = aMax[2] - aMin[2];
+	return DX * DY + DY * DZ + DZ * DX;
+}
+
+float SceneBVH::GetUnionHalfArea(const Node& A, const Node& B)
+{
+	float Min[3], Max[3];
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		Min[Axis] = std::min(A.Min[Axis], B.Min[Axis]);
+		Max[Axis] = std::max(A.Max[Axis], B.Max[Axis]);
+	}
+	return GetHalfArea(Min, Max);
+}
+
+float SceneBVH::IntersectRay(const Node& aNode, const float aOrigin[3], const float aInvDirection[3], float aMaxDistance)
+{
+	float Enter = 0.0f, Exit = aMaxDistance;
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		float T0 = (aNode.Min[Axis] - aOrigin[Axis]) * aInvDirection[Axis];
+		float T1 = (aNode.Max[Axis] - aOrigin[Axis]) * aInvDirection[Axis];
+		Enter = std::max(Enter, std::min(T0, T1));
+		Exit = std::min(Exit, std::max(T0, T1));
+	}
+	return Enter <= Exit ? Enter : FLT_MAX;
+}
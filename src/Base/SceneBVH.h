@@ -0,0 +1,171 @@
+#pragma once
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "SceneStore.h"
+#include "../Utility/ParallelFor.h"
+
+// Dynamic bounding volume hierarchy over the world space bounds of the scene's items, one item per leaf.
+// Build creates the tree top down with binned SAH splits. Leaves keep their box enlarged by a margin, so
+// an item moving within it costs nothing; an item leaving it is removed and re-inserted at the cheapest
+// sibling found by a greedy SAH descent, refitting its ancestors on the way up.
+// Answers frustum, sphere and closest hit ray queries; batches of rays run across worker threads.
+class SceneBVH
+{
+public:
+	using ItemId = SceneStore::ItemId;
+
+	struct Ray
+	{
+		DirectX::XMFLOAT3 Origin;
+		DirectX::XMFLOAT3 Direction;	// Need not be normalized, distances are in its units
+		float MaxDistance = FLT_MAX;
+	};
+
+	struct RayHit
+	{
+		ItemId Item = SceneStore::InvalidItem;
+		float Distance = FLT_MAX;
+	};
+
+	// Margin added on every side of the leaf boxes
+	void SetMargin(float aMargin) { Margin = aMargin; }
+	float GetMargin() const { return Margin; }
+
+	// Replaces the tree with one leaf per item of the streams
+	void Build(const SceneStore::WorldBoundsStreams& aBounds);
+	// Moves the item's leaf if aWorldBounds left its enlarged box, returns true if the tree changed.
+	// Items past the current count are inserted.
+	bool Update(ItemId aItem, const DirectX::BoundingBox& aWorldBounds);
+	void Remove(ItemId aItem);
+	void Clear();
+
+	size_t GetItemCount() const { return ItemCount; }
+	size_t GetNodeCount() const { return Nodes.size() - FreeNodes.size(); }
+	std::uint32_t GetDepth() const;
+	// Sum of the interior node surface areas relative to the root's, lower is better for queries
+	float GetSahCost() const;
+
+	// Items whose leaf box intersects the frustum given by 6 normalized inward planes, dot(N, P) + W >= 0
+	// inside (FrustumCuller::GetPlanes). Appends to aItems.
+	void QueryFrustum(const DirectX::XMFLOAT4 aPlanes[6], std::vector<ItemId>& aItems) const;
+	void QuerySphere(const DirectX::XMFLOAT3& aCenter, float aRadius, std::vector<ItemId>& aItems) const;
+
+	// Closest item along the ray. aHitTest(ItemId, float& aDistance) is called for every item whose
+	// leaf box the ray enters before the current closest hit, it returns true and sets aDistance for an
+	// exact hit closer than the value passed in, so e.g. triangle tests can refine the leaf boxes.
+	template<typename HitFunc>
+	RayHit Raycast(const Ray& aRay, HitFunc&& aHitTest) const;
+	// Runs Raycast for every ray over worker threads. aHitTest(size_t aRayIndex, ItemId, float& aDistance) is
+	// called like for Raycast with the index of the ray in aRays, it must be safe to call concurrently.
+	template<typename HitFunc>
+	void RaycastBatch(const Ray* aRays, size_t aCount, RayHit* aHits, HitFunc&& aHitTest, size_t aGrainSize = 64) const;
+
+private:
+	static constexpr std::int32_t NullNode = -1;
+	static constexpr std::uint32_t BinCount = 16;
+
+	struct Node
+	{
+		float Min[3];
+		float Max[3];
+		std::int32_t Parent;
+		std::int32_t Children[2];	// NullNode for leaves
+		ItemId Item;				// Leaves only
+
+		bool IsLeaf() const { return Children[0] == NullNode; }
+	};
+
+	struct BuildInput;
+
+	std::int32_t AllocateNode();
+	void FreeNode(std::int32_t aNode);
+	std::int32_t BuildRange(const BuildInput& aInput, std::vector<ItemId>& aItems, size_t aBegin, size_t aEnd, std::int32_t aParent);
+	void InsertLeaf(std::int32_t aLeaf);
+	void RemoveLeaf(std::int32_t aLeaf);
+	void RefitAncestors(std::int32_t aNode);
+	void SetLeafBox(std::int32_t aLeaf, const DirectX::BoundingBox& aWorldBounds);
+
+	static float GetHalfArea(const float aMin[3], const float aMax[3]);
+	static float GetUnionHalfArea(const Node& A, const Node& B);
+	// Entry distance of the ray into the node's box, FLT_MAX on a miss
+	static float IntersectRay(const Node& aNode, const float aOrigin[3], const float aInvDirection[3], float aMaxDistance);
+
+	std::vector<Node> Nodes;
+	std::vector<std::int32_t> FreeNodes;
+	std::vector<std::int32_t> ItemLeaves;		// ItemId -> leaf node, NullNode if not in the tree
+	std::int32_t Root = NullNode;
+	size_t ItemCount = 0;
+	float Margin = 0.1f;
+};
+
+template<typename HitFunc>
+inline SceneBVH::RayHit SceneBVH::Raycast(const Ray& aRay, HitFunc&& aHitTest) const
+{
+	RayHit Result;
+	Result.Distance = aRay.MaxDistance;
+	if (Root == NullNode)
+		return Result;
+
+	const float Origin[3] = { aRay.Origin.x, aRay.Origin.y, aRay.Origin.z };
+	const float Direction[3] = { aRay.Direction.x, aRay.Direction.y, aRay.Direction.z };
+	float InvDirection[3];
+	for (int Axis = 0; Axis < 3; Axis++)
+		InvDirection[Axis] = 1.0f / (Direction[Axis] != 0.0f ? Direction[Axis] : 1e-30f);
+
+	struct StackEntry
+	{
+		std::int32_t Node;
+		float Distance;
+	};
+	std::vector<StackEntry> Stack;
+	Stack.reserve(64);
+	float RootDistance = IntersectRay(Nodes[Root], Origin, InvDirection, Result.Distance);
+	if (RootDistance != FLT_MAX)
+		Stack.push_back({ Root, RootDistance });
+	while (!Stack.empty())
+	{
+		StackEntry Entry = Stack.back();
+		Stack.pop_back();
+		if (Entry.Distance >= Result.Distance)
+			continue;
+
+		const Node& Current = Nodes[Entry.Node];
+		if (Current.IsLeaf())
+		{
+			float Distance = Result.Distance;
+			if (aHitTest(Current.Item, Distance) && Distance < Result.Distance)
+			{
+				Result.Item = Current.Item;
+				Result.Distance = Distance;
+			}
+			continue;
+		}
+
+		// Far child pushed first so the near one is visited next
+		float Distances[2];
+		for (int i = 0; i < 2; i++)
+			Distances[i] = IntersectRay(Nodes[Current.Children[i]], Origin, InvDirection, Result.Distance);
+		int Near = Distances[1] < Distances[0] ? 1 : 0;
+		if (Distances[1 - Near] != FLT_MAX)
+			Stack.push_back({ Current.Children[1 - Near], Distances[1 - Near] });
+		if (Distances[Near] != FLT_MAX)
+			Stack.push_back({ Current.Children[Near], Distances[Near] });
+	}
+	if (Result.Item == SceneStore::InvalidItem)
+		Result.Distance = FLT_MAX;
+	return Result;
+}
+
+template<typename HitFunc>
+inline void SceneBVH::RaycastBatch(const Ray* aRays, size_t aCount, RayHit* aHits, HitFunc&& aHitTest, size_t aGrainSize) const
+{
+	ParallelFor(aCount, aGrainSize, [&](size_t aBegin, size_t aEnd)
+	{
+		for (size_t i = aBegin; i < aEnd; i++)
+			aHits[i] = Raycast(aRays[i], [&](ItemId aItem, float& aDistance) { return aHitTest(i, aItem, aDistance); });
+	});
+}
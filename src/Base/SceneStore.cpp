@@ -0,0 +1,153 @@
+#include "SceneStore.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+SceneStore::SceneStore(std::uint32_t aLayerCount, std::int32_t aFramesInFlight)
+	: FramesInFlight(aFramesInFlight), LayerItems(aLayerCount)
+{
+}
+
+void SceneStore::Reserve(size_t aItemCount)
+{
+	Worlds.reserve(aItemCount);
+	Bounds.reserve(aItemCount);
+	for (auto* Stream : { &WorldBounds.CenterX, &WorldBounds.CenterY, &WorldBounds.CenterZ,
+		&WorldBounds.ExtentX, &WorldBounds.ExtentY, &WorldBounds.ExtentZ })
+		Stream->reserve(aItemCount);
+	DrawArguments.reserve(aItemCount);
+	MeshIds.reserve(aItemCount);
+	MaterialIndices.reserve(aItemCount);
+	Layers.reserve(aItemCount);
+	DynamicFlags.reserve(aItemCount);
+	NumFramesDirty.reserve(aItemCount);
+	DirtyItems.reserve(aItemCount);
+	Names.reserve(aItemCount);
+	NameToItem.reserve(aItemCount);
+}
+
+SceneStore::ItemId SceneStore::AddItem(const std::string& aName, std::uint32_t aLayer, const DirectX::XMFLOAT4X4& aWorld,
+	const DirectX::BoundingBox& aBounds, const DrawArgs& aDrawArgs, std::uint32_t aMaterialIndex)
+{
+	assert(aLayer < LayerItems.size() && "Invalid render layer");
+	if (NameToItem.find(aName) != NameToItem.end())
+		return InvalidItem;
+
+	ItemId Id = static_cast<ItemId>(Worlds.size());
+	Worlds.push_back(aWorld);
+	Bounds.push_back(aBounds);
+	DrawArguments.push_back(aDrawArgs);
+	MeshIds.push_back(GetOrAddMeshId(aDrawArgs));
+	MaterialIndices.push_back(aMaterialIndex);
+	Layers.push_back(aLayer);
+	DynamicFlags.push_back(0);
+	NumFramesDirty.push_back(0);
+	Names.push_back(aName);
+	NameToItem.emplace(aName, Id);
+	for (auto* Stream : { &WorldBounds.CenterX, &WorldBounds.CenterY, &WorldBounds.CenterZ,
+		&WorldBounds.ExtentX, &WorldBounds.ExtentY, &WorldBounds.ExtentZ })
+		Stream->push_back(0.0f);
+	UpdateWorldBounds(Id);
+	MarkDirty(Id);
+
+	LayerItems[aLayer].push_back(Id);
+	return Id;
+}
+
+SceneStore::ItemId SceneStore::FindItem(const std::string& aName) const
+{
+	auto It = NameToItem.find(aName);
+	return It != NameToItem.end() ? It->second : InvalidItem;
+}
+
+void SceneStore::SetWorld(ItemId aId, const DirectX::XMFLOAT4X4& aWorld)
+{
+	assert(IsValid(aId));
+	Worlds[aId] = aWorld;
+	UpdateWorldBounds(aId);
+	MarkDirty(aId);
+}
+
+void SceneStore::SetDrawArgs(ItemId aId, const DrawArgs& aDrawArgs)
+{
+	assert(IsValid(aId));
+	DrawArguments[aId] = aDrawArgs;
+	MeshIds[aId] = GetOrAddMeshId(aDrawArgs);
+	MarkDirty(aId);
+}
+
+void SceneStore::SetDynamic(ItemId aId, bool bDynamic)
+{
+	assert(IsValid(aId));
+	if (IsDynamic(aId) == bDynamic)
+		return;
+	DynamicFlags[aId] = bDynamic ? 1 : 0;
+	if (bDynamic)
+		DynamicItemCount++;
+	else
+		DynamicItemCount--;
+}
+
+DirectX::BoundingBox SceneStore::GetWorldBounds(ItemId aId) const
+{
+	assert(IsValid(aId));
+	return DirectX::BoundingBox(
+		DirectX::XMFLOAT3(WorldBounds.CenterX[aId], WorldBounds.CenterY[aId], WorldBounds.CenterZ[aId]),
+		DirectX::XMFLOAT3(WorldBounds.ExtentX[aId], WorldBounds.ExtentY[aId], WorldBounds.ExtentZ[aId]));
+}
+
+void SceneStore::UpdateWorldBounds(ItemId aId)
+{
+	// Row vector convention (p' = p * World): the world box encloses the transformed local box,
+	// its extents are the local extents projected on the absolute rotation-scale rows
+	const DirectX::XMFLOAT4X4& M = Worlds[aId];
+	const DirectX::XMFLOAT3& C = Bounds[aId].Center;
+	const DirectX::XMFLOAT3& E = Bounds[aId].Extents;
+
+	WorldBounds.CenterX[aId] = C.x * M._11 + C.y * M._21 + C.z * M._31 + M._41;
+	WorldBounds.CenterY[aId] = C.x * M._12 + C.y * M._22 + C.z * M._32 + M._42;
+	WorldBounds.CenterZ[aId] = C.x * M._13 + C.y * M._23 + C.z * M._33 + M._43;
+	WorldBounds.ExtentX[aId] = E.x * std::fabs(M._11) + E.y * std::fabs(M._21) + E.z * std::fabs(M._31);
+	WorldBounds.ExtentY[aId] = E.x * std::fabs(M._12) + E.y * std::fabs(M._22) + E.z * std::fabs(M._32);
+	WorldBounds.ExtentZ[aId] = E.x * std::fabs(M._13) + E.y * std::fabs(M._23) + E.z * std::fabs(M._33);
+}
+
+std::uint32_t SceneStore::GetOrAddMeshId(const DrawArgs& aDrawArgs)
+{
+	auto MeshKey = std::make_tuple(aDrawArgs.GeometryId, aDrawArgs.IndexCount, aDrawArgs.IndexStartLocation,
+		aDrawArgs.VertexStartLocation);
+	auto It = MeshIdLookup.find(MeshKey);
+	if (It != MeshIdLookup.end())
+		return It->second;
+
+	// Live and freed ids together are [0, N), a new id is only taken past them when none is free
+	std::uint32_t MeshId = static_cast<std::uint32_t>(MeshIdLookup.size());
+	if (!FreeMeshIds.empty())
+	{
+		MeshId = FreeMeshIds.back();
+		FreeMeshIds.pop_back();
+	}
+	MeshIdLookup.emplace(MeshKey, MeshId);
+	return MeshId;
+}
+
+void SceneStore::RemoveGeometryMeshes(std::uint32_t aGeometryId)
+{
+	// Keys are ordered by geometry id first, so the meshes of a geometry are one range
+	auto Begin = MeshIdLookup.lower_bound(std::make_tuple(aGeometryId, 0u, 0u, INT32_MIN));
+	auto End = Begin;
+	for (; End != MeshIdLookup.end() && std::get<0>(End->first) == aGeometryId; ++End)
+	{
+		assert(std::find(MeshIds.begin(), MeshIds.end(), End->second) == MeshIds.end() && "Geometry still drawn by an item");
+		FreeMeshIds.push_back(End->second);
+	}
+	MeshIdLookup.erase(Begin, End);
+}
+
+void SceneStore::MarkDirty(ItemId aId)
+{
+	assert(IsValid(aId));
+	if (NumFramesDirty[aId] <= 0)
+		DirtyItems.push_back(aId);
+	NumFramesDirty[aId] = FramesInFlight;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <tuple>
+
+struct MeshGeometry;
+class TriangleBVH;
+struct Meshlet;
+
+// Structure-of-arrays storage for the render items of a scene.
+// An item is a plain index into parallel arrays: the components touched every frame
+// (transform, bounds, draw args, material index) are kept contiguous so the update and draw
+// loops stream through memory, while names only live in a cold side table used for
+// lookups, picking output and save/load.
+// Every item also carries a dirty counter spanning the frame resource ring, so only
+// items that changed have to be re-uploaded into the per-frame buffers.
+class SceneStore
+{
+public:
+	using ItemId = std::uint32_t;
+	static constexpr ItemId InvalidItem = UINT32_MAX;
+
+	// World space AABBs as SoA streams for SIMD culling, kept in sync with the world transforms
+	struct WorldBoundsStreams
+	{
+		std::vector<float> CenterX, CenterY, CenterZ;
+		std::vector<float> ExtentX, ExtentY, ExtentZ;
+	};
+
+	struct DrawArgs
+	{
+		MeshGeometry* MeshGeometryRef = nullptr;
+		std::uint32_t GeometryId = 0;		// MeshGeometry::Id, mesh ids are keyed on it rather than the address
+		std::uint32_t IndexCount = 0;
+		std::uint32_t IndexStartLocation = 0;
+		std::int32_t VertexStartLocation = 0;
+		const TriangleBVH* PickingBvh = nullptr;	// Local space triangles for ray queries, may be null
+		DirectX::XMFLOAT4 PositionDequant = { 0.0f, 0.0f, 0.0f, 1.0f };	// Of compact vertices, folded into the uploaded world
+		const Meshlet* Meshlets = nullptr;	// Of the submesh, culled by ClusterCuller when drawn alone
+		std::uint32_t MeshletCount = 0;
+	};
+
+	SceneStore(std::uint32_t aLayerCount, std::int32_t aFramesInFlight);
+	SceneStore(const SceneStore&) = delete;
+	SceneStore& operator=(const SceneStore&) = delete;
+
+	void Reserve(size_t aItemCount);
+
+	// Returns InvalidItem if an item with the same name already exists
+	ItemId AddItem(const std::string& aName, std::uint32_t aLayer, const DirectX::XMFLOAT4X4& aWorld,
+		const DirectX::BoundingBox& aBounds, const DrawArgs& aDrawArgs, std::uint32_t aMaterialIndex);
+	ItemId FindItem(const std::string& aName) const;
+
+	size_t GetItemCount() const { return Worlds.size(); }
+	bool IsValid(ItemId aId) const { return aId < Worlds.size(); }
+	const std::vector<ItemId>& GetLayerItems(std::uint32_t aLayer) const { return LayerItems[aLayer]; }
+
+	const DirectX::XMFLOAT4X4& GetWorld(ItemId aId) const { return Worlds[aId]; }
+	void SetWorld(ItemId aId, const DirectX::XMFLOAT4X4& aWorld);
+	const DirectX::BoundingBox& GetBounds(ItemId aId) const { return Bounds[aId]; }
+	DirectX::BoundingBox GetWorldBounds(ItemId aId) const;
+	const DrawArgs& GetDrawArgs(ItemId aId) const { return DrawArguments[aId]; }
+	// Swaps the geometry an item draws, e.g. its level of detail. The local bounds are kept, the item is marked
+	// dirty as its uploaded world depends on the position dequantization.
+	void SetDrawArgs(ItemId aId, const DrawArgs& aDrawArgs);
+	// Dense id shared by every item drawing the same geometry and submesh range
+	std::uint32_t GetMeshId(ItemId aId) const { return MeshIds[aId]; }
+	std::uint32_t GetMeshCount() const { return static_cast<std::uint32_t>(MeshIdLookup.size()); }
+	// Forgets the mesh ids of a removed geometry, no item may draw it anymore. Their ids are reused by the next meshes.
+	void RemoveGeometryMeshes(std::uint32_t aGeometryId);
+	std::uint32_t GetMaterialIndex(ItemId aId) const { return MaterialIndices[aId]; }
+	std::uint32_t GetLayer(ItemId aId) const { return Layers[aId]; }
+	// Items are static unless flagged dynamic, e.g. static shadow casters can be cached
+	void SetDynamic(ItemId aId, bool bDynamic);
+	bool IsDynamic(ItemId aId) const { return DynamicFlags[aId] != 0; }
+	size_t GetDynamicItemCount() const { return DynamicItemCount; }
+	const std::string& GetName(ItemId aId) const { return Names[aId]; }
+
+	const std::vector<DirectX::XMFLOAT4X4>& GetWorlds() const { return Worlds; }
+	const std::vector<DirectX::BoundingBox>& GetAllBounds() const { return Bounds; }
+	const WorldBoundsStreams& GetAllWorldBounds() const { return WorldBounds; }
+	const std::vector<DrawArgs>& GetAllDrawArgs() const { return DrawArguments; }
+	const std::vector<std::uint32_t>& GetMeshIds() const { return MeshIds; }
+	const std::vector<std::uint32_t>& GetMaterialIndices() const { return MaterialIndices; }
+	const std::vector<std::uint8_t>& GetDynamicFlags() const { return DynamicFlags; }
+
+	// Flags the item for upload into each of the next FramesInFlight frame resources
+	void MarkDirty(ItemId aId);
+	size_t GetDirtyItemCount() const { return DirtyItems.size(); }
+
+	// Calls aUpload(ItemId) for every dirty item and ages its counter by one frame.
+	// Returns the number of items uploaded.
+	template<typename UploadFunc>
+	size_t ConsumeDirtyItems(UploadFunc&& aUpload);
+
+private:
+	void UpdateWorldBounds(ItemId aId);
+	std::uint32_t GetOrAddMeshId(const DrawArgs& aDrawArgs);
+
+	// Hot components
+	std::vector<DirectX::XMFLOAT4X4> Worlds;
+	std::vector<DirectX::BoundingBox> Bounds;		// Local space
+	WorldBoundsStreams WorldBounds;
+	std::vector<DrawArgs> DrawArguments;
+	std::vector<std::uint32_t> MeshIds;
+	std::vector<std::uint32_t> MaterialIndices;	// Material::MatCBIndex
+	std::vector<std::uint32_t> Layers;
+	std::vector<std::uint8_t> DynamicFlags;
+	size_t DynamicItemCount = 0;
+	std::vector<std::int32_t> NumFramesDirty;
+	std::vector<ItemId> DirtyItems;
+	std::int32_t FramesInFlight;
+
+	// Cold components
+	std::vector<std::string> Names;
+	std::unordered_map<std::string, ItemId> NameToItem;
+	// Geometry id, index count, start index and base vertex to mesh id
+	std::map<std::tuple<std::uint32_t, std::uint32_t, std::uint32_t, std::int32_t>, std::uint32_t> MeshIdLookup;
+	std::vector<std::uint32_t> FreeMeshIds;
+
+	std::vector<std::vector<ItemId>> LayerItems;
+};
+
+template<typename UploadFunc>
+inline size_t SceneStore::ConsumeDirtyItems(UploadFunc&& aUpload)
+{
+	size_t Uploaded = DirtyItems.size();
+	size_t Kept = 0;
+	for (ItemId Id : DirtyItems)
+	{
+		aUpload(Id);
+		if (--NumFramesDirty[Id] > 0)
+			DirtyItems[Kept++] = Id;
+	}
+	DirtyItems.resize(Kept);
+	return Uploaded;
+}
@@ -0,0 +1,131 @@
+#include "ShadowCache.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+void ShadowCache::Resize(std::uint32_t aSliceCount, std::uint32_t aResolution)
+{
+	assert(aResolution > 0);
+	Slices.assign(aSliceCount, Slice());
+	Resolution = aResolution;
+	InvalidateAll();
+}
+
+void ShadowCache::SetSliceProjection(std::uint32_t aSlice, const DirectX::XMFLOAT4X4& aViewProj)
+{
+	assert(aSlice < Slices.size() && "Shadow cache slice out of range");
+	Slice& Current = Slices[aSlice];
+	if (Current.bHasProjection && std::memcmp(&Current.ViewProj, &aViewProj, sizeof(aViewProj)) == 0)
+		return;
+
+	Current.ViewProj = aViewProj;
+	Current.bHasProjection = true;
+	InvalidateSlice(aSlice);
+}
+
+void ShadowCache::InvalidateSlice(std::uint32_t aSlice)
+{
+	assert(aSlice < Slices.size() && "Shadow cache slice out of range");
+	Slices[aSlice].Dirty = { 0, 0, (std::int32_t)Resolution, (std::int32_t)Resolution };
+}
+
+void ShadowCache::InvalidateAll()
+{
+	for (std::uint32_t i = 0; i < Slices.size(); i++)
+		InvalidateSlice(i);
+}
+
+void ShadowCache::InvalidateBounds(const DirectX::BoundingBox& aWorldBounds)
+{
+	const DirectX::XMFLOAT3& C = aWorldBounds.Center;
+	const DirectX::XMFLOAT3& E = aWorldBounds.Extents;
+	for (Slice& Current : Slices)
+	{
+		if (!Current.bHasProjection)
+			continue;
+
+		// Light space footprint of the box: the bounds of its projected corners
+		const DirectX::XMFLOAT4X4& M = Current.ViewProj;
+		float MinX = FLT_MAX, MinY = FLT_MAX, MaxX = -FLT_MAX, MaxY = -FLT_MAX;
+		for (int Corner = 0; Corner < 8; Corner++)
+		{
+			float X = C.x + ((Corner & 1) ? E.x : -E.x);
+			float Y = C.y + ((Corner & 2) ? E.y : -E.y);
+			float Z = C.z + ((Corner & 4) ? E.z : -E.z);
+			float W = X * M._14 + Y * M._24 + Z * M._34 + M._44;
+			float NdcX = (X * M._11 + Y * M._21 + Z * M._31 + M._41) / W;
+			float NdcY = (X * M._12 + Y * M._22 + Z * M._32 + M._42) / W;
+			MinX = std::min(MinX, NdcX);
+			MaxX = std::max(MaxX, NdcX);
+			MinY = std::min(MinY, NdcY);
+			MaxY = std::max(MaxY, NdcY);
+		}
+
+		// NDC to texels, grown by one texel to cover partially rasterized edges
+		float Scale = 0.5f * (float)Resolution;
+		Region Footprint;
+		Footprint.Left = (std::int32_t)std::floor((MinX + 1.0f) * Scale) - 1;
+		Footprint.Right = (std::int32_t)std::ceil((MaxX + 1.0f) * Scale) + 1;
+		Footprint.Top = (std::int32_t)std::floor((1.0f - MaxY) * Scale) - 1;
+		Footprint.Bottom = (std::int32_t)std::ceil((1.0f - MinY) * Scale) + 1;
+		AddDirtyRegion(Current, Footprint);
+	}
+}
+
+DirectX::XMFLOAT4X4 ShadowCache::GetDirtyViewProj(std::uint32_t aSlice) const
+{
+	assert(aSlice < Slices.size() && IsDirty(aSlice));
+	const Slice& Current = Slices[aSlice];
+	const Region& Dirty = Current.Dirty;
+
+	// Scales and offsets NDC xy so the dirty texels map to [-1, 1]
+	float InvScale = 2.0f / (float)Resolution;
+	float X0 = Dirty.Left * InvScale - 1.0f;
+	float X1 = Dirty.Right * InvScale - 1.0f;
+	float Y0 = 1.0f - Dirty.Bottom * InvScale;
+	float Y1 = 1.0f - Dirty.Top * InvScale;
+	float ScaleX = 2.0f / (X1 - X0);
+	float ScaleY = 2.0f / (Y1 - Y0);
+	float OffsetX = -0.5f * (X0 + X1) * ScaleX;
+	float OffsetY = -0.5f * (Y0 + Y1) * ScaleY;
+
+	// ViewProj * [ScaleX 0 0 0; 0 ScaleY 0 0; 0 0 1 0; OffsetX OffsetY 0 1]
+	DirectX::XMFLOAT4X4 Result = Current.ViewProj;
+	for (int Row = 0; Row < 4; Row++)
+	{
+		float W = Current.ViewProj.m[Row][3];
+		Result.m[Row][0] = Current.ViewProj.m[Row][0] * ScaleX + W * OffsetX;
+		Result.m[Row][1] = Current.ViewProj.m[Row][1] * ScaleY + W * OffsetY;
+	}
+	return Result;
+}
+
+void ShadowCache::MarkClean(std::uint32_t aSlice)
+{
+	assert(aSlice < Slices.size() && "Shadow cache slice out of range");
+	Slices[aSlice].Dirty = Region();
+}
+
+void ShadowCache::AddDirtyRegion(Slice& aSlice, const Region& aRegion)
+{
+	Region Clamped;
+	Clamped.Left = std::max(aRegion.Left, 0);
+	Clamped.Top = std::max(aRegion.Top, 0);
+	Clamped.Right = std::min(aRegion.Right, (std::int32_t)Resolution);
+	Clamped.Bottom = std::min(aRegion.Bottom, (std::int32_t)Resolution);
+	if (Clamped.IsEmpty())
+		return;
+
+	Region& Dirty = aSlice.Dirty;
+	if (Dirty.IsEmpty())
+	{
+		Dirty = Clamped;
+		return;
+	}
+	Dirty.Left = std::min(Dirty.Left, Clamped.Left);
+	Dirty.Top = std::min(Dirty.Top, Clamped.Top);
+	Dirty.Right = std::max(Dirty.Right, Clamped.Right);
+	Dirty.Bottom = std::max(Dirty.Bottom, Clamped.Bottom);
+}
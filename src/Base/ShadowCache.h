@@ -0,0 +1,56 @@
+#pragma once
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+// Bookkeeping for a cached static shadow layer, one slice per cascade.
+// A slice is fully invalidated when its light projection changes (light direction or cascade refit);
+// a moved static caster only invalidates the texels covered by its old and new bounds. Every slice
+// keeps the union of its invalidated texels, which is cleared and re-rendered with a scissor.
+class ShadowCache
+{
+public:
+	// Texel rectangle, Right and Bottom exclusive (same layout as a D3D12_RECT)
+	struct Region
+	{
+		std::int32_t Left = 0;
+		std::int32_t Top = 0;
+		std::int32_t Right = 0;
+		std::int32_t Bottom = 0;
+
+		bool IsEmpty() const { return Right <= Left || Bottom <= Top; }
+		std::uint64_t GetArea() const { return IsEmpty() ? 0 : (std::uint64_t)(Right - Left) * (std::uint64_t)(Bottom - Top); }
+	};
+
+	// Invalidates every slice
+	void Resize(std::uint32_t aSliceCount, std::uint32_t aResolution);
+
+	// aViewProj uses the CPU side row vector convention. A different projection invalidates the slice.
+	void SetSliceProjection(std::uint32_t aSlice, const DirectX::XMFLOAT4X4& aViewProj);
+	void InvalidateSlice(std::uint32_t aSlice);
+	void InvalidateAll();
+	// Invalidates the texels covered by a world space box in every slice
+	void InvalidateBounds(const DirectX::BoundingBox& aWorldBounds);
+
+	std::uint32_t GetSliceCount() const { return static_cast<std::uint32_t>(Slices.size()); }
+	bool IsDirty(std::uint32_t aSlice) const { return !Slices[aSlice].Dirty.IsEmpty(); }
+	const Region& GetDirtyRegion(std::uint32_t aSlice) const { return Slices[aSlice].Dirty; }
+	// Slice projection narrowed to the dirty region, for culling the casters that have to be re-rendered
+	DirectX::XMFLOAT4X4 GetDirtyViewProj(std::uint32_t aSlice) const;
+	// Call once the dirty region of the slice has been re-rendered
+	void MarkClean(std::uint32_t aSlice);
+
+private:
+	struct Slice
+	{
+		DirectX::XMFLOAT4X4 ViewProj = {};
+		bool bHasProjection = false;
+		Region Dirty;
+	};
+
+	void AddDirtyRegion(Slice& aSlice, const Region& aRegion);
+
+	std::vector<Slice> Slices;
+	std::uint32_t Resolution = 0;
+};
@@ -1,10 +1,12 @@
 #include "ShadowMap.h"
 
-ShadowMap::ShadowMap(ID3D12Device* aDevice, UINT aWidth, UINT aHeight)
+ShadowMap::ShadowMap(ID3D12Device* aDevice, GpuMemoryAllocator* aAllocator, UINT aWidth, UINT aHeight, UINT aArraySize)
 {
 	Width = aWidth;
 	Height = aHeight;
+	ArraySize = aArraySize;
 	Device = aDevice;
+	Allocator = aAllocator;
 	BuildResource();
 }
 
@@ -18,9 +20,10 @@ RECT ShadowMap::GetRect()
 	return { 0, 0, (int)Width, (int)Height };
 }
 
-CD3DX12_CPU_DESCRIPTOR_HANDLE ShadowMap::GetDsvHeapCpuHandle()
+CD3DX12_CPU_DESCRIPTOR_HANDLE ShadowMap::GetDsvHeapCpuHandle(UINT aSlice)
 {
-	return DSV;
+	assert(aSlice < DSV.size() && "Shadow map slice out of range");
+	return DSV[aSlice];
 }
 
 ID3D12Resource* ShadowMap::GetResourcePtr()
@@ -28,28 +31,38 @@ ID3D12Resource* ShadowMap::GetResourcePtr()
 	return DepthBufferResource.Get();
 }
 
-void ShadowMap::BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE aSrvCpuHandle, CD3DX12_CPU_DESCRIPTOR_HANDLE aDsvCpuHandle)
+void ShadowMap::BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE aSrvCpuHandle, CD3DX12_CPU_DESCRIPTOR_HANDLE aDsvCpuHandle,
+	UINT aDsvDescriptorSize)
 {
 	// Store the handles for later use
 	SRV = aSrvCpuHandle;
-	DSV = aDsvCpuHandle;
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC SrvDesc = {};
 	SrvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
-	SrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	SrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
 	SrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	SrvDesc.Texture2D.MipLevels = 1;
-	SrvDesc.Texture2D.MostDetailedMip = 0;
-	SrvDesc.Texture2D.ResourceMinLODClamp = 0;
-	SrvDesc.Texture2D.PlaneSlice = 0;
+	SrvDesc.Texture2DArray.MipLevels = 1;
+	SrvDesc.Texture2DArray.MostDetailedMip = 0;
+	SrvDesc.Texture2DArray.ResourceMinLODClamp = 0;
+	SrvDesc.Texture2DArray.PlaneSlice = 0;
+	SrvDesc.Texture2DArray.FirstArraySlice = 0;
+	SrvDesc.Texture2DArray.ArraySize = ArraySize;
 	Device->CreateShaderResourceView(DepthBufferResource.Get(), &SrvDesc, aSrvCpuHandle);
 
-	D3D12_DEPTH_STENCIL_VIEW_DESC DsvDesc = {};
-	DsvDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-	DsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-	DsvDesc.Flags = D3D12_DSV_FLAG_NONE;
-	DsvDesc.Texture2D.MipSlice = 0;
-	Device->CreateDepthStencilView(DepthBufferResource.Get(), &DsvDesc, aDsvCpuHandle);
+	DSV.clear();
+	for (UINT Slice = 0; Slice < ArraySize; Slice++)
+	{
+		CD3DX12_CPU_DESCRIPTOR_HANDLE SliceDsv(aDsvCpuHandle, Slice, aDsvDescriptorSize);
+		D3D12_DEPTH_STENCIL_VIEW_DESC DsvDesc = {};
+		DsvDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+		DsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+		DsvDesc.Flags = D3D12_DSV_FLAG_NONE;
+		DsvDesc.Texture2DArray.MipSlice = 0;
+		DsvDesc.Texture2DArray.FirstArraySlice = Slice;
+		DsvDesc.Texture2DArray.ArraySize = 1;
+		Device->CreateDepthStencilView(DepthBufferResource.Get(), &DsvDesc, SliceDsv);
+		DSV.push_back(SliceDsv);
+	}
 }
 
 void ShadowMap::BuildResource()
@@ -60,7 +73,7 @@ void ShadowMap::BuildResource()
 	DsvResDesc.Alignment = 0;
 	DsvResDesc.Width     = Width;
 	DsvResDesc.Height    = Height;
-	DsvResDesc.DepthOrArraySize = 1;
+	DsvResDesc.DepthOrArraySize = (UINT16)ArraySize;
 	DsvResDesc.MipLevels = 1;
 	DsvResDesc.Format    = DXGI_FORMAT_R24G8_TYPELESS;
 	DsvResDesc.SampleDesc= {1,0};
@@ -71,8 +84,7 @@ void ShadowMap::BuildResource()
 	DsvClearVal.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;		//@TODO
 	DsvClearVal.DepthStencil = {1 , 0};
 
-	auto HeapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-	Device->CreateCommittedResource(&HeapProperty, D3D12_HEAP_FLAG_NONE, &DsvResDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ, &DsvClearVal, IID_PPV_ARGS(&DepthBufferResource));
+	ThrowIfFailed(Allocator->CreateResource(D3D12_HEAP_TYPE_DEFAULT, DsvResDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ, &DsvClearVal, DepthBufferResource));
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 #include "../Utility/d3dUtil.h"
+#include "../Utility/GpuMemoryAllocator.h"
 
 class ShadowMap
 {
@@ -8,21 +9,26 @@ public:
 	ShadowMap(const ShadowMap&) = delete;
 	ShadowMap& operator=(const ShadowMap&) = delete;
 	
-	ShadowMap(ID3D12Device* aDevice, UINT aWidth, UINT aHeight);
+	// One array slice per cascade, sampled as a Texture2DArray
+	ShadowMap(ID3D12Device* aDevice, GpuMemoryAllocator* aAllocator, UINT aWidth, UINT aHeight, UINT aArraySize = 1);
 	D3D12_VIEWPORT GetViewport();
 	RECT GetRect();
-	CD3DX12_CPU_DESCRIPTOR_HANDLE GetDsvHeapCpuHandle();
+	CD3DX12_CPU_DESCRIPTOR_HANDLE GetDsvHeapCpuHandle(UINT aSlice = 0);
+	UINT GetArraySize() const { return ArraySize; }
 
 	ID3D12Resource* GetResourcePtr();
-	void BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE aSRV , CD3DX12_CPU_DESCRIPTOR_HANDLE aDSV);
+	// aDSV is the first of ArraySize consecutive DSV heap slots
+	void BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE aSRV , CD3DX12_CPU_DESCRIPTOR_HANDLE aDSV, UINT aDsvDescriptorSize);
 
 private:
 	UINT Width;
 	UINT Height;
+	UINT ArraySize;
 	CD3DX12_CPU_DESCRIPTOR_HANDLE SRV; 
-	CD3DX12_CPU_DESCRIPTOR_HANDLE DSV;
+	std::vector<CD3DX12_CPU_DESCRIPTOR_HANDLE> DSV;
 
 	ID3D12Device* Device;
+	GpuMemoryAllocator* Allocator;
 	Microsoft::WRL::ComPtr<ID3D12Resource> DepthBufferResource;
 	void BuildResource();
 };
\ No newline at end of file
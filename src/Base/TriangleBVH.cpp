@@ -0,0 +1,309 @@
+#include "TriangleBVH.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	// Keeps the fixed traversal stack of Intersect safe, deeper nodes become leaves
+	constexpr std::uint32_t MaxDepth = 60;
+
+	struct BuildBounds
+	{
+		float Min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float Max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const float aMin[3], const float aMax[3])
+		{
+			for (int Axis = 0; Axis < 3; Axis++)
+			{
+				Min[Axis] = std::min(Min[Axis], aMin[Axis]);
+				Max[Axis] = std::max(Max[Axis], aMax[Axis]);
+			}
+		}
+
+		float GetHalfArea() const
+		{
+			float DX = Max[0] - Min[0], DY = Max[1] - Min[1], DZ = Max[2] - Min[2];
+			return DX < 0.0f ? 0.0f : DX * DY + DY * DZ + DZ * DX;
+		}
+	};
+
+	struct BuildTask
+	{
+		std::uint32_t Node;
+		std::uint32_t Depth;
+	};
+
+	DirectX::XMFLOAT3 Subtract(const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B)
+	{
+		return DirectX::XMFLOAT3(A.x - B.x, A.y - B.y, A.z - B.z);
+	}
+
+	DirectX::XMFLOAT3 Cross(const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B)
+	{
+		return DirectX::XMFLOAT3(A.y * B.z - A.z * B.y, A.z * B.x - A.x * B.z, A.x * B.y - A.y * B.x);
+	}
+
+	float Dot(const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B)
+	{
+		return A.x * B.x + A.y * B.y + A.z * B.z;
+	}
+}
+
+void TriangleBVH::Build(const void* aPositions, size_t aPositionStride, [[maybe_unused]] size_t aVertexCount, const void* aIndices,
+	bool b32BitIndices, std::uint32_t aIndexCount, std::int32_t aBaseVertex)
+{
+	Nodes.clear();
+	Triangles.clear();
+	std::uint32_t TriangleCount = aIndexCount / 3;
+	if (TriangleCount == 0)
+		return;
+
+	auto GetPosition = [&](std::uint32_t aIndex) -> const DirectX::XMFLOAT3&
+	{
+		std::uint32_t Index = b32BitIndices ? static_cast<const std::uint32_t*>(aIndices)[aIndex]
+			: static_cast<const std::uint16_t*>(aIndices)[aIndex];
+		std::int64_t Vertex = (std::int64_t)Index + aBaseVertex;
+		assert(Vertex >= 0 && (size_t)Vertex < aVertexCount && "Index out of the vertex buffer");
+		return *reinterpret_cast<const DirectX::XMFLOAT3*>(static_cast<const std::uint8_t*>(aPositions) + (size_t)Vertex * aPositionStride);
+	};
+
+	// Per triangle bounds and centroids, only needed while building
+	std::vector<Triangle> Source(TriangleCount);
+	std::vector<float> TriangleMin(TriangleCount * 3), TriangleMax(TriangleCount * 3), Centroids(TriangleCount * 3);
+	std::vector<std::uint32_t> Order(TriangleCount);
+	for (std::uint32_t i = 0; i < TriangleCount; i++)
+	{
+		const DirectX::XMFLOAT3& P0 = GetPosition(i * 3 + 0);
+		const DirectX::XMFLOAT3& P1 = GetPosition(i * 3 + 1);
+		const DirectX::XMFLOAT3& P2 = GetPosition(i * 3 + 2);
+		Source[i] = { P0, Subtract(P1, P0), Subtract(P2, P0), i };
+
+		const float* V[3] = { &P0.x, &P1.x, &P2.x };
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			float Min = std::min(std::min(V[0][Axis], V[1][Axis]), V[2][Axis]);
+			float Max = std::max(std::max(V[0][Axis], V[1][Axis]), V[2][Axis]);
+			TriangleMin[i * 3 + Axis] = Min;
+			TriangleMax[i * 3 + Axis] = Max;
+			Centroids[i * 3 + Axis] = (Min + Max) * 0.5f;
+		}
+		Order[i] = i;
+	}
+
+	Nodes.reserve(2 * (TriangleCount / MaxLeafTriangles + 1));
+	Nodes.push_back({ {}, {}, 0, TriangleCount });
+	std::vector<BuildTask> Tasks;
+	Tasks.push_back({ 0, 0 });
+	while (!Tasks.empty())
+	{
+		BuildTask Task = Tasks.back();
+		Tasks.pop_back();
+		std::uint32_t First = Nodes[Task.Node].First;
+		std::uint32_t Count = Nodes[Task.Node].Count;
+
+		BuildBounds Bounds, CentroidBounds;
+		for (std::uint32_t i = First; i < First + Count; i++)
+		{
+			std::uint32_t Tri = Order[i];
+			Bounds.Grow(&TriangleMin[Tri * 3], &TriangleMax[Tri * 3]);
+			CentroidBounds.Grow(&Centroids[Tri * 3], &Centroids[Tri * 3]);
+		}
+		std::copy(Bounds.Min, Bounds.Min + 3, Nodes[Task.Node].Min);
+		std::copy(Bounds.Max, Bounds.Max + 3, Nodes[Task.Node].Max);
+		if (Count <= MaxLeafTriangles || Task.Depth >= MaxDepth)
+			continue;
+
+		// Binned SAH: every axis is cut into BinCount slabs of the centroid bounds, the best
+		// boundary between two bins wins if it is cheaper than keeping the triangles in one leaf
+		float BestCost = FLT_MAX;
+		int BestAxis = -1;
+		std::uint32_t BestSplit = 0;
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			float Extent = CentroidBounds.Max[Axis] - CentroidBounds.Min[Axis];
+			if (Extent <= 0.0f)
+				continue;
+
+			BuildBounds BinBounds[BinCount];
+			std::uint32_t BinCounts[BinCount] = {};
+			float Scale = BinCount / Extent;
+			for (std::uint32_t i = First; i < First + Count; i++)
+			{
+				std::uint32_t Tri = Order[i];
+				std::uint32_t Bin = std::min(BinCount - 1, (std::uint32_t)((Centroids[Tri * 3 + Axis] - CentroidBounds.Min[Axis]) * Scale));
+				BinBounds[Bin].Grow(&TriangleMin[Tri * 3], &TriangleMax[Tri * 3]);
+				BinCounts[Bin]++;
+			}
+
+			float RightCosts[BinCount] = {};
+			BuildBounds Right;
+			std::uint32_t RightCount = 0;
+			for (std::uint32_t Bin = BinCount - 1; Bin > 0; Bin--)
+			{
+				Right.Grow(BinBounds[Bin].Min, BinBounds[Bin].Max);
+				RightCount += BinCounts[Bin];
+				RightCosts[Bin] = RightCount * Right.GetHalfArea();
+			}
+			BuildBounds Left;
+			std::uint32_t LeftCount = 0;
+			for (std::uint32_t Split = 1; Split < BinCount; Split++)
+			{
+				Left.Grow(BinBounds[Split - 1].Min, BinBounds[Split - 1].Max);
+				LeftCount += BinCounts[Split - 1];
+				if (LeftCount == 0 || LeftCount == Count)
+					continue;
+				float Cost = LeftCount * Left.GetHalfArea() + RightCosts[Split];
+				if (Cost < BestCost)
+				{
+					BestCost = Cost;
+					BestAxis = Axis;
+					BestSplit = Split;
+				}
+			}
+		}
+
+		// One triangle test costs about as much as one node test
+		float LeafCost = Count * Bounds.GetHalfArea();
+		if (BestAxis < 0 || BestCost + Bounds.GetHalfArea() >= LeafCost)
+			continue;
+
+		float Scale = BinCount / (CentroidBounds.Max[BestAxis] - CentroidBounds.Min[BestAxis]);
+		auto Middle = std::partition(Order.begin() + First, Order.begin() + First + Count, [&](std::uint32_t aTri)
+		{
+			std::uint32_t Bin = std::min(BinCount - 1, (std::uint32_t)((Centroids[aTri * 3 + BestAxis] - CentroidBounds.Min[BestAxis]) * Scale));
+			return Bin < BestSplit;
+		});
+		std::uint32_t LeftCount = (std::uint32_t)(Middle - Order.begin()) - First;
+		assert(LeftCount > 0 && LeftCount < Count && "SAH split produced an empty child");
+
+		std::uint32_t LeftChild = static_cast<std::uint32_t>(Nodes.size());
+		Nodes.push_back({ {}, {}, First, LeftCount });
+		Nodes.push_back({ {}, {}, First + LeftCount, Count - LeftCount });
+		Nodes[Task.Node].First = LeftChild;
+		Nodes[Task.Node].Count = 0;
+		Tasks.push_back({ LeftChild, Task.Depth + 1 });
+		Tasks.push_back({ LeftChild + 1, Task.Depth + 1 });
+	}
+
+	Triangles.resize(TriangleCount);
+	for (std::uint32_t i = 0; i < TriangleCount; i++)
+		Triangles[i] = Source[Order[i]];
+}
+
+bool TriangleBVH::Intersect(const DirectX::XMFLOAT3& aOrigin, const DirectX::XMFLOAT3& aDirection, Hit& aHit,
+	float aMaxDistance) const
+{
+	if (Nodes.empty())
+		return false;
+
+	const float Origin[3] = { aOrigin.x, aOrigin.y, aOrigin.z };
+	const float Direction[3] = { aDirection.x, aDirection.y, aDirection.z };
+	float InvDirection[3];
+	for (int Axis = 0; Axis < 3; Axis++)
+		InvDirection[Axis] = 1.0f / (Direction[Axis] != 0.0f ? Direction[Axis] : 1e-30f);
+
+	float Closest = aMaxDistance;
+	bool bHit = false;
+	if (IntersectNode(Nodes[0], Origin, InvDirection, Closest) == FLT_MAX)
+		return false;
+
+	struct StackEntry
+	{
+		std::uint32_t Node;
+		float Distance;
+	};
+	StackEntry Stack[MaxDepth + 4];
+	std::uint32_t StackSize = 0;
+	std::uint32_t Current = 0;
+	for (;;)
+	{
+		const Node& CurrentNode = Nodes[Current];
+		if (CurrentNode.Count > 0)
+		{
+			// Moller-Trumbore
+			for (std::uint32_t i = CurrentNode.First; i < CurrentNode.First + CurrentNode.Count; i++)
+			{
+				const Triangle& Tri = Triangles[i];
+				DirectX::XMFLOAT3 P = Cross(aDirection, Tri.Edge2);
+				float Det = Dot(Tri.Edge1, P);
+				if (Det == 0.0f)
+					continue;
+				float InvDet = 1.0f / Det;
+				DirectX::XMFLOAT3 T = Subtract(aOrigin, Tri.V0);
+				float U = Dot(T, P) * InvDet;
+				if (U < 0.0f || U > 1.0f)
+					continue;
+				DirectX::XMFLOAT3 Q = Cross(T, Tri.Edge1);
+				float V = Dot(aDirection, Q) * InvDet;
+				if (V < 0.0f || U + V > 1.0f)
+					continue;
+				float Distance = Dot(Tri.Edge2, Q) * InvDet;
+				if (Distance > 0.0f && Distance < Closest)
+				{
+					Closest = Distance;
+					aHit = { Distance, Tri.Index, U, V };
+					bHit = true;
+				}
+			}
+		}
+		else
+		{
+			// Near child first, the far one waits on the stack with its entry distance
+			std::uint32_t Near = CurrentNode.First, Far = CurrentNode.First + 1;
+			float NearDistance = IntersectNode(Nodes[Near], Origin, InvDirection, Closest);
+			float FarDistance = IntersectNode(Nodes[Far], Origin, InvDirection, Closest);
+			if (FarDistance < NearDistance)
+			{
+				std::swap(Near, Far);
+				std::swap(NearDistance, FarDistance);
+			}
+			if (NearDistance != FLT_MAX)
+			{
+				if (FarDistance != FLT_MAX)
+					Stack[StackSize++] = { Far, FarDistance };
+				Current = Near;
+				continue;
+			}
+		}
+
+		// Pop the next node that can still beat the closest hit
+		bool bFound = false;
+		while (StackSize > 0 && !bFound)
+		{
+			const StackEntry& Entry = Stack[--StackSize];
+			if (Entry.Distance < Closest)
+			{
+				Current = Entry.Node;
+				bFound = true;
+			}
+		}
+		if (!bFound)
+			break;
+	}
+	return bHit;
+}
+
+DirectX::BoundingBox TriangleBVH::GetBounds() const
+{
+	if (Nodes.empty())
+		return DirectX::BoundingBox();
+	const Node& Root = Nodes[0];
+	DirectX::XMFLOAT3 Center((Root.Min[0] + Root.Max[0]) * 0.5f, (Root.Min[1] + Root.Max[1]) * 0.5f, (Root.Min[2] + Root.Max[2]) * 0.5f);
+	DirectX::XMFLOAT3 Extents(Root.Max[0] - Center.x, Root.Max[1] - Center.y, Root.Max[2] - Center.z);
+	return DirectX::BoundingBox(Center, Extents);
+}
+
+float TriangleBVH::IntersectNode(const Node& aNode, const float aOrigin[3], const float aInvDirection[3], float aMaxDistance)
+{
+	float Enter = 0.0f, Exit = aMaxDistance;
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		float T0 = (aNode.Min[Axis] - aOrigin[Axis]) * aInvDirection[Axis];
+		float T1 = (aNode.Max[Axis] - aOrigin[Axis]) * aInvDirection[Axis];
+		Enter = std::max(Enter, std::min(T0, T1));
+		Exit = std::min(Exit, std::max(T0, T1));
+	}
+	return Enter <= Exit ? Enter : FLT_MAX;
+}
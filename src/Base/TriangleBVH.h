@@ -0,0 +1,59 @@
+#pragma once
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounding volume hierarchy over the triangles of one submesh, used for closest hit ray queries (picking).
+// Built once per submesh with binned SAH splits; triangles are copied into node order as a vertex and two
+// edges so a query only touches the BVH's own memory, not the vertex and index buffers.
+class TriangleBVH
+{
+public:
+	struct Hit
+	{
+		float Distance = 0.0f;		// Ray parameter, in units of the (not necessarily normalized) direction
+		std::uint32_t Triangle = 0;	// Index of the triangle within the submesh (first index / 3)
+		float U = 0.0f, V = 0.0f;	// Barycentrics of vertex 1 and 2
+	};
+
+	// Reads aIndexCount indices starting at aIndices, 16 or 32 bits wide, each offset by aBaseVertex into
+	// aPositions (aPositionStride bytes apart), same as a DrawIndexedInstanced call
+	void Build(const void* aPositions, size_t aPositionStride, size_t aVertexCount, const void* aIndices,
+		bool b32BitIndices, std::uint32_t aIndexCount, std::int32_t aBaseVertex);
+
+	// Closest triangle hit with Distance in (0, aMaxDistance), both triangle sides count
+	bool Intersect(const DirectX::XMFLOAT3& aOrigin, const DirectX::XMFLOAT3& aDirection, Hit& aHit,
+		float aMaxDistance = FLT_MAX) const;
+
+	bool IsEmpty() const { return Nodes.empty(); }
+	size_t GetTriangleCount() const { return Triangles.size(); }
+	size_t GetNodeCount() const { return Nodes.size(); }
+	DirectX::BoundingBox GetBounds() const;
+
+private:
+	static constexpr std::uint32_t BinCount = 16;
+	static constexpr std::uint32_t MaxLeafTriangles = 4;
+
+	struct Node
+	{
+		float Min[3];
+		float Max[3];
+		std::uint32_t First;	// Leaf: first triangle, interior: left child (right child is First + 1)
+		std::uint32_t Count;	// 0 for interior nodes
+	};
+
+	struct Triangle
+	{
+		DirectX::XMFLOAT3 V0, Edge1, Edge2;
+		std::uint32_t Index;
+	};
+
+	// Box of the node against a ray given by its inverse direction, returns the entry distance or FLT_MAX
+	static float IntersectNode(const Node& aNode, const float aOrigin[3], const float aInvDirection[3], float aMaxDistance);
+
+	std::vector<Node> Nodes;
+	std::vector<Triangle> Triangles;
+};
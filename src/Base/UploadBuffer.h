@@ -1,12 +1,13 @@
 #pragma once
 #include "../Utility/d3dUtil.h"
+#include "../Utility/GpuMemoryAllocator.h"
 
 template<typename DataType>
 class UploadBuffer
 {
 public:
 
-	UploadBuffer(ID3D12Device* Device , UINT TotalDataCount , bool bISConstBuffer)
+	UploadBuffer(GpuMemoryAllocator* Allocator , UINT TotalDataCount , bool bISConstBuffer)
 	{
 		TotalElementsCount = TotalDataCount;
 		if (bISConstBuffer)
@@ -15,10 +16,7 @@ public:
 			PerDataSize = sizeof(DataType);
 
 		TotalDataSize = PerDataSize * TotalElementsCount;
-		auto HeapProperty = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD) ;
-		auto ResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(TotalDataSize);
-		ThrowIfFailed( Device->CreateCommittedResource(&HeapProperty ,D3D12_HEAP_FLAG_NONE,
-			&ResourceDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&Resource))  );
+		Resource = Allocator->CreateBuffer(D3D12_HEAP_TYPE_UPLOAD, TotalDataSize, D3D12_RESOURCE_STATE_GENERIC_READ);
 
 		ThrowIfFailed( Resource->Map(0, nullptr,  reinterpret_cast<void**>(&ResourceMap)));
 
@@ -36,7 +34,11 @@ public:
 
 	
 	D3D12_GPU_VIRTUAL_ADDRESS GetResourceGpuAddress() const;
+	ID3D12Resource* GetResource() const { return Resource.Get(); }
 	void CopyData(UINT ElementIndex , const DataType& Data);
+	// Copies Count tightly packed elements, only valid for non constant buffers
+	void CopyRange(UINT FirstElementIndex, const DataType* Data, UINT Count);
+	UINT GetElementCount() const { return TotalElementsCount; }
 
 
 private:
@@ -62,3 +64,11 @@ inline void UploadBuffer<DataType>::CopyData(UINT ElementIndex, const DataType&
 	assert(ElementIndex < TotalElementsCount);
 	memcpy(&ResourceMap[ElementIndex*PerDataSize], &Data, PerDataSize);
 }
+
+template<typename DataType>
+inline void UploadBuffer<DataType>::CopyRange(UINT FirstElementIndex, const DataType* Data, UINT Count)
+{
+	assert(PerDataSize == sizeof(DataType) && "CopyRange requires a tightly packed buffer");
+	assert(FirstElementIndex + Count <= TotalElementsCount);
+	memcpy(&ResourceMap[FirstElementIndex * PerDataSize], Data, Count * sizeof(DataType));
+}
@@ -10,12 +10,17 @@
     #define NUM_SPOT_LIGHTS 0
 #endif
 
+#ifndef MAX_CASCADES
+    #define MAX_CASCADES 4  // CascadedShadows::MaxCascades
+#endif
+
 #include "LightingUtil.hlsl"
 
 Texture2D gTextureMaps[512] : register(t0, space0);
 
-Texture2D ShadowMap : register(t0, space1);
+Texture2DArray ShadowMap : register(t0, space1);  // One slice per cascade
 TextureCube TexSkyBox : register(t1, space1);
+TextureCubeArray ProbeCubes : register(t2, space1);  // One cube per reflection probe
 
 SamplerState gsamPointWrap : register(s0);
 SamplerState gsamPointClamp : register(s1);
@@ -30,18 +35,27 @@ cbuffer PassData : register(b0)
     float4x4 View;
     float4x4 Proj;
     float4x4 ViewProj;
-    float4x4 ShadowTransform;
+    float4x4 ShadowTransforms[MAX_CASCADES];
     float3 Eye;
-    float Padding;
+    uint CascadeCount;
     Light TotalLights[MaxLights];
 }
 
-cbuffer ObjData : register(b1)
+// Offset of the current instanced draw into gInstanceIndices
+cbuffer DrawData : register(b1)
 {
-    float4x4 World;
+    uint InstanceBase;
 }
 
-cbuffer MaterialData : register(b2)
+struct InstanceData
+{
+    float4x4 World;
+    uint MaterialIndex;
+    uint2 ProbeIndices;  // Reflection probes blended by ProbeBlend
+    float ProbeBlend;
+};
+
+struct MaterialData
 {
     float4 DiffuseAlbedo;
     float3 FresnelR0;
@@ -50,24 +64,70 @@ cbuffer MaterialData : register(b2)
     uint DiffuseTexIndex;
     uint NormalTexIndex;
     uint Padding1;  // Match C++ struct padding
+};
+
+// Material table shared by all render items, indexed by Material::MatCBIndex
+StructuredBuffer<MaterialData> gMaterialData : register(t0, space2);
+// Per render item data, indexed by render item id
+StructuredBuffer<InstanceData> gInstanceData : register(t1, space2);
+// Render item ids of every instanced draw of the frame
+StructuredBuffer<uint> gInstanceIndices : register(t2, space2);
+
+InstanceData GetInstanceData(uint aInstanceId)
+{
+    return gInstanceData[gInstanceIndices[InstanceBase + aInstanceId]];
 }
 
+// Vertex layout of ShapesApp::BuildShadersAndInputLayout
+struct VertexIn
+{
+#ifdef COMPACT_VERTEX
+    // CompactVertex: the position is snorm in the quantization box of its submesh, whose dequantization is
+    // folded into InstanceData::World; normal and tangent are octahedral snorm
+    float3 lPosition : POSITION;
+    float2 texCoord  : TEXCOORD;
+    float2 normalL   : NORMAL;
+    float2 tangentL  : TANGENT;
+#else
+    float3 lPosition : POSITION;
+    float2 texCoord  : TEXCOORD;
+    float3 normalL   : NORMAL;
+    float3 tangentL  : TANGENT;
+#endif
+};
 
+// Inverse of OctahedralEncode in CompactVertex.cpp
+float3 OctahedralDecode(float2 Encoded)
+{
+    float3 Direction = float3(Encoded, 1.0f - abs(Encoded.x) - abs(Encoded.y));
+    if (Direction.z < 0.0f)
+        Direction.xy = (1.0f - abs(Direction.yx)) * (Direction.xy >= 0.0f ? 1.0f : -1.0f);
+    return normalize(Direction);
+}
 
+float3 GetVertexNormal(VertexIn Input)
+{
+#ifdef COMPACT_VERTEX
+    return OctahedralDecode(Input.normalL);
+#else
+    return Input.normalL;
+#endif
+}
 
-float CalcShadowFactor(float4 shadowPosH)
+float3 GetVertexTangent(VertexIn Input)
 {
-    // Complete projection by doing division by w.
-    shadowPosH.xyz /= shadowPosH.w;
+#ifdef COMPACT_VERTEX
+    return OctahedralDecode(Input.tangentL);
+#else
+    return Input.tangentL;
+#endif
+}
 
-    // Depth in NDC space.
-    float depth = shadowPosH.z;
 
-    uint width, height, numMips;
-    ShadowMap.GetDimensions(0, width, height, numMips);
 
-    // Texel size.
-    float dx = 1.0f / (float) width;
+
+float SampleShadowCascade(float3 shadowPos, uint cascade, float dx)
+{
     float percentLit = 0.0f;
     const float2 offsets[9] =
     {
@@ -80,8 +140,29 @@ float CalcShadowFactor(float4 shadowPosH)
     for (int i = 0; i < 9; ++i)
     {
         percentLit += ShadowMap.SampleCmpLevelZero(gsamShadow,
-            shadowPosH.xy + offsets[i], depth).r;
+            float3(shadowPos.xy + offsets[i], cascade), shadowPos.z).r;
     }
     return percentLit / 9.0f;
 }
 
+float CalcShadowFactor(float3 worldPos)
+{
+    uint width, height, elements, numMips;
+    ShadowMap.GetDimensions(0, width, height, elements, numMips);
+
+    // Texel size.
+    float dx = 1.0f / (float) width;
+
+    // Map based cascade selection: the finest cascade whose projection contains the point, keeping
+    // the PCF kernel inside the map. It does not depend on the camera, so the cube map faces can
+    // sample the cascades fitted to the main view.
+    [loop]
+    for (uint cascade = 0; cascade < CascadeCount; ++cascade)
+    {
+        float4 shadowPosH = mul(float4(worldPos, 1.0f), ShadowTransforms[cascade]);
+        float3 shadowPos = shadowPosH.xyz / shadowPosH.w;
+        if (all(abs(shadowPos.xy - 0.5f) < 0.5f - dx) && shadowPos.z < 1.0f)
+            return SampleShadowCascade(shadowPos, cascade, dx);
+    }
+    return 1.0f;
+}
@@ -1,13 +1,5 @@
 #include "CommonBuffer.hlsl"
 
-struct VertexIn
-{
-    float3 lPosition : POSITION;
-    float2 texCoord  : TEXCOORD;
-    float3 normalL   : NORMAL;
-    float3 tangentL  : TANGENT;
-};
-
 struct VertexOut
 {
     float4 hPosition : SV_POSITION;
@@ -15,17 +7,18 @@ struct VertexOut
 };
 
 
-VertexOut VS(VertexIn Input)
+VertexOut VS(VertexIn Input, uint InstanceId : SV_InstanceID)
 {
     VertexOut Output;
     Output.texCoord = Input.texCoord;
-    Output.hPosition = float4(Input.lPosition, 1.0f);
+    // The quad is already in clip space, its world only dequantizes compact positions
+    Output.hPosition = float4(mul(float4(Input.lPosition, 1.0f), GetInstanceData(InstanceId).World).xyz, 1.0f);
     return Output;
 }
 
 float4 PS(VertexOut VOutput)   : SV_TARGET
 {
-    return float4(ShadowMap.Sample(gsamLinearWrap, VOutput.texCoord).rrr,1);
+    return float4(ShadowMap.Sample(gsamLinearWrap, float3(VOutput.texCoord, 0)).rrr,1);
 
 }
 
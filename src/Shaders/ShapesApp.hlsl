@@ -1,45 +1,44 @@
 
 #include "CommonBuffer.hlsl"
 
-struct VertexIn
-{
-    float3 lPosition : POSITION;
-    float2 texCoord  : TEXCOORD;
-    float3 normalL   : NORMAL;
-    float3 tangentL  : TANGENT;
-};
-
 struct VertexOut
 {
     float4 hPosition : SV_POSITION;
     float3 wPosition : POSITION0;
-    float4 hShadowPosition : POSITION1;
     float2 texCoord  : TEXCOORD;
     float3 normalW   : NORMAL;
     float3 tangentW  : TANGENT;
+    nointerpolation uint materialIndex : MATINDEX;
+    nointerpolation uint2 probeIndices : PROBEINDEX;
+    nointerpolation float probeBlend : PROBEBLEND;
 };
 
 
-VertexOut VS(VertexIn Input)
+VertexOut VS(VertexIn Input, uint InstanceId : SV_InstanceID)
 {
     VertexOut Output;
+    InstanceData Instance = GetInstanceData(InstanceId);
+    float4x4 World = Instance.World;
     float4 WorldPos = mul(float4(Input.lPosition, 1.0f), World);
     Output.hPosition = mul(WorldPos, ViewProj);
     Output.wPosition = WorldPos.xyz;
     Output.texCoord = Input.texCoord;
-    Output.normalW = normalize(mul(Input.normalL, (float3x3) World));
-    Output.tangentW = normalize(mul(Input.tangentL, (float3x3) World));
-    Output.hShadowPosition = mul(WorldPos, ShadowTransform);
+    Output.normalW = normalize(mul(GetVertexNormal(Input), (float3x3) World));
+    Output.tangentW = normalize(mul(GetVertexTangent(Input), (float3x3) World));
+    Output.materialIndex = Instance.MaterialIndex;
+    Output.probeIndices = Instance.ProbeIndices;
+    Output.probeBlend = Instance.ProbeBlend;
     
     return Output;
 }
 
 float4 PS(VertexOut VOutput)    : SV_TARGET
 {
+    MaterialData MatData = gMaterialData[VOutput.materialIndex];
     float4 ambientLight = float4(0.1f, 0.1f, 0.1f, 1.0f);
-    float4 mDiffuseAlbedo = DiffuseAlbedo;
-    mDiffuseAlbedo *= gTextureMaps[DiffuseTexIndex].Sample(gsamAnisotropicWrap, (VOutput.texCoord*UvTileValue));
-    float4 NormalMapCoord = gTextureMaps[NormalTexIndex].Sample(gsamAnisotropicWrap, (VOutput.texCoord*UvTileValue));
+    float4 mDiffuseAlbedo = MatData.DiffuseAlbedo;
+    mDiffuseAlbedo *= gTextureMaps[MatData.DiffuseTexIndex].Sample(gsamAnisotropicWrap, (VOutput.texCoord * MatData.UvTileValue));
+    float4 NormalMapCoord = gTextureMaps[MatData.NormalTexIndex].Sample(gsamAnisotropicWrap, (VOutput.texCoord * MatData.UvTileValue));
     
     float3 NormalW = normalize(VOutput.normalW);
     float3 BumpedNormalWPos = NormalSampleToWorldPos(NormalMapCoord.rgb, NormalW, VOutput.tangentW);
@@ -49,11 +48,11 @@ float4 PS(VertexOut VOutput)    : SV_TARGET
     float4 ambient = ambientLight * mDiffuseAlbedo;
     
     float3 ToEye = normalize(Eye - VOutput.wPosition);
-    float Shine = Shininess * NormalMapCoord.a;
-    Material Mat = { mDiffuseAlbedo, FresnelR0, Shine };
+    float Shine = MatData.Shininess * NormalMapCoord.a;
+    Material Mat = { mDiffuseAlbedo, MatData.FresnelR0, Shine };
     float3 ShadowFactor = float3(1, 1, 1);
     
-    ShadowFactor[0] = CalcShadowFactor(VOutput.hShadowPosition);
+    ShadowFactor[0] = CalcShadowFactor(VOutput.wPosition);
     
     float4 DirectLight = ComputeLighting(TotalLights, Mat, VOutput.wPosition, BumpedNormalWPos, ToEye, ShadowFactor);
     
@@ -63,8 +62,13 @@ float4 PS(VertexOut VOutput)    : SV_TARGET
     //Speclular Reflectiom
     float3 EyeToPixel = -ToEye;
     float3 ReflectedRay = reflect(EyeToPixel, NormalW);
+#ifdef PROBE_REFLECTIONS
+    float3 ReflectionColor = lerp(ProbeCubes.Sample(gsamLinearWrap, float4(ReflectedRay, VOutput.probeIndices.x)).rgb,
+        ProbeCubes.Sample(gsamLinearWrap, float4(ReflectedRay, VOutput.probeIndices.y)).rgb, VOutput.probeBlend);
+#else
     float3 ReflectionColor = TexSkyBox.Sample(gsamLinearWrap, ReflectedRay).rgb;
-    float3 FresnelEffect = SchlickFresnel(FresnelR0, NormalW, ReflectedRay);
+#endif
+    float3 FresnelEffect = SchlickFresnel(MatData.FresnelR0, NormalW, ReflectedRay);
     LightColor.rgb += Shine * FresnelEffect * ReflectionColor;
     
     LightColor.a = mDiffuseAlbedo.a;
@@ -1,40 +1,34 @@
 
 #include "CommonBuffer.hlsl"
 
-struct VertexIn
-{
-    float3 lPosition : POSITION;
-    float2 texCoord  : TEXCOORD;
-    float3 normalL   : NORMAL;
-    float3 tangentL  : TANGENT;
-};
-
 struct VertexOut
 {
     float4 hPosition : SV_POSITION;
-    float3 lPosition : POSITION;
+    float3 sampleDir : POSITION;
     float2 texCoord  : TEXCOORD;
     float3 normalW   : NORMAL;
     float3 tangentW  : TANGENT;
 };
 
-VertexOut VS(VertexIn Input)
+VertexOut VS(VertexIn Input, uint InstanceId : SV_InstanceID)
 {
     VertexOut Output;
+    float4x4 World = GetInstanceData(InstanceId).World;
     float4 WorldPos = mul(float4(Input.lPosition, 1.0f), World);
+    // The cube map is sampled with WorldPos - Eye: compact vertices are quantized and only World dequantizes them
+    Output.sampleDir = WorldPos.xyz;
     WorldPos.xyz += Eye;
     Output.hPosition = mul(WorldPos, ViewProj).xyww;
-    Output.lPosition = Input.lPosition;
     
     Output.texCoord = Input.texCoord;
-    Output.normalW = normalize(mul(Input.normalL, (float3x3) World));
-    Output.tangentW = normalize(mul(Input.tangentL, (float3x3) World));
+    Output.normalW = normalize(mul(GetVertexNormal(Input), (float3x3) World));
+    Output.tangentW = normalize(mul(GetVertexTangent(Input), (float3x3) World));
     return Output;
 }
 
 float4 PS(VertexOut VOutput)    : SV_TARGET
 {
-    float4 BaseAlbedo = TexSkyBox.Sample(gsamLinearWrap, VOutput.lPosition);
+    float4 BaseAlbedo = TexSkyBox.Sample(gsamLinearWrap, VOutput.sampleDir);
     return BaseAlbedo;
 
 }
@@ -6,8 +6,15 @@
 #include <filesystem>
 #include "Utility/GeometryGenerator.h"
 #include "Base/CubeMapRT.h"
+#include "Utility/ParallelFor.h"
+#include <chrono>
+#include <psapi.h>
 
 const int gNumFrameResources = 3;
+// Submeshes of imported models with at least this many triangles are split into meshlets for ClusterCuller
+const size_t gMinClusterTriangles = 4096;
+// Cluster culled draws written as indirect arguments per frame, further draws are issued directly
+const UINT gMaxClusterDraws = 4096;
 
 
 void ConvertToDDsTexturesOnStartup()
@@ -40,14 +47,54 @@ void ConvertToDDsTexturesOnStartup()
 	std::cout << "===== CONVERSION COMPLETE =====" << std::endl;
 }
 
+void ReportMeshOptimization(const std::string& aName, const MeshOptimizer::Stats& aStats)
+{
+	char Message[256];
+	snprintf(Message, sizeof(Message), "%s optimized: %zu triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", aName.c_str(),
+		aStats.After.Triangles, aStats.Before.GetAcmr(), aStats.After.GetAcmr(), aStats.Before.GetAtvr(), aStats.After.GetAtvr());
+	::OutputDebugStringA(Message);
+}
+
+std::string GetMeshCachePath(const std::string& aGeometryName)
+{
+	return "Assets\\Cooked\\" + aGeometryName + ".dxmesh";
+}
+
+// Everything besides the source file that changes the cooked mesh: LoadModel flags, the mesh optimization and meshlets
+std::uint64_t HashImportSettings(bool aFlipUVs, bool aGenerateNormals, bool aFlipWindingOrder, const MeshOptimizer::Settings& aSettings)
+{
+	std::uint64_t Hash = MeshCache::HashValue(MeshCache::Version);
+	Hash = MeshCache::HashValue(gMinClusterTriangles, Hash);
+	Hash = MeshCache::HashValue(aFlipUVs, Hash);
+	Hash = MeshCache::HashValue(aGenerateNormals, Hash);
+	Hash = MeshCache::HashValue(aFlipWindingOrder, Hash);
+	Hash = MeshCache::HashValue(aSettings.CacheSize, Hash);
+	Hash = MeshCache::HashValue(aSettings.OverdrawThreshold, Hash);
+	Hash = MeshCache::HashValue(aSettings.bOptimizeOverdraw, Hash);
+	return MeshCache::HashValue(aSettings.bOptimizeVertexFetch, Hash);
+}
+
+// Settings of a generated LOD level, chained to the settings of the model it is simplified from
+std::uint64_t HashLodSettings(std::uint64_t aModelSettingsHash, float aTriangleRatio, const MeshSimplifier::Settings& aSettings)
+{
+	std::uint64_t Hash = MeshCache::HashValue(aTriangleRatio, aModelSettingsHash);
+	Hash = MeshCache::HashValue(aSettings.NormalWeight, Hash);
+	Hash = MeshCache::HashValue(aSettings.bLockBorders, Hash);
+	return MeshCache::HashValue(aSettings.BorderWeight, Hash);
+}
+
+void ReportMeshLoadTime(const std::string& aName, bool bFromCache, std::chrono::steady_clock::time_point aStartTime)
+{
+	double Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - aStartTime).count();
+	char Message[256];
+	snprintf(Message, sizeof(Message), "%s %s in %.2f ms\n", aName.c_str(), bFromCache ? "loaded from cache" : "imported", Milliseconds);
+	::OutputDebugStringA(Message);
+}
+
 ShapesApp::ShapesApp(HINSTANCE ScreenInstance) : DxRenderBase(ScreenInstance), SkyBox{ "Tex_snowcube1024" }
 , bDebugShadowMap{ false }
 {
 	ViewCamera = std::make_unique<Camera>();
-	for (int i = 0; i < 6; i++)
-	{
-		CubeMapCameras[i] = std::make_unique<Camera>();
-	}
 }
 
 ShapesApp::~ShapesApp()
@@ -64,7 +111,7 @@ void ShapesApp::ProcessKeyboardInput(float DeltaTime)
 	float ObjRotateSpeed = 1 * DeltaTime;
 	float ObjScaleSpeed = 1.0f + (2.0f * DeltaTime);  
 
-	if (bLeftMouseDown && PickedRenderItem)
+	if (bLeftMouseDown && PickedRenderItem != SceneStore::InvalidItem)
 	{
 		if (GetAsyncKeyState('W') & 0x8000)
 			MovePickedObj(0, 0, ObjDragSpeed,false);
@@ -164,7 +211,7 @@ void ShapesApp::OnMouseMove(WPARAM BtnState, int X, int Y)
 
 void ShapesApp::Pick(int X, int Y)
 {
-	PickedRenderItem = nullptr;
+	PickedRenderItem = SceneStore::InvalidItem;
 	//Convert to NDC
 	float Xndc = (2.0f * X / ScreenWidth) - 1;
 	float Yndc = 1 - (2.0f * Y / ScreenHeight);
@@ -181,81 +228,93 @@ void ShapesApp::Pick(int X, int Y)
 	DirectX::XMVECTOR ViewDet = DirectX::XMMatrixDeterminant(View);
 	auto InvView = DirectX::XMMatrixInverse(&ViewDet, View);
 
-	auto& OpaqRItems = RenderLayerItems[(int)RenderLayer::Opaque];
-	auto& RefRItems = RenderLayerItems[(int)RenderLayer::Reflection];
-	std::vector<RenderItem*> AllowedRenderItems;
+	DirectX::XMFLOAT3 RayOrigin, RayDirection;
+	DirectX::XMStoreFloat3(&RayOrigin, DirectX::XMVector3TransformCoord(CamRayOrigin, InvView));
+	DirectX::XMStoreFloat3(&RayDirection, DirectX::XMVector3TransformNormal(CamRayDir, InvView));
 
-	AllowedRenderItems.reserve(OpaqRItems.size() + RefRItems.size() );
-	AllowedRenderItems.insert(AllowedRenderItems.begin(), OpaqRItems.begin(), OpaqRItems.end());
-	AllowedRenderItems.insert(AllowedRenderItems.begin(), RefRItems.begin(), RefRItems.end());
-
-	for (auto RenderItem : AllowedRenderItems)
+	// The scene tree only hands out items whose box the ray enters before the closest triangle hit so far.
+	// The direction is left unnormalized: hit distances are then measured along the view ray in every
+	// item's local space and stay comparable whatever the item's scale.
+	SceneBVH::Ray Ray{ RayOrigin, RayDirection };
+	SceneBVH::RayHit Hit = SceneTree.Raycast(Ray, [&](RenderItemId RenderItem, float& Distance)
 	{
-		auto World4x4 = RenderItem->World;
-		auto World = DirectX::XMLoadFloat4x4(&World4x4);
+		RenderLayer Layer = (RenderLayer)Scene.GetLayer(RenderItem);
+		const TriangleBVH* Bvh = Scene.GetDrawArgs(RenderItem).PickingBvh;
+		if ((Layer != RenderLayer::Opaque && Layer != RenderLayer::Reflection) || !Bvh)
+			return false;
+
+		auto World = DirectX::XMLoadFloat4x4(&Scene.GetWorld(RenderItem));
 		DirectX::XMVECTOR WorldDet = DirectX::XMMatrixDeterminant(World);
 		auto InvWorld = DirectX::XMMatrixInverse(&WorldDet, World);
 
 		DirectX::XMMATRIX ToLocal = DirectX::XMMatrixMultiply(InvView, InvWorld);
-		auto LocalRayOrigin = DirectX::XMVector3TransformCoord(CamRayOrigin, ToLocal);
-		auto LocalRayDir = DirectX::XMVector3TransformNormal(CamRayDir, ToLocal);
-		LocalRayDir = DirectX::XMVector3Normalize(LocalRayDir);
-
-		float Dist = 0.0f;
-		if (RenderItem->Bounds.Intersects(LocalRayOrigin, LocalRayDir, Dist))
-		{
-			auto VertexData = (Vertex*)RenderItem->MeshGeometryRef->VertexBufferCPU->GetBufferPointer();
-			auto IndexData = (GeometryGenerator::uint16*)RenderItem->MeshGeometryRef->IndexBufferCPU->GetBufferPointer();
-			auto Indices = IndexData + RenderItem->IndexStartLocation;
-			auto TotalIndices = RenderItem->IndexCount;
-			UINT TrisCount = TotalIndices / 3;
-
-			for (int i = 0; i < TrisCount; i++)
-			{
-				GeometryGenerator::uint16 Index0 = Indices[i * 3 + 0 + RenderItem->VertexStartLocation];
-				GeometryGenerator::uint16 Index1 = Indices[i * 3 + 1 + RenderItem->VertexStartLocation];
-				GeometryGenerator::uint16 Index2 = Indices[i * 3 + 2 + RenderItem->VertexStartLocation];
-
-				auto vPos0 = VertexData[Index0].Position;
-				auto vPos1 = VertexData[Index1].Position;
-				auto vPos2 = VertexData[Index2].Position;
-				DirectX::XMVECTOR Pos0 = DirectX::XMLoadFloat3(&vPos0);
-				DirectX::XMVECTOR Pos1 = DirectX::XMLoadFloat3(&vPos1);
-				DirectX::XMVECTOR Pos2 = DirectX::XMLoadFloat3(&vPos2);
-
-				float Dist2 = 0.0f;
-				if (DirectX::TriangleTests::Intersects(LocalRayOrigin, LocalRayDir, Pos0, Pos1, Pos2, Dist2))
-				{
-					PickedRenderItem = RenderItem;
-					::OutputDebugStringA("Picked");
-					return;
-				}
-			}
-		}
-
-	}
-
+		DirectX::XMFLOAT3 Origin, Direction;
+		DirectX::XMStoreFloat3(&Origin, DirectX::XMVector3TransformCoord(CamRayOrigin, ToLocal));
+		DirectX::XMStoreFloat3(&Direction, DirectX::XMVector3TransformNormal(CamRayDir, ToLocal));
+		TriangleBVH::Hit TriangleHit;
+		if (!Bvh->Intersect(Origin, Direction, TriangleHit, Distance))
+			return false;
+		Distance = TriangleHit.Distance;
+		return true;
+	});
+
+	PickedRenderItem = Hit.Item;
+	if (PickedRenderItem != SceneStore::InvalidItem)
+		::OutputDebugStringA("Picked");
 }
 
 void ShapesApp::MovePickedObj(float X, float Y, float Z, bool bInLocalSpace)
 {
-	if (!PickedRenderItem)	return;
+	if (PickedRenderItem == SceneStore::InvalidItem)	return;
 
-	auto RiWorldTransform = DirectX::XMLoadFloat4x4(&PickedRenderItem->World);
+	auto RiWorldTransform = DirectX::XMLoadFloat4x4(&Scene.GetWorld(PickedRenderItem));
 	DirectX::XMMATRIX Translation;
 	if (bInLocalSpace)
 		Translation = DirectX::XMMatrixMultiply(DirectX::XMMatrixTranslation(X, Y, Z), RiWorldTransform);
 	else  //In World Space
 		Translation = DirectX::XMMatrixMultiply(RiWorldTransform, DirectX::XMMatrixTranslation(X, Y, Z));
 
-	DirectX::XMStoreFloat4x4(&PickedRenderItem->World, Translation);
+	DirectX::XMFLOAT4X4 NewWorld;
+	DirectX::XMStoreFloat4x4(&NewWorld, Translation);
+	MakeItemDynamic(PickedRenderItem);
+	SetItemWorld(PickedRenderItem, NewWorld);
+
+}
+
+void ShapesApp::SetItemWorld(RenderItemId aId, const DirectX::XMFLOAT4X4& aWorld)
+{
+	DirectX::BoundingBox OldBounds = Scene.GetWorldBounds(aId);
+	Scene.SetWorld(aId, aWorld);
+	DirectX::BoundingBox NewBounds = Scene.GetWorldBounds(aId);
+	SceneTree.Update(aId, NewBounds);
+	if (Scene.GetLayer(aId) != (UINT)RenderLayer::Opaque)
+		return;
+
+	// Only the texels under the old and the new bounds of a static caster have to be re-rendered
+	if (!Scene.IsDynamic(aId))
+	{
+		StaticShadowCache.InvalidateBounds(OldBounds);
+		StaticShadowCache.InvalidateBounds(NewBounds);
+	}
+	// Same for the probe faces seeing the item
+	Probes.InvalidateBounds(OldBounds);
+	Probes.InvalidateBounds(NewBounds);
+}
 
+void ShapesApp::MakeItemDynamic(RenderItemId aId)
+{
+	if (Scene.IsDynamic(aId))
+		return;
+	// Its depth is still baked into the static layer, the re-render of that region leaves it out
+	if (Scene.GetLayer(aId) == (UINT)RenderLayer::Opaque)
+		StaticShadowCache.InvalidateBounds(Scene.GetWorldBounds(aId));
+	Scene.SetDynamic(aId, true);
 }
 
 void ShapesApp::RotatePickedObj(float Pitch, float Yaw, float Roll)
 {
-	if (!PickedRenderItem)	return;
-	auto RiWorldTransform = DirectX::XMLoadFloat4x4(&PickedRenderItem->World);
+	if (PickedRenderItem == SceneStore::InvalidItem)	return;
+	auto RiWorldTransform = DirectX::XMLoadFloat4x4(&Scene.GetWorld(PickedRenderItem));
 	DirectX::XMMATRIX Rotation;
 	DirectX::XMMATRIX Result;
 	DirectX::XMVECTOR CachedPosition = RiWorldTransform.r[3];
@@ -265,14 +324,17 @@ void ShapesApp::RotatePickedObj(float Pitch, float Yaw, float Roll)
 	Result = DirectX::XMMatrixMultiply(RiWorldTransform, Rotation);
 	Result.r[3] = CachedPosition;
 
-	DirectX::XMStoreFloat4x4(&PickedRenderItem->World, Result);
+	DirectX::XMFLOAT4X4 NewWorld;
+	DirectX::XMStoreFloat4x4(&NewWorld, Result);
+	MakeItemDynamic(PickedRenderItem);
+	SetItemWorld(PickedRenderItem, NewWorld);
 }
 
 void ShapesApp::ScalePickedObj(float ScaleX, float ScaleY, float ScaleZ)
 {
-	if (!PickedRenderItem)	return;
+	if (PickedRenderItem == SceneStore::InvalidItem)	return;
 
-	auto RiWorldTransform = DirectX::XMLoadFloat4x4(&PickedRenderItem->World);
+	auto RiWorldTransform = DirectX::XMLoadFloat4x4(&Scene.GetWorld(PickedRenderItem));
 
 	// Decompose the current world matrix into scale, rotation, and translation
 	DirectX::XMVECTOR currentScale;
@@ -289,25 +351,29 @@ void ShapesApp::ScalePickedObj(float ScaleX, float ScaleY, float ScaleZ)
 		DirectX::XMMatrixRotationQuaternion(currentRotation) *
 		DirectX::XMMatrixTranslationFromVector(currentTranslation);
 
-	DirectX::XMStoreFloat4x4(&PickedRenderItem->World, Result);
+	DirectX::XMFLOAT4X4 NewWorld;
+	DirectX::XMStoreFloat4x4(&NewWorld, Result);
+	MakeItemDynamic(PickedRenderItem);
+	SetItemWorld(PickedRenderItem, NewWorld);
 }
 
 void ShapesApp::OnResize()
 {
 	DxRenderBase::OnResize();
 	ViewCamera->SetLens(0.25f * DirectX::XM_PI, AspectRatio(), 0.1f, 1000.0f);
+	Occluders.Resize(OcclusionBufferWidth, std::max(1u, static_cast<UINT>(OcclusionBufferWidth / AspectRatio())));
 }
 
 void ShapesApp::CreateRtvDsvHeap()
 {
 	D3D12_DESCRIPTOR_HEAP_DESC RtvHeapDesc;
-	RtvHeapDesc.NumDescriptors = SwapChainBuffferCount + 6; //Main buffers + CubeMap faces
+	RtvHeapDesc.NumDescriptors = SwapChainBuffferCount + 6 * MAX_REFLECTION_PROBES; //Main buffers + CubeMap faces of every probe
 	RtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
 	RtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 	RtvHeapDesc.NodeMask = 0;
 	ThrowIfFailed(DxDevice3D->CreateDescriptorHeap(&RtvHeapDesc, IID_PPV_ARGS(&RtvHeap)));
 	D3D12_DESCRIPTOR_HEAP_DESC DsvHeapDesc;
-	DsvHeapDesc.NumDescriptors = 3;  // Main depth buffer + Shadow + CubeMap
+	DsvHeapDesc.NumDescriptors = 2 + 2 * CascadedShadows::MaxCascades;  // Main depth buffer + Shadow cascades + Static shadow cascades + CubeMap
 	DsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
 	DsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 	DsvHeapDesc.NodeMask = 0;
@@ -321,27 +387,44 @@ bool ShapesApp::Initialize()
 		return false;
 	ConvertToDDsTexturesOnStartup();
 	InitCamera();
-	InitCubeMapCameras(0, 0, 0);
+	LoadReflectionProbes("ReflectionProbes.txt");
+	std::vector<ProbeLookup::Probe> LookupProbes;
+	for (UINT i = 0; i < (UINT)ReflectionProbes.size(); i++)
+	{
+		const ProbeSettings& Probe = ReflectionProbes[i];
+		InitCubeMapCameras(i);
+		ProbeScheduler::ProbeDesc ReflectionProbeDesc;
+		ReflectionProbeDesc.Center = Probe.Center;
+		ReflectionProbeDesc.InfluenceRadius = Probe.InfluenceRadius;
+		ReflectionProbeDesc.Policy = Probe.Policy;
+		ReflectionProbeDesc.FacesPerFrame = Probe.FacesPerFrame;
+		Probes.AddProbe(ReflectionProbeDesc);
+		LookupProbes.push_back({ Probe.Center, Probe.InfluenceRadius > 0.0f ? Probe.InfluenceRadius : Probe.FarZ });
+	}
+	Probes.SetFaceBudget(ProbeFaceBudget);
+	ReflectionProbeLookup.Build(LookupProbes);
 
-	UINT DepthTextureWidth = 2048;
-	UINT DepthTextureHeight = 2048;
-	ShadowMapObj = std::make_unique<ShadowMap>(DxDevice3D.Get(), DepthTextureWidth, DepthTextureHeight);
+	UINT DepthTextureSize = ShadowCascades.GetSettings().Resolution;
+	ShadowMapObj = std::make_unique<ShadowMap>(DxDevice3D.Get(), GpuMemory.get(), DepthTextureSize, DepthTextureSize, CascadedShadows::MaxCascades);
+	StaticShadowMapObj = std::make_unique<ShadowMap>(DxDevice3D.Get(), GpuMemory.get(), DepthTextureSize, DepthTextureSize, CascadedShadows::MaxCascades);
+	StaticShadowCache.Resize(CascadedShadows::MaxCascades, DepthTextureSize);
 	UINT CubeMapWidth = 512;
 	UINT CubeMapHeight = 512;
-	CubeMapObj = std::make_unique<CubeMapRT>(DxDevice3D.Get(), CubeMapWidth, CubeMapHeight, BackBufferFormat, DepthStencilFormat);
-
-	SceneSphereBound.Center = DirectX::XMFLOAT3(0.0f, -1.5f, 0.0f);
-	SceneSphereBound.Radius = 10.0f;
+	CubeMapObj = std::make_unique<CubeMapRT>(DxDevice3D.Get(), GpuMemory.get(), CubeMapWidth, CubeMapHeight, BackBufferFormat, DepthStencilFormat,
+		(UINT)ReflectionProbes.size());
 
 	ThrowIfFailed(CommandList->Reset(CommandAlloc.Get(), nullptr));
 	BuildRootSignature();
 	BuildShadersAndInputLayout();
 	BuildDescriptorHeap();
 
+	SharedGeometry = std::make_unique<GeometryPool>(GpuMemory.get());
 	BuildGeometryResource();
 	BuildTextures();
 	BuildDescriptors();
 	BuildRenderItems();
+	// Items were inserted one by one, a full SAH build gives a better tree
+	SceneTree.Build(Scene.GetAllWorldBounds());
 	LoadRenderItemsData();
 
 	BuildFrameResources();
@@ -352,6 +435,14 @@ bool ShapesApp::Initialize()
 	CommandQueue->ExecuteCommandLists(_countof(Commands), Commands);
 
 	FlushCommandQueue();
+	// The staging buffers of the geometry uploads are done
+	SharedGeometry->MarkSubmitted(CurrentFenceValue);
+	SharedGeometry->ReleaseCompleted(CurrentFenceValue);
+	// So are the texture uploads, their ranges go back to the upload heaps
+	for (auto& [Name, Tex] : Textures)
+		Tex->UploadHeap = nullptr;
+	GpuMemory->TrimEmptyBlocks();
+	GpuMemory->ReportStats();
 	return true;
 }
 
@@ -365,11 +456,46 @@ void ShapesApp::InitCamera()
 	ViewCamera->UpdateViewMatrix();
 }
 
-void ShapesApp::InitCubeMapCameras(float CenterX, float CenterY, float CenterZ)
+void ShapesApp::LoadReflectionProbes(const std::string& aPath)
+{
+	ReflectionProbes.clear();
+	std::ifstream IfileStream(aPath);
+	std::string StringLine;
+	while (IfileStream.is_open() && std::getline(IfileStream, StringLine))
+	{
+		if (StringLine.empty() || StringLine[0] == '#')
+			continue;
+
+		std::istringstream IStringStream(StringLine);
+		std::string ProbeName;
+		ProbeSettings Probe;
+		if (!(IStringStream >> ProbeName >> Probe.Center.x >> Probe.Center.y >> Probe.Center.z >> Probe.InfluenceRadius))
+		{
+			std::string ErrorMsg = "[Warning] Skipped malformed reflection probe line: " + StringLine + "\n";
+			::OutputDebugStringA(ErrorMsg.c_str());
+			continue;
+		}
+		if (ReflectionProbes.size() == MAX_REFLECTION_PROBES)
+		{
+			::OutputDebugStringA("[Warning] Too many reflection probes, the remaining ones are ignored\n");
+			break;
+		}
+		ReflectionProbes.push_back(Probe);
+	}
+
+	if (ReflectionProbes.empty())
+		ReflectionProbes.push_back(ProbeSettings{});
+	CubeMapCameras.resize(ReflectionProbes.size() * 6);
+	for (auto& CubeMapCamera : CubeMapCameras)
+		CubeMapCamera = std::make_unique<Camera>();
+}
+
+void ShapesApp::InitCubeMapCameras(UINT aProbe)
 {
-	float PositionX{ CenterX };
-	float PositionY{ CenterY };
-	float PositionZ{ CenterZ };
+	const ProbeSettings& Probe = ReflectionProbes[aProbe];
+	float PositionX{ Probe.Center.x };
+	float PositionY{ Probe.Center.y };
+	float PositionZ{ Probe.Center.z };
 	DirectX::XMFLOAT3 Position{ PositionX, PositionY, PositionZ };
 	DirectX::XMFLOAT3 Target;
 	DirectX::XMFLOAT3 Up;
@@ -395,10 +521,11 @@ void ShapesApp::InitCubeMapCameras(float CenterX, float CenterY, float CenterZ)
 
 	for (int i = 0; i < 6; i++)
 	{
-		CubeMapCameras[i]->SetPosition(Position);
-		CubeMapCameras[i]->LookAt(CubeMapCameras[i]->GetPosition3f(), Targets[i], Ups[i]);
-		CubeMapCameras[i]->SetLens(0.5f * DirectX::XM_PI, 1.0f, 0.1f, 1000.0f);  // 90 degrees FOV for seamless cube mapping
-		CubeMapCameras[i]->UpdateViewMatrix();
+		Camera* FaceCamera = CubeMapCameras[aProbe * 6 + i].get();
+		FaceCamera->SetPosition(Position);
+		FaceCamera->LookAt(FaceCamera->GetPosition3f(), Targets[i], Ups[i]);
+		FaceCamera->SetLens(0.5f * DirectX::XM_PI, 1.0f, Probe.NearZ, Probe.FarZ);  // 90 degrees FOV for seamless cube mapping
+		FaceCamera->UpdateViewMatrix();
 	}
 }
 
@@ -416,7 +543,7 @@ void ShapesApp::BuildTextures()
 		auto OriginalFileName = Entry.path().stem().string();
 		NewTexture->Name = "Tex_" + OriginalFileName;
 		NewTexture->Filename = Entry.path().wstring();
-		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(DxDevice3D.Get(), CommandList.Get(),
+		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(GpuMemory.get(), CommandList.Get(),
 			NewTexture->Filename.c_str(), NewTexture->Resource, NewTexture->UploadHeap));
 
 		// Set debug names for easier tracking
@@ -468,7 +595,7 @@ void ShapesApp::BuildDescriptors()
 	ShadowSkyMapHeapIndex = DescriptorsSlot;
 	auto ShadowMapCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(HeapStart, DescriptorsSlot++, CbvSrvUavDescriptorSize);
 	auto DepthHeapCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(GetDsvHeapCpuHandle(), 1, DsvDescriptorSize);
-	ShadowMapObj->BuildDescriptors(ShadowMapCpuHandle, DepthHeapCpuHandle);
+	ShadowMapObj->BuildDescriptors(ShadowMapCpuHandle, DepthHeapCpuHandle, DsvDescriptorSize);
 
 	//Skybox
 	auto TextureData = GetTexture(SkyBox);
@@ -483,22 +610,18 @@ void ShapesApp::BuildDescriptors()
 	SkyboxSrvDesc.TextureCube.ResourceMinLODClamp = 0;
 	DxDevice3D->CreateShaderResourceView(TextureData->Resource.Get(), &SkyboxSrvDesc, SKyboxDescHeapHandle);
 
-	//ShadowMap2
-	ShadowCubeMapHeapIndex = DescriptorsSlot;
-	ShadowMapCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(HeapStart, DescriptorsSlot++, CbvSrvUavDescriptorSize);
-	ShadowMapObj->BuildDescriptors(ShadowMapCpuHandle, DepthHeapCpuHandle);
-
-	//CubeMap
+	//Reflection probe CubeMap array, last SRV of the ShadowMap/Skybox table
 	SrvCubeMapHeapIndex = DescriptorsSlot;
 	auto SrvCubeMapCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(HeapStart, DescriptorsSlot++, CbvSrvUavDescriptorSize);
-	auto DepthCubeMpaCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(GetDsvHeapCpuHandle(), 2, DsvDescriptorSize);
-	CD3DX12_CPU_DESCRIPTOR_HANDLE RtvCubeMapCpuHandles[6];
-	for (int i = 0; i < 6; i++)
-	{
-		RtvCubeMapCpuHandles[i] = CD3DX12_CPU_DESCRIPTOR_HANDLE(GetRtvHeapCpuHandle(),
-			SwapChainBuffferCount + i, RtvDescriptorSize);
-	}
-	CubeMapObj->BuildDescriptors(SrvCubeMapCpuHandle, RtvCubeMapCpuHandles, DepthCubeMpaCpuHandle);
+	auto DepthCubeMpaCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(GetDsvHeapCpuHandle(), 1 + 2 * CascadedShadows::MaxCascades, DsvDescriptorSize);
+	auto RtvCubeMapCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(GetRtvHeapCpuHandle(), SwapChainBuffferCount, RtvDescriptorSize);
+	CubeMapObj->BuildDescriptors(SrvCubeMapCpuHandle, RtvCubeMapCpuHandle, RtvDescriptorSize, DepthCubeMpaCpuHandle);
+
+	//Static ShadowMap cache
+	StaticShadowMapHeapIndex = DescriptorsSlot;
+	auto StaticShadowMapCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(HeapStart, DescriptorsSlot++, CbvSrvUavDescriptorSize);
+	auto StaticDepthHeapCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(GetDsvHeapCpuHandle(), 1 + CascadedShadows::MaxCascades, DsvDescriptorSize);
+	StaticShadowMapObj->BuildDescriptors(StaticShadowMapCpuHandle, StaticDepthHeapCpuHandle, DsvDescriptorSize);
 
 	//NullSrv
 	UINT NullSrvSlot = DescriptorsSlot;
@@ -557,6 +680,8 @@ Material* ShapesApp::BuildOrGetMaterial(std::string aMatName, std::string aDiffu
 	NewMaterial->FresnelR0 = DirectX::XMFLOAT3(aFresnalRO, aFresnalRO, aFresnalRO);  // Increase for more Reflection
 	NewMaterial->Shininess = aShininess;
 	NewMaterial->UvTileValue = aUvTileValue;
+	NewMaterial->Name = MaterialName;
+	NewMaterial->MatCBIndex = static_cast<int>(Materials.size());
 	Materials[MaterialName] = move(NewMaterial);
 	return Materials[MaterialName].get();
 }
@@ -634,16 +759,123 @@ void ShapesApp::Update(const GameTime& Gt)
 		WaitForSingleObject(EventHandle, INFINITE);
 		CloseHandle(EventHandle);
 	}
+	SharedGeometry->ReleaseCompleted(Fence->GetCompletedValue());
 
+	UpdateLods();
 	UpdateConstBuffers();
+	ReportFrameStats(Gt.GetDeltaTime());
+}
+
+void ShapesApp::FrameStats::Add(const FrameStats& aOther)
+{
+	ObjectsUploaded += aOther.ObjectsUploaded;
+	MaterialsUploaded += aOther.MaterialsUploaded;
+	DrawCalls += aOther.DrawCalls;
+	InstancesDrawn += aOther.InstancesDrawn;
+	TrianglesDrawn += aOther.TrianglesDrawn;
+	LodSwitches += aOther.LodSwitches;
+	QueuedItems += aOther.QueuedItems;
+	CulledItems += aOther.CulledItems;
+	OcclusionCulledItems += aOther.OcclusionCulledItems;
+	OccluderTriangles += aOther.OccluderTriangles;
+	StateChanges += aOther.StateChanges;
+	StateChangesSaved += aOther.StateChangesSaved;
+	SortMilliseconds += aOther.SortMilliseconds;
+	ShadowCastersSubmitted += aOther.ShadowCastersSubmitted;
+	ShadowCastersLightCulled += aOther.ShadowCastersLightCulled;
+	ShadowCastersReceiverCulled += aOther.ShadowCastersReceiverCulled;
+	StaticShadowSlicesRendered += aOther.StaticShadowSlicesRendered;
+	StaticShadowTexelsRendered += aOther.StaticShadowTexelsRendered;
+	ClustersTested += aOther.ClustersTested;
+	ClustersFrustumCulled += aOther.ClustersFrustumCulled;
+	ClustersBackfaceCulled += aOther.ClustersBackfaceCulled;
+	ClustersSmallCulled += aOther.ClustersSmallCulled;
+	ClusterDraws += aOther.ClusterDraws;
+	for (int i = 0; i < 6; i++)
+	{
+		CubeFaceDrawCalls[i] += aOther.CubeFaceDrawCalls[i];
+		CubeFaceItems[i] += aOther.CubeFaceItems[i];
+	}
+	CubeFacesRendered += aOther.CubeFacesRendered;
+}
+
+void ShapesApp::ReportFrameStats(float DeltaTime)
+{
+	if (!bFrameStats)
+	{
+		CurrentFrameStats = {};
+		return;
+	}
+	AccumulatedFrameStats.Add(CurrentFrameStats);
+	AccumulatedFrameCount++;
+	CurrentFrameStats = {};
+
+	FrameStatsTimer += DeltaTime;
+	if (FrameStatsTimer < 1.0f)
+		return;
+
+	UINT Frames = AccumulatedFrameCount;
+	std::string StatsMsg = "[Stats] Avg per frame over " + std::to_string(Frames) + " frames:";
+	StatsMsg += " ObjUploads=" + std::to_string(AccumulatedFrameStats.ObjectsUploaded / Frames);
+	StatsMsg += " MatUploads=" + std::to_string(AccumulatedFrameStats.MaterialsUploaded / Frames);
+	StatsMsg += " DrawCalls=" + std::to_string(AccumulatedFrameStats.DrawCalls / Frames);
+	StatsMsg += " Instances=" + std::to_string(AccumulatedFrameStats.InstancesDrawn / Frames);
+	StatsMsg += " Triangles=" + std::to_string(AccumulatedFrameStats.TrianglesDrawn / Frames);
+	StatsMsg += " LodSwitches=" + std::to_string(AccumulatedFrameStats.LodSwitches / Frames);
+	StatsMsg += " Queued=" + std::to_string(AccumulatedFrameStats.QueuedItems / Frames);
+	StatsMsg += " Culled=" + std::to_string(AccumulatedFrameStats.CulledItems / Frames);
+	StatsMsg += " Occluded=" + std::to_string(AccumulatedFrameStats.OcclusionCulledItems / Frames);
+	StatsMsg += " OccluderTris=" + std::to_string(AccumulatedFrameStats.OccluderTriangles / Frames);
+	StatsMsg += " StateChanges=" + std::to_string(AccumulatedFrameStats.StateChanges / Frames);
+	StatsMsg += " Saved=" + std::to_string(AccumulatedFrameStats.StateChangesSaved / Frames);
+	StatsMsg += " SortMs=" + std::to_string(AccumulatedFrameStats.SortMilliseconds / Frames);
+	StatsMsg += " ShadowCasters(submitted/light culled/receiver culled)=" + std::to_string(AccumulatedFrameStats.ShadowCastersSubmitted / Frames)
+		+ "/" + std::to_string(AccumulatedFrameStats.ShadowCastersLightCulled / Frames)
+		+ "/" + std::to_string(AccumulatedFrameStats.ShadowCastersReceiverCulled / Frames);
+	StatsMsg += " StaticShadow(slices/texels)=" + std::to_string(AccumulatedFrameStats.StaticShadowSlicesRendered / Frames)
+		+ "/" + std::to_string(AccumulatedFrameStats.StaticShadowTexelsRendered / Frames);
+	StatsMsg += " Clusters(tested/frustum/backface/small culled/draws)=" + std::to_string(AccumulatedFrameStats.ClustersTested / Frames)
+		+ "/" + std::to_string(AccumulatedFrameStats.ClustersFrustumCulled / Frames)
+		+ "/" + std::to_string(AccumulatedFrameStats.ClustersBackfaceCulled / Frames)
+		+ "/" + std::to_string(AccumulatedFrameStats.ClustersSmallCulled / Frames)
+		+ "/" + std::to_string(AccumulatedFrameStats.ClusterDraws / Frames);
+	GeometryPool::Stats PoolStats = SharedGeometry->GetStats();
+	StatsMsg += " GeometryPool(buffers/geometries/used KB/capacity KB/free ranges/max fragmentation)=" + std::to_string(PoolStats.BufferCount)
+		+ "/" + std::to_string(PoolStats.GeometryCount)
+		+ "/" + std::to_string(PoolStats.UsedBytes / 1024)
+		+ "/" + std::to_string(PoolStats.CapacityBytes / 1024)
+		+ "/" + std::to_string(PoolStats.FreeRanges)
+		+ "/" + std::to_string(PoolStats.MaxFragmentation);
+	GpuMemoryAllocator::Stats MemoryStats = GpuMemory->GetTotalStats();
+	GpuMemoryAllocator::Budget LocalBudget = GpuMemory->QueryBudget(DXGI_MEMORY_SEGMENT_GROUP_LOCAL);
+	StatsMsg += " GpuMemory(blocks/placed MB/block MB/dedicated MB/max fragmentation/local usage MB/local budget MB)="
+		+ std::to_string(MemoryStats.BlockCount)
+		+ "/" + std::to_string(MemoryStats.AllocatedBytes >> 20)
+		+ "/" + std::to_string(MemoryStats.BlockBytes >> 20)
+		+ "/" + std::to_string(MemoryStats.DedicatedBytes >> 20)
+		+ "/" + std::to_string(MemoryStats.Fragmentation)
+		+ "/" + std::to_string(LocalBudget.CurrentUsageBytes >> 20)
+		+ "/" + std::to_string(LocalBudget.BudgetBytes >> 20);
+	StatsMsg += " CubeFacesRendered=" + std::to_string((float)AccumulatedFrameStats.CubeFacesRendered / Frames);
+	StatsMsg += " CubeFaces(draws/items)=";
+	for (int i = 0; i < 6; i++)
+	{
+		StatsMsg += std::to_string(AccumulatedFrameStats.CubeFaceDrawCalls[i] / Frames) + "/"
+			+ std::to_string(AccumulatedFrameStats.CubeFaceItems[i] / Frames) + (i < 5 ? "," : "");
+	}
+	StatsMsg += " (Items=" + std::to_string(Scene.GetItemCount()) + ")\n";
+	::OutputDebugStringA(StatsMsg.c_str());
+
+	AccumulatedFrameStats = {};
+	AccumulatedFrameCount = 0;
+	FrameStatsTimer = 0.0f;
 }
 
 void ShapesApp::UpdateConstBuffers()
 {
 	auto PassConstBufferRes = GetCurrentFrameResource()->PassConstBufferRes.get();
-	auto ObjConstBufferRes = GetCurrentFrameResource()->ObjConstBufferRes.get();
-	auto MatConstBufferRes = GetCurrentFrameResource()->MatConstBufferRes.get();
-	int ObjConstBufferIndex = 0;
+	auto InstanceBufferRes = GetCurrentFrameResource()->InstanceBufferRes.get();
+	auto MaterialBufferRes = GetCurrentFrameResource()->MaterialBufferRes.get();
 
 
 	DirectX::XMMATRIX XView = ViewCamera->GetView();
@@ -670,109 +902,249 @@ void ShapesApp::UpdateConstBuffers()
 
 
 
-	DirectX::XMVECTOR LightDir = DirectX::XMLoadFloat3(&PassConstBufferData.Lights[0].Direction);
-	DirectX::XMVECTOR LightPos = DirectX::XMVectorScale(LightDir, -2 * SceneSphereBound.Radius);
-	DirectX::XMVECTOR FocusPt = DirectX::XMVectorZero();
-	DirectX::XMVECTOR UpDir = DirectX::XMVectorSet(0, 1, 0, 0);
-	XView = DirectX::XMMatrixLookAtLH(LightPos, FocusPt, UpDir);
-	DirectX::XMFLOAT3 LightSpacePos;
-	DirectX::XMStoreFloat3(&LightSpacePos, DirectX::XMVector3TransformCoord(FocusPt, XView));
-	float Left = LightSpacePos.x - SceneSphereBound.Radius;
-	float Right = LightSpacePos.x + SceneSphereBound.Radius;
-	float Top = LightSpacePos.y + SceneSphereBound.Radius;
-	float Bottom = LightSpacePos.y - SceneSphereBound.Radius;
-	float Near = LightSpacePos.z - SceneSphereBound.Radius;
-	float Far = LightSpacePos.z + SceneSphereBound.Radius;
-	XProj = DirectX::XMMatrixOrthographicOffCenterLH(Left, Right, Bottom, Top, Near, Far);
-	XViewProj = DirectX::XMMatrixMultiply(XView, XProj);
-	DirectX::XMStoreFloat3(&EyePos, LightPos);
-	DirectX::XMMATRIX T(		// Transform NDC space [-1,+1]^2 to texture space [0,1]^2
-		0.5f, 0.0f, 0.0f, 0.0f,
-		0.0f, -0.5f, 0.0f, 0.0f,
-		0.0f, 0.0f, 1.0f, 0.0f,
-		0.5f, 0.5f, 0.0f, 1.0f);
-	DirectX::XMMATRIX ShadowTransform = XViewProj * T;
-	PassConstBuffer ShadowPassBufferData = {};
-	DirectX::XMStoreFloat4x4(&ShadowPassBufferData.View, DirectX::XMMatrixTranspose(XView));
-	DirectX::XMStoreFloat4x4(&ShadowPassBufferData.Proj, DirectX::XMMatrixTranspose(XProj));
-	DirectX::XMStoreFloat4x4(&ShadowPassBufferData.ViewProj, DirectX::XMMatrixTranspose(XViewProj));
-	DirectX::XMStoreFloat4x4(&ShadowPassBufferData.ShadowTransform, DirectX::XMMatrixTranspose(ShadowTransform));
-	ShadowPassBufferData.Eye = EyePos;
-
-
-	DirectX::XMStoreFloat4x4(&PassConstBufferData.ShadowTransform, DirectX::XMMatrixTranspose(ShadowTransform));
-	PassConstBufferRes->CopyData(0, PassConstBufferData);
-	PassConstBufferRes->CopyData(1, ShadowPassBufferData);
+	// Cascades are refitted to the camera every frame, the light basis only depends on the light direction
+	CascadedShadows::CameraFrustum CameraFrustum = { ViewCamera->GetPosition3f(), ViewCamera->GetRight3f(),
+		ViewCamera->GetUp3f(), ViewCamera->GetLook3f(), ViewCamera->GetFovY(), ViewCamera->GetAspect(),
+		ViewCamera->GetNearZ(), ViewCamera->GetFarZ() };
+	const DirectX::XMFLOAT3& LightDir = PassConstBufferData.Lights[0].Direction;
+	ShadowCascades.Update(CameraFrustum, LightDir);
+	const CascadedShadows::Settings& CascadeSettings = ShadowCascades.GetSettings();
 
-	for (int i = 0; i < 6; i++)
+	DirectX::XMFLOAT3 LightLook;
+	DirectX::XMStoreFloat3(&LightLook, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&LightDir)));
+	PassConstBufferData.CascadeCount = ShadowCascades.GetCascadeCount();
+	for (UINT c = 0; c < ShadowCascades.GetCascadeCount(); c++)
 	{
-		XView = CubeMapCameras[i]->GetView();
-		XProj = CubeMapCameras[i]->GetProj();
-		XViewProj = DirectX::XMMatrixMultiply(XView, XProj);
-		EyePos = CubeMapCameras[i]->GetPosition3f();
+		const CascadedShadows::Cascade& Cascade = ShadowCascades.GetCascade(c);
+		DirectX::XMStoreFloat4x4(&PassConstBufferData.ShadowTransforms[c],
+			DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&Cascade.ShadowTransform)));
+
+		// The eye sits on the cascade's near plane, depth grows along the light direction
+		float EyeDistance = Cascade.SphereRadius + CascadeSettings.CasterMargin;
+		PassView& CascadeView = ShadowPassViews[c];
+		CascadeView.ViewProj = Cascade.ViewProj;
+		CascadeView.Eye = DirectX::XMFLOAT3(Cascade.SphereCenter.x - LightLook.x * EyeDistance,
+			Cascade.SphereCenter.y - LightLook.y * EyeDistance, Cascade.SphereCenter.z - LightLook.z * EyeDistance);
+		CascadeView.Look = LightLook;
+		CascadeView.MaxDepth = EyeDistance + Cascade.SphereRadius;
+		CascadeView.bShadowCasters = true;
+
+		PassConstBuffer ShadowPassBufferData = {};
+		DirectX::XMStoreFloat4x4(&ShadowPassBufferData.View, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&Cascade.View)));
+		DirectX::XMStoreFloat4x4(&ShadowPassBufferData.Proj, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&Cascade.Proj)));
+		DirectX::XMStoreFloat4x4(&ShadowPassBufferData.ViewProj, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&Cascade.ViewProj)));
+		ShadowPassBufferData.Eye = CascadeView.Eye;
+		PassConstBufferRes->CopyData(ShadowPassIndex + c, ShadowPassBufferData);
+
+		// A refitted cascade or a new light direction invalidates the whole cached slice
+		StaticShadowCache.SetSliceProjection(c, Cascade.ViewProj);
+	}
+	PassConstBufferRes->CopyData(MainPassIndex, PassConstBufferData);
 
-		PassConstBuffer CubeMapPassBufferData = {};
-		//Transpose before sending to GPU! Which changes row majour to column majour
-		DirectX::XMStoreFloat4x4(&CubeMapPassBufferData.View, DirectX::XMMatrixTranspose(XView));
-		DirectX::XMStoreFloat4x4(&CubeMapPassBufferData.Proj, DirectX::XMMatrixTranspose(XProj));
-		DirectX::XMStoreFloat4x4(&CubeMapPassBufferData.ViewProj, DirectX::XMMatrixTranspose(XViewProj));
-		CubeMapPassBufferData.Eye = EyePos;
-		// Copy lights and shadow transform from main pass
-		std::memcpy(CubeMapPassBufferData.Lights, PassConstBufferData.Lights, sizeof(PassConstBufferData.Lights));
-		CubeMapPassBufferData.ShadowTransform = PassConstBufferData.ShadowTransform;
-		PassConstBufferRes->CopyData(2 + i, CubeMapPassBufferData);
+	// Probe pass constants only change when a probe moves or the cascades it samples are refitted
+	if (std::memcmp(ProbeShadowTransforms, PassConstBufferData.ShadowTransforms, sizeof(ProbeShadowTransforms)) != 0)
+	{
+		std::memcpy(ProbeShadowTransforms, PassConstBufferData.ShadowTransforms, sizeof(ProbeShadowTransforms));
+		for (ProbeScheduler::ProbeId Probe = 0; Probe < Probes.GetProbeCount(); Probe++)
+			Probes.InvalidatePassConstants(Probe);
+	}
+	for (ProbeScheduler::ProbeId Probe = 0; Probe < Probes.GetProbeCount(); Probe++)
+	{
+		if (!Probes.ArePassConstantsDirty(Probe))
+			continue;
+		for (UINT i = 0; i < 6; i++)
+		{
+			const Camera& FaceCamera = *CubeMapCameras[Probe * 6 + i];
+			XView = FaceCamera.GetView();
+			XProj = FaceCamera.GetProj();
+			XViewProj = DirectX::XMMatrixMultiply(XView, XProj);
+			EyePos = FaceCamera.GetPosition3f();
+
+			PassConstBuffer CubeMapPassBufferData = {};
+			//Transpose before sending to GPU! Which changes row majour to column majour
+			DirectX::XMStoreFloat4x4(&CubeMapPassBufferData.View, DirectX::XMMatrixTranspose(XView));
+			DirectX::XMStoreFloat4x4(&CubeMapPassBufferData.Proj, DirectX::XMMatrixTranspose(XProj));
+			DirectX::XMStoreFloat4x4(&CubeMapPassBufferData.ViewProj, DirectX::XMMatrixTranspose(XViewProj));
+			CubeMapPassBufferData.Eye = EyePos;
+			// Copy lights and shadow cascades from main pass
+			std::memcpy(CubeMapPassBufferData.Lights, PassConstBufferData.Lights, sizeof(PassConstBufferData.Lights));
+			std::memcpy(CubeMapPassBufferData.ShadowTransforms, PassConstBufferData.ShadowTransforms, sizeof(PassConstBufferData.ShadowTransforms));
+			CubeMapPassBufferData.CascadeCount = PassConstBufferData.CascadeCount;
+			PassConstBufferRes->CopyData(CubeFacePassIndex + Probe * 6 + i, CubeMapPassBufferData);
+		}
+		Probes.ConsumePassConstantsDirty(Probe);
 	}
 
-	for (auto& RenderItem : RenderItems)
+	// Materials live once in the material table, indexed by MatCBIndex
+	for (auto& [MaterialName, MaterialRef] : Materials)
 	{
-		DirectX::XMMATRIX XWorld = DirectX::XMLoadFloat4x4(&RenderItem->World);
-		ObjConstBuffer  ObjConstBufferData;
-		DirectX::XMStoreFloat4x4(&ObjConstBufferData.World, DirectX::XMMatrixTranspose(XWorld));
-		ObjConstBufferRes->CopyData(ObjConstBufferIndex, ObjConstBufferData);
+		if (MaterialRef->NumFramesDirty <= 0)
+			continue;
 
-		assert(RenderItem->MaterialRef->DiffuseSrvHeapIndex >= 0 && RenderItem->MaterialRef->NormalSrvHeapIndex >= 0);
-		MaterialConstBuffer MatConstBufferData
+		assert(MaterialRef->DiffuseSrvHeapIndex >= 0 && MaterialRef->NormalSrvHeapIndex >= 0);
+		MaterialBufferData MatBufferData
 		{
-			RenderItem->MaterialRef->DiffuseAlbedo,
-			RenderItem->MaterialRef->FresnelR0,
-			RenderItem->MaterialRef->Shininess,
-			RenderItem->MaterialRef->UvTileValue,
-			(UINT)RenderItem->MaterialRef->DiffuseSrvHeapIndex,
-			(UINT)RenderItem->MaterialRef->NormalSrvHeapIndex
+			MaterialRef->DiffuseAlbedo,
+			MaterialRef->FresnelR0,
+			MaterialRef->Shininess,
+			MaterialRef->UvTileValue,
+			(UINT)MaterialRef->DiffuseSrvHeapIndex,
+			(UINT)MaterialRef->NormalSrvHeapIndex
 		};
-		MatConstBufferRes->CopyData(ObjConstBufferIndex, MatConstBufferData);
-		ObjConstBufferIndex++;
+		MaterialBufferRes->CopyData(MaterialRef->MatCBIndex, MatBufferData);
+		MaterialRef->NumFramesDirty--;
+		CurrentFrameStats.MaterialsUploaded++;
 	}
+
+	// Only items that changed within the last gNumFrameResources frames are written
+	const auto& Worlds = Scene.GetWorlds();
+	const auto& MaterialIndices = Scene.GetMaterialIndices();
+	size_t Uploaded = Scene.ConsumeDirtyItems([&](RenderItemId InstanceIndex)
+	{
+		DirectX::XMMATRIX XWorld = DirectX::XMLoadFloat4x4(&Worlds[InstanceIndex]);
+		// Compact positions are dequantized by the world matrix, identity for full precision vertices
+		const DirectX::XMFLOAT4& Dequant = Scene.GetDrawArgs(InstanceIndex).PositionDequant;
+		XWorld = DirectX::XMMatrixScaling(Dequant.w, Dequant.w, Dequant.w) * DirectX::XMMatrixTranslation(Dequant.x, Dequant.y, Dequant.z) * XWorld;
+		InstanceData InstanceBufferData = {};
+		DirectX::XMStoreFloat4x4(&InstanceBufferData.World, DirectX::XMMatrixTranspose(XWorld));
+		InstanceBufferData.MaterialIndex = MaterialIndices[InstanceIndex];
+		// Reflective items blend the two probes around their bounds center, reassigned whenever they move
+		if (Scene.GetLayer(InstanceIndex) == (UINT)RenderLayer::Reflection)
+		{
+			ProbeLookup::Assignment Assigned = ReflectionProbeLookup.Find(Scene.GetWorldBounds(InstanceIndex).Center);
+			InstanceBufferData.ProbeIndices[0] = Assigned.Probes[0];
+			InstanceBufferData.ProbeIndices[1] = Assigned.Probes[1];
+			InstanceBufferData.ProbeBlend = Assigned.Blend;
+		}
+		InstanceBufferRes->CopyData(InstanceIndex, InstanceBufferData);
+	});
+	CurrentFrameStats.ObjectsUploaded = static_cast<UINT>(Uploaded);
 }
 
-void ShapesApp::DrawSceneToShadowMap()
+void ShapesApp::UpdateStaticShadowCache()
 {
+	UINT PassSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstBuffer));
+	auto PassConstBufferRes = GetCurrentFrameResource()->PassConstBufferRes.get();
+
+	bool bAnyDirty = false;
+	for (UINT c = 0; c < ShadowCascades.GetCascadeCount(); c++)
+		bAnyDirty |= StaticShadowCache.IsDirty(c);
+	if (!bAnyDirty)
+		return;
+
 	auto Barier = CD3DX12_RESOURCE_BARRIER::Transition(
-		ShadowMapObj->GetResourcePtr(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+		StaticShadowMapObj->GetResourcePtr(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE);
 	CommandList->ResourceBarrier(1, &Barier);
 
-	auto ShadowViewport = ShadowMapObj->GetViewport();
-	auto ShadowScissorRect = ShadowMapObj->GetRect();
+	auto ShadowViewport = StaticShadowMapObj->GetViewport();
 	CommandList->RSSetViewports(1, &ShadowViewport);
-	CommandList->RSSetScissorRects(1, &ShadowScissorRect);
 
-	CommandList->ClearDepthStencilView(ShadowMapObj->GetDsvHeapCpuHandle(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL,
-		1, 0, 0, nullptr);
-
-	auto Dsv = ShadowMapObj->GetDsvHeapCpuHandle();
-	CommandList->OMSetRenderTargets(0, nullptr, false, &Dsv);
+	for (UINT c = 0; c < ShadowCascades.GetCascadeCount(); c++)
+	{
+		if (!StaticShadowCache.IsDirty(c))
+			continue;
 
-	CommandList->SetPipelineState(PSO["ShadowOpaque"].Get());
-	DrawRenderItems(CommandList.Get(), RenderLayerItems[(UINT)RenderLayer::Opaque]);
+		// Only the dirty texels are cleared and rasterized, and only the casters overlapping them are drawn.
+		// The cache must not depend on the camera, so receiver culling is off.
+		const ShadowCache::Region& Dirty = StaticShadowCache.GetDirtyRegion(c);
+		D3D12_RECT DirtyRect = { Dirty.Left, Dirty.Top, Dirty.Right, Dirty.Bottom };
+		auto Dsv = StaticShadowMapObj->GetDsvHeapCpuHandle(c);
+		CommandList->ClearDepthStencilView(Dsv, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1, 0, 1, &DirtyRect);
+		CommandList->RSSetScissorRects(1, &DirtyRect);
+		CommandList->OMSetRenderTargets(0, nullptr, false, &Dsv);
+
+		auto PassBufferGpuAddress = PassConstBufferRes->GetResourceGpuAddress() + (ShadowPassIndex + c) * PassSize;
+		CommandList->SetGraphicsRootConstantBufferView(0, PassBufferGpuAddress);
+
+		PassView DirtyView = ShadowPassViews[c];
+		DirtyView.ViewProj = StaticShadowCache.GetDirtyViewProj(c);
+		DirtyView.bReceiverCulling = false;
+		DirtyView.Mobility = MobilityFilter::StaticOnly;
+		const LayerDraw ShadowLayers[] = { { RenderLayer::Opaque, "ShadowOpaque", true, true } };
+		QueueRenderLayers(ShadowLayers, _countof(ShadowLayers), DirtyView);
+		DrawRenderQueue(CommandList.Get());
+
+		CurrentFrameStats.StaticShadowSlicesRendered++;
+		CurrentFrameStats.StaticShadowTexelsRendered += Dirty.GetArea();
+		StaticShadowCache.MarkClean(c);
+	}
 
 	auto Barier2 = CD3DX12_RESOURCE_BARRIER::Transition(
-		ShadowMapObj->GetResourcePtr(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ);
+		StaticShadowMapObj->GetResourcePtr(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ);
 	CommandList->ResourceBarrier(1, &Barier2);
+}
+
+void ShapesApp::DrawSceneToShadowMap()
+{
+	UINT PassSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstBuffer));
+	auto PassConstBufferRes = GetCurrentFrameResource()->PassConstBufferRes.get();
+
+	UpdateStaticShadowCache();
+
+	// The static layer is the starting depth of every cascade, dynamic casters are drawn on top
+	auto Barier = CD3DX12_RESOURCE_BARRIER::Transition(
+		ShadowMapObj->GetResourcePtr(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
+	CommandList->ResourceBarrier(1, &Barier);
+	for (UINT c = 0; c < ShadowCascades.GetCascadeCount(); c++)
+	{
+		// D24S8 has a depth and a stencil plane, each is a subresource
+		for (UINT Plane = 0; Plane < 2; Plane++)
+		{
+			UINT Subresource = D3D12CalcSubresource(0, c, Plane, 1, ShadowMapObj->GetArraySize());
+			CD3DX12_TEXTURE_COPY_LOCATION Dst(ShadowMapObj->GetResourcePtr(), Subresource);
+			CD3DX12_TEXTURE_COPY_LOCATION Src(StaticShadowMapObj->GetResourcePtr(), Subresource);
+			CommandList->CopyTextureRegion(&Dst, 0, 0, 0, &Src, nullptr);
+		}
+	}
+
+	if (Scene.GetDynamicItemCount() > 0)
+	{
+		auto Barier2 = CD3DX12_RESOURCE_BARRIER::Transition(
+			ShadowMapObj->GetResourcePtr(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+		CommandList->ResourceBarrier(1, &Barier2);
+
+		auto ShadowViewport = ShadowMapObj->GetViewport();
+		auto ShadowScissorRect = ShadowMapObj->GetRect();
+		CommandList->RSSetViewports(1, &ShadowViewport);
+		CommandList->RSSetScissorRects(1, &ShadowScissorRect);
+
+		// One slice per cascade, each culled against its own light volume
+		for (UINT c = 0; c < ShadowCascades.GetCascadeCount(); c++)
+		{
+			auto Dsv = ShadowMapObj->GetDsvHeapCpuHandle(c);
+			CommandList->OMSetRenderTargets(0, nullptr, false, &Dsv);
+
+			auto PassBufferGpuAddress = PassConstBufferRes->GetResourceGpuAddress() + (ShadowPassIndex + c) * PassSize;
+			CommandList->SetGraphicsRootConstantBufferView(0, PassBufferGpuAddress);
+
+			PassView DynamicView = ShadowPassViews[c];
+			DynamicView.Mobility = MobilityFilter::DynamicOnly;
+			const LayerDraw ShadowLayers[] = { { RenderLayer::Opaque, "ShadowOpaque", true, true } };
+			QueueRenderLayers(ShadowLayers, _countof(ShadowLayers), DynamicView);
+			DrawRenderQueue(CommandList.Get());
+		}
+
+		auto Barier3 = CD3DX12_RESOURCE_BARRIER::Transition(
+			ShadowMapObj->GetResourcePtr(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ);
+		CommandList->ResourceBarrier(1, &Barier3);
+	}
+	else
+	{
+		auto Barier2 = CD3DX12_RESOURCE_BARRIER::Transition(
+			ShadowMapObj->GetResourcePtr(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+		CommandList->ResourceBarrier(1, &Barier2);
+	}
 
 }
 
 void ShapesApp::DrawSceneToCubeMap()
 {
+	// Only the faces picked by the scheduler are re-rendered, the others keep last frame's content
+	const auto& ScheduledFaces = Probes.ScheduleFrame();
+	if (ScheduledFaces.empty())
+		return;
+	CurrentFrameStats.CubeFacesRendered += static_cast<UINT>(ScheduledFaces.size());
+
 	UINT PassSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstBuffer));
 	auto CamPassConstBufferRes = GetCurrentFrameResource()->PassConstBufferRes.get();
 	auto CubeMapViewport = CubeMapObj->GetViewport();
@@ -787,24 +1159,38 @@ void ShapesApp::DrawSceneToCubeMap()
 		CubeMapObj->GetDsResourcePtr(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_DEPTH_WRITE);
 	CommandList->ResourceBarrier(2, Barriers);
 
-	for (int i = 0; i < 6; i++)
+	for (const ProbeScheduler::FaceUpdate& FaceUpdate : ScheduledFaces)
 	{
-		CommandList->ClearRenderTargetView(CubeMapObj->GetRtvCpuHandle((size_t)i), DirectX::Colors::Black, 0, nullptr);
+		int i = (int)FaceUpdate.Face;
+		const ProbeSettings& Probe = ReflectionProbes[FaceUpdate.Probe];
+		const Camera& FaceCamera = *CubeMapCameras[FaceUpdate.Probe * 6 + i];
+		CommandList->ClearRenderTargetView(CubeMapObj->GetRtvCpuHandle((size_t)i, FaceUpdate.Probe), DirectX::Colors::Black, 0, nullptr);
 		CommandList->ClearDepthStencilView(CubeMapObj->GetDsvCpuHandle(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL,
 			1, 0, 0, nullptr);
 
 		auto Dsv = CubeMapObj->GetDsvCpuHandle();
-		auto Rtv = CubeMapObj->GetRtvCpuHandle((size_t)i);
+		auto Rtv = CubeMapObj->GetRtvCpuHandle((size_t)i, FaceUpdate.Probe);
 		CommandList->OMSetRenderTargets(1, &Rtv, true, &Dsv);
 
-		auto CamPassBufferGpuAddress = CamPassConstBufferRes->GetResourceGpuAddress() + ((2 + i) * PassSize);
+		auto CamPassBufferGpuAddress = CamPassConstBufferRes->GetResourceGpuAddress() + ((CubeFacePassIndex + FaceUpdate.Probe * 6 + i) * PassSize);
 		CommandList->SetGraphicsRootConstantBufferView(0, CamPassBufferGpuAddress);
 
-		DrawRenderItems(CommandList.Get(), RenderLayerItems[(UINT)RenderLayer::Opaque]);
-
-		CommandList->SetPipelineState(PSO["Sky"].Get());
-		DrawRenderItems(CommandList.Get(), RenderLayerItems[(UINT)RenderLayer::Skybox]);
-		CommandList->SetPipelineState(PSO["Opaque"].Get());
+		const LayerDraw CubeFaceLayers[] =
+		{
+			{ RenderLayer::Opaque, "Opaque", true, true },
+			{ RenderLayer::Skybox, "Sky", false, false }
+		};
+		// Faces only draw what lies within the probe's influence and covers enough texels
+		PassView FaceView = GetCameraPassView(FaceCamera);
+		FaceView.MaxDistance = Probe.InfluenceRadius;
+		FaceView.MinProjectedSize = Probe.MinProjectedSize;
+		FaceView.ProjectionScale = CubeMapViewport.Height * 0.5f / std::tan(FaceCamera.GetFovY() * 0.5f);
+		QueueRenderLayers(CubeFaceLayers, _countof(CubeFaceLayers), FaceView);
+
+		UINT DrawCallsBefore = CurrentFrameStats.DrawCalls;
+		DrawRenderQueue(CommandList.Get());
+		CurrentFrameStats.CubeFaceDrawCalls[i] += CurrentFrameStats.DrawCalls - DrawCallsBefore;
+		CurrentFrameStats.CubeFaceItems[i] += static_cast<UINT>(DrawQueue.GetSize());
 	}
 	CD3DX12_RESOURCE_BARRIER EndBarriers[2];
 	EndBarriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(
@@ -821,9 +1207,10 @@ void ShapesApp::Draw(const GameTime& Gt)
 
 	ThrowIfFailed(CurrentFrameResource->CommandAlloc->Reset());
 	ThrowIfFailed(CommandList->Reset(CurrentFrameResource->CommandAlloc.Get(), PSO["Opaque"].Get()));
+	BoundPso = PSO["Opaque"].Get();
 
-	UINT PassSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstBuffer));
-	auto CamPassConstBufferRes = GetCurrentFrameResource()->PassConstBufferRes.get();
+	// Geometries only move here, before any draw of the frame reads their offsets
+	SharedGeometry->Defragment(CommandList.Get(), GeometryDefragmentThreshold);
 
 	ID3D12DescriptorHeap* DescHeap[] = { SrvDescriptorHeap.Get() };
 	CommandList->SetDescriptorHeaps(_countof(DescHeap), DescHeap);
@@ -834,13 +1221,16 @@ void ShapesApp::Draw(const GameTime& Gt)
 
 	CommandList->SetGraphicsRootDescriptorTable(4, NullSrvGpuHandle);
 
-	auto CamPassBufferGpuAddress = CamPassConstBufferRes->GetResourceGpuAddress() + 1 * PassSize;
-	CommandList->SetGraphicsRootConstantBufferView(0, CamPassBufferGpuAddress);
+	auto MaterialBufferRes = CurrentFrameResource->MaterialBufferRes.get();
+	CommandList->SetGraphicsRootShaderResourceView(3, MaterialBufferRes->GetResourceGpuAddress());
+	CommandList->SetGraphicsRootShaderResourceView(5, CurrentFrameResource->InstanceBufferRes->GetResourceGpuAddress());
+	CommandList->SetGraphicsRootShaderResourceView(6, CurrentFrameResource->InstanceIndexBufferRes->GetResourceGpuAddress());
+	InstanceIndexCursor = 0;
+	ClusterDrawCursor = 0;
+
 	DrawSceneToShadowMap();
 
 	//--------------------------
-	CommandList->SetPipelineState(PSO["Opaque"].Get());
-
 	CD3DX12_GPU_DESCRIPTOR_HANDLE ShadowSkyGpuHandle(SrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
 	ShadowSkyGpuHandle.Offset(ShadowSkyMapHeapIndex, CbvSrvUavDescriptorSize);
 	CommandList->SetGraphicsRootDescriptorTable(4, ShadowSkyGpuHandle);
@@ -861,26 +1251,24 @@ void ShapesApp::Draw(const GameTime& Gt)
 	CommandList->OMSetRenderTargets(1, &Rtv, true, &Dsv);
 
 	auto PassConstBufferRes = GetCurrentFrameResource()->PassConstBufferRes.get();
-	auto PassBufferGpuAddress = PassConstBufferRes->GetResourceGpuAddress();
+	auto PassBufferGpuAddress = PassConstBufferRes->GetResourceGpuAddress() + MainPassIndex * d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstBuffer));
 	CommandList->SetGraphicsRootConstantBufferView(0, PassBufferGpuAddress);
 
-	CommandList->SetPipelineState(PSO["Opaque"].Get());
-	DrawRenderItems(CommandList.Get(), RenderLayerItems[(UINT)RenderLayer::Opaque]);
-
+	LayerDraw MainLayers[4];
+	UINT MainLayerCount = 0;
+	MainLayers[MainLayerCount++] = { RenderLayer::Opaque, "Opaque", true, true };
 	if (bDebugShadowMap)
-	{
-		CommandList->SetPipelineState(PSO["ShadowDebug"].Get());
-		DrawRenderItems(CommandList.Get(), RenderLayerItems[(UINT)RenderLayer::ShadowDebug]);
-	}
-	CommandList->SetPipelineState(PSO["Sky"].Get());
-	DrawRenderItems(CommandList.Get(), RenderLayerItems[(UINT)RenderLayer::Skybox]);
-
-	//Render the CubeMap Reflection
-	CommandList->SetPipelineState(PSO["Opaque"].Get());
-	CD3DX12_GPU_DESCRIPTOR_HANDLE CubeMap(SrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	CubeMap.Offset(ShadowCubeMapHeapIndex, CbvSrvUavDescriptorSize);
-	CommandList->SetGraphicsRootDescriptorTable(4, CubeMap);
-	DrawRenderItems(CommandList.Get(), RenderLayerItems[(UINT)RenderLayer::Reflection]);
+		MainLayers[MainLayerCount++] = { RenderLayer::ShadowDebug, "ShadowDebug", false, false };
+	MainLayers[MainLayerCount++] = { RenderLayer::Skybox, "Sky", false, false };
+	// Reflective items sample their assigned probes from the cube array of the ShadowMap/Skybox table
+	MainLayers[MainLayerCount++] = { RenderLayer::Reflection, "Reflection", true, true };
+	PassView MainView = GetCameraPassView(*ViewCamera);
+	MainView.bOcclusionCulling = true;
+	MainView.bClusterCulling = bClusterCulling;
+	MainView.ProjectionScale = Viewport.Height * 0.5f / std::tan(ViewCamera->GetFovY() * 0.5f);
+	RenderOccluders(MainView);
+	QueueRenderLayers(MainLayers, MainLayerCount, MainView);
+	DrawRenderQueue(CommandList.Get());
 
 	auto Barier2 = CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBufferResource(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
 	CommandList->ResourceBarrier(1, &Barier2);
@@ -894,35 +1282,389 @@ void ShapesApp::Draw(const GameTime& Gt)
 
 	CurrentFrameResource->FenceValue = ++CurrentFenceValue;
 	CommandQueue->Signal(Fence.Get(), CurrentFenceValue);
+	SharedGeometry->MarkSubmitted(CurrentFenceValue);
+
+}
+
+void ShapesApp::QueueRenderLayers(const LayerDraw* aLayers, UINT aLayerCount, const PassView& aView)
+{
+	assert(aLayerCount <= (1u << RenderQueue::BucketBits) && "Too many layers in one pass");
+	DrawQueue.Clear();
+	QueuedBuckets.clear();
+	ClusterCulledBuckets = 0;
+	if (aView.bClusterCulling)
+	{
+		Clusters.SetView(aView.ViewProj, aView.Eye, aView.ProjectionScale);
+		Clusters.SetMinProjectedSize(MinClusterProjectedSize);
+	}
+
+	const auto& WorldBounds = Scene.GetAllWorldBounds();
+	bool bAnyCulledLayer = false;
+	for (UINT i = 0; i < aLayerCount; i++)
+		bAnyCulledLayer |= aLayers[i].bFrustumCull;
+	const std::vector<std::uint8_t>* Visibility = bAnyCulledLayer ? &CullPass(aView) : nullptr;
+
+	const auto& MeshIds = Scene.GetMeshIds();
+	const auto& MaterialIndices = Scene.GetMaterialIndices();
+	const auto& DynamicFlags = Scene.GetDynamicFlags();
+	DirectX::XMVECTOR Eye = DirectX::XMLoadFloat3(&aView.Eye);
+	DirectX::XMVECTOR Look = DirectX::XMLoadFloat3(&aView.Look);
+
+	for (UINT Bucket = 0; Bucket < aLayerCount; Bucket++)
+	{
+		const LayerDraw& Layer = aLayers[Bucket];
+		QueuedBuckets.push_back(Layer.Layer);
+		// Culled layers draw back face culled geometry, the cone test relies on it
+		if (aView.bClusterCulling && Layer.bFrustumCull)
+			ClusterCulledBuckets |= 1u << Bucket;
+		UINT PsoId = PsoIds.at(Layer.PsoName);
+
+		for (RenderItemId Id : Scene.GetLayerItems((UINT)Layer.Layer))
+		{
+			if (aView.Mobility != MobilityFilter::All && (DynamicFlags[Id] != 0) != (aView.Mobility == MobilityFilter::DynamicOnly))
+				continue;
+			if (Layer.bFrustumCull && !(*Visibility)[Id])
+			{
+				CurrentFrameStats.CulledItems++;
+				if (aView.bShadowCasters)
+				{
+					if (!PassCuller.IsVisible(Id))
+						CurrentFrameStats.ShadowCastersLightCulled++;
+					else
+						CurrentFrameStats.ShadowCastersReceiverCulled++;
+				}
+				continue;
+			}
+
+			std::uint32_t Depth = 0;
+			if (Layer.bSortByDepth)
+			{
+				DirectX::XMVECTOR Center = DirectX::XMVectorSet(WorldBounds.CenterX[Id], WorldBounds.CenterY[Id], WorldBounds.CenterZ[Id], 1.0f);
+				float ViewDepth = DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMVectorSubtract(Center, Eye), Look));
+				Depth = RenderQueue::QuantizeDepth(ViewDepth, aView.MaxDepth);
+			}
+			std::uint64_t Key = RenderQueue::MakeKey(Bucket, PsoId, MeshIds[Id], MaterialIndices[Id], Depth);
+			// Ids beyond the key fields, MakeKey asserted in debug builds
+			if (Key == RenderQueue::InvalidKey)
+				continue;
+			DrawQueue.Push(Key, Id);
+		}
+	}
+
+	// Walks the queue twice, only done while stats are reported
+	if (bFrameStats)
+	{
+		UINT SubmissionOrderChanges = CountQueueStateChanges();
+		DrawQueue.Sort();
+		UINT SortedChanges = CountQueueStateChanges();
+		if (SubmissionOrderChanges > SortedChanges)
+			CurrentFrameStats.StateChangesSaved += SubmissionOrderChanges - SortedChanges;
+	}
+	else
+		DrawQueue.Sort();
+	CurrentFrameStats.QueuedItems += static_cast<UINT>(DrawQueue.GetSize());
+	if (aView.bShadowCasters)
+		CurrentFrameStats.ShadowCastersSubmitted += static_cast<UINT>(DrawQueue.GetSize());
+	CurrentFrameStats.SortMilliseconds += DrawQueue.GetLastSortMilliseconds();
+}
+
+void ShapesApp::DrawRenderQueue(ID3D12GraphicsCommandList* CommandList, const std::function<void(RenderLayer)>& aOnLayerBegin)
+{
+	if (DrawQueue.IsEmpty())
+		return;
+
+	auto InstanceIndexBufferRes = GetCurrentFrameResource()->InstanceIndexBufferRes.get();
+	const auto& AllDrawArgs = Scene.GetAllDrawArgs();
+	const auto& Keys = DrawQueue.GetKeys();
+	const auto& Items = DrawQueue.GetItems();
+
+	// The sorted item ids are the instance indices of this pass
+	UINT ItemCount = static_cast<UINT>(Items.size());
+	assert(InstanceIndexCursor + ItemCount <= InstanceIndexBufferRes->GetElementCount() && "Instance index buffer overflow");
+	InstanceIndexBufferRes->CopyRange(InstanceIndexCursor, Items.data(), ItemCount);
+
+	CommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	UINT StateChanges = 1;
+	// Geometries share the pool buffers of their vertex stride and index format, most draws bind nothing
+	GeometryBuffer* BoundVertexBuffer = nullptr;
+	GeometryBuffer* BoundIndexBuffer = nullptr;
+	std::uint32_t CurrentBucket = UINT32_MAX;
+
+	UINT BatchStart = 0;
+	while (BatchStart < ItemCount)
+	{
+		std::uint64_t BatchKey = RenderQueue::GetBatchKey(Keys[BatchStart]);
+		UINT BatchEnd = BatchStart + 1;
+		while (BatchEnd < ItemCount && RenderQueue::GetBatchKey(Keys[BatchEnd]) == BatchKey)
+			BatchEnd++;
+
+		std::uint32_t Bucket = RenderQueue::GetBucket(Keys[BatchStart]);
+		if (Bucket != CurrentBucket)
+		{
+			CurrentBucket = Bucket;
+			if (aOnLayerBegin)
+				aOnLayerBegin(QueuedBuckets[Bucket]);
+		}
+
+		ID3D12PipelineState* Pso = PsoTable[RenderQueue::GetPso(Keys[BatchStart])];
+		if (Pso != BoundPso)
+		{
+			CommandList->SetPipelineState(Pso);
+			BoundPso = Pso;
+			StateChanges++;
+		}
+
+		const auto& DrawArgs = AllDrawArgs[Items[BatchStart]];
+		const MeshGeometry* Geo = DrawArgs.MeshGeometryRef;
+		if (Geo->VertexBuffer != BoundVertexBuffer)
+		{
+			BoundVertexBuffer = Geo->VertexBuffer;
+			auto vbv = BoundVertexBuffer->GetVertexBufferView();
+			CommandList->IASetVertexBuffers(0, 1, &vbv);
+			StateChanges++;
+		}
+		if (Geo->IndexBuffer != BoundIndexBuffer)
+		{
+			BoundIndexBuffer = Geo->IndexBuffer;
+			auto ibv = BoundIndexBuffer->GetIndexBufferView();
+			CommandList->IASetIndexBuffer(&ibv);
+			StateChanges++;
+		}
+
+		UINT InstanceCount = BatchEnd - BatchStart;
+		CommandList->SetGraphicsRoot32BitConstant(1, InstanceIndexCursor + BatchStart, 0);
+		StateChanges++;
+		if (InstanceCount == 1 && DrawArgs.MeshletCount > 0 && ((ClusterCulledBuckets >> Bucket) & 1))
+			DrawClusters(CommandList, DrawArgs, Scene.GetWorld(Items[BatchStart]));
+		else
+		{
+			CommandList->DrawIndexedInstanced(DrawArgs.IndexCount, InstanceCount, DrawArgs.IndexStartLocation + Geo->StartIndexLocation,
+				DrawArgs.VertexStartLocation + INT(Geo->BaseVertexLocation), 0);
+
+			CurrentFrameStats.DrawCalls++;
+			CurrentFrameStats.InstancesDrawn += InstanceCount;
+			CurrentFrameStats.TrianglesDrawn += UINT64(DrawArgs.IndexCount / 3) * InstanceCount;
+		}
+		BatchStart = BatchEnd;
+	}
+	InstanceIndexCursor += ItemCount;
+	CurrentFrameStats.StateChanges += StateChanges;
+}
+
+UINT ShapesApp::CountQueueStateChanges() const
+{
+	// PSO, vertex buffer, index buffer and topology binds of the queue in its current order, like DrawRenderQueue.
+	// Every queued draw is a triangle list, so the topology is only bound once.
+	const auto& AllDrawArgs = Scene.GetAllDrawArgs();
+	const auto& Keys = DrawQueue.GetKeys();
+	const auto& Items = DrawQueue.GetItems();
+	UINT Changes = 0;
+	for (size_t i = 0; i < Keys.size(); i++)
+	{
+		const MeshGeometry* Geo = AllDrawArgs[Items[i]].MeshGeometryRef;
+		if (i == 0)
+		{
+			Changes += 4;
+			continue;
+		}
+		const MeshGeometry* PrevGeo = AllDrawArgs[Items[i - 1]].MeshGeometryRef;
+		Changes += RenderQueue::GetPso(Keys[i]) != RenderQueue::GetPso(Keys[i - 1]);
+		Changes += Geo->VertexBuffer != PrevGeo->VertexBuffer;
+		Changes += Geo->IndexBuffer != PrevGeo->IndexBuffer;
+	}
+	return Changes;
+}
 
+void ShapesApp::DrawClusters(ID3D12GraphicsCommandList* CommandList, const SceneStore::DrawArgs& aDrawArgs, const DirectX::XMFLOAT4X4& aWorld)
+{
+	ClusterRanges.clear();
+	Clusters.ResetCounters();
+	const MeshGeometry* Geo = aDrawArgs.MeshGeometryRef;
+	Clusters.Cull(aDrawArgs.Meshlets, aDrawArgs.MeshletCount, aWorld, aDrawArgs.IndexStartLocation + Geo->StartIndexLocation, ClusterRanges);
+	INT BaseVertexLocation = aDrawArgs.VertexStartLocation + INT(Geo->BaseVertexLocation);
+	CurrentFrameStats.ClustersTested += static_cast<UINT>(Clusters.GetTestedCount());
+	CurrentFrameStats.ClustersFrustumCulled += static_cast<UINT>(Clusters.GetFrustumCulledCount());
+	CurrentFrameStats.ClustersBackfaceCulled += static_cast<UINT>(Clusters.GetBackfaceCulledCount());
+	CurrentFrameStats.ClustersSmallCulled += static_cast<UINT>(Clusters.GetSmallCulledCount());
+	if (ClusterRanges.empty())
+		return;
+
+	UINT RangeCount = static_cast<UINT>(ClusterRanges.size());
+	UINT64 IndexCount = 0;
+	for (const ClusterCuller::IndexRange& Range : ClusterRanges)
+		IndexCount += Range.IndexCount;
+
+	// The ranges of an item go out as one ExecuteIndirect, directly drawn once the argument buffer of the frame is full
+	auto ClusterDrawArgsRes = GetCurrentFrameResource()->ClusterDrawArgsRes.get();
+	if (ClusterDrawCursor + RangeCount <= ClusterDrawArgsRes->GetElementCount())
+	{
+		for (UINT i = 0; i < RangeCount; i++)
+		{
+			D3D12_DRAW_INDEXED_ARGUMENTS Args = { ClusterRanges[i].IndexCount, 1, ClusterRanges[i].IndexStart, BaseVertexLocation, 0 };
+			ClusterDrawArgsRes->CopyData(ClusterDrawCursor + i, Args);
+		}
+		CommandList->ExecuteIndirect(ClusterCommandSignature.Get(), RangeCount, ClusterDrawArgsRes->GetResource(),
+			UINT64(ClusterDrawCursor) * sizeof(D3D12_DRAW_INDEXED_ARGUMENTS), nullptr, 0);
+		ClusterDrawCursor += RangeCount;
+	}
+	else
+	{
+		for (const ClusterCuller::IndexRange& Range : ClusterRanges)
+			CommandList->DrawIndexedInstanced(Range.IndexCount, 1, Range.IndexStart, BaseVertexLocation, 0);
+	}
+
+	CurrentFrameStats.DrawCalls += RangeCount;
+	CurrentFrameStats.ClusterDraws += RangeCount;
+	CurrentFrameStats.InstancesDrawn++;
+	CurrentFrameStats.TrianglesDrawn += IndexCount / 3;
+}
+
+const std::vector<std::uint8_t>& ShapesApp::CullPass(const PassView& aView)
+{
+	if (aView.bShadowCasters)
+		return CullShadowCasters(aView);
+
+	PassCuller.SetViewProj(aView.ViewProj);
+	PassCuller.ClearSweep();
+	if (aView.MaxDistance > 0.0f || aView.MinProjectedSize > 0.0f)
+		PassCuller.SetRangeLimits(aView.Eye, aView.MaxDistance, aView.MinProjectedSize, aView.ProjectionScale);
+	else
+		PassCuller.ClearRangeLimits();
+	if (!bSceneBvhCulling)
+	{
+		PassCuller.Cull(Scene.GetAllWorldBounds());
+		return CullOccluded(aView, PassCuller.GetVisibility());
+	}
+
+	// The scene tree rejects whole subtrees against the frustum, only the items of the leaves it
+	// reaches go through the exact per item tests
+	BvhCandidates.clear();
+	SceneTree.QueryFrustum(PassCuller.GetPlanes(), BvhCandidates);
+	const auto& WorldBounds = Scene.GetAllWorldBounds();
+	SceneStore::WorldBoundsStreams& Candidates = BvhCandidateBounds;
+	for (auto* Stream : { &Candidates.CenterX, &Candidates.CenterY, &Candidates.CenterZ,
+		&Candidates.ExtentX, &Candidates.ExtentY, &Candidates.ExtentZ })
+		Stream->resize(BvhCandidates.size());
+	for (size_t i = 0; i < BvhCandidates.size(); i++)
+	{
+		RenderItemId Id = BvhCandidates[i];
+		Candidates.CenterX[i] = WorldBounds.CenterX[Id];
+		Candidates.CenterY[i] = WorldBounds.CenterY[Id];
+		Candidates.CenterZ[i] = WorldBounds.CenterZ[Id];
+		Candidates.ExtentX[i] = WorldBounds.ExtentX[Id];
+		Candidates.ExtentY[i] = WorldBounds.ExtentY[Id];
+		Candidates.ExtentZ[i] = WorldBounds.ExtentZ[Id];
+	}
+	PassCuller.Cull(Candidates);
+	BvhVisibility.assign(Scene.GetItemCount(), 0);
+	for (size_t i = 0; i < BvhCandidates.size(); i++)
+		BvhVisibility[BvhCandidates[i]] = PassCuller.IsVisible(i) ? 1 : 0;
+	return CullOccluded(aView, BvhVisibility);
 }
 
-void ShapesApp::DrawRenderItems(ID3D12GraphicsCommandList* CommandList, std::vector<RenderItem*>& RenderItem)
+void ShapesApp::RenderOccluders(const PassView& aView)
 {
-	auto ObjConstBufferRes = GetCurrentFrameResource()->ObjConstBufferRes.get();
-	auto MatConstBufferRes = GetCurrentFrameResource()->MatConstBufferRes.get();
+	if (!bOcclusionCulling)
+		return;
+	Occluders.BeginFrame(aView.ViewProj);
 
-	for (auto& RItem : RenderItem)
+	// Opaque items in front of the eye that cover the most of the view, by bounding sphere radius over distance
+	const auto& WorldBounds = Scene.GetAllWorldBounds();
+	OccluderCandidates.clear();
+	for (RenderItemId Id : Scene.GetLayerItems((UINT)RenderLayer::Opaque))
 	{
-		auto vbv = RItem->MeshGeometryRef->VertexBufferView();
-		CommandList->IASetVertexBuffers(0, 1, &vbv);
-		auto ibv = RItem->MeshGeometryRef->IndexBufferView();
-		CommandList->IASetIndexBuffer(&ibv);
-		CommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		const SceneStore::DrawArgs& Args = Scene.GetDrawArgs(Id);
+		const MeshGeometry* Geometry = Args.MeshGeometryRef;
+		if (Args.IndexCount / 3 > MaxOccluderTriangles || !Geometry->VertexBufferCPU || !Geometry->IndexBufferCPU)
+			continue;
+
+		float ToCenterX = WorldBounds.CenterX[Id] - aView.Eye.x;
+		float ToCenterY = WorldBounds.CenterY[Id] - aView.Eye.y;
+		float ToCenterZ = WorldBounds.CenterZ[Id] - aView.Eye.z;
+		float Radius = std::sqrt(WorldBounds.ExtentX[Id] * WorldBounds.ExtentX[Id] + WorldBounds.ExtentY[Id] * WorldBounds.ExtentY[Id]
+			+ WorldBounds.ExtentZ[Id] * WorldBounds.ExtentZ[Id]);
+		if (ToCenterX * aView.Look.x + ToCenterY * aView.Look.y + ToCenterZ * aView.Look.z + Radius <= 0.0f)
+			continue;
+		float Distance = std::sqrt(ToCenterX * ToCenterX + ToCenterY * ToCenterY + ToCenterZ * ToCenterZ);
+		float Size = Radius / std::max(Distance, 1e-3f);
+		if (Size >= MinOccluderSize)
+			OccluderCandidates.push_back({ Size, Id });
+	}
+	size_t OccluderCount = std::min<size_t>(MaxOccluders, OccluderCandidates.size());
+	std::partial_sort(OccluderCandidates.begin(), OccluderCandidates.begin() + OccluderCount, OccluderCandidates.end(),
+		[](const auto& A, const auto& B) { return A.first > B.first; });
 
-		auto ObjConstBufferSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjConstBuffer));
-		auto ObjBufferGpuAddress = ObjConstBufferRes->GetResourceGpuAddress() + ObjConstBufferSize * RItem->ObjConstBufferIndex;
-		CommandList->SetGraphicsRootConstantBufferView(1, ObjBufferGpuAddress);
+	for (size_t i = 0; i < OccluderCount; i++)
+	{
+		RenderItemId Id = OccluderCandidates[i].second;
+		const SceneStore::DrawArgs& Args = Scene.GetDrawArgs(Id);
+		const MeshGeometry* Geometry = Args.MeshGeometryRef;
+		// Positions lead the full precision CPU vertices
+		bool b32BitIndices = Geometry->IndexFormat == DXGI_FORMAT_R32_UINT;
+		const auto* Indices = static_cast<const std::uint8_t*>(Geometry->IndexBufferCPU->GetBufferPointer());
+		Occluders.RasterizeOccluder(Geometry->VertexBufferCPU->GetBufferPointer(), Geometry->VertexBufferCPUByteStride,
+			Geometry->VertexBufferCPU->GetBufferSize() / Geometry->VertexBufferCPUByteStride, Indices + Args.IndexStartLocation * (b32BitIndices ? 4 : 2),
+			b32BitIndices, Args.IndexCount, Args.VertexStartLocation, Scene.GetWorld(Id));
+	}
+	Occluders.EndOccluders();
+	CurrentFrameStats.OccluderTriangles += static_cast<UINT>(Occluders.GetRasterizedTriangleCount());
+}
 
-		auto MatConstBufferSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstBuffer));
-		auto MatBufferGpuAddress = MatConstBufferRes->GetResourceGpuAddress() + MatConstBufferSize * RItem->ObjConstBufferIndex;
-		CommandList->SetGraphicsRootConstantBufferView(3, MatBufferGpuAddress);
+const std::vector<std::uint8_t>& ShapesApp::CullOccluded(const PassView& aView, const std::vector<std::uint8_t>& aVisibility)
+{
+	if (!bOcclusionCulling || !aView.bOcclusionCulling)
+		return aVisibility;
+	Occluders.Cull(Scene.GetAllWorldBounds(), aVisibility);
+	CurrentFrameStats.OcclusionCulledItems += static_cast<UINT>(Occluders.GetOccludedCount());
+	return Occluders.GetVisibility();
+}
 
-		CommandList->DrawIndexedInstanced(RItem->IndexCount, 1, RItem->IndexStartLocation, RItem->VertexStartLocation, 0);
+const std::vector<std::uint8_t>& ShapesApp::CullShadowCasters(const PassView& aLightView)
+{
+	const auto& WorldBounds = Scene.GetAllWorldBounds();
+
+	// Casters between the light and its ortho volume still shadow it, so the near plane is dropped
+	PassCuller.SetViewProj(aLightView.ViewProj, true);
+	PassCuller.ClearSweep();
+	PassCuller.ClearRangeLimits();
+	PassCuller.Cull(WorldBounds);
+	ShadowCasterVisibility = PassCuller.GetVisibility();
+	if (!bShadowReceiverCulling || !aLightView.bReceiverCulling)
+		return ShadowCasterVisibility;
+
+	// A caster is only kept if its box, swept along the light direction through the light volume,
+	// reaches a receiver that is drawn: the main camera frustum or a reflection probe's influence box
+	ReceiverCuller.ClearRangeLimits();
+	ReceiverCuller.SetSweep(aLightView.Look, aLightView.MaxDepth);
+	ReceiverCuller.SetViewProj(GetCameraPassView(*ViewCamera).ViewProj);
+	ReceiverCuller.Cull(WorldBounds);
+	ShadowReceiverVisibility = ReceiverCuller.GetVisibility();
+
+	for (const ProbeSettings& Probe : ReflectionProbes)
+	{
+		float ProbeExtent = Probe.InfluenceRadius > 0.0f ? Probe.InfluenceRadius : Probe.FarZ;
+		ReceiverCuller.SetBox(Probe.Center, DirectX::XMFLOAT3(ProbeExtent, ProbeExtent, ProbeExtent));
+		ReceiverCuller.Cull(WorldBounds);
+		const auto& ProbeReceivers = ReceiverCuller.GetVisibility();
+		for (size_t i = 0; i < ShadowReceiverVisibility.size(); i++)
+			ShadowReceiverVisibility[i] |= ProbeReceivers[i];
 	}
+	for (size_t i = 0; i < ShadowCasterVisibility.size(); i++)
+		ShadowCasterVisibility[i] &= ShadowReceiverVisibility[i];
+	return ShadowCasterVisibility;
+}
+
+ShapesApp::PassView ShapesApp::GetCameraPassView(const Camera& aCamera) const
+{
+	PassView View;
+	DirectX::XMStoreFloat4x4(&View.ViewProj, DirectX::XMMatrixMultiply(aCamera.GetView(), aCamera.GetProj()));
+	View.Eye = aCamera.GetPosition3f();
+	View.Look = aCamera.GetLook3f();
+	View.MaxDepth = aCamera.GetFarZ();
+	return View;
 }
 
-FrameResource<ShapesApp::PassConstBuffer, ShapesApp::ObjConstBuffer, ShapesApp::MaterialConstBuffer>* ShapesApp::GetCurrentFrameResource() const
+FrameResource<ShapesApp::PassConstBuffer, ShapesApp::InstanceData, ShapesApp::MaterialBufferData>* ShapesApp::GetCurrentFrameResource() const
 {
 	assert((CurrentFrameResourceIndex >= 0 && CurrentFrameResourceIndex < FrameResources.size()) && "Trying to get FrameRes REF with an invalid Index");
 	return FrameResources[CurrentFrameResourceIndex].get();
@@ -930,19 +1672,21 @@ FrameResource<ShapesApp::PassConstBuffer, ShapesApp::ObjConstBuffer, ShapesApp::
 
 void ShapesApp::BuildRootSignature()
 {
-	const size_t TotalRootParameters = 5;
+	const size_t TotalRootParameters = 7;
 	CD3DX12_ROOT_PARAMETER RootParameter[TotalRootParameters];
 	RootParameter[0].InitAsConstantBufferView(0, 0);
-	RootParameter[1].InitAsConstantBufferView(1, 0);
+	RootParameter[1].InitAsConstants(1, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);	//InstanceBase (b1)
 
 	CD3DX12_DESCRIPTOR_RANGE TextureDescTable;
 	TextureDescTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, MAX_TEXTURES, 0, 0);		//Textures
 	RootParameter[2].InitAsDescriptorTable(1, &TextureDescTable, D3D12_SHADER_VISIBILITY_PIXEL);
-	RootParameter[3].InitAsConstantBufferView(2, 0, D3D12_SHADER_VISIBILITY_PIXEL);	//Material
+	RootParameter[3].InitAsShaderResourceView(0, 2, D3D12_SHADER_VISIBILITY_PIXEL);	//Material table (t0, space2)
 
 	CD3DX12_DESCRIPTOR_RANGE ShadowSkyDescTable;
-	ShadowSkyDescTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 0, 1);  // 2 SRVs at t0-t1 in space1
+	ShadowSkyDescTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0, 1);  // ShadowMap, Skybox, probe CubeMap array at t0-t2 in space1
 	RootParameter[4].InitAsDescriptorTable(1, &ShadowSkyDescTable, D3D12_SHADER_VISIBILITY_PIXEL);
+	RootParameter[5].InitAsShaderResourceView(1, 2, D3D12_SHADER_VISIBILITY_VERTEX);	//Instance data (t1, space2)
+	RootParameter[6].InitAsShaderResourceView(2, 2, D3D12_SHADER_VISIBILITY_VERTEX);	//Instance indices (t2, space2)
 
 
 	auto Samplers = d3dUtil::GetStaticSamplers();
@@ -959,218 +1703,470 @@ void ShapesApp::BuildRootSignature()
 
 	ThrowIfFailed(DxDevice3D->CreateRootSignature(0, SignatureBlob->GetBufferPointer(),
 		SignatureBlob->GetBufferSize(), IID_PPV_ARGS(RootSignature.GetAddressOf())));
+
+	// Cluster draws only vary their index range, the instance base stays the root constant set before them
+	D3D12_INDIRECT_ARGUMENT_DESC ClusterArgument = {};
+	ClusterArgument.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+	D3D12_COMMAND_SIGNATURE_DESC ClusterSignatureDesc = {};
+	ClusterSignatureDesc.ByteStride = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+	ClusterSignatureDesc.NumArgumentDescs = 1;
+	ClusterSignatureDesc.pArgumentDescs = &ClusterArgument;
+	ThrowIfFailed(DxDevice3D->CreateCommandSignature(&ClusterSignatureDesc, nullptr, IID_PPV_ARGS(ClusterCommandSignature.GetAddressOf())));
 }
 
 void ShapesApp::BuildShadersAndInputLayout()
 {
-	InputLayouts.push_back(
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,
-			0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	if (bCompactVertices)
+	{
+		// CompactVertex
+		InputLayouts.push_back(
+			{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM,
+				0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+
+		InputLayouts.push_back(
+			{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,
+				0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+
+		InputLayouts.push_back(
+			{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM,
+				0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+
+		InputLayouts.push_back(
+			{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM,
+				0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
+	else
+	{
+		InputLayouts.push_back(
+			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,
+				0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
 
-	InputLayouts.push_back(
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,
-			0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+		InputLayouts.push_back(
+			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,
+				0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
 
-	InputLayouts.push_back(
-		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT,
-			0, 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+		InputLayouts.push_back(
+			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT,
+				0, 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
 
-	InputLayouts.push_back(
-		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT,
-			0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+		InputLayouts.push_back(
+			{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT,
+				0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
 
-	Shaders["Vertex"] = d3dUtil::CompileShader(L"src\\Shaders\\ShapesApp.hlsl", nullptr, "VS", "vs_5_1");
+	// Every vertex shader reads the layout above
+	const D3D_SHADER_MACRO CompactVertexDefines[] = { { "COMPACT_VERTEX", "1" }, { nullptr, nullptr } };
+	const D3D_SHADER_MACRO* VertexDefines = bCompactVertices ? CompactVertexDefines : nullptr;
+
+	Shaders["Vertex"] = d3dUtil::CompileShader(L"src\\Shaders\\ShapesApp.hlsl", VertexDefines, "VS", "vs_5_1");
 	Shaders["Pixel"] = d3dUtil::CompileShader(L"src\\Shaders\\ShapesApp.hlsl", nullptr, "PS", "ps_5_1");
+	const D3D_SHADER_MACRO ProbeReflectionDefines[] = { { "PROBE_REFLECTIONS", "1" }, { nullptr, nullptr } };
+	Shaders["ReflectionPS"] = d3dUtil::CompileShader(L"src\\Shaders\\ShapesApp.hlsl", ProbeReflectionDefines, "PS", "ps_5_1");
 
-	Shaders["SkyVertex"] = d3dUtil::CompileShader(L"src\\Shaders\\Skybox.hlsl", nullptr, "VS", "vs_5_1");
+	Shaders["SkyVertex"] = d3dUtil::CompileShader(L"src\\Shaders\\Skybox.hlsl", VertexDefines, "VS", "vs_5_1");
 	Shaders["SkyPixel"] = d3dUtil::CompileShader(L"src\\Shaders\\Skybox.hlsl", nullptr, "PS", "ps_5_1");
 
-	Shaders["ShadowVS"] = d3dUtil::CompileShader(L"src\\Shaders\\ShadowMap.hlsl", nullptr, "VS", "vs_5_1");
+	Shaders["ShadowVS"] = d3dUtil::CompileShader(L"src\\Shaders\\ShadowMap.hlsl", VertexDefines, "VS", "vs_5_1");
 	Shaders["ShadowPS"] = d3dUtil::CompileShader(L"src\\Shaders\\ShadowMap.hlsl", nullptr, "PS", "ps_5_1");
 
-	Shaders["ShadowDebugVS"] = d3dUtil::CompileShader(L"src\\Shaders\\ShadowMapDebug.hlsl", nullptr, "VS", "vs_5_1");
+	Shaders["ShadowDebugVS"] = d3dUtil::CompileShader(L"src\\Shaders\\ShadowMapDebug.hlsl", VertexDefines, "VS", "vs_5_1");
 	Shaders["ShadowDebugPS"] = d3dUtil::CompileShader(L"src\\Shaders\\ShadowMapDebug.hlsl", nullptr, "PS", "ps_5_1");
 }
 
-void ShapesApp::CreateModelGeometry(std::string Path, std::string GeomertryName)
+void ShapesApp::ImportModel(ModelImport& aImport)
 {
-	ModelImporter::ModelData ModelData;
-	bool ModelLoaded = ModelImporter::LoadModel(
-		Path,
-		ModelData, true, false, false);
-	if (ModelLoaded)
+	auto StartTime = std::chrono::steady_clock::now();
+	MeshCache::Key SourceKey = { MeshCache::HashFile(aImport.Path), HashImportSettings(true, false, false, {}) };
+	std::vector<MeshCache::Key> LevelKeys = { SourceKey };
+	if (aImport.TriangleRatios.empty())
+		aImport.LevelGeometries = { aImport.GeometryName };
+	else
 	{
-		std::string DebugMsg = GeomertryName + " model loaded successfully:\n";
-		DebugMsg += "  Vertices: " + std::to_string(ModelData.Vertices.size()) + "\n";
-		DebugMsg += "  Indices: " + std::to_string(ModelData.Use32BitIndices ? ModelData.Indices32.size() : ModelData.Indices16.size()) + "\n";
-		DebugMsg += "  Submeshes: " + std::to_string(ModelData.Submeshes.size()) + "\n";
-		::OutputDebugStringA(DebugMsg.c_str());
+		aImport.LevelGeometries = { aImport.GeometryName + "_LOD0" };
+		for (size_t Level = 0; Level < aImport.TriangleRatios.size(); Level++)
+		{
+			aImport.LevelGeometries.push_back(aImport.GeometryName + "_LOD" + std::to_string(Level + 1));
+			LevelKeys.push_back({ SourceKey.SourceHash, HashLodSettings(SourceKey.SettingsHash, aImport.TriangleRatios[Level], {}) });
+		}
+	}
 
-		auto Geomertry = ModelImporter::CreateMeshGeometry(ModelData, DxDevice3D.Get(), CommandList.Get(),GeomertryName);
-		MeshGeometries[Geomertry->Name] = std::move(Geomertry);
+	aImport.CachedLevels.resize(aImport.LevelGeometries.size());
+	bool bCached = true;
+	for (size_t Level = 0; Level < aImport.LevelGeometries.size() && bCached; Level++)
+		bCached = aImport.CachedLevels[Level].Open(GetMeshCachePath(aImport.LevelGeometries[Level]), LevelKeys[Level]);
+	if (bCached)
+	{
+		aImport.bLoaded = true;
+		aImport.bFromCache = true;
+		ReportMeshLoadTime(aImport.GeometryName, true, StartTime);
+		return;
 	}
-	else
+	aImport.CachedLevels.clear();
+
+	ModelImporter::ModelData ModelData;
+	if (!ModelImporter::LoadModel(aImport.Path, ModelData, true, false, false))
 	{
-		std::string Error = GeomertryName + " Failed to load model!\n";
+		std::string Error = aImport.GeometryName + " Failed to load model!\n";
 		::OutputDebugStringA(Error.c_str());
+		return;
 	}
-}
 
-void ShapesApp::BuildGeometryResource()
-{
-	CreateModelGeometry("Assets\\Models\\SMG\\M24_R_Low_Poly_Version_fbx.fbx", "SMG");
-	CreateModelGeometry("Assets\\Models\\Body.fbx", "Body");
-	CreateModelGeometry("Assets\\Models\\Skull\\skull_low.fbx", "Skull");
-	CreateModelGeometry("Assets\\Models\\Cross\\cross_low.fbx", "Cross");
+	std::string DebugMsg = aImport.GeometryName + " model loaded successfully:\n";
+	DebugMsg += "  Vertices: " + std::to_string(ModelData.Vertices.size()) + "\n";
+	DebugMsg += "  Indices: " + std::to_string(ModelData.Use32BitIndices ? ModelData.Indices32.size() : ModelData.Indices16.size()) + "\n";
+	DebugMsg += "  Submeshes: " + std::to_string(ModelData.Submeshes.size()) + "\n";
+	ReportMeshOptimization(aImport.LevelGeometries[0], ModelImporter::OptimizeModel(ModelData));
 
-	GeometryGenerator GeoGen;
-	//SkyBox
-	GeometryGenerator::MeshData SphereGeo = GeoGen.CreateSphere(1.0f, 24, 24);
-	auto SkyboxSphere = std::make_unique<MeshGeometry>();
-	SkyboxSphere->Name = "Skybox";
-	SkyboxSphere->VertexByteStride = sizeof(Vertex);
-	SkyboxSphere->VertexBufferByteSize = static_cast<UINT>(SphereGeo.Vertices.size() * sizeof(Vertex));
+	std::vector<ModelImporter::LodData> GeneratedLods = ModelImporter::GenerateLods(ModelData, aImport.TriangleRatios);
+	DebugMsg += "  Meshlets: " + std::to_string(ModelImporter::BuildMeshlets(ModelData, gMinClusterTriangles)) + "\n";
+	aImport.ImportedLevels.push_back(std::move(ModelData));
+	for (size_t Level = 0; Level < GeneratedLods.size(); Level++)
+	{
+		ModelImporter::ModelData& LevelData = GeneratedLods[Level].Model;
+		size_t IndexCount = LevelData.Use32BitIndices ? LevelData.Indices32.size() : LevelData.Indices16.size();
+		DebugMsg += "  LOD" + std::to_string(Level + 1) + ": " + std::to_string(IndexCount / 3) + " triangles, ratio "
+			+ std::to_string(GeneratedLods[Level].TriangleRatio) + ", error " + std::to_string(GeneratedLods[Level].Error) + "\n";
+
+		ReportMeshOptimization(aImport.LevelGeometries[Level + 1], ModelImporter::OptimizeModel(LevelData));
+		ModelImporter::BuildMeshlets(LevelData, gMinClusterTriangles);
+		aImport.ImportedLevels.push_back(std::move(LevelData));
+	}
+	::OutputDebugStringA(DebugMsg.c_str());
 
-	ThrowIfFailed(D3DCreateBlob(SkyboxSphere->VertexBufferByteSize, &SkyboxSphere->VertexBufferCPU));
-	memcpy(SkyboxSphere->VertexBufferCPU->GetBufferPointer(), SphereGeo.Vertices.data(), SkyboxSphere->VertexBufferByteSize);
+	for (size_t Level = 0; Level < aImport.ImportedLevels.size(); Level++)
+	{
+		std::vector<DirectX::BoundingBox> SubmeshBounds;
+		for (const auto& [SubmeshName, Submesh] : ModelImporter::BuildSubmeshGeometries(aImport.ImportedLevels[Level]))
+			SubmeshBounds.push_back(Submesh.Bounds);
+		std::string CachePath = GetMeshCachePath(aImport.LevelGeometries[Level]);
+		if (!MeshCache::Write(CachePath, aImport.ImportedLevels[Level], SubmeshBounds, LevelKeys[Level]))
+			::OutputDebugStringA((aImport.LevelGeometries[Level] + " Failed to write " + CachePath + "\n").c_str());
+	}
+	aImport.bLoaded = true;
+	ReportMeshLoadTime(aImport.GeometryName, false, StartTime);
+}
 
-	SkyboxSphere->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(DxDevice3D.Get(), CommandList.Get(),
-		SphereGeo.Vertices.data(), SkyboxSphere->VertexBufferByteSize, SkyboxSphere->VertexBufferUploader);
-	SkyboxSphere->VertexBufferGPU->SetName(L"Skybox_VB");
-	if (SkyboxSphere->VertexBufferUploader)
-		SkyboxSphere->VertexBufferUploader->SetName(L"Skybox_VB_Upload");
+bool ShapesApp::UploadModel(ModelImport& aImport)
+{
+	if (!aImport.bLoaded)
+		return false;
 
-	SkyboxSphere->IndexFormat = DXGI_FORMAT_R16_UINT;
-	SkyboxSphere->IndexBufferByteSize = static_cast<UINT>(SphereGeo.GetIndices16().size() * sizeof(uint16_t));
+	bool bAdded = true;
+	for (size_t Level = 0; Level < aImport.LevelGeometries.size(); Level++)
+	{
+		const std::string& LevelName = aImport.LevelGeometries[Level];
+		if (aImport.bFromCache)
+			bAdded &= CreateCachedGeometry(LevelName, aImport.CachedLevels[Level]);
+		else
+		{
+			auto Geometry = ModelImporter::CreateMeshGeometry(aImport.ImportedLevels[Level], *SharedGeometry, CommandList.Get(), LevelName,
+				bCompactVertices);
+			bAdded &= AddMeshGeometry(std::move(Geometry));
+		}
+	}
+	// A refused level leaves the previous geometry of its name in place, which must not become a level of the model
+	if (!aImport.TriangleRatios.empty() && bAdded)
+		CreateLodModel(aImport.GeometryName, aImport.LevelGeometries, aImport.ScreenSizes);
+
+	// Uploads are copied into upload buffers, the CPU data and mappings are no longer needed
+	aImport.CachedLevels.clear();
+	aImport.ImportedLevels.clear();
+	return bAdded;
+}
 
-	ThrowIfFailed(D3DCreateBlob(SkyboxSphere->IndexBufferByteSize, &SkyboxSphere->IndexBufferCPU));
-	memcpy(SkyboxSphere->IndexBufferCPU->GetBufferPointer(), SphereGeo.GetIndices16().data(), SkyboxSphere->IndexBufferByteSize);
+bool ShapesApp::CreateCachedGeometry(const std::string& aName, const MeshCache::CachedMesh& aMesh)
+{
+	std::vector<std::pair<std::string, SubmeshGeometry>> Submeshes;
+	for (size_t i = 0; i < aMesh.GetSubmeshes().size(); i++)
+	{
+		const ModelImporter::ModelData::Submesh& Cached = aMesh.GetSubmeshes()[i];
+		SubmeshGeometry Submesh;
+		Submesh.IndexCount = Cached.IndexCount;
+		Submesh.StartIndexLocation = Cached.StartIndexLocation;
+		Submesh.BaseVertexLocation = Cached.BaseVertexLocation;
+		Submesh.Bounds = aMesh.GetSubmeshBounds()[i];
+		Submesh.Meshlets = Cached.Meshlets;
+		Submeshes.emplace_back(Cached.Name, std::move(Submesh));
+	}
 
-	SkyboxSphere->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(DxDevice3D.Get(), CommandList.Get(),
-		SphereGeo.GetIndices16().data(), SkyboxSphere->IndexBufferByteSize, SkyboxSphere->IndexBufferUploader);
-	SkyboxSphere->IndexBufferGPU->SetName(L"Skybox_IB");
-	if (SkyboxSphere->IndexBufferUploader)
-		SkyboxSphere->IndexBufferUploader->SetName(L"Skybox_IB_Upload");
+	// The mapped arrays are copied into the upload buffers here, the mapping may close afterwards
+	auto Geometry = ModelImporter::CreateMeshGeometry(aMesh.GetMeshView(), std::move(Submeshes), *SharedGeometry, CommandList.Get(),
+		aName, bCompactVertices);
+	return AddMeshGeometry(std::move(Geometry));
+}
 
-	SubmeshGeometry SphereDrawArg;
-	SphereDrawArg.BaseVertexLocation = 0;
-	SphereDrawArg.StartIndexLocation = 0;
-	SphereDrawArg.IndexCount = static_cast<UINT>(SphereGeo.GetIndices16().size());
-	SphereDrawArg.Bounds = GeometryGenerator::CalculateBounds(SphereGeo.Vertices);
-	SkyboxSphere->DrawArgs["Base"] = SphereDrawArg;
-	MeshGeometries[SkyboxSphere->Name] = move(SkyboxSphere);
+bool ShapesApp::CreateGeneratedGeometry(const std::string& aName, GeometryGenerator::MeshData& aMeshData)
+{
+	ModelImporter::ModelData ModelData;
+	ModelData.Name = aName;
+	ModelData.Use32BitIndices = aMeshData.Vertices.size() > 65535;
+	ModelData.Submeshes.push_back({ "Base", static_cast<UINT>(aMeshData.Indices32.size()), 0, 0, 0 });
+	if (ModelData.Use32BitIndices)
+		ModelData.Indices32 = std::move(aMeshData.Indices32);
+	else
+		ModelData.Indices16 = aMeshData.GetIndices16();
+	ModelData.Vertices = std::move(aMeshData.Vertices);
+	ReportMeshOptimization(aName, ModelImporter::OptimizeModel(ModelData));
 
+	auto Geometry = ModelImporter::CreateMeshGeometry(ModelData, *SharedGeometry, CommandList.Get(), aName, bCompactVertices);
+	return AddMeshGeometry(std::move(Geometry));
+}
 
-	// Cube
-	GeometryGenerator::MeshData CubeGeo = GeoGen.CreateBox(1.0f, 1.0f, 1.0f, 0);
-	auto CubeMeshGeo = std::make_unique<MeshGeometry>();
-	CubeMeshGeo->Name = "Cube";
-	CubeMeshGeo->VertexByteStride = sizeof(Vertex);
-	CubeMeshGeo->VertexBufferByteSize = static_cast<UINT>(CubeGeo.Vertices.size() * sizeof(Vertex));
+bool ShapesApp::AddMeshGeometry(std::unique_ptr<MeshGeometry> aGeometry)
+{
+	if (MeshGeometries.count(aGeometry->Name) != 0 && !RemoveMeshGeometry(aGeometry->Name))
+	{
+		::OutputDebugStringA(("Geometry " + aGeometry->Name + " was not replaced, the new one is dropped\n").c_str());
+		SharedGeometry->Remove(*aGeometry);
+		return false;
+	}
+	aGeometry->Id = NextGeometryId++;
+	MeshGeometries[aGeometry->Name] = std::move(aGeometry);
+	return true;
+}
 
-	ThrowIfFailed(D3DCreateBlob(CubeMeshGeo->VertexBufferByteSize, &CubeMeshGeo->VertexBufferCPU));
-	memcpy(CubeMeshGeo->VertexBufferCPU->GetBufferPointer(), CubeGeo.Vertices.data(), CubeMeshGeo->VertexBufferByteSize);
+bool ShapesApp::RemoveMeshGeometry(const std::string& aName)
+{
+	auto GeometryIt = MeshGeometries.find(aName);
+	if (GeometryIt == MeshGeometries.end())
+		return false;
 
-	CubeMeshGeo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(DxDevice3D.Get(), CommandList.Get(),
-		CubeGeo.Vertices.data(), CubeMeshGeo->VertexBufferByteSize, CubeMeshGeo->VertexBufferUploader);
+	MeshGeometry* Geometry = GeometryIt->second.get();
+	for (const SceneStore::DrawArgs& DrawArgs : Scene.GetAllDrawArgs())
+	{
+		if (DrawArgs.MeshGeometryRef == Geometry)
+		{
+			::OutputDebugStringA(("Geometry " + aName + " is still drawn by a scene item\n").c_str());
+			return false;
+		}
+	}
+	for (const auto& [ModelName, Model] : LodModels)
+	{
+		if (std::find(Model.Levels.begin(), Model.Levels.end(), Geometry) != Model.Levels.end())
+		{
+			::OutputDebugStringA(("Geometry " + aName + " is a level of the LOD model " + ModelName + "\n").c_str());
+			return false;
+		}
+	}
 
-	CubeMeshGeo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	CubeMeshGeo->IndexBufferByteSize = static_cast<UINT>(CubeGeo.GetIndices16().size() * sizeof(uint16_t));
+	Scene.RemoveGeometryMeshes(Geometry->Id);
+	SharedGeometry->Remove(*Geometry);
+	MeshGeometries.erase(GeometryIt);
+	return true;
+}
 
-	ThrowIfFailed(D3DCreateBlob(CubeMeshGeo->IndexBufferByteSize, &CubeMeshGeo->IndexBufferCPU));
-	memcpy(CubeMeshGeo->IndexBufferCPU->GetBufferPointer(), CubeGeo.GetIndices16().data(), CubeMeshGeo->IndexBufferByteSize);
+void ShapesApp::BuildGeometryResource()
+{
+	// Cold start imports and cooks every model, warm starts map the cooked files
+	auto StartTime = std::chrono::steady_clock::now();
+	std::vector<ModelImport> Imports(6);
+	Imports[0] = { "Assets\\Models\\SMG\\M24_R_Low_Poly_Version_fbx.fbx", "SMG" };
+	Imports[1] = { "Assets\\Models\\Body.fbx", "Body" };
+	Imports[2] = { "Assets\\Models\\Skull\\skull_high.fbx", "Skull_LOD0" };
+	Imports[3] = { "Assets\\Models\\Skull\\skull_low.fbx", "Skull_LOD1" };
+	Imports[4] = { "Assets\\Models\\Skull\\skull_s.fbx", "Skull_LOD2" };
+	Imports[5] = { "Assets\\Models\\Cross\\cross_low.fbx", "Cross", { 0.5f, 0.2f }, { 0.2f, 0.06f } };
+
+	// Models import on worker threads, each into its own ModelImport, then upload in order on this thread. The
+	// results don't depend on the thread count. The per submesh loops of an import run inline on its worker.
+	ParallelFor(Imports.size(), 1, [&Imports](size_t aBegin, size_t aEnd)
+		{
+			for (size_t i = aBegin; i < aEnd; i++)
+				ImportModel(Imports[i]);
+		});
+	double ImportMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+	PROCESS_MEMORY_COUNTERS MemoryCounters = {};
+	::GetProcessMemoryInfo(::GetCurrentProcess(), &MemoryCounters, sizeof(MemoryCounters));
+	char Message[256];
+	snprintf(Message, sizeof(Message), "Models imported in %.2f ms, peak working set %.1f MB\n", ImportMilliseconds,
+		MemoryCounters.PeakWorkingSetSize / (1024.0 * 1024.0));
+	::OutputDebugStringA(Message);
+
+	for (ModelImport& Import : Imports)
+	{
+		if (!UploadModel(Import))
+			::OutputDebugStringA((Import.GeometryName + " Failed to upload model!\n").c_str());
+	}
+	CreateLodModel("Skull", { "Skull_LOD0", "Skull_LOD1", "Skull_LOD2" }, { 0.25f, 0.08f });
 
-	CubeMeshGeo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(DxDevice3D.Get(), CommandList.Get(),
-		CubeGeo.GetIndices16().data(), CubeMeshGeo->IndexBufferByteSize, CubeMeshGeo->IndexBufferUploader);
+	// Nothing is drawn yet, so no geometry of the same name can refuse these
+	GeometryGenerator GeoGen;
+	//SkyBox
+	GeometryGenerator::MeshData SphereGeo = GeoGen.CreateSphere(1.0f, 24, 24);
+	bool bGeneratedAdded = CreateGeneratedGeometry("Skybox", SphereGeo);
 
-	SubmeshGeometry CubeMeshPartition;
-	CubeMeshPartition.BaseVertexLocation = 0;
-	CubeMeshPartition.StartIndexLocation = 0;
-	CubeMeshPartition.IndexCount = static_cast<UINT>(CubeGeo.GetIndices16().size());
-	CubeMeshPartition.Bounds = GeometryGenerator::CalculateBounds(CubeGeo.Vertices);
-	CubeMeshGeo->DrawArgs["Base"] = CubeMeshPartition;
-	MeshGeometries[CubeMeshGeo->Name] = move(CubeMeshGeo);
+	// Cube
+	GeometryGenerator::MeshData CubeGeo = GeoGen.CreateBox(1.0f, 1.0f, 1.0f, 0);
+	bGeneratedAdded &= CreateGeneratedGeometry("Cube", CubeGeo);
 
 	// Surface geometry (1x1 quad, will be scaled and tiled in BuildRenderItems)
 	GeometryGenerator::MeshData SurfaceGeo = GeoGen.CreateQuad(-0.5f, -0.5f, 1.0f, 1.0f, 0.0f);
-	auto SurfaceMeshGeo = std::make_unique<MeshGeometry>();
-	SurfaceMeshGeo->Name = "Surface";
-	SurfaceMeshGeo->VertexByteStride = sizeof(Vertex);
-	SurfaceMeshGeo->VertexBufferByteSize = static_cast<UINT>(SurfaceGeo.Vertices.size() * sizeof(Vertex));
+	bGeneratedAdded &= CreateGeneratedGeometry("Surface", SurfaceGeo);
 
-	ThrowIfFailed(D3DCreateBlob(SurfaceMeshGeo->VertexBufferByteSize, &SurfaceMeshGeo->VertexBufferCPU));
-	memcpy(SurfaceMeshGeo->VertexBufferCPU->GetBufferPointer(), SurfaceGeo.Vertices.data(), SurfaceMeshGeo->VertexBufferByteSize);
-
-	SurfaceMeshGeo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(DxDevice3D.Get(), CommandList.Get(),
-		SurfaceGeo.Vertices.data(), SurfaceMeshGeo->VertexBufferByteSize, SurfaceMeshGeo->VertexBufferUploader);
-
-	SurfaceMeshGeo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	SurfaceMeshGeo->IndexBufferByteSize = static_cast<UINT>(SurfaceGeo.GetIndices16().size() * sizeof(uint16_t));
-
-	ThrowIfFailed(D3DCreateBlob(SurfaceMeshGeo->IndexBufferByteSize, &SurfaceMeshGeo->IndexBufferCPU));
-	memcpy(SurfaceMeshGeo->IndexBufferCPU->GetBufferPointer(), SurfaceGeo.GetIndices16().data(), SurfaceMeshGeo->IndexBufferByteSize);
+	//ShadowDebug Plane Layer
+	GeometryGenerator::MeshData QuadGeo = GeoGen.CreateQuad(0, 0, 1, 1, 0);
+	bGeneratedAdded &= CreateGeneratedGeometry("DebugQuad", QuadGeo);
+	assert(bGeneratedAdded && "A generated geometry was not added");
+	double Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+	::OutputDebugStringA(("Geometry built in " + std::to_string(Milliseconds) + " ms\n").c_str());
 
-	SurfaceMeshGeo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(DxDevice3D.Get(), CommandList.Get(),
-		SurfaceGeo.GetIndices16().data(), SurfaceMeshGeo->IndexBufferByteSize, SurfaceMeshGeo->IndexBufferUploader);
+	BuildPickingBvhs();
+}
 
-	SubmeshGeometry SurfaceMeshPartition;
-	SurfaceMeshPartition.BaseVertexLocation = 0;
-	SurfaceMeshPartition.StartIndexLocation = 0;
-	SurfaceMeshPartition.IndexCount = static_cast<UINT>(SurfaceGeo.GetIndices16().size());
-	SurfaceMeshPartition.Bounds = GeometryGenerator::CalculateBounds(SurfaceGeo.Vertices);
-	SurfaceMeshGeo->DrawArgs["Base"] = SurfaceMeshPartition;
-	MeshGeometries[SurfaceMeshGeo->Name] = move(SurfaceMeshGeo);
+void ShapesApp::BuildPickingBvhs()
+{
+	for (auto& [GeometryName, Geometry] : MeshGeometries)
+	{
+		if (!Geometry->VertexBufferCPU || !Geometry->IndexBufferCPU)
+			continue;
 
-	//ShadowDebug Plane Layer
-	GeometryGenerator::MeshData QuadGeo = GeoGen.CreateQuad(0, 0, 1, 1, 0);
-	auto DebugQuad = std::make_unique<MeshGeometry>();
-	DebugQuad->Name = "DebugQuad";
-	DebugQuad->VertexByteStride = sizeof(Vertex);
-	DebugQuad->VertexBufferByteSize = static_cast<UINT>(QuadGeo.Vertices.size() * sizeof(Vertex));
+		// Positions lead the full precision CPU vertices
+		size_t VertexCount = Geometry->VertexBufferCPU->GetBufferSize() / Geometry->VertexBufferCPUByteStride;
+		bool b32BitIndices = Geometry->IndexFormat == DXGI_FORMAT_R32_UINT;
+		const auto* Indices = static_cast<const std::uint8_t*>(Geometry->IndexBufferCPU->GetBufferPointer());
+		for (auto& [SubmeshName, Submesh] : Geometry->DrawArgs)
+		{
+			auto Bvh = std::make_shared<TriangleBVH>();
+			Bvh->Build(Geometry->VertexBufferCPU->GetBufferPointer(), Geometry->VertexBufferCPUByteStride, VertexCount,
+				Indices + Submesh.StartIndexLocation * (b32BitIndices ? 4 : 2), b32BitIndices, Submesh.IndexCount,
+				Submesh.BaseVertexLocation);
+			Submesh.PickingBvh = std::move(Bvh);
+		}
+	}
+}
 
-	ThrowIfFailed(D3DCreateBlob(DebugQuad->VertexBufferByteSize, &DebugQuad->VertexBufferCPU));
-	memcpy(DebugQuad->VertexBufferCPU->GetBufferPointer(), QuadGeo.Vertices.data(), DebugQuad->VertexBufferByteSize);
+void ShapesApp::CreateLodModel(const std::string& aName, const std::vector<std::string>& aLevelGeometries, const std::vector<float>& aScreenSizes)
+{
+	assert(aScreenSizes.size() + 1 == aLevelGeometries.size() && "One screen size per level but the last expected");
+	LodModel Model;
+	std::vector<float> ScreenSizes;
+	for (size_t Level = 0; Level < aLevelGeometries.size(); Level++)
+	{
+		auto GeometryIt = MeshGeometries.find(aLevelGeometries[Level]);
+		if (GeometryIt == MeshGeometries.end())
+		{
+			std::string ErrorMsg = "[Error] LOD model '" + aName + "' skips missing level '" + aLevelGeometries[Level] + "'\n";
+			::OutputDebugStringA(ErrorMsg.c_str());
+			continue;
+		}
 
-	DebugQuad->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(DxDevice3D.Get(), CommandList.Get(),
-		QuadGeo.Vertices.data(), DebugQuad->VertexBufferByteSize, DebugQuad->VertexBufferUploader);
+		// Levels are matched to the finest one by submesh name. Levels of a single submesh are matched
+		// whatever their name, e.g. levels authored in separate files.
+		const auto& LevelDrawArgs = GeometryIt->second->DrawArgs;
+		std::vector<std::string> LevelSubmeshes;
+		if (Model.Levels.empty())
+		{
+			for (const auto& [SubmeshName, Submesh] : LevelDrawArgs)
+				LevelSubmeshes.push_back(SubmeshName);
+		}
+		else if (LevelDrawArgs.size() == 1 && Model.Submeshes[0].size() == 1)
+			LevelSubmeshes.push_back(LevelDrawArgs.begin()->first);
+		else
+		{
+			for (const std::string& SubmeshName : Model.Submeshes[0])
+			{
+				if (LevelDrawArgs.find(SubmeshName) != LevelDrawArgs.end())
+					LevelSubmeshes.push_back(SubmeshName);
+			}
+		}
+		if (!Model.Levels.empty() && (LevelSubmeshes.size() != Model.Submeshes[0].size() || LevelDrawArgs.size() != LevelSubmeshes.size()))
+		{
+			std::string ErrorMsg = "[Error] LOD model '" + aName + "' skips level '" + aLevelGeometries[Level] + "', its submesh names differ\n";
+			::OutputDebugStringA(ErrorMsg.c_str());
+			assert(false && "LOD levels must have the submesh names of the finest level");
+			continue;
+		}
 
-	DebugQuad->IndexFormat = DXGI_FORMAT_R16_UINT;
-	DebugQuad->IndexBufferByteSize = static_cast<UINT>(QuadGeo.GetIndices16().size() * sizeof(uint16_t));
+		// A level left out passes its range on to the level drawn instead
+		if (!Model.Levels.empty())
+			ScreenSizes.push_back(aScreenSizes[Level - 1]);
+		Model.Levels.push_back(GeometryIt->second.get());
+		Model.Submeshes.push_back(std::move(LevelSubmeshes));
+	}
+	if (Model.Levels.empty())
+		return;
 
-	ThrowIfFailed(D3DCreateBlob(DebugQuad->IndexBufferByteSize, &DebugQuad->IndexBufferCPU));
-	memcpy(DebugQuad->IndexBufferCPU->GetBufferPointer(), QuadGeo.GetIndices16().data(), DebugQuad->IndexBufferByteSize);
+	Model.Group = Lods.AddGroup(ScreenSizes);
+	LodModels[aName] = std::move(Model);
+}
 
-	DebugQuad->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(DxDevice3D.Get(), CommandList.Get(),
-		QuadGeo.GetIndices16().data(), DebugQuad->IndexBufferByteSize, DebugQuad->IndexBufferUploader);
+void ShapesApp::UpdateLods()
+{
+	Lods.SetBias(LodBias);
+	// _22 of the projection is cot(FovY / 2)
+	size_t Changed = Lods.Select(Scene, ViewCamera->GetPosition3f(), ViewCamera->GetProj4x4f()._22);
+	CurrentFrameStats.LodSwitches += static_cast<UINT>(Changed);
 
-	SubmeshGeometry QuadQuad;
-	QuadQuad.BaseVertexLocation = 0;
-	QuadQuad.StartIndexLocation = 0;
-	QuadQuad.IndexCount = static_cast<UINT>(QuadGeo.GetIndices16().size());
-	QuadQuad.Bounds = GeometryGenerator::CalculateBounds(QuadGeo.Vertices);
-	DebugQuad->DrawArgs["Base"] = QuadQuad;
-	MeshGeometries[DebugQuad->Name] = move(DebugQuad);
+	// Every pass draws the new level, like for a moved item the cached shadows and probe faces under it are stale
+	for (RenderItemId Id : Lods.GetChangedItems())
+	{
+		if (Scene.GetLayer(Id) != (UINT)RenderLayer::Opaque)
+			continue;
+		DirectX::BoundingBox Bounds = Scene.GetWorldBounds(Id);
+		if (!Scene.IsDynamic(Id))
+			StaticShadowCache.InvalidateBounds(Bounds);
+		Probes.InvalidateBounds(Bounds);
+	}
 }
 
 void ShapesApp::ModelToRenderItem(const std::string& meshKey, UINT& objIndex, Material* material,
 	const DirectX::XMMATRIX& worldTransform, RenderLayer layer)
 {
+	auto LodIt = LodModels.find(meshKey);
+	if (LodIt != LodModels.end())
+	{
+		// Items start at the finest level, see CreateLodModel for how the submeshes of the other levels are matched
+		const LodModel& Model = LodIt->second;
+		MeshGeometry* Finest = Model.Levels[0];
+		std::vector<SceneStore::DrawArgs> LevelDrawArgs;
+		for (size_t SubmeshIndex = 0; SubmeshIndex < Model.Submeshes[0].size(); SubmeshIndex++)
+		{
+			const std::string& submeshName = Model.Submeshes[0][SubmeshIndex];
+			std::string Name = meshKey + "_" + std::to_string(objIndex++) + "_" + submeshName;
+			RenderItemId Id = AddRenderItem(Name, worldTransform, Finest, Finest->DrawArgs.at(submeshName), material, layer);
+			if (Id != SceneStore::InvalidItem)
+			{
+				LevelDrawArgs.clear();
+				for (size_t Level = 0; Level < Model.Levels.size(); Level++)
+					LevelDrawArgs.push_back(MakeDrawArgs(Model.Levels[Level], Model.Levels[Level]->DrawArgs.at(Model.Submeshes[Level][SubmeshIndex])));
+				Lods.AddItem(Id, Model.Group, LevelDrawArgs);
+			}
+		}
+		return;
+	}
+
 	if (MeshGeometries.find(meshKey) != MeshGeometries.end())
 	{
 		auto MeshGeo = MeshGeometries[meshKey].get();
 		for (const auto& [submeshName, submesh] : MeshGeo->DrawArgs)
 		{
-			std::unique_ptr<RenderItem> NewRenderItem = std::make_unique<RenderItem>();
-			NewRenderItem->Name = meshKey + "_" + std::to_string(objIndex) + "_" + submeshName;
-			DirectX::XMStoreFloat4x4(&NewRenderItem->World, worldTransform);
-			NewRenderItem->ObjConstBufferIndex = objIndex++;
-			NewRenderItem->MeshGeometryRef = MeshGeo;
-			NewRenderItem->MaterialRef = material;
-			NewRenderItem->IndexCount = submesh.IndexCount;
-			NewRenderItem->IndexStartLocation = submesh.StartIndexLocation;
-			NewRenderItem->VertexStartLocation = submesh.BaseVertexLocation;
-			NewRenderItem->Bounds = submesh.Bounds;
-			AddRenderItem(std::move(NewRenderItem), layer);
+			std::string Name = meshKey + "_" + std::to_string(objIndex++) + "_" + submeshName;
+			AddRenderItem(Name, worldTransform, MeshGeo, submesh, material, layer);
+		}
+	}
+}
+
+void ShapesApp::SpawnMeshInstances(const std::string& meshKey, UINT& objIndex, Material* material,
+	const std::vector<DirectX::XMFLOAT4X4>& worldTransforms, RenderLayer layer)
+{
+	auto MeshIt = MeshGeometries.find(meshKey);
+	if (MeshIt == MeshGeometries.end())
+	{
+		std::string ErrorMsg = "[Error] Cannot spawn instances of unknown mesh '" + meshKey + "'\n";
+		::OutputDebugStringA(ErrorMsg.c_str());
+		return;
+	}
+
+	auto MeshGeo = MeshIt->second.get();
+	Scene.Reserve(Scene.GetItemCount() + worldTransforms.size() * MeshGeo->DrawArgs.size());
+	for (const auto& WorldTransform : worldTransforms)
+	{
+		DirectX::XMMATRIX XWorld = DirectX::XMLoadFloat4x4(&WorldTransform);
+		UINT InstanceIndex = objIndex++;
+		for (const auto& [submeshName, submesh] : MeshGeo->DrawArgs)
+		{
+			std::string Name = meshKey + "_" + std::to_string(InstanceIndex) + "_" + submeshName;
+			AddRenderItem(Name, XWorld, MeshGeo, submesh, material, layer);
 		}
 	}
 }
@@ -1220,65 +2216,56 @@ void ShapesApp::BuildRenderItems()
 		DirectX::XMMatrixIdentity(),
 		RenderLayer::ShadowDebug);
 
-	std::unique_ptr<RenderItem> CubeMesh = std::make_unique<RenderItem>();
-	CubeMesh->Name = std::string("CubeMesh_") + "Base";
-	DirectX::XMStoreFloat4x4(&CubeMesh->World, DirectX::XMMatrixTranslation(3.0f, -1.5f, 2.0f));  // Move cube away from z=0
-	CubeMesh->ObjConstBufferIndex = objIndex++;
-	CubeMesh->MeshGeometryRef = MeshGeometries["Cube"].get();
-	CubeMesh->MaterialRef = BuildOrGetMaterial("CubeMesh", "ice", "default_nmap",
-		1.0f, .5f, .5f, 1);
-	CubeMesh->IndexCount = CubeMesh->MeshGeometryRef->DrawArgs["Base"].IndexCount;
-	CubeMesh->IndexStartLocation = CubeMesh->MeshGeometryRef->DrawArgs["Base"].StartIndexLocation;
-	CubeMesh->VertexStartLocation = CubeMesh->MeshGeometryRef->DrawArgs["Base"].BaseVertexLocation;
-	CubeMesh->Bounds = CubeMesh->MeshGeometryRef->DrawArgs["Base"].Bounds;
-	AddRenderItem(std::move(CubeMesh), RenderLayer::Opaque);
-
-	std::unique_ptr<RenderItem> SurfaceMesh = std::make_unique<RenderItem>();
-	SurfaceMesh->Name = std::string("SurfaceMesh_") + "Base";
-	DirectX::XMStoreFloat4x4(&SurfaceMesh->World, DirectX::XMMatrixScaling(10, 10, 1)
-		* DirectX::XMMatrixRotationX(DirectX::XM_PIDIV2) * DirectX::XMMatrixTranslation(0.0f, -2.0f, 0.0f));
-	SurfaceMesh->ObjConstBufferIndex = objIndex++;
-	SurfaceMesh->MeshGeometryRef = MeshGeometries["Surface"].get();
-	SurfaceMesh->MaterialRef = BuildOrGetMaterial("SurfaceMesh", "ice", "default_nmap",
-		1.0f, .2f, .9f, 1);
-	SurfaceMesh->IndexCount = SurfaceMesh->MeshGeometryRef->DrawArgs["Base"].IndexCount;
-	SurfaceMesh->IndexStartLocation = SurfaceMesh->MeshGeometryRef->DrawArgs["Base"].StartIndexLocation;
-	SurfaceMesh->VertexStartLocation = SurfaceMesh->MeshGeometryRef->DrawArgs["Base"].BaseVertexLocation;
-	SurfaceMesh->Bounds = SurfaceMesh->MeshGeometryRef->DrawArgs["Base"].Bounds;
-	AddRenderItem(std::move(SurfaceMesh), RenderLayer::Opaque);
-
-	std::unique_ptr<RenderItem> SkyBoxMesh = std::make_unique<RenderItem>();
-	SkyBoxMesh->Name = std::string("SkyBoxMesh_") + "Base";
-	DirectX::XMStoreFloat4x4(&SkyBoxMesh->World, DirectX::XMMatrixScaling(500, 500, 500));
-	SkyBoxMesh->ObjConstBufferIndex = objIndex++;
-	SkyBoxMesh->MeshGeometryRef = MeshGeometries["Skybox"].get();
-	SkyBoxMesh->MaterialRef = BuildOrGetMaterial("Reflection", "white1x1", "default_nmap",
-		.05f, .95f, .95f, 1);
-	SkyBoxMesh->IndexCount = SkyBoxMesh->MeshGeometryRef->DrawArgs["Base"].IndexCount;
-	SkyBoxMesh->IndexStartLocation = SkyBoxMesh->MeshGeometryRef->DrawArgs["Base"].StartIndexLocation;
-	SkyBoxMesh->VertexStartLocation = SkyBoxMesh->MeshGeometryRef->DrawArgs["Base"].BaseVertexLocation;
-	SkyBoxMesh->Bounds = SkyBoxMesh->MeshGeometryRef->DrawArgs["Base"].Bounds;
-	AddRenderItem(std::move(SkyBoxMesh), RenderLayer::Skybox);
-
-	std::unique_ptr<RenderItem> ReflectionSphere = std::make_unique<RenderItem>();
-	ReflectionSphere->Name = std::string("ReflectionSphere_") + "Base";
-	DirectX::XMStoreFloat4x4(&ReflectionSphere->World, DirectX::XMMatrixScaling(.5f, .5f, .5f));
-	ReflectionSphere->ObjConstBufferIndex = objIndex++;
-	ReflectionSphere->MeshGeometryRef = MeshGeometries["Skybox"].get();
-	ReflectionSphere->MaterialRef = GetMaterial("Reflection");
-	ReflectionSphere->IndexCount = ReflectionSphere->MeshGeometryRef->DrawArgs["Base"].IndexCount;
-	ReflectionSphere->IndexStartLocation = ReflectionSphere->MeshGeometryRef->DrawArgs["Base"].StartIndexLocation;
-	ReflectionSphere->VertexStartLocation = ReflectionSphere->MeshGeometryRef->DrawArgs["Base"].BaseVertexLocation;
-	ReflectionSphere->Bounds = ReflectionSphere->MeshGeometryRef->DrawArgs["Base"].Bounds;
-	AddRenderItem(std::move(ReflectionSphere), RenderLayer::Reflection);
+	AddRenderItem(std::string("CubeMesh_") + "Base", DirectX::XMMatrixTranslation(3.0f, -1.5f, 2.0f),  // Move cube away from z=0
+		MeshGeometries["Cube"].get(), MeshGeometries["Cube"]->DrawArgs["Base"],
+		BuildOrGetMaterial("CubeMesh", "ice", "default_nmap", 1.0f, .5f, .5f, 1),
+		RenderLayer::Opaque);
+
+	AddRenderItem(std::string("SurfaceMesh_") + "Base", DirectX::XMMatrixScaling(10, 10, 1)
+		* DirectX::XMMatrixRotationX(DirectX::XM_PIDIV2) * DirectX::XMMatrixTranslation(0.0f, -2.0f, 0.0f),
+		MeshGeometries["Surface"].get(), MeshGeometries["Surface"]->DrawArgs["Base"],
+		BuildOrGetMaterial("SurfaceMesh", "ice", "default_nmap", 1.0f, .2f, .9f, 1),
+		RenderLayer::Opaque);
+
+	AddRenderItem(std::string("SkyBoxMesh_") + "Base", DirectX::XMMatrixScaling(500, 500, 500),
+		MeshGeometries["Skybox"].get(), MeshGeometries["Skybox"]->DrawArgs["Base"],
+		BuildOrGetMaterial("Reflection", "white1x1", "default_nmap", .05f, .95f, .95f, 1),
+		RenderLayer::Skybox);
+
+	AddRenderItem(std::string("ReflectionSphere_") + "Base", DirectX::XMMatrixScaling(.5f, .5f, .5f),
+		MeshGeometries["Skybox"].get(), MeshGeometries["Skybox"]->DrawArgs["Base"],
+		GetMaterial("Reflection"),
+		RenderLayer::Reflection);
+
+	// Stress scene for the instanced draw path: the cubes share one submesh and material
+	if (InstancedCubeGrid > 0)
+	{
+		std::vector<DirectX::XMFLOAT4X4> CubeWorlds(InstancedCubeGrid * InstancedCubeGrid);
+		float Spacing = 10.0f / InstancedCubeGrid;
+		float CubeScale = 0.5f * Spacing;
+		for (UINT z = 0; z < InstancedCubeGrid; z++)
+		{
+			for (UINT x = 0; x < InstancedCubeGrid; x++)
+			{
+				DirectX::XMStoreFloat4x4(&CubeWorlds[z * InstancedCubeGrid + x],
+					DirectX::XMMatrixScaling(CubeScale, CubeScale, CubeScale) *
+					DirectX::XMMatrixTranslation(-5.0f + (x + 0.5f) * Spacing, -2.0f + 0.5f * CubeScale, -5.0f + (z + 0.5f) * Spacing));
+			}
+		}
+		SpawnMeshInstances("Cube", objIndex, GetMaterial("CubeMesh"), CubeWorlds, RenderLayer::Opaque);
+	}
 }
 
 void ShapesApp::BuildFrameResources()
 {
-	UINT RenderItemCount = static_cast<UINT>(RenderItems.size()); //Total Const Buffer Data we needed
-	UINT TotalPass = 8; // MainPass(1) + ShadowPass(1) + CubeMapPass(6)
+	UINT RenderItemCount = static_cast<UINT>(Scene.GetItemCount()); //Total Instance Data we needed
+	UINT MaterialCount = static_cast<UINT>(Materials.size());
+	UINT TotalPass = TotalPassCount; // MainPass(1) + CubeMapPass(6 per probe) + ShadowPass(one per cascade)
+	// Every item is drawn at most once per pass
+	UINT InstanceIndexCount = RenderItemCount * TotalPass;
 	for (UINT i = 0; i < TotalFrameResources; i++)
-		FrameResources.push_back(std::make_unique<FrameResource<PassConstBuffer, ObjConstBuffer, MaterialConstBuffer>>(DxDevice3D.Get(), TotalPass, RenderItemCount, RenderItemCount));
+		FrameResources.push_back(std::make_unique<FrameResource<PassConstBuffer, InstanceData, MaterialBufferData>>(DxDevice3D.Get(), GpuMemory.get(),
+			TotalPass, RenderItemCount, InstanceIndexCount, MaterialCount, gMaxClusterDraws));
 }
 
 void ShapesApp::BuildDescriptorHeap()
@@ -1327,6 +2314,13 @@ void ShapesApp::BuildPSO()
 	OpaquePsoDesc.SampleDesc.Quality = 0;
 	ThrowIfFailed(DxDevice3D->CreateGraphicsPipelineState(&OpaquePsoDesc, IID_PPV_ARGS(&PSO["Opaque"])));
 
+	// PSO for reflective items, samples the reflection probe cube array
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC ReflectionPsoDesc = OpaquePsoDesc;
+	ReflectionPsoDesc.PS =
+	{ reinterpret_cast<BYTE*>(Shaders["ReflectionPS"]->GetBufferPointer()),
+		Shaders["ReflectionPS"]->GetBufferSize() };
+	ThrowIfFailed(DxDevice3D->CreateGraphicsPipelineState(&ReflectionPsoDesc, IID_PPV_ARGS(&PSO["Reflection"])));
+
 	//
 	 // PSO for shadow map pass.
 	 //
@@ -1334,6 +2328,8 @@ void ShapesApp::BuildPSO()
 	smapPsoDesc.RasterizerState.DepthBias = 1000;
 	smapPsoDesc.RasterizerState.DepthBiasClamp = 0.0f;
 	smapPsoDesc.RasterizerState.SlopeScaledDepthBias = 2.0f;
+	// Casters between the light and a cascade's near plane are clamped to it instead of clipped
+	smapPsoDesc.RasterizerState.DepthClipEnable = FALSE;
 	smapPsoDesc.pRootSignature = RootSignature.Get();
 	smapPsoDesc.VS =
 	{
@@ -1378,6 +2374,12 @@ void ShapesApp::BuildPSO()
 		Shaders["SkyPixel"]->GetBufferSize()
 	};
 	ThrowIfFailed(DxDevice3D->CreateGraphicsPipelineState(&SkyPsoDesc, IID_PPV_ARGS(&PSO["Sky"])));
+
+	for (auto& [PsoName, PsoRef] : PSO)
+	{
+		PsoIds[PsoName] = static_cast<UINT>(PsoTable.size());
+		PsoTable.push_back(PsoRef.Get());
+	}
 }
 
 void ShapesApp::SaveRenderItemsData()
@@ -1385,17 +2387,17 @@ void ShapesApp::SaveRenderItemsData()
 	std::ofstream OfileStream("RenderItems_metadata.txt");
 	if (!OfileStream.is_open())
 		return;
-	auto& OpaqRItems = RenderLayerItems[(int)RenderLayer::Opaque];
-	auto& RefRItems = RenderLayerItems[(int)RenderLayer::Reflection];
-	std::vector<RenderItem*> AllowedRenderItems;
+	auto& OpaqRItems = Scene.GetLayerItems((int)RenderLayer::Opaque);
+	auto& RefRItems = Scene.GetLayerItems((int)RenderLayer::Reflection);
+	std::vector<RenderItemId> AllowedRenderItems;
 	AllowedRenderItems.reserve(OpaqRItems.size() + RefRItems.size());
 	AllowedRenderItems.insert(AllowedRenderItems.begin(), OpaqRItems.begin(), OpaqRItems.end());
 	AllowedRenderItems.insert(AllowedRenderItems.begin(), RefRItems.begin(), RefRItems.end());
 
 	for (auto RenderItem : AllowedRenderItems)
 	{
-		auto world = RenderItem->World;
-		OfileStream << RenderItem->Name << " "
+		const auto& world = Scene.GetWorld(RenderItem);
+		OfileStream << Scene.GetName(RenderItem) << " "
 			<< world._11 << " " << world._12 << " " << world._13 << " " << world._14 << " "
 			<< world._21 << " " << world._22 << " " << world._23 << " " << world._24 << " "
 			<< world._31 << " " << world._32 << " " << world._33 << " " << world._34 << " "
@@ -1411,13 +2413,6 @@ void ShapesApp::LoadRenderItemsData()
 	if (!IfileStream.is_open())
 		return;
 
-	auto& OpaqRItems = RenderLayerItems[(int)RenderLayer::Opaque];
-	auto& RefRItems = RenderLayerItems[(int)RenderLayer::Reflection];
-	std::vector<RenderItem*> AllowedRenderItems;
-	AllowedRenderItems.reserve(OpaqRItems.size() + RefRItems.size());
-	AllowedRenderItems.insert(AllowedRenderItems.begin(), OpaqRItems.begin(), OpaqRItems.end());
-	AllowedRenderItems.insert(AllowedRenderItems.begin(), RefRItems.begin(), RefRItems.end());
-
 	std::string StringLine;
 	while (std::getline(IfileStream, StringLine))
 	{
@@ -1431,50 +2426,55 @@ void ShapesApp::LoadRenderItemsData()
 			>> RiWorld._31 >> RiWorld._32 >> RiWorld._33 >> RiWorld._34
 			>> RiWorld._41 >> RiWorld._42 >> RiWorld._43 >> RiWorld._44)
 		{
-			for (auto& RenderItem : AllowedRenderItems)
-			{
-				if (RenderItem->Name == RiName)
-				{
-					RenderItem->World = RiWorld;
-					break;
-				}
-			}
+			RenderItemId RenderItem = Scene.FindItem(RiName);
+			RenderLayer Layer = Scene.IsValid(RenderItem) ? (RenderLayer)Scene.GetLayer(RenderItem) : RenderLayer::Count;
+			if (Layer == RenderLayer::Opaque || Layer == RenderLayer::Reflection)
+				SetItemWorld(RenderItem, RiWorld);
 		}
 	}
 	IfileStream.close();
 	OutputDebugStringA("Rendered Items World Location Loaded");
 }
 
-ShapesApp::RenderItem* ShapesApp::AddRenderItem(std::unique_ptr<RenderItem> aRenderItem, RenderLayer aLayer)
+SceneStore::DrawArgs ShapesApp::MakeDrawArgs(MeshGeometry* aMeshGeometry, const SubmeshGeometry& aSubmesh)
 {
-	if (!aRenderItem)
+	SceneStore::DrawArgs DrawArgs;
+	DrawArgs.MeshGeometryRef = aMeshGeometry;
+	DrawArgs.GeometryId = aMeshGeometry->Id;
+	DrawArgs.IndexCount = aSubmesh.IndexCount;
+	DrawArgs.IndexStartLocation = aSubmesh.StartIndexLocation;
+	DrawArgs.VertexStartLocation = aSubmesh.BaseVertexLocation;
+	DrawArgs.PickingBvh = aSubmesh.PickingBvh.get();
+	DrawArgs.PositionDequant = aSubmesh.PositionDequant;
+	DrawArgs.Meshlets = aSubmesh.Meshlets.data();
+	DrawArgs.MeshletCount = static_cast<std::uint32_t>(aSubmesh.Meshlets.size());
+	return DrawArgs;
+}
+
+ShapesApp::RenderItemId ShapesApp::AddRenderItem(const std::string& aName, const DirectX::XMMATRIX& aWorld,
+	MeshGeometry* aMeshGeometry, const SubmeshGeometry& aSubmesh, Material* aMaterial, RenderLayer aLayer)
+{
+	if (!aMeshGeometry || !aMaterial)
 	{
-		std::string ErrorMsg = "[Error] Attempted to add null RenderItem\n";
+		std::string ErrorMsg = "[Error] Attempted to add RenderItem '" + aName + "' without geometry or material\n";
 		::OutputDebugStringA(ErrorMsg.c_str());
-		assert(false && "Attempted to add null RenderItem");
-		return nullptr;
+		assert(false && "Attempted to add RenderItem without geometry or material");
+		return SceneStore::InvalidItem;
 	}
 
-	// Check for duplicate name
-	for (const auto& ExistingItem : RenderItems)
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMStoreFloat4x4(&World, aWorld);
+
+	// SceneStore rejects duplicate names
+	RenderItemId Id = Scene.AddItem(aName, (std::uint32_t)aLayer, World, aSubmesh.Bounds, MakeDrawArgs(aMeshGeometry, aSubmesh),
+		(std::uint32_t)aMaterial->MatCBIndex);
+	if (Id == SceneStore::InvalidItem)
 	{
-		if (ExistingItem->Name == aRenderItem->Name)
-		{
-			std::string ErrorMsg = "[Error] RenderItem with name '" + aRenderItem->Name + "' already exists\n";
-			::OutputDebugStringA(ErrorMsg.c_str());
-			assert(false && "RenderItem with duplicate name already exists");
-			return nullptr;
-		}
+		std::string ErrorMsg = "[Error] RenderItem with name '" + aName + "' already exists\n";
+		::OutputDebugStringA(ErrorMsg.c_str());
+		assert(false && "RenderItem with duplicate name already exists");
+		return Id;
 	}
-
-	// Get raw pointer before moving
-	RenderItem* RawPtr = aRenderItem.get();
-
-	// Add to main RenderItems vector
-	RenderItems.push_back(std::move(aRenderItem));
-
-	// Add to appropriate layer
-	RenderLayerItems[(int)aLayer].push_back(RawPtr);
-
-	return RawPtr;
+	SceneTree.Update(Id, Scene.GetWorldBounds(Id));
+	return Id;
 }
@@ -8,9 +8,27 @@
 #include "Base/ShadowMap.h"
 #include "Base/CubeMapRt.h"
 #include "Base/Camera.h"
+#include "Base/SceneStore.h"
+#include "Base/RenderQueue.h"
+#include "Base/FrustumCuller.h"
+#include "Base/CascadedShadows.h"
+#include "Base/ShadowCache.h"
+#include "Base/ProbeScheduler.h"
+#include "Base/ProbeLookup.h"
+#include "Base/TriangleBVH.h"
+#include "Base/SceneBVH.h"
+#include "Base/OcclusionCuller.h"
+#include "Base/ClusterCuller.h"
+#include "Base/LodSelector.h"
+#include "Utility/GeometryGenerator.h"
+#include "Utility/MeshCache.h"
+#include "Utility/GeometryPool.h"
+#include <functional>
 
 // Maximum number of textures that can be bound at once
 static constexpr UINT MAX_TEXTURES = 512;
+// Cubes in the reflection probe array
+static constexpr UINT MAX_REFLECTION_PROBES = 8;
 
 enum class RenderLayer
 {
@@ -42,31 +60,180 @@ public:
 	virtual void OnMouseMove(WPARAM BtnState, int X, int Y) override;
 
 private:
-	struct RenderItem;
-	struct ObjConstBuffer;
+	using RenderItemId = SceneStore::ItemId;
+	struct InstanceData;
 	struct PassConstBuffer;
-	struct MaterialConstBuffer;
+	struct MaterialBufferData;
+
+	// Pass constant buffer slots of a frame resource
+	static constexpr UINT MainPassIndex = 0;
+	static constexpr UINT CubeFacePassIndex = 1;	// 6 faces per reflection probe
+	static constexpr UINT ShadowPassIndex = CubeFacePassIndex + 6 * MAX_REFLECTION_PROBES;	// One per cascade
+	static constexpr UINT TotalPassCount = ShadowPassIndex + CascadedShadows::MaxCascades;
+
+	// Per-frame counters, accumulated and printed to the debug output once per second
+	struct FrameStats
+	{
+		UINT ObjectsUploaded = 0;
+		UINT MaterialsUploaded = 0;
+		UINT DrawCalls = 0;
+		UINT InstancesDrawn = 0;
+		UINT64 TrianglesDrawn = 0;			// Over every pass
+		UINT LodSwitches = 0;
+		UINT QueuedItems = 0;
+		UINT CulledItems = 0;
+		UINT OcclusionCulledItems = 0;		// Part of CulledItems, in view but behind occluders
+		UINT OccluderTriangles = 0;
+		UINT StateChanges = 0;
+		UINT StateChangesSaved = 0;			// Queue transitions in submission order minus those once sorted
+		double SortMilliseconds = 0.0;
+		UINT CubeFaceDrawCalls[6] = {};
+		UINT CubeFaceItems[6] = {};
+		UINT CubeFacesRendered = 0;
+		UINT ShadowCastersSubmitted = 0;
+		UINT ShadowCastersLightCulled = 0;		// Outside the light volume
+		UINT ShadowCastersReceiverCulled = 0;	// Shadow cannot reach a visible receiver
+		UINT StaticShadowSlicesRendered = 0;	// Cascades whose cached static layer was (partly) re-rendered
+		UINT64 StaticShadowTexelsRendered = 0;
+		UINT ClustersTested = 0;
+		UINT ClustersFrustumCulled = 0;
+		UINT ClustersBackfaceCulled = 0;
+		UINT ClustersSmallCulled = 0;
+		UINT ClusterDraws = 0;					// Index ranges left after merging neighbours, part of DrawCalls
+
+		void Add(const FrameStats& aOther);
+	};
+
+	// Reflection probe rendered by DrawSceneToCubeMap into its cube of the probe array
+	struct ProbeSettings
+	{
+		DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+		float InfluenceRadius = 100.0f;		// Items whose bounds lie entirely farther away are skipped, 0 disables
+		float MinProjectedSize = 2.0f;		// In face pixels, smaller items are skipped, 0 disables
+		float NearZ = 0.1f;
+		float FarZ = 1000.0f;
+		// Faces are only re-rendered when an item within the influence sphere moves
+		ProbeScheduler::UpdatePolicy Policy = ProbeScheduler::UpdatePolicy::OnChange;
+		UINT FacesPerFrame = 1;		// Always policy only
+	};
+
+	// A layer drawn within a pass, layers are drawn in the order they are queued
+	struct LayerDraw
+	{
+		RenderLayer Layer;
+		const char* PsoName;
+		bool bSortByDepth;
+		bool bFrustumCull;		// False for layers positioned by their shaders (sky, debug quad)
+	};
+
+	// Items a pass draws, see SceneStore::IsDynamic
+	enum class MobilityFilter
+	{
+		All,
+		StaticOnly,
+		DynamicOnly
+	};
+
+	// View of a pass, used for frustum culling and for the front to back depth of the sort keys
+	struct PassView
+	{
+		DirectX::XMFLOAT4X4 ViewProj;
+		DirectX::XMFLOAT3 Eye;
+		DirectX::XMFLOAT3 Look;
+		float MaxDepth = 0.0f;
+		// Range limits around Eye, see FrustumCuller::SetRangeLimits
+		float MaxDistance = 0.0f;
+		float MinProjectedSize = 0.0f;
+		float ProjectionScale = 0.0f;
+		bool bShadowCasters = false;	// Cull as shadow casters of the light described by this view
+		bool bReceiverCulling = true;	// Shadow casters only, see CullShadowCasters
+		bool bOcclusionCulling = false;	// Test against the occluders of RenderOccluders, which must use the same view
+		bool bClusterCulling = false;	// Cull the meshlets of single drawn items, needs ProjectionScale
+		MobilityFilter Mobility = MobilityFilter::All;
+	};
 
 	void BuildRootSignature();
 	void BuildShadersAndInputLayout();
-	void CreateModelGeometry(std::string Path, std::string GeomertryName);
+	// A model file to import as GeometryName. With TriangleRatios it is loaded as GeometryName_LOD0 and simplified to
+	// the ratios as GeometryName_LOD1.., then GeometryName becomes a LOD model of them, see ModelImporter::GenerateLods
+	// and CreateLodModel.
+	struct ModelImport
+	{
+		std::string Path;
+		std::string GeometryName;
+		std::vector<float> TriangleRatios;
+		std::vector<float> ScreenSizes;
+
+		// Filled by ImportModel, one entry per level
+		std::vector<std::string> LevelGeometries;
+		std::vector<MeshCache::CachedMesh> CachedLevels;
+		std::vector<ModelImporter::ModelData> ImportedLevels;
+		bool bLoaded = false;
+		bool bFromCache = false;
+	};
+	// CPU phase of a model import, safe to run for several models at once as it touches no renderer state. Maps the
+	// cooked files of every level when they were written from the same source and settings, otherwise imports Path with
+	// Assimp, optimizes and simplifies it and cooks the levels, see MeshCache.
+	static void ImportModel(ModelImport& aImport);
+	// GPU phase on the render thread, records the uploads of the levels and releases the CPU data. False when the import
+	// failed or a level was not added, see AddMeshGeometry; the LOD model is then not created.
+	bool UploadModel(ModelImport& aImport);
+	// Uploads a mapped cooked mesh as aName, false when it was not added
+	bool CreateCachedGeometry(const std::string& aName, const MeshCache::CachedMesh& aMesh);
+	// Optimizes and uploads a GeometryGenerator mesh as aName with the single submesh "Base", its vertices and 32 bit
+	// indices are moved out. False when it was not added.
+	bool CreateGeneratedGeometry(const std::string& aName, GeometryGenerator::MeshData& aMeshData);
 	void BuildGeometryResource();
+	// Gives aGeometry its id and stores it by name, replacing a geometry of the same name. Returns false and frees
+	// aGeometry when that one is still drawn.
+	bool AddMeshGeometry(std::unique_ptr<MeshGeometry> aGeometry);
+	// Releases the pool ranges of aName, its scene mesh ids and forgets it. Refused while a scene item or LOD model
+	// still draws it.
+	bool RemoveMeshGeometry(const std::string& aName);
+	// Triangle BVH of every submesh, used by Pick
+	void BuildPickingBvhs();
+	// Makes aName a LOD model of the geometries aLevelGeometries, finest first, see LodSelector::AddGroup.
+	// Submeshes are matched to the first level by name, levels that are missing or lack one of its submesh names
+	// are left out. Single submesh levels are matched whatever their names.
+	void CreateLodModel(const std::string& aName, const std::vector<std::string>& aLevelGeometries, const std::vector<float>& aScreenSizes);
 	void BuildRenderItems();
 	void BuildFrameResources();
 	void BuildDescriptorHeap();
 	void BuildPSO();
 	//OnDraw
 	void UpdateConstBuffers();
-	void DrawRenderItems(ID3D12GraphicsCommandList* CommandList, std::vector<RenderItem*>& RenderItem);
+	// Picks the level of every LOD model item from its size in ViewCamera
+	void UpdateLods();
+	void ReportFrameStats(float DeltaTime);
+	void QueueRenderLayers(const LayerDraw* aLayers, UINT aLayerCount, const PassView& aView);
+	// Draws the sorted queue, aOnLayerBegin is called before the first draw of every queued layer
+	void DrawRenderQueue(ID3D12GraphicsCommandList* CommandList, const std::function<void(RenderLayer)>& aOnLayerBegin = nullptr);
+	// PSO, vertex buffer, index buffer and topology binds between consecutive entries of DrawQueue
+	UINT CountQueueStateChanges() const;
+	// Draws the visible meshlet ranges of a single item, indirectly while the frame's argument buffer has room
+	void DrawClusters(ID3D12GraphicsCommandList* CommandList, const SceneStore::DrawArgs& aDrawArgs, const DirectX::XMFLOAT4X4& aWorld);
+	PassView GetCameraPassView(const Camera& aCamera) const;
+	const std::vector<std::uint8_t>& CullPass(const PassView& aView);
+	const std::vector<std::uint8_t>& CullShadowCasters(const PassView& aLightView);
+	// Rasterizes the largest opaque items in front of aView into Occluders
+	void RenderOccluders(const PassView& aView);
+	const std::vector<std::uint8_t>& CullOccluded(const PassView& aView, const std::vector<std::uint8_t>& aVisibility);
 	void DrawSceneToShadowMap();
+	void UpdateStaticShadowCache();
 	void DrawSceneToCubeMap();
 
 	void Pick(int X, int Y);
 	void MovePickedObj(float X, float Y, float Z , bool bInLocalSpace=true);
 	void RotatePickedObj(float Pitch, float Yaw, float Roll);
 	void ScalePickedObj(float ScaleX, float ScaleY, float ScaleZ);
+	// Scene.SetWorld plus invalidation of the cached static shadows and probe faces under the item
+	void SetItemWorld(RenderItemId aId, const DirectX::XMFLOAT4X4& aWorld);
+	// Moves the item out of the cached static shadow layer, it is drawn over it every frame from now on
+	void MakeItemDynamic(RenderItemId aId);
 	void InitCamera();
-	void InitCubeMapCameras(float CenterX , float CenterY, float CenterZ);
+	// Reads "Name X Y Z InfluenceRadius" lines, falls back to a single probe at the origin
+	void LoadReflectionProbes(const std::string& aPath);
+	void InitCubeMapCameras(UINT aProbe);
 	void BuildTextures();
 	void BuildDescriptors();
 	Material* BuildOrGetMaterial(std::string aMatName, std::string aDiffuseTexName, std::string aNormalTexName,
@@ -76,32 +243,99 @@ private:
 	bool AddTexture(std::unique_ptr<Texture> aTexture);
 	void SaveRenderItemsData();
 	void LoadRenderItemsData();
-	RenderItem* AddRenderItem(std::unique_ptr<RenderItem> aRenderItem, RenderLayer aLayer);
+	static SceneStore::DrawArgs MakeDrawArgs(MeshGeometry* aMeshGeometry, const SubmeshGeometry& aSubmesh);
+	RenderItemId AddRenderItem(const std::string& aName, const DirectX::XMMATRIX& aWorld, MeshGeometry* aMeshGeometry,
+		const SubmeshGeometry& aSubmesh, Material* aMaterial, RenderLayer aLayer);
+	// Adds one render item per submesh of meshKey, a geometry or a LOD model
 	void ModelToRenderItem(const std::string& meshKey, UINT& objIndex, Material* material,
 		const DirectX::XMMATRIX& worldTransform, RenderLayer layer = RenderLayer::Opaque);
+	// Adds one render item per submesh of meshKey for every world transform; items sharing a submesh
+	// are drawn with a single instanced draw. Must be called before BuildFrameResources.
+	void SpawnMeshInstances(const std::string& meshKey, UINT& objIndex, Material* material,
+		const std::vector<DirectX::XMFLOAT4X4>& worldTransforms, RenderLayer layer = RenderLayer::Opaque);
 
 
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> RootSignature;
 	std::vector<D3D12_INPUT_ELEMENT_DESC> InputLayouts;
 	std::unordered_map<std::string,Microsoft::WRL::ComPtr<ID3D12PipelineState>> PSO;
+	// Dense PSO ids used by the render queue sort keys
+	std::unordered_map<std::string, UINT> PsoIds;
+	std::vector<ID3D12PipelineState*> PsoTable;
+	ID3D12PipelineState* BoundPso = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> SrvDescriptorHeap;
 
 
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3DBlob>> Shaders;
+	// Shared vertex and index buffers of every MeshGeometry, declared first so it outlives them
+	std::unique_ptr<GeometryPool> SharedGeometry;
+	float GeometryDefragmentThreshold = 0.5f;	// Fragmentation a pool buffer is packed above, checked every frame
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> MeshGeometries;
+	UINT NextGeometryId = 0;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> Textures;
 	std::unordered_map<std::string, std::unique_ptr<Material>> Materials;
 
-	std::vector<std::unique_ptr<FrameResource<PassConstBuffer,ObjConstBuffer,MaterialConstBuffer>>> FrameResources;
-	std::vector<std::unique_ptr<RenderItem>> RenderItems;
-	std::vector<RenderItem*> RenderLayerItems[(int)RenderLayer::Count];
+	std::vector<std::unique_ptr<FrameResource<PassConstBuffer,InstanceData,MaterialBufferData>>> FrameResources;
+	SceneStore Scene{ (std::uint32_t)RenderLayer::Count, gNumFrameResources };
 	std::vector<Texture*> Texture2DStack;
 	std::string SkyBox = "Tex_sunsetcube1024";
-	RenderItem* PickedRenderItem = nullptr;
+	RenderItemId PickedRenderItem = SceneStore::InvalidItem;
+	RenderQueue DrawQueue;
+	std::vector<RenderLayer> QueuedBuckets;		// Bucket of a sort key -> layer
+	FrustumCuller PassCuller;
+	FrustumCuller ReceiverCuller;
+	std::vector<std::uint8_t> ShadowCasterVisibility;
+	std::vector<std::uint8_t> ShadowReceiverVisibility;
+	bool bShadowReceiverCulling = true;
+	// Scene level BVH over the items' world bounds, used by Pick and the camera passes' culling
+	SceneBVH SceneTree;
+	bool bSceneBvhCulling = true;
+	std::vector<RenderItemId> BvhCandidates;
+	SceneStore::WorldBoundsStreams BvhCandidateBounds;
+	std::vector<std::uint8_t> BvhVisibility;
+	// Software depth buffer of the main camera's occluders
+	OcclusionCuller Occluders;
+	bool bOcclusionCulling = true;
+	UINT OcclusionBufferWidth = 256;		// Height follows the aspect ratio
+	UINT MaxOccluders = 16;
+	UINT MaxOccluderTriangles = 4096;		// Per item, denser items are left out
+	float MinOccluderSize = 0.1f;			// Bounding sphere radius over distance to the eye
+	std::vector<std::pair<float, RenderItemId>> OccluderCandidates;
+	// Meshlets of items drawn without instancing are culled against the camera, see QueueRenderLayers
+	ClusterCuller Clusters;
+	bool bClusterCulling = true;
+	float MinClusterProjectedSize = 1.0f;	// Pixels
+	std::uint32_t ClusterCulledBuckets = 0;	// Bit per queued bucket
+	std::vector<ClusterCuller::IndexRange> ClusterRanges;
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature> ClusterCommandSignature;
+	// Offset of the next cluster draw in the indirect argument buffer, reset every frame
+	UINT ClusterDrawCursor = 0;
+	// Logical models drawn from several MeshGeometry levels, finest first
+	struct LodModel
+	{
+		std::vector<MeshGeometry*> Levels;
+		// DrawArgs keys per level, Submeshes[Level][i] is drawn in place of Submeshes[0][i]
+		std::vector<std::vector<std::string>> Submeshes;
+		LodSelector::GroupId Group;
+	};
+	std::unordered_map<std::string, LodModel> LodModels;
+	LodSelector Lods;
+	float LodBias = 0.0f;		// Positive favours coarser levels, see LodSelector::SetBias
+	// Side of a grid of cubes spawned through SpawnMeshInstances on the surface, e.g. 100 for 10k instanced cubes
+	UINT InstancedCubeGrid = 0;
+	// Geometry is uploaded as CompactVertex and every vertex shader compiled with COMPACT_VERTEX. Read once at startup.
+	// Off until the compact shader path has been run on a GPU, the encoding itself is covered by CompactVertexTest.
+	bool bCompactVertices = false;
+	CascadedShadows ShadowCascades;
+	PassView ShadowPassViews[CascadedShadows::MaxCascades] = {};
+	// Static casters only, re-rendered where invalidated and copied into ShadowMapObj every frame
+	std::unique_ptr<ShadowMap> StaticShadowMapObj;
+	ShadowCache StaticShadowCache;
+	// Offset of the next draw in the instance index buffer, reset every frame
+	UINT InstanceIndexCursor = 0;
 
 	UINT TotalFrameResources = 3;
 	UINT ShadowSkyMapHeapIndex;
-	UINT ShadowCubeMapHeapIndex;
+	UINT StaticShadowMapHeapIndex;
 	UINT SrvCubeMapHeapIndex;
 
 	UINT CurrentFrameResourceIndex{UINT_MAX};
@@ -109,15 +343,27 @@ private:
 	bool bDebugShadowMap=false;
 	bool bLeftMouseDown=false;
 	std::unique_ptr<Camera> ViewCamera;
-	std::unique_ptr<Camera> CubeMapCameras[6];
+	std::vector<std::unique_ptr<Camera>> CubeMapCameras;	// Probe * 6 + Face
 	std::unique_ptr<ShadowMap> ShadowMapObj;
 	std::unique_ptr<CubeMapRT> CubeMapObj;
+	std::vector<ProbeSettings> ReflectionProbes;	// Index = cube in CubeMapObj = ProbeScheduler::ProbeId
+	ProbeScheduler Probes{ gNumFrameResources };
+	ProbeLookup ReflectionProbeLookup;
+	UINT ProbeFaceBudget = 2;		// Cube faces rendered per frame over all probes
+	// Cascades last written into the probe pass constants
+	DirectX::XMFLOAT4X4 ProbeShadowTransforms[CascadedShadows::MaxCascades] = {};
 	CD3DX12_GPU_DESCRIPTOR_HANDLE NullSrvGpuHandle;
 	CD3DX12_GPU_DESCRIPTOR_HANDLE ShadowMapSrvGpuHandle;
-	DirectX::BoundingSphere SceneSphereBound;
+
+	// Accumulates and prints FrameStats, the costlier counters like FrameStats::StateChangesSaved are skipped without it
+	bool bFrameStats = true;
+	FrameStats CurrentFrameStats;
+	FrameStats AccumulatedFrameStats;
+	UINT AccumulatedFrameCount = 0;
+	float FrameStatsTimer = 0.0f;
 
 protected:
-	FrameResource<PassConstBuffer,ObjConstBuffer,MaterialConstBuffer>* GetCurrentFrameResource() const;
+	FrameResource<PassConstBuffer,InstanceData,MaterialBufferData>* GetCurrentFrameResource() const;
 };
 
 
@@ -126,25 +372,13 @@ protected:
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-struct ShapesApp::RenderItem
-{
-	RenderItem() = default;
-	std::string Name;
-	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
-	UINT ObjConstBufferIndex = -1;
-	MeshGeometry* MeshGeometryRef;
-	Material* MaterialRef;
-	DirectX::BoundingBox Bounds;
-
-	//For Multiple Objects on Same MeshGeometryData
-	UINT IndexCount;
-	UINT IndexStartLocation;
-	UINT VertexStartLocation;
-};
-
-struct ShapesApp::ObjConstBuffer
+// Element of the per-frame instance buffer (StructuredBuffer<InstanceData> in CommonBuffer.hlsl)
+struct ShapesApp::InstanceData
 {
 	DirectX::XMFLOAT4X4 World;
+	UINT MaterialIndex;		// Index into the material table (Material::MatCBIndex)
+	UINT ProbeIndices[2];	// Reflection probes blended by Reflection layer items, see ProbeLookup
+	float ProbeBlend;
 };
 
 struct ShapesApp::PassConstBuffer
@@ -152,13 +386,14 @@ struct ShapesApp::PassConstBuffer
 	DirectX::XMFLOAT4X4 View;
 	DirectX::XMFLOAT4X4 Proj;
 	DirectX::XMFLOAT4X4 ViewProj;
-	DirectX::XMFLOAT4X4 ShadowTransform;
+	DirectX::XMFLOAT4X4 ShadowTransforms[CascadedShadows::MaxCascades];
 	DirectX::XMFLOAT3	Eye;
-	float Padding;  // Align Lights array to 16-byte boundary for HLSL
+	UINT CascadeCount;  // Also aligns Lights array to 16-byte boundary for HLSL
 	Light Lights[16];
 };
 
-struct ShapesApp::MaterialConstBuffer
+// Element of the per-frame material table (StructuredBuffer<MaterialData> in CommonBuffer.hlsl)
+struct ShapesApp::MaterialBufferData
 {
 	DirectX::XMFLOAT4 DiffuseAlbedo;
 	DirectX::XMFLOAT3 FresnelRO;
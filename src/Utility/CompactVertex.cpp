@@ -0,0 +1,109 @@
+//***************************************************************************************
+// CompactVertex.cpp
+//
+// 20 byte quantized alternative to the 44 byte Vertex
+//***************************************************************************************
+
+#include "CompactVertex.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	std::int16_t ToSnorm16(float aValue)
+	{
+		return static_cast<std::int16_t>(std::lround(std::clamp(aValue, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	// Snorm to float as the input assembler does it: -32768 and -32767 both map to -1
+	float FromSnorm16(std::int16_t aValue)
+	{
+		return std::max(aValue / 32767.0f, -1.0f);
+	}
+
+	float SignNotZero(float aValue)
+	{
+		return aValue >= 0.0f ? 1.0f : -1.0f;
+	}
+}
+
+PositionQuantization MakePositionQuantization(const DirectX::BoundingBox& aBounds)
+{
+	PositionQuantization Quantization;
+	Quantization.Offset = aBounds.Center;
+	Quantization.Scale = std::max({ aBounds.Extents.x, aBounds.Extents.y, aBounds.Extents.z });
+	// A single point still needs an invertible scale
+	if (!(Quantization.Scale > 0.0f))
+		Quantization.Scale = 1.0f;
+	return Quantization;
+}
+
+DirectX::XMFLOAT2 OctahedralEncode(const DirectX::XMFLOAT3& aDirection)
+{
+	float L1Norm = std::abs(aDirection.x) + std::abs(aDirection.y) + std::abs(aDirection.z);
+	if (!(L1Norm > 0.0f))
+		return { 0.0f, 0.0f };
+
+	float X = aDirection.x / L1Norm;
+	float Y = aDirection.y / L1Norm;
+	// The lower hemisphere folds over the diagonals
+	if (aDirection.z < 0.0f)
+	{
+		float FoldedX = (1.0f - std::abs(Y)) * SignNotZero(X);
+		float FoldedY = (1.0f - std::abs(X)) * SignNotZero(Y);
+		X = FoldedX;
+		Y = FoldedY;
+	}
+	return { X, Y };
+}
+
+CompactVertex EncodeCompactVertex(const Vertex& aVertex, const PositionQuantization& aQuantization)
+{
+	CompactVertex Result;
+	float InvScale = 1.0f / aQuantization.Scale;
+	Result.Position[0] = ToSnorm16((aVertex.Position.x - aQuantization.Offset.x) * InvScale);
+	Result.Position[1] = ToSnorm16((aVertex.Position.y - aQuantization.Offset.y) * InvScale);
+	Result.Position[2] = ToSnorm16((aVertex.Position.z - aQuantization.Offset.z) * InvScale);
+	Result.Position[3] = 0;
+
+	Result.TexCoord[0] = DirectX::PackedVector::XMConvertFloatToHalf(aVertex.TexCoord.x);
+	Result.TexCoord[1] = DirectX::PackedVector::XMConvertFloatToHalf(aVertex.TexCoord.y);
+
+	DirectX::XMFLOAT2 Normal = OctahedralEncode(aVertex.Normal);
+	Result.Normal[0] = ToSnorm16(Normal.x);
+	Result.Normal[1] = ToSnorm16(Normal.y);
+	DirectX::XMFLOAT2 Tangent = OctahedralEncode(aVertex.Tangent);
+	Result.Tangent[0] = ToSnorm16(Tangent.x);
+	Result.Tangent[1] = ToSnorm16(Tangent.y);
+	return Result;
+}
+
+DirectX::XMFLOAT3 OctahedralDecode(const DirectX::XMFLOAT2& aEncoded)
+{
+	DirectX::XMFLOAT3 Direction = { aEncoded.x, aEncoded.y, 1.0f - std::abs(aEncoded.x) - std::abs(aEncoded.y) };
+	if (Direction.z < 0.0f)
+	{
+		float UnfoldedX = (1.0f - std::abs(aEncoded.y)) * SignNotZero(aEncoded.x);
+		float UnfoldedY = (1.0f - std::abs(aEncoded.x)) * SignNotZero(aEncoded.y);
+		Direction.x = UnfoldedX;
+		Direction.y = UnfoldedY;
+	}
+	float InvLength = 1.0f / std::sqrt(Direction.x * Direction.x + Direction.y * Direction.y + Direction.z * Direction.z);
+	return { Direction.x * InvLength, Direction.y * InvLength, Direction.z * InvLength };
+}
+
+Vertex DecodeCompactVertex(const CompactVertex& aVertex, const PositionQuantization& aQuantization)
+{
+	Vertex Result;
+	Result.Position = {
+		aQuantization.Offset.x + aQuantization.Scale * FromSnorm16(aVertex.Position[0]),
+		aQuantization.Offset.y + aQuantization.Scale * FromSnorm16(aVertex.Position[1]),
+		aQuantization.Offset.z + aQuantization.Scale * FromSnorm16(aVertex.Position[2]) };
+	Result.TexCoord = {
+		DirectX::PackedVector::XMConvertHalfToFloat(aVertex.TexCoord[0]),
+		DirectX::PackedVector::XMConvertHalfToFloat(aVertex.TexCoord[1]) };
+	Result.Normal = OctahedralDecode({ FromSnorm16(aVertex.Normal[0]), FromSnorm16(aVertex.Normal[1]) });
+	Result.Tangent = OctahedralDecode({ FromSnorm16(aVertex.Tangent[0]), FromSnorm16(aVertex.Tangent[1]) });
+	return Result;
+}
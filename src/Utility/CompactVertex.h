@@ -0,0 +1,51 @@
+//***************************************************************************************
+// CompactVertex.h
+//
+// 20 byte quantized alternative to the 44 byte Vertex
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "Vertex.h"
+
+// Input layout of ShapesApp with COMPACT_VERTEX:
+//   POSITION R16G16B16A16_SNORM, the position in the quantization box of its submesh, w unused
+//   TEXCOORD R16G16_FLOAT
+//   NORMAL   R16G16_SNORM, octahedral
+//   TANGENT  R16G16_SNORM, octahedral
+struct CompactVertex
+{
+	std::int16_t Position[4];
+	std::uint16_t TexCoord[2];
+	std::int16_t Normal[2];
+	std::int16_t Tangent[2];
+};
+static_assert(sizeof(CompactVertex) == 20, "CompactVertex must match the compact input layout");
+
+// Positions decode as Offset + Scale * snorm. The scale is uniform, so the dequantization can be folded into
+// a world matrix without bending normals. Stored as SubmeshGeometry::PositionDequant.
+struct PositionQuantization
+{
+	DirectX::XMFLOAT3 Offset = { 0.0f, 0.0f, 0.0f };
+	float Scale = 1.0f;
+
+	DirectX::XMFLOAT4 GetDequant() const { return { Offset.x, Offset.y, Offset.z, Scale }; }
+};
+
+// Box centre and largest half extent
+PositionQuantization MakePositionQuantization(const DirectX::BoundingBox& aBounds);
+
+// Octahedral map of a direction to [-1, 1]^2, see Cigolle et al. 2014, decoded by OctahedralDecode in
+// CommonBuffer.hlsl. Zero vectors map to +Z.
+DirectX::XMFLOAT2 OctahedralEncode(const DirectX::XMFLOAT3& aDirection);
+
+CompactVertex EncodeCompactVertex(const Vertex& aVertex, const PositionQuantization& aQuantization);
+
+// CPU copies of the decode in CommonBuffer.hlsl, the GPU stores the snorm and half values as the input layout
+// reads them. OctahedralDecode returns a unit vector.
+DirectX::XMFLOAT3 OctahedralDecode(const DirectX::XMFLOAT2& aEncoded);
+Vertex DecodeCompactVertex(const CompactVertex& aVertex, const PositionQuantization& aQuantization);
@@ -24,6 +24,7 @@
 #include <wrl.h>
 
 #include "DDSTextureLoader.h" 
+#include "GpuMemoryAllocator.h"
 
 using namespace Microsoft::WRL;
 
@@ -1228,7 +1229,7 @@ static HRESULT CreateD3DResources( _In_ ID3D11Device* d3dDevice,
 }
 
 static HRESULT CreateD3DResources12(
-	ID3D12Device* device,
+	GpuMemoryAllocator* allocator,
 	ID3D12GraphicsCommandList* cmdList,
 	_In_ uint32_t resDim,
 	_In_ size_t width,
@@ -1244,7 +1245,7 @@ static HRESULT CreateD3DResources12(
 	ComPtr<ID3D12Resource>& textureUploadHeap
 	)
 {
-	if (device == nullptr)
+	if (allocator == nullptr)
 		return E_POINTER;
 
 	if (forceSRGB)
@@ -1269,14 +1270,12 @@ static HRESULT CreateD3DResources12(
 		texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 		texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-		auto heapPropsDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-		hr = device->CreateCommittedResource(
-			&heapPropsDefault,
-			D3D12_HEAP_FLAG_NONE,
-			&texDesc,
+		hr = allocator->CreateResource(
+			D3D12_HEAP_TYPE_DEFAULT,
+			texDesc,
 			D3D12_RESOURCE_STATE_COMMON,
 			nullptr,
-			IID_PPV_ARGS(&texture)
+			texture
 			);
 
 		if (FAILED(hr))
@@ -1289,15 +1288,13 @@ static HRESULT CreateD3DResources12(
 			const UINT num2DSubresources = texDesc.DepthOrArraySize * texDesc.MipLevels;
 			const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, num2DSubresources);
 
-			auto heapPropsUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
 			auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
-			hr = device->CreateCommittedResource(
-				&heapPropsUpload,
-				D3D12_HEAP_FLAG_NONE,
-				&bufferDesc,
+			hr = allocator->CreateResource(
+				D3D12_HEAP_TYPE_UPLOAD,
+				bufferDesc,
 				D3D12_RESOURCE_STATE_GENERIC_READ,
 				nullptr,
-				IID_PPV_ARGS(&textureUploadHeap));
+				textureUploadHeap);
 			if (FAILED(hr))
 			{
 				texture = nullptr;
@@ -1675,7 +1672,7 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
 }
 
 static HRESULT CreateTextureFromDDS12(
-	_In_ ID3D12Device* device,
+	_In_ GpuMemoryAllocator* allocator,
 	_In_opt_ ID3D12GraphicsCommandList* cmdList,
 	_In_ const DDS_HEADER* header,
 	_In_reads_bytes_(bitSize) const uint8_t* bitData,
@@ -1863,7 +1860,7 @@ static HRESULT CreateTextureFromDDS12(
 	if (SUCCEEDED(hr))
 	{
 		hr = CreateD3DResources12(
-			device, cmdList,
+			allocator, cmdList,
 			resDim, twidth, theight, tdepth,
 			mipCount - skipMip,
 			arraySize,
@@ -1924,7 +1921,7 @@ HRESULT DirectX::CreateDDSTextureFromMemory( ID3D11Device* d3dDevice,
 
 _Use_decl_annotations_
 HRESULT DirectX::CreateDDSTextureFromMemory12(
-	ID3D12Device* device,
+	GpuMemoryAllocator* allocator,
 	_In_ ID3D12GraphicsCommandList* cmdList,
 	_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
 	_In_ size_t ddsDataSize,
@@ -1937,7 +1934,7 @@ HRESULT DirectX::CreateDDSTextureFromMemory12(
 	if (alphaMode)
 		(*alphaMode) = DDS_ALPHA_MODE_UNKNOWN;
 
-	if (!device || !cmdList || !ddsData || !ddsDataSize)
+	if (!allocator || !cmdList || !ddsData || !ddsDataSize)
 	{
 		return E_INVALIDARG;
 	}
@@ -1976,7 +1973,7 @@ HRESULT DirectX::CreateDDSTextureFromMemory12(
 		+ (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0);
 
 	HRESULT hr = CreateTextureFromDDS12(
-		device,
+		allocator,
 		cmdList,
 		header,
 		ddsData + offset,
@@ -2139,7 +2136,7 @@ HRESULT DirectX::CreateDDSTextureFromFile( ID3D11Device* d3dDevice,
                                        texture, textureView, alphaMode );
 }
 
-HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
+HRESULT DirectX::CreateDDSTextureFromFile12(_In_ GpuMemoryAllocator* allocator,
 	_In_ ID3D12GraphicsCommandList* cmdList,
 	_In_z_ const wchar_t* szFileName,
 	_Out_ ComPtr<ID3D12Resource>& texture,
@@ -2160,7 +2157,7 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 		*alphaMode = DDS_ALPHA_MODE_UNKNOWN;
 	}
 
-	if (!device || !szFileName)
+	if (!allocator || !szFileName)
 	{
 		return E_INVALIDARG;
 	}
@@ -2176,7 +2173,7 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 		return hr;
 	}
 
-	hr = CreateTextureFromDDS12(device, cmdList, header,
+	hr = CreateTextureFromDDS12(allocator, cmdList, header,
 		bitData, bitSize, maxsize, false, texture, textureUploadHeap);
 
 	if (SUCCEEDED(hr))
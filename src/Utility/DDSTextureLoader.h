@@ -44,6 +44,9 @@
 #define _Use_decl_annotations_
 #endif
 
+// The D3D12 loaders place textures and upload heaps through it instead of committing them
+class GpuMemoryAllocator;
+
 namespace DirectX
 {
     enum DDS_ALPHA_MODE
@@ -65,7 +68,7 @@ namespace DirectX
                                         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
                                       );
 
-	HRESULT CreateDDSTextureFromMemory12(_In_ ID3D12Device* device,
+	HRESULT CreateDDSTextureFromMemory12(_In_ GpuMemoryAllocator* allocator,
 		                                 _In_ ID3D12GraphicsCommandList* cmdList,
 		                                 _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
 		                                 _In_ size_t ddsDataSize,
@@ -83,7 +86,7 @@ namespace DirectX
                                       _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
                                     );
 
-	HRESULT CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
+	HRESULT CreateDDSTextureFromFile12(_In_ GpuMemoryAllocator* allocator,
 		                               _In_ ID3D12GraphicsCommandList* cmdList,
 		                               _In_z_ const wchar_t* szFileName,
 		                               _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
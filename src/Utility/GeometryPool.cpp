@@ -0,0 +1,231 @@
+//***************************************************************************************
+// GeometryPool.cpp
+//
+// Shared vertex and index buffers every MeshGeometry is suballocated from
+//***************************************************************************************
+
+#include "GeometryPool.h"
+#include <algorithm>
+
+GeometryBuffer::GeometryBuffer(UINT aElementSize, DXGI_FORMAT aIndexFormat, const std::wstring& aName)
+	: ElementSize(aElementSize), IndexFormat(aIndexFormat), Name(aName)
+{
+}
+
+D3D12_VERTEX_BUFFER_VIEW GeometryBuffer::GetVertexBufferView() const
+{
+	D3D12_VERTEX_BUFFER_VIEW View;
+	View.BufferLocation = Resource->GetGPUVirtualAddress();
+	View.StrideInBytes = ElementSize;
+	View.SizeInBytes = static_cast<UINT>(Ranges.GetCapacity() * ElementSize);
+	return View;
+}
+
+D3D12_INDEX_BUFFER_VIEW GeometryBuffer::GetIndexBufferView() const
+{
+	D3D12_INDEX_BUFFER_VIEW View;
+	View.BufferLocation = Resource->GetGPUVirtualAddress();
+	View.Format = IndexFormat;
+	View.SizeInBytes = static_cast<UINT>(Ranges.GetCapacity() * ElementSize);
+	return View;
+}
+
+GeometryPool::GeometryPool(GpuMemoryAllocator* aAllocator, UINT64 aInitialBufferBytes)
+	: Allocator(aAllocator), InitialBufferBytes(aInitialBufferBytes)
+{
+}
+
+void GeometryPool::Add(MeshGeometry& aGeometry, const void* aVertices, const void* aIndices, ID3D12GraphicsCommandList* aCommandList)
+{
+	assert(aGeometry.VertexBuffer == nullptr && "Geometry is already in a pool");
+	UINT IndexSize = aGeometry.IndexFormat == DXGI_FORMAT_R32_UINT ? sizeof(std::uint32_t) : sizeof(std::uint16_t);
+	UINT64 VertexCount = aGeometry.VertexBufferByteSize / aGeometry.VertexByteStride;
+	UINT64 IndexCount = aGeometry.IndexBufferByteSize / IndexSize;
+	assert(VertexCount > 0 && IndexCount > 0 && "Empty geometries have nothing to draw");
+
+	GeometryBuffer& Vertices = GetBuffer(aGeometry.VertexByteStride, DXGI_FORMAT_UNKNOWN);
+	GeometryBuffer& Indices = GetBuffer(IndexSize, aGeometry.IndexFormat);
+	std::uint64_t VertexOffset = AllocateRange(Vertices, VertexCount, aCommandList);
+	std::uint64_t IndexOffset = AllocateRange(Indices, IndexCount, aCommandList);
+
+	// One staging buffer for both, released once the copies are done
+	UINT64 VertexBytes = VertexCount * Vertices.ElementSize;
+	UINT64 IndexBytes = IndexCount * Indices.ElementSize;
+	UINT64 IndexDataOffset = (VertexBytes + 15) & ~UINT64(15);
+	auto Staging = Allocator->CreateBuffer(D3D12_HEAP_TYPE_UPLOAD, IndexDataOffset + IndexBytes, D3D12_RESOURCE_STATE_GENERIC_READ);
+	BYTE* Mapped = nullptr;
+	ThrowIfFailed(Staging->Map(0, nullptr, reinterpret_cast<void**>(&Mapped)));
+	memcpy(Mapped, aVertices, VertexBytes);
+	memcpy(Mapped + IndexDataOffset, aIndices, IndexBytes);
+	Staging->Unmap(0, nullptr);
+
+	D3D12_RESOURCE_BARRIER ToCopy[2] = {
+		CD3DX12_RESOURCE_BARRIER::Transition(Vertices.Resource.Get(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST),
+		CD3DX12_RESOURCE_BARRIER::Transition(Indices.Resource.Get(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST) };
+	aCommandList->ResourceBarrier(2, ToCopy);
+	aCommandList->CopyBufferRegion(Vertices.Resource.Get(), VertexOffset * Vertices.ElementSize, Staging.Get(), 0, VertexBytes);
+	aCommandList->CopyBufferRegion(Indices.Resource.Get(), IndexOffset * Indices.ElementSize, Staging.Get(), IndexDataOffset, IndexBytes);
+	D3D12_RESOURCE_BARRIER ToRead[2] = {
+		CD3DX12_RESOURCE_BARRIER::Transition(Vertices.Resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ),
+		CD3DX12_RESOURCE_BARRIER::Transition(Indices.Resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ) };
+	aCommandList->ResourceBarrier(2, ToRead);
+	Retire(Staging);
+
+	Vertices.Owners[VertexOffset] = &aGeometry;
+	Indices.Owners[IndexOffset] = &aGeometry;
+	aGeometry.VertexBuffer = &Vertices;
+	aGeometry.IndexBuffer = &Indices;
+	aGeometry.BaseVertexLocation = static_cast<UINT>(VertexOffset);
+	aGeometry.StartIndexLocation = static_cast<UINT>(IndexOffset);
+}
+
+void GeometryPool::Remove(MeshGeometry& aGeometry)
+{
+	if (aGeometry.VertexBuffer == nullptr)
+		return;
+
+	aGeometry.VertexBuffer->Ranges.Free(aGeometry.BaseVertexLocation);
+	aGeometry.VertexBuffer->Owners.erase(aGeometry.BaseVertexLocation);
+	aGeometry.IndexBuffer->Ranges.Free(aGeometry.StartIndexLocation);
+	aGeometry.IndexBuffer->Owners.erase(aGeometry.StartIndexLocation);
+	aGeometry.VertexBuffer = nullptr;
+	aGeometry.IndexBuffer = nullptr;
+	aGeometry.BaseVertexLocation = 0;
+	aGeometry.StartIndexLocation = 0;
+}
+
+UINT GeometryPool::Defragment(ID3D12GraphicsCommandList* aCommandList, float aMinFragmentation)
+{
+	UINT PackedCount = 0;
+	for (auto& Buffer : Buffers)
+	{
+		if (Buffer->Resource == nullptr || Buffer->Ranges.GetFragmentation() <= aMinFragmentation)
+			continue;
+
+		// Copying into a new buffer avoids overlapping copies within one resource
+		std::vector<RangeAllocator::Move> Moves = Buffer->Ranges.Defragment();
+		Relocate(*Buffer, Buffer->Ranges.GetCapacity(), Moves, aCommandList);
+
+		std::map<std::uint64_t, MeshGeometry*> Owners;
+		for (const RangeAllocator::Move& Move : Moves)
+		{
+			MeshGeometry* Geometry = Buffer->Owners.at(Move.OldOffset);
+			Owners.emplace_hint(Owners.end(), Move.NewOffset, Geometry);
+			if (Buffer->IsIndexBuffer())
+				Geometry->StartIndexLocation = static_cast<UINT>(Move.NewOffset);
+			else
+				Geometry->BaseVertexLocation = static_cast<UINT>(Move.NewOffset);
+		}
+		Buffer->Owners = std::move(Owners);
+		PackedCount++;
+	}
+	return PackedCount;
+}
+
+void GeometryPool::MarkSubmitted(UINT64 aFenceValue)
+{
+	for (auto& [FenceValue, Resource] : Retired)
+	{
+		if (FenceValue == 0)
+			FenceValue = aFenceValue;
+	}
+}
+
+void GeometryPool::ReleaseCompleted(UINT64 aCompletedFenceValue)
+{
+	Retired.erase(std::remove_if(Retired.begin(), Retired.end(), [aCompletedFenceValue](const auto& aRetired)
+		{
+			return aRetired.first != 0 && aRetired.first <= aCompletedFenceValue;
+		}), Retired.end());
+}
+
+GeometryPool::Stats GeometryPool::GetStats() const
+{
+	Stats Result;
+	for (const auto& Buffer : Buffers)
+	{
+		const RangeAllocator& Ranges = Buffer->Ranges;
+		Result.BufferCount++;
+		Result.CapacityBytes += Ranges.GetCapacity() * Buffer->ElementSize;
+		Result.UsedBytes += Ranges.GetUsedSize() * Buffer->ElementSize;
+		Result.FreeRanges += Ranges.GetFreeRangeCount();
+		Result.MaxFragmentation = std::max(Result.MaxFragmentation, Ranges.GetFragmentation());
+		if (!Buffer->IsIndexBuffer())
+			Result.GeometryCount += static_cast<UINT>(Buffer->Owners.size());
+	}
+	return Result;
+}
+
+GeometryBuffer& GeometryPool::GetBuffer(UINT aElementSize, DXGI_FORMAT aIndexFormat)
+{
+	for (auto& Buffer : Buffers)
+	{
+		if (Buffer->ElementSize == aElementSize && Buffer->IndexFormat == aIndexFormat)
+			return *Buffer;
+	}
+
+	std::wstring Name = aIndexFormat == DXGI_FORMAT_UNKNOWN ? L"GeometryPool_VB" + std::to_wstring(aElementSize)
+		: L"GeometryPool_IB" + std::to_wstring(aElementSize * 8);
+	Buffers.push_back(std::make_unique<GeometryBuffer>(aElementSize, aIndexFormat, Name));
+	return *Buffers.back();
+}
+
+std::uint64_t GeometryPool::AllocateRange(GeometryBuffer& aBuffer, UINT64 aElementCount, ID3D12GraphicsCommandList* aCommandList)
+{
+	RangeAllocator& Ranges = aBuffer.Ranges;
+	if (aBuffer.Resource == nullptr)
+	{
+		UINT64 Capacity = std::max<UINT64>(InitialBufferBytes / aBuffer.ElementSize, aElementCount);
+		Ranges.Reset(Capacity);
+		aBuffer.Resource = Allocator->CreateBuffer(D3D12_HEAP_TYPE_DEFAULT, Capacity * aBuffer.ElementSize, D3D12_RESOURCE_STATE_COMMON);
+		aBuffer.Resource->SetName(aBuffer.Name.c_str());
+		auto ToRead = CD3DX12_RESOURCE_BARRIER::Transition(aBuffer.Resource.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_GENERIC_READ);
+		aCommandList->ResourceBarrier(1, &ToRead);
+	}
+
+	std::uint64_t Offset = Ranges.Allocate(aElementCount);
+	if (Offset != RangeAllocator::InvalidOffset)
+		return Offset;
+
+	// Grow to at least twice the size, the used part is copied as is and keeps its offsets
+	UINT64 UsedEnd = Ranges.GetUsedEnd();
+	UINT64 Capacity = std::max<UINT64>(Ranges.GetCapacity() * 2, Ranges.GetCapacity() + aElementCount);
+	std::vector<RangeAllocator::Move> Moves;
+	if (UsedEnd > 0)
+		Moves.push_back({ 0, 0, UsedEnd });
+	Relocate(aBuffer, Capacity, Moves, aCommandList);
+	Ranges.Grow(Capacity);
+
+	Offset = Ranges.Allocate(aElementCount);
+	assert(Offset != RangeAllocator::InvalidOffset && "Grown geometry buffer still too small");
+	return Offset;
+}
+
+void GeometryPool::Relocate(GeometryBuffer& aBuffer, UINT64 aCapacity, const std::vector<RangeAllocator::Move>& aMoves,
+	ID3D12GraphicsCommandList* aCommandList)
+{
+	auto NewResource = Allocator->CreateBuffer(D3D12_HEAP_TYPE_DEFAULT, aCapacity * aBuffer.ElementSize, D3D12_RESOURCE_STATE_COMMON);
+	NewResource->SetName(aBuffer.Name.c_str());
+
+	D3D12_RESOURCE_BARRIER ToCopy[2] = {
+		CD3DX12_RESOURCE_BARRIER::Transition(aBuffer.Resource.Get(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_SOURCE),
+		CD3DX12_RESOURCE_BARRIER::Transition(NewResource.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST) };
+	aCommandList->ResourceBarrier(2, ToCopy);
+	for (const RangeAllocator::Move& Move : aMoves)
+	{
+		aCommandList->CopyBufferRegion(NewResource.Get(), Move.NewOffset * aBuffer.ElementSize,
+			aBuffer.Resource.Get(), Move.OldOffset * aBuffer.ElementSize, Move.Size * aBuffer.ElementSize);
+	}
+	auto ToRead = CD3DX12_RESOURCE_BARRIER::Transition(NewResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+	aCommandList->ResourceBarrier(1, &ToRead);
+
+	// The old buffer may still be read by frames in flight and by the copies above
+	Retire(aBuffer.Resource);
+	aBuffer.Resource = NewResource;
+}
+
+void GeometryPool::Retire(Microsoft::WRL::ComPtr<ID3D12Resource> aResource)
+{
+	if (aResource != nullptr)
+		Retired.emplace_back(0, std::move(aResource));
+}
@@ -0,0 +1,93 @@
+//***************************************************************************************
+// GeometryPool.h
+//
+// Shared vertex and index buffers every MeshGeometry is suballocated from
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "GpuMemoryAllocator.h"
+#include "RangeAllocator.h"
+#include <map>
+
+// A default heap buffer holding the vertices of one stride or the indices of one format. Bound once for
+// every geometry inside, ranges are in elements and become BaseVertexLocation / StartIndexLocation.
+class GeometryBuffer
+{
+public:
+	GeometryBuffer(UINT aElementSize, DXGI_FORMAT aIndexFormat, const std::wstring& aName);
+
+	D3D12_VERTEX_BUFFER_VIEW GetVertexBufferView() const;
+	D3D12_INDEX_BUFFER_VIEW GetIndexBufferView() const;
+	UINT GetElementSize() const { return ElementSize; }
+	DXGI_FORMAT GetIndexFormat() const { return IndexFormat; }
+	const RangeAllocator& GetAllocator() const { return Ranges; }
+
+private:
+	friend class GeometryPool;
+
+	bool IsIndexBuffer() const { return IndexFormat != DXGI_FORMAT_UNKNOWN; }
+
+	UINT ElementSize;
+	DXGI_FORMAT IndexFormat;	// DXGI_FORMAT_UNKNOWN for vertices
+	std::wstring Name;
+	Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+	RangeAllocator Ranges;
+	std::map<std::uint64_t, MeshGeometry*> Owners;	// First element -> geometry using the range
+};
+
+// Owns one GeometryBuffer per vertex stride and per index format in use. Geometries are views into them,
+// so draws only rebind when the stride or the index format changes. Buffers grow by copying into a larger
+// buffer and are packed again by Defragment; both update the offsets of the geometries they move.
+// Replaced buffers and staging copies stay alive until the fence value they were submitted with completes.
+class GeometryPool
+{
+public:
+	struct Stats
+	{
+		UINT BufferCount = 0;
+		UINT GeometryCount = 0;
+		UINT64 CapacityBytes = 0;
+		UINT64 UsedBytes = 0;
+		UINT64 FreeRanges = 0;
+		float MaxFragmentation = 0.0f;	// See RangeAllocator::GetFragmentation
+	};
+
+	// Buffers and staging copies are placed by aAllocator
+	explicit GeometryPool(GpuMemoryAllocator* aAllocator, UINT64 aInitialBufferBytes = 4 * 1024 * 1024);
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool& operator=(const GeometryPool&) = delete;
+
+	// Copies the vertices and indices of aGeometry into the buffers of its VertexByteStride and IndexFormat and
+	// points aGeometry at them. VertexBufferByteSize and IndexBufferByteSize give the sizes of the data.
+	void Add(MeshGeometry& aGeometry, const void* aVertices, const void* aIndices, ID3D12GraphicsCommandList* aCommandList);
+	// Frees the ranges of aGeometry. Commands recorded later on the same queue may reuse them, frames in flight
+	// were submitted earlier and are done with them by then.
+	void Remove(MeshGeometry& aGeometry);
+
+	// Packs every buffer whose fragmentation exceeds aMinFragmentation into a new buffer of the same capacity
+	// Returns the number of buffers packed.
+	UINT Defragment(ID3D12GraphicsCommandList* aCommandList, float aMinFragmentation = 0.0f);
+
+	// Resources retired by the commands recorded since the last call were submitted with aFenceValue
+	void MarkSubmitted(UINT64 aFenceValue);
+	// Releases the retired resources whose fence value has completed
+	void ReleaseCompleted(UINT64 aCompletedFenceValue);
+
+	Stats GetStats() const;
+
+private:
+	GeometryBuffer& GetBuffer(UINT aElementSize, DXGI_FORMAT aIndexFormat);
+	std::uint64_t AllocateRange(GeometryBuffer& aBuffer, UINT64 aElementCount, ID3D12GraphicsCommandList* aCommandList);
+	// Copies the ranges of aMoves from the current resource of aBuffer into a new one of aCapacity elements
+	void Relocate(GeometryBuffer& aBuffer, UINT64 aCapacity, const std::vector<RangeAllocator::Move>& aMoves,
+		ID3D12GraphicsCommandList* aCommandList);
+	void Retire(Microsoft::WRL::ComPtr<ID3D12Resource> aResource);
+
+	GpuMemoryAllocator* Allocator;
+	UINT64 InitialBufferBytes;
+	std::vector<std::unique_ptr<GeometryBuffer>> Buffers;
+	// Fence value 0 until MarkSubmitted
+	std::vector<std::pair<UINT64, Microsoft::WRL::ComPtr<ID3D12Resource>>> Retired;
+};
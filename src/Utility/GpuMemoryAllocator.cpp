@@ -0,0 +1,422 @@
+//***************************************************************************************
+// GpuMemoryAllocator.cpp
+//
+// Places resources into large ID3D12Heap blocks instead of committing each one
+//***************************************************************************************
+
+#include "GpuMemoryAllocator.h"
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+	// Private data slot of the AllocationReleaser of a resource
+	const GUID AllocationReleaserGuid = { 0x6a3f5c21, 0x8e4b, 0x4d7a, { 0x9c, 0x12, 0x5b, 0x7e, 0x0f, 0x43, 0xa1, 0xd8 } };
+
+	UINT GetHeapTypeIndex(D3D12_HEAP_TYPE aHeapType)
+	{
+		assert(aHeapType >= D3D12_HEAP_TYPE_DEFAULT && aHeapType <= D3D12_HEAP_TYPE_READBACK && "Custom heaps are not pooled");
+		return static_cast<UINT>(aHeapType) - D3D12_HEAP_TYPE_DEFAULT;
+	}
+
+	D3D12_HEAP_FLAGS GetHeapFlags(GpuMemoryCategory aCategory)
+	{
+		switch (aCategory)
+		{
+		case GpuMemoryCategory::Buffer:			return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+		case GpuMemoryCategory::Texture:		return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+		default:								return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+		}
+	}
+
+	const char* GetName(D3D12_HEAP_TYPE aHeapType)
+	{
+		return aHeapType == D3D12_HEAP_TYPE_DEFAULT ? "Default" : aHeapType == D3D12_HEAP_TYPE_UPLOAD ? "Upload" : "Readback";
+	}
+
+	const char* GetName(GpuMemoryCategory aCategory)
+	{
+		return aCategory == GpuMemoryCategory::Buffer ? "Buffer" : aCategory == GpuMemoryCategory::Texture ? "Texture" : "RenderTarget";
+	}
+}
+
+// Lives in the private data of a resource, D3D releases it with the resource and it returns the range
+class GpuMemoryAllocator::AllocationReleaser final : public IUnknown
+{
+public:
+	AllocationReleaser(GpuMemoryAllocator& aOwner, Pool& aPool, UINT aBlock, const TlsfAllocator::Allocation& aAllocation,
+		UINT64 aDedicatedBytes)
+		: Owner(aOwner), OwnerPool(aPool), Block(aBlock), Allocation(aAllocation), DedicatedBytes(aDedicatedBytes)
+	{
+	}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID aId, void** aObject) override
+	{
+		if (aObject == nullptr)
+			return E_POINTER;
+		if (aId != __uuidof(IUnknown))
+		{
+			*aObject = nullptr;
+			return E_NOINTERFACE;
+		}
+		AddRef();
+		*aObject = static_cast<IUnknown*>(this);
+		return S_OK;
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() override
+	{
+		return ++RefCount;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() override
+	{
+		ULONG Count = --RefCount;
+		if (Count == 0)
+		{
+			Owner.Release(OwnerPool, Block, Allocation, DedicatedBytes);
+			delete this;
+		}
+		return Count;
+	}
+
+private:
+	std::atomic<ULONG> RefCount = 1;
+	GpuMemoryAllocator& Owner;
+	Pool& OwnerPool;
+	UINT Block;
+	TlsfAllocator::Allocation Allocation;
+	UINT64 DedicatedBytes;
+};
+
+void GpuMemoryAllocator::Stats::Add(const Stats& aOther)
+{
+	BlockCount += aOther.BlockCount;
+	BlockBytes += aOther.BlockBytes;
+	AllocationCount += aOther.AllocationCount;
+	AllocatedBytes += aOther.AllocatedBytes;
+	FreeRanges += aOther.FreeRanges;
+	LargestFreeRange = std::max(LargestFreeRange, aOther.LargestFreeRange);
+	Fragmentation = std::max(Fragmentation, aOther.Fragmentation);
+	DedicatedCount += aOther.DedicatedCount;
+	DedicatedBytes += aOther.DedicatedBytes;
+}
+
+GpuMemoryAllocator::GpuMemoryAllocator(ID3D12Device* aDevice, IDXGIAdapter3* aAdapter, UINT64 aBlockSize)
+	: Device(aDevice), Adapter(aAdapter), BlockSize(aBlockSize)
+{
+	assert(aBlockSize % D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT == 0 && "Block size must be a multiple of 64 KB");
+
+	D3D12_FEATURE_DATA_ARCHITECTURE Architecture = {};
+	if (SUCCEEDED(Device->CheckFeatureSupport(D3D12_FEATURE_ARCHITECTURE, &Architecture, sizeof(Architecture))))
+		bUma = Architecture.UMA;
+
+	for (UINT Type = 0; Type < HeapTypeCount; Type++)
+	{
+		for (UINT Category = 0; Category < (UINT)GpuMemoryCategory::Count; Category++)
+		{
+			Pools[Type][Category].HeapType = static_cast<D3D12_HEAP_TYPE>(D3D12_HEAP_TYPE_DEFAULT + Type);
+			Pools[Type][Category].Category = static_cast<GpuMemoryCategory>(Category);
+		}
+	}
+}
+
+GpuMemoryAllocator::~GpuMemoryAllocator()
+{
+	Stats Total = GetTotalStats();
+	if (Total.AllocationCount > 0 || Total.DedicatedCount > 0)
+	{
+		::OutputDebugStringA(("GpuMemoryAllocator destroyed with " + std::to_string(Total.AllocationCount) + " placed and "
+			+ std::to_string(Total.DedicatedCount) + " dedicated resources alive\n").c_str());
+		assert(false && "Resources must be released before their allocator");
+	}
+}
+
+HRESULT GpuMemoryAllocator::CreateResource(D3D12_HEAP_TYPE aHeapType, const D3D12_RESOURCE_DESC& aDesc,
+	D3D12_RESOURCE_STATES aInitialState, const D3D12_CLEAR_VALUE* aClearValue, Microsoft::WRL::ComPtr<ID3D12Resource>& aResource)
+{
+	// A resource replaced here returns its range through Release, which must not run under Lock
+	aResource.Reset();
+	GpuMemoryCategory Category = GetCategory(aDesc);
+	D3D12_RESOURCE_DESC Desc = aDesc;
+
+	// Small textures may use 4 KB placement, the device reports the default alignment when they can't
+	D3D12_RESOURCE_ALLOCATION_INFO Info = {};
+	if (Category == GpuMemoryCategory::Texture && Desc.Alignment == 0 && Desc.SampleDesc.Count <= 1)
+	{
+		Desc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+		Info = Device->GetResourceAllocationInfo(0, 1, &Desc);
+		if (Info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+			Desc.Alignment = 0;
+	}
+	if (Desc.Alignment == 0 || Info.SizeInBytes == 0)
+		Info = Device->GetResourceAllocationInfo(0, 1, &Desc);
+	if (Info.SizeInBytes == UINT64_MAX)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> Guard(Lock);
+	Pool& TargetPool = GetPool(aHeapType, Category);
+
+	// Large and multisampled resources would waste most of a block
+	if (Info.SizeInBytes > BlockSize / 2 || Info.Alignment > D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT)
+	{
+		auto HeapProperties = CD3DX12_HEAP_PROPERTIES(aHeapType);
+		HRESULT Result = Device->CreateCommittedResource(&HeapProperties, D3D12_HEAP_FLAG_NONE, &aDesc, aInitialState, aClearValue,
+			IID_PPV_ARGS(aResource.GetAddressOf()));
+		if (FAILED(Result))
+			return Result;
+		TargetPool.DedicatedCount++;
+		TargetPool.DedicatedBytes += Info.SizeInBytes;
+		TrackResource(aResource.Get(), TargetPool, DedicatedBlock, {}, Info.SizeInBytes);
+		return S_OK;
+	}
+
+	UINT BlockIndex = 0;
+	TlsfAllocator::Allocation Allocation;
+	for (; BlockIndex < TargetPool.Blocks.size() && !Allocation.IsValid(); BlockIndex++)
+	{
+		if (TargetPool.Blocks[BlockIndex] != nullptr)
+			Allocation = TargetPool.Blocks[BlockIndex]->Ranges.Allocate(Info.SizeInBytes, Info.Alignment);
+	}
+	if (Allocation.IsValid())
+		BlockIndex--;
+	else
+	{
+		BlockIndex = CreateBlock(TargetPool);
+		Allocation = TargetPool.Blocks[BlockIndex]->Ranges.Allocate(Info.SizeInBytes, Info.Alignment);
+		assert(Allocation.IsValid() && "Resource does not fit an empty block");
+	}
+
+	HeapBlock& Block = *TargetPool.Blocks[BlockIndex];
+	HRESULT Result = Device->CreatePlacedResource(Block.Heap.Get(), Allocation.Offset, &Desc, aInitialState, aClearValue,
+		IID_PPV_ARGS(aResource.GetAddressOf()));
+	if (FAILED(Result))
+	{
+		Block.Ranges.Free(Allocation);
+		return Result;
+	}
+	TrackResource(aResource.Get(), TargetPool, BlockIndex, Allocation, 0);
+	return S_OK;
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> GpuMemoryAllocator::CreateBuffer(D3D12_HEAP_TYPE aHeapType, UINT64 aByteSize,
+	D3D12_RESOURCE_STATES aInitialState)
+{
+	Microsoft::WRL::ComPtr<ID3D12Resource> Buffer;
+	auto ResourceDesc = CD3DX12_RESOURCE_DESC::Buffer(aByteSize);
+	ThrowIfFailed(CreateResource(aHeapType, ResourceDesc, aInitialState, nullptr, Buffer));
+	return Buffer;
+}
+
+void GpuMemoryAllocator::TrimEmptyBlocks()
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	for (auto& TypePools : Pools)
+	{
+		for (Pool& CategoryPool : TypePools)
+			ReleaseEmptyBlocks(CategoryPool, 0);
+	}
+}
+
+GpuMemoryAllocator::Stats GpuMemoryAllocator::GetStats(D3D12_HEAP_TYPE aHeapType, GpuMemoryCategory aCategory) const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	return GetStats(GetPool(aHeapType, aCategory));
+}
+
+GpuMemoryAllocator::Stats GpuMemoryAllocator::GetTotalStats() const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	Stats Total;
+	for (const auto& TypePools : Pools)
+	{
+		for (const Pool& CategoryPool : TypePools)
+			Total.Add(GetStats(CategoryPool));
+	}
+	return Total;
+}
+
+GpuMemoryAllocator::Budget GpuMemoryAllocator::QueryBudget(DXGI_MEMORY_SEGMENT_GROUP aSegmentGroup) const
+{
+	Budget Result;
+	DXGI_QUERY_VIDEO_MEMORY_INFO Info = {};
+	if (Adapter != nullptr && SUCCEEDED(Adapter->QueryVideoMemoryInfo(0, aSegmentGroup, &Info)))
+	{
+		Result.BudgetBytes = Info.Budget;
+		Result.CurrentUsageBytes = Info.CurrentUsage;
+	}
+	std::lock_guard<std::mutex> Guard(Lock);
+	Result.AllocatorBytes = GetSegmentBytes(aSegmentGroup);
+	return Result;
+}
+
+void GpuMemoryAllocator::ReportStats() const
+{
+	constexpr UINT64 MB = 1024 * 1024;
+	std::string Report = "[GpuMemory]";
+	for (const auto& TypePools : Pools)
+	{
+		for (const Pool& CategoryPool : TypePools)
+		{
+			Stats PoolStats = GetStats(CategoryPool.HeapType, CategoryPool.Category);
+			if (PoolStats.BlockCount == 0 && PoolStats.DedicatedCount == 0)
+				continue;
+			Report += std::string(" ") + GetName(CategoryPool.HeapType) + "/" + GetName(CategoryPool.Category)
+				+ "(blocks/MB/resources/used MB/free ranges/fragmentation/dedicated/MB)=" + std::to_string(PoolStats.BlockCount)
+				+ "/" + std::to_string(PoolStats.BlockBytes / MB)
+				+ "/" + std::to_string(PoolStats.AllocationCount)
+				+ "/" + std::to_string(PoolStats.AllocatedBytes / MB)
+				+ "/" + std::to_string(PoolStats.FreeRanges)
+				+ "/" + std::to_string(PoolStats.Fragmentation)
+				+ "/" + std::to_string(PoolStats.DedicatedCount)
+				+ "/" + std::to_string(PoolStats.DedicatedBytes / MB);
+		}
+	}
+	for (DXGI_MEMORY_SEGMENT_GROUP Group : { DXGI_MEMORY_SEGMENT_GROUP_LOCAL, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL })
+	{
+		Budget SegmentBudget = QueryBudget(Group);
+		Report += std::string(Group == DXGI_MEMORY_SEGMENT_GROUP_LOCAL ? " Local" : " NonLocal")
+			+ "(budget/usage/allocator MB)=" + std::to_string(SegmentBudget.BudgetBytes / MB)
+			+ "/" + std::to_string(SegmentBudget.CurrentUsageBytes / MB)
+			+ "/" + std::to_string(SegmentBudget.AllocatorBytes / MB);
+	}
+	Report += "\n";
+	::OutputDebugStringA(Report.c_str());
+}
+
+GpuMemoryCategory GpuMemoryAllocator::GetCategory(const D3D12_RESOURCE_DESC& aDesc)
+{
+	if (aDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		return GpuMemoryCategory::Buffer;
+	if (aDesc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+		return GpuMemoryCategory::RenderTarget;
+	return GpuMemoryCategory::Texture;
+}
+
+GpuMemoryAllocator::Pool& GpuMemoryAllocator::GetPool(D3D12_HEAP_TYPE aHeapType, GpuMemoryCategory aCategory)
+{
+	return Pools[GetHeapTypeIndex(aHeapType)][(size_t)aCategory];
+}
+
+const GpuMemoryAllocator::Pool& GpuMemoryAllocator::GetPool(D3D12_HEAP_TYPE aHeapType, GpuMemoryCategory aCategory) const
+{
+	return Pools[GetHeapTypeIndex(aHeapType)][(size_t)aCategory];
+}
+
+DXGI_MEMORY_SEGMENT_GROUP GpuMemoryAllocator::GetSegmentGroup(D3D12_HEAP_TYPE aHeapType) const
+{
+	return bUma || aHeapType == D3D12_HEAP_TYPE_DEFAULT ? DXGI_MEMORY_SEGMENT_GROUP_LOCAL : DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL;
+}
+
+UINT GpuMemoryAllocator::CreateBlock(Pool& aPool)
+{
+	// Over budget the OS starts paging, worth knowing before the frame rate drops
+	DXGI_MEMORY_SEGMENT_GROUP SegmentGroup = GetSegmentGroup(aPool.HeapType);
+	DXGI_QUERY_VIDEO_MEMORY_INFO Info = {};
+	if (Adapter != nullptr && SUCCEEDED(Adapter->QueryVideoMemoryInfo(0, SegmentGroup, &Info)) && Info.CurrentUsage + BlockSize > Info.Budget)
+	{
+		::OutputDebugStringA((std::string("GpuMemoryAllocator: new ") + GetName(aPool.HeapType) + "/" + GetName(aPool.Category)
+			+ " block exceeds the memory budget\n").c_str());
+	}
+
+	auto Block = std::make_unique<HeapBlock>();
+	D3D12_HEAP_DESC HeapDesc = {};
+	HeapDesc.SizeInBytes = BlockSize;
+	HeapDesc.Properties = CD3DX12_HEAP_PROPERTIES(aPool.HeapType);
+	HeapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	HeapDesc.Flags = GetHeapFlags(aPool.Category);
+	ThrowIfFailed(Device->CreateHeap(&HeapDesc, IID_PPV_ARGS(Block->Heap.GetAddressOf())));
+	Block->Ranges.Reset(BlockSize);
+
+	auto Slot = std::find(aPool.Blocks.begin(), aPool.Blocks.end(), nullptr);
+	UINT Index = static_cast<UINT>(Slot - aPool.Blocks.begin());
+	std::string Name = std::string("GpuMemory_") + GetName(aPool.HeapType) + "_" + GetName(aPool.Category) + "_" + std::to_string(Index);
+	Block->Heap->SetName(std::wstring(Name.begin(), Name.end()).c_str());
+	if (Slot != aPool.Blocks.end())
+		*Slot = std::move(Block);
+	else
+		aPool.Blocks.push_back(std::move(Block));
+	return Index;
+}
+
+void GpuMemoryAllocator::Release(Pool& aPool, UINT aBlock, const TlsfAllocator::Allocation& aAllocation, UINT64 aDedicatedBytes)
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	if (aBlock == DedicatedBlock)
+	{
+		aPool.DedicatedCount--;
+		aPool.DedicatedBytes -= aDedicatedBytes;
+		return;
+	}
+
+	HeapBlock& Block = *aPool.Blocks[aBlock];
+	Block.Ranges.Free(aAllocation);
+	// One empty block stays to absorb the next allocations without creating a heap
+	if (Block.Ranges.IsEmpty())
+		ReleaseEmptyBlocks(aPool, 1);
+}
+
+void GpuMemoryAllocator::TrackResource(ID3D12Resource* aResource, Pool& aPool, UINT aBlock, const TlsfAllocator::Allocation& aAllocation,
+	UINT64 aDedicatedBytes)
+{
+	// The resource takes its own reference, dropping ours leaves it the only owner
+	auto* Releaser = new AllocationReleaser(*this, aPool, aBlock, aAllocation, aDedicatedBytes);
+	HRESULT Result = aResource->SetPrivateDataInterface(AllocationReleaserGuid, Releaser);
+	assert(SUCCEEDED(Result) && "Resource refused its releaser");
+	if (FAILED(Result))
+	{
+		// The range leaks, releasing it here would take Lock a second time
+		delete Releaser;
+		return;
+	}
+	Releaser->Release();
+}
+
+void GpuMemoryAllocator::ReleaseEmptyBlocks(Pool& aPool, UINT aKeepCount)
+{
+	UINT EmptyCount = 0;
+	for (auto& Block : aPool.Blocks)
+	{
+		if (Block != nullptr && Block->Ranges.IsEmpty() && ++EmptyCount > aKeepCount)
+			Block.reset();
+	}
+	while (!aPool.Blocks.empty() && aPool.Blocks.back() == nullptr)
+		aPool.Blocks.pop_back();
+}
+
+GpuMemoryAllocator::Stats GpuMemoryAllocator::GetStats(const Pool& aPool) const
+{
+	Stats Result;
+	for (const auto& Block : aPool.Blocks)
+	{
+		if (Block == nullptr)
+			continue;
+		const TlsfAllocator& Ranges = Block->Ranges;
+		Result.BlockCount++;
+		Result.BlockBytes += Ranges.GetCapacity();
+		Result.AllocationCount += static_cast<UINT>(Ranges.GetAllocationCount());
+		Result.AllocatedBytes += Ranges.GetUsedSize();
+		Result.FreeRanges += Ranges.GetFreeBlockCount();
+		Result.LargestFreeRange = std::max<UINT64>(Result.LargestFreeRange, Ranges.GetLargestFreeBlock());
+		Result.Fragmentation = std::max(Result.Fragmentation, Ranges.GetFragmentation());
+	}
+	Result.DedicatedCount = aPool.DedicatedCount;
+	Result.DedicatedBytes = aPool.DedicatedBytes;
+	return Result;
+}
+
+UINT64 GpuMemoryAllocator::GetSegmentBytes(DXGI_MEMORY_SEGMENT_GROUP aSegmentGroup) const
+{
+	UINT64 Bytes = 0;
+	for (const auto& TypePools : Pools)
+	{
+		for (const Pool& CategoryPool : TypePools)
+		{
+			if (GetSegmentGroup(CategoryPool.HeapType) != aSegmentGroup)
+				continue;
+			Stats PoolStats = GetStats(CategoryPool);
+			Bytes += PoolStats.BlockBytes + PoolStats.DedicatedBytes;
+		}
+	}
+	return Bytes;
+}
@@ -0,0 +1,124 @@
+//***************************************************************************************
+// GpuMemoryAllocator.h
+//
+// Places resources into large ID3D12Heap blocks instead of committing each one
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "TlsfAllocator.h"
+#include <climits>
+#include <mutex>
+
+// Heaps of resource heap tier 1 hold only one of these
+enum class GpuMemoryCategory
+{
+	Buffer,
+	Texture,		// Neither render target nor depth stencil
+	RenderTarget,	// Render targets and depth stencils
+	Count
+};
+
+// Creates placed resources in blocks of BlockSize bytes, one list of blocks per heap type and category, each
+// suballocated by a TlsfAllocator. Resources larger than half a block are committed on their own and counted
+// as dedicated. Small textures are placed at D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT when the device allows it.
+// The range of a resource is returned when the resource is destroyed, through an object in its private data,
+// so callers keep holding plain ComPtr<ID3D12Resource> and release them once the GPU is done as before.
+// Placed render targets and depth stencils may land on memory of released resources and must be cleared,
+// discarded or copied to before they are read. Must outlive every resource it created. Thread safe.
+class GpuMemoryAllocator
+{
+public:
+	struct Stats
+	{
+		UINT BlockCount = 0;
+		UINT64 BlockBytes = 0;
+		UINT AllocationCount = 0;
+		UINT64 AllocatedBytes = 0;		// Including alignment padding
+		UINT64 FreeRanges = 0;
+		UINT64 LargestFreeRange = 0;
+		float Fragmentation = 0.0f;		// Of the most fragmented block, see TlsfAllocator::GetFragmentation
+		UINT DedicatedCount = 0;
+		UINT64 DedicatedBytes = 0;
+
+		void Add(const Stats& aOther);
+	};
+
+	struct Budget
+	{
+		UINT64 BudgetBytes = 0;			// What the OS grants the process in the segment group, 0 without an adapter
+		UINT64 CurrentUsageBytes = 0;	// Of the whole process
+		UINT64 AllocatorBytes = 0;		// Blocks and dedicated resources of this allocator in the segment group
+	};
+
+	GpuMemoryAllocator(ID3D12Device* aDevice, IDXGIAdapter3* aAdapter, UINT64 aBlockSize = 64 * 1024 * 1024);
+	GpuMemoryAllocator(const GpuMemoryAllocator&) = delete;
+	GpuMemoryAllocator& operator=(const GpuMemoryAllocator&) = delete;
+	~GpuMemoryAllocator();
+
+	ID3D12Device* GetDevice() const { return Device.Get(); }
+
+	// Drop in for CreateCommittedResource with D3D12_HEAP_FLAG_NONE
+	HRESULT CreateResource(D3D12_HEAP_TYPE aHeapType, const D3D12_RESOURCE_DESC& aDesc, D3D12_RESOURCE_STATES aInitialState,
+		const D3D12_CLEAR_VALUE* aClearValue, Microsoft::WRL::ComPtr<ID3D12Resource>& aResource);
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(D3D12_HEAP_TYPE aHeapType, UINT64 aByteSize, D3D12_RESOURCE_STATES aInitialState);
+
+	// Releases the blocks no resource is placed in, one per heap type and category is kept otherwise
+	void TrimEmptyBlocks();
+
+	Stats GetStats(D3D12_HEAP_TYPE aHeapType, GpuMemoryCategory aCategory) const;
+	Stats GetTotalStats() const;
+	// Local is video memory, non local system memory visible to the GPU. On UMA devices everything is local.
+	Budget QueryBudget(DXGI_MEMORY_SEGMENT_GROUP aSegmentGroup) const;
+	// Writes the stats of every heap type and category and the budgets to the debug output
+	void ReportStats() const;
+
+	static GpuMemoryCategory GetCategory(const D3D12_RESOURCE_DESC& aDesc);
+
+private:
+	class AllocationReleaser;
+
+	static constexpr UINT HeapTypeCount = 3;	// Default, upload, readback
+	static constexpr UINT DedicatedBlock = UINT_MAX;
+
+	struct HeapBlock
+	{
+		Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+		TlsfAllocator Ranges;
+	};
+
+	struct Pool
+	{
+		D3D12_HEAP_TYPE HeapType = D3D12_HEAP_TYPE_DEFAULT;
+		GpuMemoryCategory Category = GpuMemoryCategory::Buffer;
+		// Null entries are released blocks whose slot is reused
+		std::vector<std::unique_ptr<HeapBlock>> Blocks;
+		UINT DedicatedCount = 0;
+		UINT64 DedicatedBytes = 0;
+	};
+
+	Pool& GetPool(D3D12_HEAP_TYPE aHeapType, GpuMemoryCategory aCategory);
+	const Pool& GetPool(D3D12_HEAP_TYPE aHeapType, GpuMemoryCategory aCategory) const;
+	DXGI_MEMORY_SEGMENT_GROUP GetSegmentGroup(D3D12_HEAP_TYPE aHeapType) const;
+	// Block index of a new block in aPool
+	UINT CreateBlock(Pool& aPool);
+	// Called by AllocationReleaser when the resource is destroyed
+	void Release(Pool& aPool, UINT aBlock, const TlsfAllocator::Allocation& aAllocation, UINT64 aDedicatedBytes);
+	// Attaches an AllocationReleaser to aResource
+	void TrackResource(ID3D12Resource* aResource, Pool& aPool, UINT aBlock, const TlsfAllocator::Allocation& aAllocation,
+		UINT64 aDedicatedBytes);
+	// Frees empty blocks of aPool beyond aKeepCount, must hold Lock
+	void ReleaseEmptyBlocks(Pool& aPool, UINT aKeepCount);
+	// Must hold Lock
+	Stats GetStats(const Pool& aPool) const;
+	// Bytes of the blocks and dedicated resources in aSegmentGroup, must hold Lock
+	UINT64 GetSegmentBytes(DXGI_MEMORY_SEGMENT_GROUP aSegmentGroup) const;
+
+	Microsoft::WRL::ComPtr<ID3D12Device> Device;
+	Microsoft::WRL::ComPtr<IDXGIAdapter3> Adapter;
+	UINT64 BlockSize;
+	bool bUma = false;
+	mutable std::mutex Lock;
+	Pool Pools[HeapTypeCount][(size_t)GpuMemoryCategory::Count];
+};
@@ -0,0 +1,438 @@
+//***************************************************************************************
+// MeshCache.cpp
+//
+// Cooked .dxmesh files of imported models, loaded without Assimp through a memory map
+//***************************************************************************************
+
+#include "MeshCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr std::uint32_t FileMagic = 0x48534d44;	// "DMSH"
+	constexpr size_t SectionAlignment = 16;
+
+	// Strings live in one blob at the end of the file
+	struct StringRef
+	{
+		std::uint32_t Offset;
+		std::uint32_t Length;
+	};
+
+	// Sections follow in this order, each aligned to SectionAlignment:
+	// vertices, indices, meshlets, submeshes, materials, strings
+	struct FileHeader
+	{
+		std::uint32_t Magic;
+		std::uint32_t Version;
+		std::uint64_t SourceHash;
+		std::uint64_t SettingsHash;
+		std::uint64_t FileSize;
+
+		std::uint32_t VertexStride;
+		std::uint32_t Use32BitIndices;
+		std::uint64_t VertexCount;
+		std::uint64_t VertexOffset;
+		std::uint64_t IndexCount;
+		std::uint64_t IndexOffset;
+		std::uint64_t MeshletCount;
+		std::uint64_t MeshletOffset;
+
+		std::uint32_t SubmeshCount;
+		std::uint32_t MaterialCount;
+		std::uint64_t SubmeshOffset;
+		std::uint64_t MaterialOffset;
+		std::uint64_t StringOffset;
+		std::uint64_t StringSize;
+	};
+
+	struct SubmeshRecord
+	{
+		StringRef Name;
+		std::uint32_t IndexCount;
+		std::uint32_t StartIndexLocation;
+		std::int32_t BaseVertexLocation;
+		std::uint32_t MaterialIndex;
+		DirectX::XMFLOAT3 BoundsCenter;
+		DirectX::XMFLOAT3 BoundsExtents;
+		std::uint32_t FirstMeshlet;
+		std::uint32_t MeshletCount;
+	};
+
+	struct MaterialRecord
+	{
+		StringRef Name;
+		StringRef DiffuseTexturePath;
+		StringRef NormalTexturePath;
+		DirectX::XMFLOAT4 DiffuseColor;
+		float Roughness;
+		float Metallic;
+	};
+
+	size_t AlignSection(size_t aOffset)
+	{
+		return (aOffset + SectionAlignment - 1) & ~(SectionAlignment - 1);
+	}
+
+	StringRef AddString(std::string& aStrings, const std::string& aValue)
+	{
+		StringRef Ref = { static_cast<std::uint32_t>(aStrings.size()), static_cast<std::uint32_t>(aValue.size()) };
+		aStrings += aValue;
+		return Ref;
+	}
+
+	bool SectionFits(std::uint64_t aOffset, std::uint64_t aCount, std::uint64_t aElementSize, std::uint64_t aFileSize)
+	{
+		return aOffset % SectionAlignment == 0 && aOffset <= aFileSize && aCount <= (aFileSize - aOffset) / aElementSize;
+	}
+}
+
+namespace MeshCache
+{
+	std::uint64_t HashBytes(const void* aData, size_t aSize, std::uint64_t aSeed)
+	{
+		const std::uint8_t* Bytes = static_cast<const std::uint8_t*>(aData);
+		std::uint64_t Hash = aSeed;
+		for (size_t i = 0; i < aSize; i++)
+		{
+			Hash ^= Bytes[i];
+			Hash *= 0x100000001b3ull;
+		}
+		return Hash;
+	}
+
+	std::uint64_t HashFile(const std::string& aPath)
+	{
+		MappedFile File;
+		if (!File.Open(aPath))
+			return 0;
+		std::uint64_t Hash = HashBytes(File.GetData(), File.GetSize());
+		return Hash != 0 ? Hash : 1;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& aOther) noexcept
+	{
+		*this = std::move(aOther);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& aOther) noexcept
+	{
+		if (this != &aOther)
+		{
+			Close();
+			std::swap(Data, aOther.Data);
+			std::swap(Size, aOther.Size);
+			std::swap(FileHandle, aOther.FileHandle);
+			std::swap(MappingHandle, aOther.MappingHandle);
+		}
+		return *this;
+	}
+
+	bool MappedFile::Open(const std::string& aPath)
+	{
+		Close();
+#ifdef _WIN32
+		HANDLE File = ::CreateFileA(aPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (File == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER FileSize;
+		if (!::GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0)
+		{
+			::CloseHandle(File);
+			return false;
+		}
+		HANDLE Mapping = ::CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!Mapping)
+		{
+			::CloseHandle(File);
+			return false;
+		}
+		const void* View = ::MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!View)
+		{
+			::CloseHandle(Mapping);
+			::CloseHandle(File);
+			return false;
+		}
+		FileHandle = File;
+		MappingHandle = Mapping;
+		Size = static_cast<size_t>(FileSize.QuadPart);
+#else
+		int File = ::open(aPath.c_str(), O_RDONLY);
+		if (File < 0)
+			return false;
+		struct stat FileStat;
+		if (::fstat(File, &FileStat) != 0 || FileStat.st_size == 0)
+		{
+			::close(File);
+			return false;
+		}
+		void* View = ::mmap(nullptr, static_cast<size_t>(FileStat.st_size), PROT_READ, MAP_PRIVATE, File, 0);
+		::close(File);
+		if (View == MAP_FAILED)
+			return false;
+		Size = static_cast<size_t>(FileStat.st_size);
+#endif
+		Data = static_cast<const std::uint8_t*>(View);
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (!Data)
+			return;
+#ifdef _WIN32
+		::UnmapViewOfFile(Data);
+		::CloseHandle(static_cast<HANDLE>(MappingHandle));
+		::CloseHandle(static_cast<HANDLE>(FileHandle));
+#else
+		::munmap(const_cast<std::uint8_t*>(Data), Size);
+#endif
+		Data = nullptr;
+		Size = 0;
+		FileHandle = nullptr;
+		MappingHandle = nullptr;
+	}
+
+	bool Write(const std::string& aPath, const ModelImporter::ModelData& aModel, const std::vector<DirectX::BoundingBox>& aSubmeshBounds,
+		const Key& aKey)
+	{
+		size_t SubmeshCount = std::max<size_t>(aModel.Submeshes.size(), 1);
+		if (aSubmeshBounds.size() != SubmeshCount)
+			return false;
+
+		std::string Strings;
+		std::vector<Meshlet> Meshlets;
+		std::vector<SubmeshRecord> SubmeshRecords(SubmeshCount);
+		for (size_t i = 0; i < SubmeshCount; i++)
+		{
+			SubmeshRecord& Record = SubmeshRecords[i];
+			Record.Name = AddString(Strings, ModelImporter::GetSubmeshName(aModel, i));
+			if (aModel.Submeshes.empty())
+			{
+				Record.IndexCount = static_cast<std::uint32_t>(aModel.Use32BitIndices ? aModel.Indices32.size() : aModel.Indices16.size());
+				Record.StartIndexLocation = 0;
+				Record.BaseVertexLocation = 0;
+				Record.MaterialIndex = 0;
+				Record.FirstMeshlet = 0;
+				Record.MeshletCount = 0;
+			}
+			else
+			{
+				const ModelImporter::ModelData::Submesh& Submesh = aModel.Submeshes[i];
+				Record.IndexCount = Submesh.IndexCount;
+				Record.StartIndexLocation = Submesh.StartIndexLocation;
+				Record.BaseVertexLocation = Submesh.BaseVertexLocation;
+				Record.MaterialIndex = Submesh.MaterialIndex;
+				Record.FirstMeshlet = static_cast<std::uint32_t>(Meshlets.size());
+				Record.MeshletCount = static_cast<std::uint32_t>(Submesh.Meshlets.size());
+				Meshlets.insert(Meshlets.end(), Submesh.Meshlets.begin(), Submesh.Meshlets.end());
+			}
+			Record.BoundsCenter = aSubmeshBounds[i].Center;
+			Record.BoundsExtents = aSubmeshBounds[i].Extents;
+		}
+
+		std::vector<MaterialRecord> MaterialRecords(aModel.Materials.size());
+		for (size_t i = 0; i < aModel.Materials.size(); i++)
+		{
+			const ModelImporter::ModelMaterial& Material = aModel.Materials[i];
+			MaterialRecord& Record = MaterialRecords[i];
+			Record.Name = AddString(Strings, Material.Name);
+			Record.DiffuseTexturePath = AddString(Strings, Material.DiffuseTexturePath);
+			Record.NormalTexturePath = AddString(Strings, Material.NormalTexturePath);
+			Record.DiffuseColor = Material.DiffuseColor;
+			Record.Roughness = Material.Roughness;
+			Record.Metallic = Material.Metallic;
+		}
+
+		const void* Indices = aModel.Use32BitIndices ? static_cast<const void*>(aModel.Indices32.data()) : aModel.Indices16.data();
+		size_t IndexCount = aModel.Use32BitIndices ? aModel.Indices32.size() : aModel.Indices16.size();
+		size_t IndexSize = aModel.Use32BitIndices ? sizeof(std::uint32_t) : sizeof(std::uint16_t);
+
+		FileHeader Header = {};
+		Header.Magic = FileMagic;
+		Header.Version = Version;
+		Header.SourceHash = aKey.SourceHash;
+		Header.SettingsHash = aKey.SettingsHash;
+		Header.VertexStride = sizeof(Vertex);
+		Header.Use32BitIndices = aModel.Use32BitIndices ? 1 : 0;
+		Header.VertexCount = aModel.Vertices.size();
+		Header.VertexOffset = AlignSection(sizeof(FileHeader));
+		Header.IndexCount = IndexCount;
+		Header.IndexOffset = AlignSection(Header.VertexOffset + Header.VertexCount * sizeof(Vertex));
+		Header.MeshletCount = Meshlets.size();
+		Header.MeshletOffset = AlignSection(Header.IndexOffset + IndexCount * IndexSize);
+		Header.SubmeshCount = static_cast<std::uint32_t>(SubmeshRecords.size());
+		Header.SubmeshOffset = AlignSection(Header.MeshletOffset + Meshlets.size() * sizeof(Meshlet));
+		Header.MaterialCount = static_cast<std::uint32_t>(MaterialRecords.size());
+		Header.MaterialOffset = AlignSection(Header.SubmeshOffset + SubmeshRecords.size() * sizeof(SubmeshRecord));
+		Header.StringOffset = AlignSection(Header.MaterialOffset + MaterialRecords.size() * sizeof(MaterialRecord));
+		Header.StringSize = Strings.size();
+		Header.FileSize = Header.StringOffset + Header.StringSize;
+
+		std::error_code Error;
+		std::filesystem::path Path(aPath);
+		if (Path.has_parent_path())
+			std::filesystem::create_directories(Path.parent_path(), Error);
+
+		std::string TempPath = aPath + ".tmp";
+		{
+			std::ofstream Out(TempPath, std::ios::binary | std::ios::trunc);
+			if (!Out)
+				return false;
+
+			auto WriteSection = [&Out](std::uint64_t aOffset, const void* aData, size_t aSize)
+			{
+				static const char Padding[SectionAlignment] = {};
+				Out.write(Padding, static_cast<std::streamsize>(aOffset - static_cast<std::uint64_t>(Out.tellp())));
+				Out.write(static_cast<const char*>(aData), static_cast<std::streamsize>(aSize));
+			};
+			Out.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+			WriteSection(Header.VertexOffset, aModel.Vertices.data(), aModel.Vertices.size() * sizeof(Vertex));
+			WriteSection(Header.IndexOffset, Indices, IndexCount * IndexSize);
+			WriteSection(Header.MeshletOffset, Meshlets.data(), Meshlets.size() * sizeof(Meshlet));
+			WriteSection(Header.SubmeshOffset, SubmeshRecords.data(), SubmeshRecords.size() * sizeof(SubmeshRecord));
+			WriteSection(Header.MaterialOffset, MaterialRecords.data(), MaterialRecords.size() * sizeof(MaterialRecord));
+			WriteSection(Header.StringOffset, Strings.data(), Strings.size());
+			if (!Out)
+				return false;
+		}
+
+		std::filesystem::rename(TempPath, Path, Error);
+		if (Error)
+		{
+			std::filesystem::remove(TempPath, Error);
+			return false;
+		}
+		return true;
+	}
+
+	bool CachedMesh::Open(const std::string& aPath, const Key& aKey)
+	{
+		View = {};
+		Submeshes.clear();
+		SubmeshBounds.clear();
+		Materials.clear();
+		if (!File.Open(aPath) || File.GetSize() < sizeof(FileHeader))
+			return false;
+
+		const std::uint8_t* Data = File.GetData();
+		FileHeader Header;
+		memcpy(&Header, Data, sizeof(Header));
+		size_t IndexSize = Header.Use32BitIndices ? sizeof(std::uint32_t) : sizeof(std::uint16_t);
+		bool bValid = Header.Magic == FileMagic && Header.Version == Version && Header.VertexStride == sizeof(Vertex)
+			&& Header.SourceHash == aKey.SourceHash && Header.SettingsHash == aKey.SettingsHash
+			&& Header.FileSize == File.GetSize()
+			&& SectionFits(Header.VertexOffset, Header.VertexCount, sizeof(Vertex), Header.FileSize)
+			&& SectionFits(Header.IndexOffset, Header.IndexCount, IndexSize, Header.FileSize)
+			&& SectionFits(Header.MeshletOffset, Header.MeshletCount, sizeof(Meshlet), Header.FileSize)
+			&& SectionFits(Header.SubmeshOffset, Header.SubmeshCount, sizeof(SubmeshRecord), Header.FileSize)
+			&& SectionFits(Header.MaterialOffset, Header.MaterialCount, sizeof(MaterialRecord), Header.FileSize)
+			&& Header.StringOffset <= Header.FileSize && Header.StringSize <= Header.FileSize - Header.StringOffset;
+		if (!bValid)
+		{
+			File.Close();
+			return false;
+		}
+
+		const char* Strings = reinterpret_cast<const char*>(Data + Header.StringOffset);
+		auto ReadString = [&](const StringRef& aRef, std::string& aOut)
+		{
+			if (aRef.Offset > Header.StringSize || aRef.Length > Header.StringSize - aRef.Offset)
+				return false;
+			aOut.assign(Strings + aRef.Offset, aRef.Length);
+			return true;
+		};
+		auto Fail = [this]()
+		{
+			Submeshes.clear();
+			SubmeshBounds.clear();
+			Materials.clear();
+			File.Close();
+			return false;
+		};
+
+		// Every vertex a submesh reads through its base vertex must exist
+		const void* Indices = Data + Header.IndexOffset;
+		auto IndicesFit = [&](const SubmeshRecord& aRecord)
+		{
+			std::int64_t FirstVertex = aRecord.BaseVertexLocation;
+			std::uint64_t MaxIndex = 0;
+			for (std::uint32_t i = 0; i < aRecord.IndexCount; i++)
+			{
+				size_t Index = aRecord.StartIndexLocation + size_t(i);
+				MaxIndex = std::max<std::uint64_t>(MaxIndex, Header.Use32BitIndices ? static_cast<const std::uint32_t*>(Indices)[Index]
+					: static_cast<const std::uint16_t*>(Indices)[Index]);
+			}
+			return aRecord.IndexCount == 0
+				|| (FirstVertex >= 0 && std::uint64_t(FirstVertex) + MaxIndex < Header.VertexCount);
+		};
+
+		const Meshlet* Meshlets = reinterpret_cast<const Meshlet*>(Data + Header.MeshletOffset);
+		const SubmeshRecord* SubmeshRecords = reinterpret_cast<const SubmeshRecord*>(Data + Header.SubmeshOffset);
+		Submeshes.resize(Header.SubmeshCount);
+		SubmeshBounds.resize(Header.SubmeshCount);
+		for (std::uint32_t i = 0; i < Header.SubmeshCount; i++)
+		{
+			const SubmeshRecord& Record = SubmeshRecords[i];
+			ModelImporter::ModelData::Submesh& Submesh = Submeshes[i];
+			if (!ReadString(Record.Name, Submesh.Name) || Record.StartIndexLocation > Header.IndexCount
+				|| Record.IndexCount > Header.IndexCount - Record.StartIndexLocation
+				|| Record.FirstMeshlet > Header.MeshletCount || Record.MeshletCount > Header.MeshletCount - Record.FirstMeshlet
+				|| !IndicesFit(Record))
+				return Fail();
+
+			Submesh.IndexCount = Record.IndexCount;
+			Submesh.StartIndexLocation = Record.StartIndexLocation;
+			Submesh.BaseVertexLocation = Record.BaseVertexLocation;
+			Submesh.MaterialIndex = Record.MaterialIndex;
+			Submesh.Meshlets.assign(Meshlets + Record.FirstMeshlet, Meshlets + Record.FirstMeshlet + Record.MeshletCount);
+			for (const Meshlet& Cluster : Submesh.Meshlets)
+			{
+				if (Cluster.IndexStart > Submesh.IndexCount || Cluster.IndexCount > Submesh.IndexCount - Cluster.IndexStart)
+					return Fail();
+			}
+			SubmeshBounds[i] = DirectX::BoundingBox(Record.BoundsCenter, Record.BoundsExtents);
+		}
+
+		const MaterialRecord* MaterialRecords = reinterpret_cast<const MaterialRecord*>(Data + Header.MaterialOffset);
+		Materials.resize(Header.MaterialCount);
+		for (std::uint32_t i = 0; i < Header.MaterialCount; i++)
+		{
+			const MaterialRecord& Record = MaterialRecords[i];
+			ModelImporter::ModelMaterial& Material = Materials[i];
+			if (!ReadString(Record.Name, Material.Name) || !ReadString(Record.DiffuseTexturePath, Material.DiffuseTexturePath)
+				|| !ReadString(Record.NormalTexturePath, Material.NormalTexturePath))
+				return Fail();
+			Material.DiffuseColor = Record.DiffuseColor;
+			Material.Roughness = Record.Roughness;
+			Material.Metallic = Record.Metallic;
+		}
+
+		View.Vertices = reinterpret_cast<const Vertex*>(Data + Header.VertexOffset);
+		View.VertexCount = static_cast<size_t>(Header.VertexCount);
+		View.Indices = Indices;
+		View.IndexCount = static_cast<size_t>(Header.IndexCount);
+		View.Use32BitIndices = Header.Use32BitIndices != 0;
+		return true;
+	}
+}
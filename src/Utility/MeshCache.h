@@ -0,0 +1,95 @@
+//***************************************************************************************
+// MeshCache.h
+//
+// Cooked .dxmesh files of imported models, loaded without Assimp through a memory map
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <DirectXCollision.h>
+#include "ModelData.h"
+
+namespace MeshCache
+{
+	// Bumped whenever the file layout or the cooking of a model changes
+	constexpr std::uint32_t Version = 3;
+
+	// A file is only used when both hashes match the ones it was written with
+	struct Key
+	{
+		std::uint64_t SourceHash = 0;	// Contents of the source model file
+		std::uint64_t SettingsHash = 0;	// Import flags and post processing, see HashValue
+	};
+
+	// 64 bit FNV-1a, aSeed chains several calls
+	std::uint64_t HashBytes(const void* aData, size_t aSize, std::uint64_t aSeed = 0xcbf29ce484222325ull);
+
+	template<typename T>
+	std::uint64_t HashValue(const T& aValue, std::uint64_t aSeed = 0xcbf29ce484222325ull)
+	{
+		return HashBytes(&aValue, sizeof(T), aSeed);
+	}
+
+	// Hash of the file contents, 0 when it can't be read
+	std::uint64_t HashFile(const std::string& aPath);
+
+	// Read only view of a whole file
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& aOther) noexcept;
+		MappedFile& operator=(MappedFile&& aOther) noexcept;
+
+		bool Open(const std::string& aPath);
+		void Close();
+
+		const std::uint8_t* GetData() const { return Data; }
+		size_t GetSize() const { return Size; }
+
+	private:
+		const std::uint8_t* Data = nullptr;
+		size_t Size = 0;
+		void* FileHandle = nullptr;
+		void* MappingHandle = nullptr;
+	};
+
+	// Writes the vertices, indices, submeshes with their bounds and meshlets and the materials of aModel. aSubmeshBounds
+	// has a box per submesh, or one for a model without submeshes, see ModelImporter::BuildSubmeshGeometries. The file
+	// is written next to its final path and renamed, so a crash never leaves a partial file behind.
+	bool Write(const std::string& aPath, const ModelImporter::ModelData& aModel, const std::vector<DirectX::BoundingBox>& aSubmeshBounds,
+		const Key& aKey);
+
+	// A .dxmesh file mapped into memory. The vertex and index arrays are used in place, moving a CachedMesh
+	// keeps them valid.
+	class CachedMesh
+	{
+	public:
+		// False when the file is missing, truncated, of another version or written for another key, or when a
+		// submesh reaches past the vertex or index arrays. Every index is checked, so a damaged file can't be
+		// drawn or read out of bounds.
+		bool Open(const std::string& aPath, const Key& aKey);
+
+		const ModelImporter::MeshView& GetMeshView() const { return View; }
+		// Named like ModelImporter::GetSubmeshName, with the material index and meshlets they were written with
+		const std::vector<ModelImporter::ModelData::Submesh>& GetSubmeshes() const { return Submeshes; }
+		// One per submesh
+		const std::vector<DirectX::BoundingBox>& GetSubmeshBounds() const { return SubmeshBounds; }
+		const std::vector<ModelImporter::ModelMaterial>& GetMaterials() const { return Materials; }
+
+	private:
+		MappedFile File;
+		ModelImporter::MeshView View;
+		std::vector<ModelImporter::ModelData::Submesh> Submeshes;
+		std::vector<DirectX::BoundingBox> SubmeshBounds;
+		std::vector<ModelImporter::ModelMaterial> Materials;
+	};
+}
@@ -0,0 +1,418 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//
+// Reorders indexed triangle lists for the post-transform vertex cache, overdraw and
+// vertex fetch locality
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	// Triangles around every vertex, CSR
+	struct Adjacency
+	{
+		std::vector<std::uint32_t> Offsets;
+		std::vector<std::uint32_t> Triangles;
+
+		Adjacency(const std::uint32_t* aIndices, size_t aIndexCount, size_t aVertexCount)
+			: Offsets(aVertexCount + 1, 0), Triangles(aIndexCount)
+		{
+			for (size_t i = 0; i < aIndexCount; i++)
+				Offsets[aIndices[i] + 1]++;
+			for (size_t v = 0; v < aVertexCount; v++)
+				Offsets[v + 1] += Offsets[v];
+			std::vector<std::uint32_t> Cursor(Offsets.begin(), Offsets.end() - 1);
+			for (size_t i = 0; i < aIndexCount; i++)
+				Triangles[Cursor[aIndices[i]]++] = static_cast<std::uint32_t>(i / 3);
+		}
+	};
+
+	// FIFO cache by time stamps: a vertex is cached while fewer than CacheSize misses happened since its own
+	struct FifoCache
+	{
+		std::vector<std::uint32_t> Stamps;
+		std::uint32_t Time;
+		std::uint32_t Size;
+
+		FifoCache(size_t aVertexCount, std::uint32_t aCacheSize)
+			: Stamps(aVertexCount, 0), Time(aCacheSize + 1), Size(aCacheSize)
+		{
+		}
+
+		bool IsCached(std::uint32_t aVertex) const { return Time - Stamps[aVertex] <= Size; }
+
+		void Flush() { Time += Size + 1; }
+
+		// Returns true on a miss
+		bool Access(std::uint32_t aVertex)
+		{
+			if (IsCached(aVertex))
+				return false;
+			Stamps[aVertex] = Time++;
+			return true;
+		}
+	};
+}
+
+namespace MeshOptimizer
+{
+	void CacheStats::Add(const CacheStats& aOther)
+	{
+		Triangles += aOther.Triangles;
+		Vertices += aOther.Vertices;
+		Misses += aOther.Misses;
+	}
+
+	CacheStats AnalyzeVertexCache(const std::uint32_t* aIndices, size_t aIndexCount, size_t aVertexCount, std::uint32_t aCacheSize)
+	{
+		CacheStats Stats;
+		Stats.Triangles = aIndexCount / 3;
+		FifoCache Cache(aVertexCount, aCacheSize);
+		std::vector<bool> Used(aVertexCount, false);
+		for (size_t i = 0; i < aIndexCount; i++)
+		{
+			std::uint32_t Index = aIndices[i];
+			if (Cache.Access(Index))
+				Stats.Misses++;
+			if (!Used[Index])
+			{
+				Used[Index] = true;
+				Stats.Vertices++;
+			}
+		}
+		return Stats;
+	}
+
+	void OptimizeVertexCache(std::uint32_t* aIndices, size_t aIndexCount, size_t aVertexCount, std::uint32_t aCacheSize,
+		std::vector<std::uint32_t>* aOutClusters)
+	{
+		if (aOutClusters)
+			aOutClusters->clear();
+		size_t TriangleCount = aIndexCount / 3;
+		if (TriangleCount == 0)
+			return;
+
+		Adjacency Triangles(aIndices, TriangleCount * 3, aVertexCount);
+		std::vector<std::uint32_t> LiveCount(aVertexCount);
+		for (size_t v = 0; v < aVertexCount; v++)
+			LiveCount[v] = Triangles.Offsets[v + 1] - Triangles.Offsets[v];
+
+		FifoCache Cache(aVertexCount, aCacheSize);
+		std::vector<bool> Emitted(TriangleCount, false);
+		std::vector<std::uint32_t> DeadEnds;
+		std::vector<std::uint32_t> Candidates;
+		std::vector<std::uint32_t> Result;
+		Result.reserve(TriangleCount * 3);
+		size_t Cursor = 0;	// Vertices below it have no triangles left
+
+		auto SkipDeadEnd = [&]() -> std::int64_t
+		{
+			while (!DeadEnds.empty())
+			{
+				std::uint32_t Vertex = DeadEnds.back();
+				DeadEnds.pop_back();
+				if (LiveCount[Vertex] > 0)
+					return Vertex;
+			}
+			for (; Cursor < aVertexCount; Cursor++)
+			{
+				if (LiveCount[Cursor] > 0)
+					return static_cast<std::int64_t>(Cursor);
+			}
+			return -1;
+		};
+
+		std::int64_t Fanning = SkipDeadEnd();
+		while (Fanning >= 0)
+		{
+			if (aOutClusters && (aOutClusters->empty() || Candidates.empty()))
+				aOutClusters->push_back(static_cast<std::uint32_t>(Result.size() / 3));
+
+			Candidates.clear();
+			std::uint32_t FanVertex = static_cast<std::uint32_t>(Fanning);
+			for (std::uint32_t k = Triangles.Offsets[FanVertex]; k < Triangles.Offsets[FanVertex + 1]; k++)
+			{
+				std::uint32_t Triangle = Triangles.Triangles[k];
+				if (Emitted[Triangle])
+					continue;
+				Emitted[Triangle] = true;
+				for (std::uint32_t Corner = 0; Corner < 3; Corner++)
+				{
+					std::uint32_t Vertex = aIndices[Triangle * 3 + Corner];
+					Result.push_back(Vertex);
+					DeadEnds.push_back(Vertex);
+					Candidates.push_back(Vertex);
+					LiveCount[Vertex]--;
+					Cache.Access(Vertex);
+				}
+			}
+
+			// Next fan: the vertex whose triangles still hit the cache once fanned, the oldest such one first
+			std::int64_t Best = -1;
+			std::int64_t BestPriority = -1;
+			for (std::uint32_t Vertex : Candidates)
+			{
+				if (LiveCount[Vertex] == 0)
+					continue;
+				std::int64_t Priority = 0;
+				std::int64_t Age = std::int64_t(Cache.Time) - Cache.Stamps[Vertex];
+				if (Age + 2 * std::int64_t(LiveCount[Vertex]) <= aCacheSize)
+					Priority = Age;
+				if (Priority > BestPriority)
+				{
+					Best = Vertex;
+					BestPriority = Priority;
+				}
+			}
+			if (Best < 0)
+			{
+				// Dead end, the next fan starts a cluster
+				Candidates.clear();
+				Best = SkipDeadEnd();
+			}
+			Fanning = Best;
+		}
+
+		std::copy(Result.begin(), Result.end(), aIndices);
+	}
+
+	void OptimizeOverdraw(std::uint32_t* aIndices, size_t aIndexCount, const Vertex* aVertices, size_t aVertexCount,
+		const std::vector<std::uint32_t>& aClusters, std::uint32_t aCacheSize, float aThreshold)
+	{
+		size_t TriangleCount = aIndexCount / 3;
+		if (TriangleCount == 0)
+			return;
+
+		// Soft boundaries: cut a cluster wherever its ACMR so far, starting from an empty cache, is back within the
+		// threshold of the whole cluster's. The cache is flushed at every cut as the clusters get reordered.
+		FifoCache Cache(aVertexCount, aCacheSize);
+		auto TriangleMisses = [&](size_t aTriangle)
+		{
+			return size_t(Cache.Access(aIndices[aTriangle * 3])) + Cache.Access(aIndices[aTriangle * 3 + 1]) + Cache.Access(aIndices[aTriangle * 3 + 2]);
+		};
+		std::vector<std::uint32_t> Clusters;
+		for (size_t c = 0; c < aClusters.size(); c++)
+		{
+			size_t Begin = aClusters[c];
+			size_t End = c + 1 < aClusters.size() ? aClusters[c + 1] : TriangleCount;
+			Cache.Flush();
+			size_t ClusterMisses = 0;
+			for (size_t t = Begin; t < End; t++)
+				ClusterMisses += TriangleMisses(t);
+			float Limit = aThreshold * float(ClusterMisses) / float(std::max<size_t>(End - Begin, 1));
+
+			Clusters.push_back(static_cast<std::uint32_t>(Begin));
+			Cache.Flush();
+			size_t Start = Begin;
+			size_t Misses = 0;
+			for (size_t t = Begin; t + 1 < End; t++)
+			{
+				Misses += TriangleMisses(t);
+				if (float(Misses) <= Limit * float(t - Start + 1))
+				{
+					Clusters.push_back(static_cast<std::uint32_t>(t + 1));
+					Cache.Flush();
+					Start = t + 1;
+					Misses = 0;
+				}
+			}
+		}
+		if (Clusters.empty() || Clusters[0] != 0)
+			Clusters.insert(Clusters.begin(), 0);
+
+		// Area weighted centroid and normal of every cluster and the mesh
+		struct ClusterInfo
+		{
+			std::uint32_t Begin;
+			std::uint32_t End;
+			float Sort;
+		};
+		std::vector<ClusterInfo> Infos(Clusters.size());
+		std::vector<float> Centroids(Clusters.size() * 3);
+		std::vector<float> Normals(Clusters.size() * 3);
+		double MeshCentroid[3] = {};
+		double MeshArea = 0.0;
+		for (size_t c = 0; c < Clusters.size(); c++)
+		{
+			Infos[c].Begin = Clusters[c];
+			Infos[c].End = c + 1 < Clusters.size() ? Clusters[c + 1] : static_cast<std::uint32_t>(TriangleCount);
+			double Centroid[3] = {};
+			double Normal[3] = {};
+			double Area = 0.0;
+			for (std::uint32_t t = Infos[c].Begin; t < Infos[c].End; t++)
+			{
+				const DirectX::XMFLOAT3& P0 = aVertices[aIndices[t * 3]].Position;
+				const DirectX::XMFLOAT3& P1 = aVertices[aIndices[t * 3 + 1]].Position;
+				const DirectX::XMFLOAT3& P2 = aVertices[aIndices[t * 3 + 2]].Position;
+				double E1[3] = { double(P1.x) - P0.x, double(P1.y) - P0.y, double(P1.z) - P0.z };
+				double E2[3] = { double(P2.x) - P0.x, double(P2.y) - P0.y, double(P2.z) - P0.z };
+				double N[3] = { E1[1] * E2[2] - E1[2] * E2[1], E1[2] * E2[0] - E1[0] * E2[2], E1[0] * E2[1] - E1[1] * E2[0] };
+				double TriangleArea = 0.5 * std::sqrt(N[0] * N[0] + N[1] * N[1] + N[2] * N[2]);
+				Centroid[0] += TriangleArea * (double(P0.x) + P1.x + P2.x) / 3.0;
+				Centroid[1] += TriangleArea * (double(P0.y) + P1.y + P2.y) / 3.0;
+				Centroid[2] += TriangleArea * (double(P0.z) + P1.z + P2.z) / 3.0;
+				Normal[0] += N[0];
+				Normal[1] += N[1];
+				Normal[2] += N[2];
+				Area += TriangleArea;
+			}
+			for (int Axis = 0; Axis < 3; Axis++)
+				MeshCentroid[Axis] += Centroid[Axis];
+			MeshArea += Area;
+
+			double NormalLength = std::sqrt(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]);
+			for (int Axis = 0; Axis < 3; Axis++)
+			{
+				Centroids[c * 3 + Axis] = float(Area > 0.0 ? Centroid[Axis] / Area : 0.0);
+				Normals[c * 3 + Axis] = float(NormalLength > 0.0 ? Normal[Axis] / NormalLength : 0.0);
+			}
+		}
+		for (int Axis = 0; Axis < 3; Axis++)
+			MeshCentroid[Axis] = MeshArea > 0.0 ? MeshCentroid[Axis] / MeshArea : 0.0;
+
+		// Clusters far out along their normal face the viewer from most directions they are seen from
+		for (size_t c = 0; c < Infos.size(); c++)
+		{
+			Infos[c].Sort = float((Centroids[c * 3] - MeshCentroid[0]) * Normals[c * 3]
+				+ (Centroids[c * 3 + 1] - MeshCentroid[1]) * Normals[c * 3 + 1]
+				+ (Centroids[c * 3 + 2] - MeshCentroid[2]) * Normals[c * 3 + 2]);
+		}
+		std::stable_sort(Infos.begin(), Infos.end(), [](const ClusterInfo& A, const ClusterInfo& B) { return A.Sort > B.Sort; });
+
+		std::vector<std::uint32_t> Result;
+		Result.reserve(TriangleCount * 3);
+		for (const ClusterInfo& Info : Infos)
+			Result.insert(Result.end(), aIndices + Info.Begin * 3, aIndices + Info.End * 3);
+		std::copy(Result.begin(), Result.end(), aIndices);
+	}
+
+	size_t OptimizeVertexFetch(Vertex* aVertices, size_t aVertexCount, std::uint32_t* aIndices, size_t aIndexCount)
+	{
+		std::vector<std::uint32_t> Remap(aVertexCount, UINT32_MAX);
+		std::uint32_t Next = 0;
+		for (size_t i = 0; i < aIndexCount; i++)
+		{
+			if (Remap[aIndices[i]] == UINT32_MAX)
+				Remap[aIndices[i]] = Next++;
+			aIndices[i] = Remap[aIndices[i]];
+		}
+		size_t UsedCount = Next;
+		for (size_t v = 0; v < aVertexCount; v++)
+		{
+			if (Remap[v] == UINT32_MAX)
+				Remap[v] = Next++;
+		}
+
+		std::vector<Vertex> Source(aVertices, aVertices + aVertexCount);
+		for (size_t v = 0; v < aVertexCount; v++)
+			aVertices[Remap[v]] = Source[v];
+		return UsedCount;
+	}
+
+	Stats Optimize(Vertex* aVertices, size_t aVertexCount, std::uint32_t* aIndices, size_t aIndexCount, const Settings& aSettings)
+	{
+		Stats Result;
+		Result.Before = AnalyzeVertexCache(aIndices, aIndexCount, aVertexCount, aSettings.CacheSize);
+
+		// Orders that are already good, e.g. of the simplifier, can beat Tipsify plus overdraw clusters and are kept
+		std::vector<std::uint32_t> Source(aIndices, aIndices + aIndexCount);
+		std::vector<std::uint32_t> Clusters;
+		OptimizeVertexCache(aIndices, aIndexCount, aVertexCount, aSettings.CacheSize, &Clusters);
+		if (aSettings.bOptimizeOverdraw)
+			OptimizeOverdraw(aIndices, aIndexCount, aVertices, aVertexCount, Clusters, aSettings.CacheSize, aSettings.OverdrawThreshold);
+		if (AnalyzeVertexCache(aIndices, aIndexCount, aVertexCount, aSettings.CacheSize).Misses > Result.Before.Misses)
+			std::copy(Source.begin(), Source.end(), aIndices);
+		if (aSettings.bOptimizeVertexFetch)
+			OptimizeVertexFetch(aVertices, aVertexCount, aIndices, aIndexCount);
+
+		Result.After = AnalyzeVertexCache(aIndices, aIndexCount, aVertexCount, aSettings.CacheSize);
+		return Result;
+	}
+
+	template<typename IndexType>
+	Stats OptimizeSubmeshesImpl(Vertex* aVertices, [[maybe_unused]] size_t aVertexCount, IndexType* aIndices,
+		const std::vector<SubmeshRange>& aSubmeshes, const Settings& aSettings)
+	{
+		// Vertex range of every submesh in the whole vertex array
+		struct Range
+		{
+			std::uint32_t First = UINT32_MAX;
+			std::uint32_t Last = 0;
+			bool bShared = false;
+		};
+		std::vector<Range> Ranges(aSubmeshes.size());
+		for (size_t s = 0; s < aSubmeshes.size(); s++)
+		{
+			const SubmeshRange& Submesh = aSubmeshes[s];
+			for (std::uint32_t k = 0; k < Submesh.IndexCount; k++)
+			{
+				std::uint32_t Index = static_cast<std::uint32_t>(Submesh.BaseVertex + std::int64_t(aIndices[Submesh.StartIndex + k]));
+				assert(Index < aVertexCount && "Submesh index out of the vertex array");
+				Ranges[s].First = std::min(Ranges[s].First, Index);
+				Ranges[s].Last = std::max(Ranges[s].Last, Index);
+			}
+		}
+		for (size_t a = 0; a < Ranges.size(); a++)
+		{
+			for (size_t b = a + 1; b < Ranges.size(); b++)
+			{
+				if (Ranges[a].First <= Ranges[b].Last && Ranges[b].First <= Ranges[a].Last)
+					Ranges[a].bShared = Ranges[b].bShared = true;
+			}
+		}
+
+		// Submeshes own disjoint index ranges, each is rewritten in place by its worker
+		std::vector<Stats> SubmeshStats(aSubmeshes.size());
+		ParallelFor(aSubmeshes.size(), 1, [&](size_t aBegin, size_t aEnd)
+		{
+			std::vector<std::uint32_t> Indices;
+			for (size_t s = aBegin; s < aEnd; s++)
+			{
+				const SubmeshRange& Submesh = aSubmeshes[s];
+				const Range& VertexRange = Ranges[s];
+				if (Submesh.IndexCount == 0)
+					continue;
+
+				// Relative to the first vertex of the range while optimizing
+				std::uint32_t RangeOffset = VertexRange.First - Submesh.BaseVertex;
+				IndexType* SubmeshIndices = aIndices + Submesh.StartIndex;
+				Indices.assign(SubmeshIndices, SubmeshIndices + Submesh.IndexCount);
+				for (std::uint32_t& Index : Indices)
+					Index -= RangeOffset;
+
+				Settings SubmeshSettings = aSettings;
+				SubmeshSettings.bOptimizeVertexFetch = aSettings.bOptimizeVertexFetch && !VertexRange.bShared;
+				SubmeshStats[s] = Optimize(&aVertices[VertexRange.First], size_t(VertexRange.Last) - VertexRange.First + 1,
+					Indices.data(), Indices.size(), SubmeshSettings);
+
+				for (std::uint32_t k = 0; k < Submesh.IndexCount; k++)
+					SubmeshIndices[k] = static_cast<IndexType>(Indices[k] + RangeOffset);
+			}
+		});
+
+		Stats Result;
+		for (const Stats& Submesh : SubmeshStats)
+		{
+			Result.Before.Add(Submesh.Before);
+			Result.After.Add(Submesh.After);
+		}
+		return Result;
+	}
+
+	Stats OptimizeSubmeshes(Vertex* aVertices, size_t aVertexCount, std::uint32_t* aIndices,
+		const std::vector<SubmeshRange>& aSubmeshes, const Settings& aSettings)
+	{
+		return OptimizeSubmeshesImpl(aVertices, aVertexCount, aIndices, aSubmeshes, aSettings);
+	}
+
+	Stats OptimizeSubmeshes(Vertex* aVertices, size_t aVertexCount, std::uint16_t* aIndices,
+		const std::vector<SubmeshRange>& aSubmeshes, const Settings& aSettings)
+	{
+		return OptimizeSubmeshesImpl(aVertices, aVertexCount, aIndices, aSubmeshes, aSettings);
+	}
+}
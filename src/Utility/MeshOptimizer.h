@@ -0,0 +1,84 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Reorders indexed triangle lists for the post-transform vertex cache, overdraw and
+// vertex fetch locality
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Vertex.h"
+
+namespace MeshOptimizer
+{
+	// Counts of a FIFO post-transform cache simulation, summable over meshes
+	struct CacheStats
+	{
+		size_t Triangles = 0;
+		size_t Vertices = 0;	// Distinct vertices referenced
+		size_t Misses = 0;		// Vertex shader invocations
+
+		// Average cache miss ratio, transformed vertices per triangle: 3 without any reuse, 0.5 at best
+		float GetAcmr() const { return Triangles > 0 ? float(Misses) / Triangles : 0.0f; }
+		// Average transformed to vertex ratio, 1 when every vertex is transformed once
+		float GetAtvr() const { return Vertices > 0 ? float(Misses) / Vertices : 0.0f; }
+		void Add(const CacheStats& aOther);
+	};
+
+	struct Stats
+	{
+		CacheStats Before;
+		CacheStats After;
+	};
+
+	struct Settings
+	{
+		std::uint32_t CacheSize = 16;
+		// Overdraw clusters may raise the ACMR of their Tipsify order by this factor, 1 keeps only the
+		// clusters Tipsify ends on its own
+		float OverdrawThreshold = 1.05f;
+		bool bOptimizeOverdraw = true;
+		bool bOptimizeVertexFetch = true;
+	};
+
+	CacheStats AnalyzeVertexCache(const std::uint32_t* aIndices, size_t aIndexCount, size_t aVertexCount, std::uint32_t aCacheSize = 16);
+
+	// Tipsify (Sander et al. 2007): fans around the vertex that is freshest in the cache and still has
+	// triangles left, jumping to an unfinished vertex at dead ends. aOutClusters receives the first
+	// triangle of every run between dead ends, the hard boundaries of OptimizeOverdraw.
+	void OptimizeVertexCache(std::uint32_t* aIndices, size_t aIndexCount, size_t aVertexCount, std::uint32_t aCacheSize = 16,
+		std::vector<std::uint32_t>* aOutClusters = nullptr);
+
+	// Splits the clusters of OptimizeVertexCache further while their ACMR stays within aThreshold of the
+	// cluster's, then draws the clusters facing away from the mesh centre first, as they tend to occlude
+	// the inner ones. Order inside a cluster is kept.
+	void OptimizeOverdraw(std::uint32_t* aIndices, size_t aIndexCount, const Vertex* aVertices, size_t aVertexCount,
+		const std::vector<std::uint32_t>& aClusters, std::uint32_t aCacheSize = 16, float aThreshold = 1.05f);
+
+	// Reorders the vertices by first use and rewrites the indices, unused vertices follow in their old
+	// order. Returns the number of used vertices.
+	size_t OptimizeVertexFetch(Vertex* aVertices, size_t aVertexCount, std::uint32_t* aIndices, size_t aIndexCount);
+
+	// Runs the passes of aSettings in order and reports the cache before and after. An input order with
+	// fewer cache misses than the reordered one is kept.
+	Stats Optimize(Vertex* aVertices, size_t aVertexCount, std::uint32_t* aIndices, size_t aIndexCount, const Settings& aSettings = {});
+
+	// One submesh of vertex and index arrays shared by several, its indices are relative to BaseVertex
+	struct SubmeshRange
+	{
+		std::uint32_t IndexCount = 0;
+		std::uint32_t StartIndex = 0;
+		std::int32_t BaseVertex = 0;
+	};
+
+	// Optimize on every submesh, each on its own worker. Vertices only move within the range a submesh
+	// references, submeshes whose ranges overlap keep the vertex order. Returns the statistics summed over
+	// the submeshes.
+	Stats OptimizeSubmeshes(Vertex* aVertices, size_t aVertexCount, std::uint32_t* aIndices,
+		const std::vector<SubmeshRange>& aSubmeshes, const Settings& aSettings = {});
+	Stats OptimizeSubmeshes(Vertex* aVertices, size_t aVertexCount, std::uint16_t* aIndices,
+		const std::vector<SubmeshRange>& aSubmeshes, const Settings& aSettings = {});
+}
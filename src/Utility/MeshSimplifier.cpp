@@ -0,0 +1,308 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//
+// Quadric error metric simplification of indexed triangle lists
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	// Symmetric 4x4 matrix of the summed squared plane distances, upper triangle only
+	struct Quadric
+	{
+		double A2 = 0, AB = 0, AC = 0, AD = 0, B2 = 0, BC = 0, BD = 0, C2 = 0, CD = 0, D2 = 0;
+
+		void AddPlane(double A, double B, double C, double D, double aWeight)
+		{
+			A2 += aWeight * A * A; AB += aWeight * A * B; AC += aWeight * A * C; AD += aWeight * A * D;
+			B2 += aWeight * B * B; BC += aWeight * B * C; BD += aWeight * B * D;
+			C2 += aWeight * C * C; CD += aWeight * C * D;
+			D2 += aWeight * D * D;
+		}
+
+		void Add(const Quadric& aOther)
+		{
+			A2 += aOther.A2; AB += aOther.AB; AC += aOther.AC; AD += aOther.AD;
+			B2 += aOther.B2; BC += aOther.BC; BD += aOther.BD;
+			C2 += aOther.C2; CD += aOther.CD;
+			D2 += aOther.D2;
+		}
+
+		double Evaluate(const DirectX::XMFLOAT3& P) const
+		{
+			double X = P.x, Y = P.y, Z = P.z;
+			double Error = A2 * X * X + 2 * AB * X * Y + 2 * AC * X * Z + 2 * AD * X
+				+ B2 * Y * Y + 2 * BC * Y * Z + 2 * BD * Y
+				+ C2 * Z * Z + 2 * CD * Z
+				+ D2;
+			return std::max(Error, 0.0);
+		}
+	};
+
+	struct Candidate
+	{
+		std::uint32_t From;
+		std::uint32_t To;
+		float Cost;
+	};
+
+	struct Vector3
+	{
+		double X, Y, Z;
+	};
+
+	Vector3 Subtract(const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B)
+	{
+		return { double(A.x) - B.x, double(A.y) - B.y, double(A.z) - B.z };
+	}
+
+	Vector3 Cross(const Vector3& A, const Vector3& B)
+	{
+		return { A.Y * B.Z - A.Z * B.Y, A.Z * B.X - A.X * B.Z, A.X * B.Y - A.Y * B.X };
+	}
+
+	double Dot(const Vector3& A, const Vector3& B)
+	{
+		return A.X * B.X + A.Y * B.Y + A.Z * B.Z;
+	}
+
+	Vector3 TriangleNormal(const DirectX::XMFLOAT3& P0, const DirectX::XMFLOAT3& P1, const DirectX::XMFLOAT3& P2)
+	{
+		return Cross(Subtract(P1, P0), Subtract(P2, P0));
+	}
+
+	std::uint64_t EdgeKey(std::uint32_t A, std::uint32_t B)
+	{
+		return A < B ? (std::uint64_t(A) << 32) | B : (std::uint64_t(B) << 32) | A;
+	}
+
+	bool IsDegenerate(const std::uint32_t* aTriangle)
+	{
+		return aTriangle[0] == aTriangle[1] || aTriangle[1] == aTriangle[2] || aTriangle[0] == aTriangle[2];
+	}
+}
+
+namespace MeshSimplifier
+{
+	Result Simplify(const Vertex* aVertices, size_t aVertexCount, const std::uint32_t* aIndices, size_t aIndexCount,
+		size_t aTargetIndexCount, float aMaxError, const Settings& aSettings)
+	{
+		Result Out;
+		Out.Indices.assign(aIndices, aIndices + aIndexCount - aIndexCount % 3);
+		std::vector<std::uint32_t>& Indices = Out.Indices;
+		if (aTargetIndexCount >= Indices.size() || aVertexCount == 0)
+			return Out;
+
+		// Vertices at the same position, the attribute splits of one surface point, share a position id
+		std::vector<std::uint32_t> PositionIds(aVertexCount);
+		std::vector<std::uint32_t> PositionVertexCounts;
+		{
+			struct PositionHash
+			{
+				size_t operator()(const DirectX::XMFLOAT3& P) const
+				{
+					std::uint32_t Bits[3];
+					std::memcpy(Bits, &P, sizeof(Bits));
+					return (Bits[0] * 73856093u) ^ (Bits[1] * 19349663u) ^ (Bits[2] * 83492791u);
+				}
+			};
+			struct PositionEqual
+			{
+				bool operator()(const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B) const
+				{
+					return A.x == B.x && A.y == B.y && A.z == B.z;
+				}
+			};
+			std::unordered_map<DirectX::XMFLOAT3, std::uint32_t, PositionHash, PositionEqual> PositionLookup;
+			PositionLookup.reserve(aVertexCount);
+			for (size_t i = 0; i < aVertexCount; i++)
+			{
+				auto [It, bInserted] = PositionLookup.emplace(aVertices[i].Position, static_cast<std::uint32_t>(PositionVertexCounts.size()));
+				if (bInserted)
+					PositionVertexCounts.push_back(0);
+				PositionIds[i] = It->second;
+			}
+		}
+
+		// Seam vertices only count if a triangle uses them
+		std::vector<std::uint8_t> bUsed(aVertexCount, 0);
+		for (std::uint32_t Index : Indices)
+		{
+			if (!bUsed[Index])
+				PositionVertexCounts[PositionIds[Index]]++;
+			bUsed[Index] = 1;
+		}
+
+		// Edges of the welded mesh: used once on a border, more than twice where it is non-manifold
+		std::unordered_map<std::uint64_t, std::uint32_t> EdgeUses;
+		EdgeUses.reserve(Indices.size());
+		for (size_t Triangle = 0; Triangle < Indices.size(); Triangle += 3)
+			for (int Corner = 0; Corner < 3; Corner++)
+				EdgeUses[EdgeKey(PositionIds[Indices[Triangle + Corner]], PositionIds[Indices[Triangle + (Corner + 1) % 3]])]++;
+
+		std::vector<std::uint8_t> bLocked(aVertexCount, 0);
+		for (size_t i = 0; i < aVertexCount; i++)
+			bLocked[i] = PositionVertexCounts[PositionIds[i]] > 1;
+
+		// Plane quadrics per position, plus constraint planes through the border edges
+		std::vector<Quadric> Quadrics(PositionVertexCounts.size());
+		for (size_t Triangle = 0; Triangle < Indices.size(); Triangle += 3)
+		{
+			const std::uint32_t* Corners = &Indices[Triangle];
+			Vector3 Normal = TriangleNormal(aVertices[Corners[0]].Position, aVertices[Corners[1]].Position, aVertices[Corners[2]].Position);
+			double Length = std::sqrt(Dot(Normal, Normal));
+			if (Length > 0.0)
+			{
+				Normal = { Normal.X / Length, Normal.Y / Length, Normal.Z / Length };
+				const DirectX::XMFLOAT3& P0 = aVertices[Corners[0]].Position;
+				double D = -(Normal.X * P0.x + Normal.Y * P0.y + Normal.Z * P0.z);
+				for (int Corner = 0; Corner < 3; Corner++)
+					Quadrics[PositionIds[Corners[Corner]]].AddPlane(Normal.X, Normal.Y, Normal.Z, D, 1.0);
+			}
+
+			for (int Corner = 0; Corner < 3; Corner++)
+			{
+				std::uint32_t A = Corners[Corner];
+				std::uint32_t B = Corners[(Corner + 1) % 3];
+				std::uint32_t Uses = EdgeUses[EdgeKey(PositionIds[A], PositionIds[B])];
+				if (Uses > 2 || (Uses == 1 && aSettings.bLockBorders))
+				{
+					bLocked[A] = 1;
+					bLocked[B] = 1;
+				}
+				else if (Uses == 1 && Length > 0.0)
+				{
+					Vector3 Edge = Subtract(aVertices[B].Position, aVertices[A].Position);
+					Vector3 EdgeNormal = Cross(Edge, Normal);
+					double EdgeLength = std::sqrt(Dot(EdgeNormal, EdgeNormal));
+					if (EdgeLength > 0.0)
+					{
+						EdgeNormal = { EdgeNormal.X / EdgeLength, EdgeNormal.Y / EdgeLength, EdgeNormal.Z / EdgeLength };
+						const DirectX::XMFLOAT3& PA = aVertices[A].Position;
+						double D = -(EdgeNormal.X * PA.x + EdgeNormal.Y * PA.y + EdgeNormal.Z * PA.z);
+						Quadrics[PositionIds[A]].AddPlane(EdgeNormal.X, EdgeNormal.Y, EdgeNormal.Z, D, aSettings.BorderWeight);
+						Quadrics[PositionIds[B]].AddPlane(EdgeNormal.X, EdgeNormal.Y, EdgeNormal.Z, D, aSettings.BorderWeight);
+					}
+				}
+			}
+		}
+
+		// Passes collapse the cheapest edges whose neighbourhoods do not overlap, then rebuild the adjacency
+		double MaxCost = aMaxError < FLT_MAX ? double(aMaxError) * aMaxError : DBL_MAX;
+		double WorstCost = 0.0;
+		size_t TriangleCount = Indices.size() / 3;
+		size_t TargetTriangleCount = aTargetIndexCount / 3;
+		std::vector<std::uint32_t> TriangleOffsets(aVertexCount + 1);
+		std::vector<std::uint32_t> VertexTriangles;
+		std::vector<Candidate> Candidates;
+		std::vector<std::uint8_t> bTouched(aVertexCount);
+		while (TriangleCount > TargetTriangleCount)
+		{
+			std::fill(TriangleOffsets.begin(), TriangleOffsets.end(), 0);
+			for (std::uint32_t Index : Indices)
+				TriangleOffsets[Index + 1]++;
+			for (size_t i = 0; i < aVertexCount; i++)
+				TriangleOffsets[i + 1] += TriangleOffsets[i];
+			VertexTriangles.resize(Indices.size());
+			{
+				std::vector<std::uint32_t> Cursor(TriangleOffsets.begin(), TriangleOffsets.end() - 1);
+				for (size_t i = 0; i < Indices.size(); i++)
+					VertexTriangles[Cursor[Indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+			}
+
+			Candidates.clear();
+			for (size_t Triangle = 0; Triangle < Indices.size(); Triangle += 3)
+			{
+				for (int Corner = 0; Corner < 6; Corner++)
+				{
+					std::uint32_t From = Indices[Triangle + Corner % 3];
+					std::uint32_t To = Indices[Triangle + (Corner < 3 ? (Corner + 1) % 3 : (Corner + 2) % 3)];
+					if (bLocked[From])
+						continue;
+					Quadric Combined = Quadrics[PositionIds[From]];
+					Combined.Add(Quadrics[PositionIds[To]]);
+					double Cost = Combined.Evaluate(aVertices[To].Position);
+					if (aSettings.NormalWeight > 0.0f)
+					{
+						const DirectX::XMFLOAT3& NF = aVertices[From].Normal;
+						const DirectX::XMFLOAT3& NT = aVertices[To].Normal;
+						Vector3 Edge = Subtract(aVertices[To].Position, aVertices[From].Position);
+						double Deviation = 1.0 - (double(NF.x) * NT.x + double(NF.y) * NT.y + double(NF.z) * NT.z);
+						Cost += aSettings.NormalWeight * std::max(Deviation, 0.0) * Dot(Edge, Edge);
+					}
+					if (Cost <= MaxCost)
+						Candidates.push_back({ From, To, static_cast<float>(Cost) });
+				}
+			}
+			std::sort(Candidates.begin(), Candidates.end(), [](const Candidate& A, const Candidate& B) { return A.Cost < B.Cost; });
+
+			std::fill(bTouched.begin(), bTouched.end(), 0);
+			size_t Collapses = 0;
+			for (const Candidate& Collapse : Candidates)
+			{
+				if (TriangleCount <= TargetTriangleCount)
+					break;
+				if (bTouched[Collapse.From] || bTouched[Collapse.To])
+					continue;
+
+				// Triangles kept by the collapse must not flip or degenerate
+				const DirectX::XMFLOAT3& Target = aVertices[Collapse.To].Position;
+				bool bFlips = false;
+				for (std::uint32_t i = TriangleOffsets[Collapse.From]; i < TriangleOffsets[Collapse.From + 1] && !bFlips; i++)
+				{
+					const std::uint32_t* Corners = &Indices[size_t(VertexTriangles[i]) * 3];
+					if (IsDegenerate(Corners) || Corners[0] == Collapse.To || Corners[1] == Collapse.To || Corners[2] == Collapse.To)
+						continue;
+					DirectX::XMFLOAT3 Moved[3];
+					for (int Corner = 0; Corner < 3; Corner++)
+						Moved[Corner] = Corners[Corner] == Collapse.From ? Target : aVertices[Corners[Corner]].Position;
+					Vector3 Before = TriangleNormal(aVertices[Corners[0]].Position, aVertices[Corners[1]].Position, aVertices[Corners[2]].Position);
+					Vector3 After = TriangleNormal(Moved[0], Moved[1], Moved[2]);
+					double AfterLength = std::sqrt(Dot(After, After));
+					bFlips = AfterLength <= 1e-12 * std::sqrt(Dot(Before, Before)) + 1e-30
+						|| Dot(Before, After) < 0.25 * std::sqrt(Dot(Before, Before)) * AfterLength;
+				}
+				if (bFlips)
+					continue;
+
+				for (std::uint32_t i = TriangleOffsets[Collapse.From]; i < TriangleOffsets[Collapse.From + 1]; i++)
+				{
+					std::uint32_t* Corners = &Indices[size_t(VertexTriangles[i]) * 3];
+					if (IsDegenerate(Corners))
+						continue;
+					for (int Corner = 0; Corner < 3; Corner++)
+					{
+						bTouched[Corners[Corner]] = 1;
+						if (Corners[Corner] == Collapse.From)
+							Corners[Corner] = Collapse.To;
+					}
+					if (IsDegenerate(Corners))
+						TriangleCount--;
+				}
+				Quadrics[PositionIds[Collapse.To]].Add(Quadrics[PositionIds[Collapse.From]]);
+				WorstCost = std::max(WorstCost, double(Collapse.Cost));
+				Collapses++;
+			}
+
+			size_t Kept = 0;
+			for (size_t Triangle = 0; Triangle < Indices.size(); Triangle += 3)
+			{
+				if (IsDegenerate(&Indices[Triangle]))
+					continue;
+				for (int Corner = 0; Corner < 3; Corner++)
+					Indices[Kept++] = Indices[Triangle + Corner];
+			}
+			Indices.resize(Kept);
+			if (Collapses == 0)
+				break;
+		}
+
+		Out.Error = static_cast<float>(std::sqrt(WorstCost));
+		return Out;
+	}
+}
@@ -0,0 +1,42 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Quadric error metric simplification of indexed triangle lists
+//***************************************************************************************
+
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Vertex.h"
+
+namespace MeshSimplifier
+{
+	struct Settings
+	{
+		// Scales the penalty of collapsing across a normal change, 0 keeps the positional error only
+		float NormalWeight = 1.0f;
+		// Open edges, e.g. submesh boundaries and holes, keep their vertices. Otherwise they may move along
+		// the boundary, held by constraint planes of this weight.
+		bool bLockBorders = true;
+		float BorderWeight = 10.0f;
+	};
+
+	struct Result
+	{
+		std::vector<std::uint32_t> Indices;		// Into the source vertices
+		// Square root of the largest collapse cost: the summed squared distances to the planes merged into
+		// the kept vertex plus the normal penalty, so a distance in model units that grows with every collapse
+		float Error = 0.0f;
+	};
+
+	// Collapses edges of the triangle list in order of their quadric error (Garland-Heckbert) until
+	// aTargetIndexCount is reached or no collapse stays within aMaxError. A collapse moves a vertex onto
+	// one of its neighbours, so the source vertices serve every level and no attribute is interpolated.
+	// Vertices sharing a position with another vertex, i.e. on a UV or normal seam, never move, nor do
+	// vertices of non-manifold edges. Collapses that flip a triangle are skipped.
+	Result Simplify(const Vertex* aVertices, size_t aVertexCount, const std::uint32_t* aIndices, size_t aIndexCount,
+		size_t aTargetIndexCount, float aMaxError = FLT_MAX, const Settings& aSettings = {});
+}
@@ -0,0 +1,242 @@
+//***************************************************************************************
+// MeshletBuilder.cpp
+//
+// Splits indexed triangle lists into small clusters with bounds for per cluster culling
+//***************************************************************************************
+
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Unemitted triangles around every vertex, CSR. Emitted triangles are swapped out of the live part
+	// so the neighbour search only visits what is left.
+	struct LiveAdjacency
+	{
+		std::vector<std::uint32_t> Offsets;
+		std::vector<std::uint32_t> Counts;
+		std::vector<std::uint32_t> Triangles;
+
+		LiveAdjacency(const std::uint32_t* aIndices, size_t aIndexCount, size_t aVertexCount)
+			: Offsets(aVertexCount + 1, 0), Counts(aVertexCount, 0), Triangles(aIndexCount)
+		{
+			for (size_t i = 0; i < aIndexCount; i++)
+				Counts[aIndices[i]]++;
+			for (size_t v = 0; v < aVertexCount; v++)
+				Offsets[v + 1] = Offsets[v] + Counts[v];
+			std::vector<std::uint32_t> Cursor(Offsets.begin(), Offsets.end() - 1);
+			for (size_t i = 0; i < aIndexCount; i++)
+				Triangles[Cursor[aIndices[i]]++] = static_cast<std::uint32_t>(i / 3);
+		}
+
+		void Remove(std::uint32_t aVertex, std::uint32_t aTriangle)
+		{
+			std::uint32_t* Begin = &Triangles[Offsets[aVertex]];
+			std::uint32_t& Count = Counts[aVertex];
+			for (std::uint32_t k = 0; k < Count; k++)
+			{
+				if (Begin[k] == aTriangle)
+				{
+					Begin[k] = Begin[--Count];
+					return;
+				}
+			}
+		}
+	};
+
+	DirectX::XMFLOAT3 Subtract(const DirectX::XMFLOAT3& aA, const DirectX::XMFLOAT3& aB)
+	{
+		return { aA.x - aB.x, aA.y - aB.y, aA.z - aB.z };
+	}
+
+	float Dot(const DirectX::XMFLOAT3& aA, const DirectX::XMFLOAT3& aB)
+	{
+		return aA.x * aB.x + aA.y * aB.y + aA.z * aB.z;
+	}
+}
+
+namespace MeshletBuilder
+{
+	std::vector<Meshlet> Build(const Vertex* aVertices, size_t aVertexCount, std::uint32_t* aIndices, size_t aIndexCount,
+		std::uint32_t aMaxVertices, std::uint32_t aMaxTriangles)
+	{
+		std::vector<Meshlet> Meshlets;
+		const size_t TriangleCount = aIndexCount / 3;
+		if (TriangleCount == 0)
+			return Meshlets;
+		aMaxVertices = std::max(aMaxVertices, 3u);
+		aMaxTriangles = std::max(aMaxTriangles, 1u);
+
+		LiveAdjacency Adjacency(aIndices, TriangleCount * 3, aVertexCount);
+		std::vector<std::uint8_t> Emitted(TriangleCount, 0);
+		// Meshlet that last referenced every vertex, membership test of the current one
+		std::vector<std::uint32_t> VertexOwner(aVertexCount, UINT32_MAX);
+
+		std::vector<std::uint32_t> Order;	// Triangles by meshlet
+		Order.reserve(TriangleCount);
+		std::vector<std::uint32_t> MeshletVertices;
+		MeshletVertices.reserve(aMaxVertices);
+		size_t MeshletBegin = 0;
+		size_t SeedCursor = 0;
+
+		auto CountNewVertices = [&](std::uint32_t aTriangle)
+		{
+			std::uint32_t Owner = static_cast<std::uint32_t>(Meshlets.size());
+			const std::uint32_t* Tri = &aIndices[aTriangle * 3];
+			return std::uint32_t(VertexOwner[Tri[0]] != Owner) + std::uint32_t(VertexOwner[Tri[1]] != Owner)
+				+ std::uint32_t(VertexOwner[Tri[2]] != Owner);
+		};
+
+		auto Finish = [&]()
+		{
+			Meshlet Cluster;
+			Cluster.IndexStart = static_cast<std::uint32_t>(MeshletBegin * 3);
+			Cluster.IndexCount = static_cast<std::uint32_t>((Order.size() - MeshletBegin) * 3);
+			Cluster.VertexCount = static_cast<std::uint32_t>(MeshletVertices.size());
+			// Keeps the vertex cache order of the input inside the meshlet
+			std::sort(Order.begin() + MeshletBegin, Order.end());
+			Meshlets.push_back(Cluster);
+			MeshletVertices.clear();
+			MeshletBegin = Order.size();
+		};
+
+		auto Append = [&](std::uint32_t aTriangle)
+		{
+			std::uint32_t Owner = static_cast<std::uint32_t>(Meshlets.size());
+			const std::uint32_t* Tri = &aIndices[aTriangle * 3];
+			for (int c = 0; c < 3; c++)
+			{
+				if (VertexOwner[Tri[c]] != Owner)
+				{
+					VertexOwner[Tri[c]] = Owner;
+					MeshletVertices.push_back(Tri[c]);
+				}
+				Adjacency.Remove(Tri[c], aTriangle);
+			}
+			Emitted[aTriangle] = 1;
+			Order.push_back(aTriangle);
+		};
+
+		while (Order.size() < TriangleCount)
+		{
+			std::uint32_t Next = UINT32_MAX;
+			if (MeshletVertices.empty())
+			{
+				while (Emitted[SeedCursor])
+					SeedCursor++;
+				Next = static_cast<std::uint32_t>(SeedCursor);
+			}
+			else
+			{
+				// Fewest new vertices first, then the triangle whose vertices have the fewest triangles left,
+				// which follows the border of the cluster instead of leaving holes behind
+				std::uint32_t BestNew = 4;
+				std::uint32_t BestLive = UINT32_MAX;
+				for (std::uint32_t v : MeshletVertices)
+				{
+					const std::uint32_t* Begin = &Adjacency.Triangles[Adjacency.Offsets[v]];
+					for (std::uint32_t k = 0; k < Adjacency.Counts[v]; k++)
+					{
+						std::uint32_t Triangle = Begin[k];
+						std::uint32_t New = CountNewVertices(Triangle);
+						const std::uint32_t* Tri = &aIndices[Triangle * 3];
+						std::uint32_t Live = Adjacency.Counts[Tri[0]] + Adjacency.Counts[Tri[1]] + Adjacency.Counts[Tri[2]];
+						if (New < BestNew || (New == BestNew && Live < BestLive))
+						{
+							Next = Triangle;
+							BestNew = New;
+							BestLive = Live;
+						}
+					}
+				}
+
+				// No neighbour left: the next seed would be anywhere, start a new meshlet there
+				if (Next == UINT32_MAX)
+				{
+					Finish();
+					continue;
+				}
+				// The best neighbour doesn't fit, it seeds the next meshlet so both stay compact
+				if (MeshletVertices.size() + BestNew > aMaxVertices || Order.size() - MeshletBegin >= aMaxTriangles)
+					Finish();
+			}
+			Append(Next);
+		}
+		Finish();
+
+		std::vector<std::uint32_t> Source(aIndices, aIndices + TriangleCount * 3);
+		for (size_t t = 0; t < TriangleCount; t++)
+		{
+			const std::uint32_t* Tri = &Source[size_t(Order[t]) * 3];
+			aIndices[t * 3 + 0] = Tri[0];
+			aIndices[t * 3 + 1] = Tri[1];
+			aIndices[t * 3 + 2] = Tri[2];
+		}
+		for (Meshlet& Cluster : Meshlets)
+			ComputeBounds(aVertices, aIndices + Cluster.IndexStart, Cluster.IndexCount, Cluster);
+		return Meshlets;
+	}
+
+	void ComputeBounds(const Vertex* aVertices, const std::uint32_t* aIndices, size_t aIndexCount, Meshlet& aMeshlet)
+	{
+		if (aIndexCount == 0)
+			return;
+
+		// Sphere around the center of the box, tighter than Ritter's for the flat patches of a cluster
+		DirectX::XMFLOAT3 Min = aVertices[aIndices[0]].Position;
+		DirectX::XMFLOAT3 Max = Min;
+		for (size_t i = 1; i < aIndexCount; i++)
+		{
+			const DirectX::XMFLOAT3& P = aVertices[aIndices[i]].Position;
+			Min = { std::min(Min.x, P.x), std::min(Min.y, P.y), std::min(Min.z, P.z) };
+			Max = { std::max(Max.x, P.x), std::max(Max.y, P.y), std::max(Max.z, P.z) };
+		}
+		DirectX::XMFLOAT3 Center = { (Min.x + Max.x) * 0.5f, (Min.y + Max.y) * 0.5f, (Min.z + Max.z) * 0.5f };
+		float RadiusSq = 0.0f;
+		for (size_t i = 0; i < aIndexCount; i++)
+		{
+			DirectX::XMFLOAT3 Delta = Subtract(aVertices[aIndices[i]].Position, Center);
+			RadiusSq = std::max(RadiusSq, Dot(Delta, Delta));
+		}
+		aMeshlet.Sphere = { Center.x, Center.y, Center.z, std::sqrt(RadiusSq) };
+
+		// Axis is the average of the unit face normals, front faces are clockwise like the D3D default.
+		// Degenerate triangles face nowhere and are left out.
+		std::vector<DirectX::XMFLOAT3> Normals;
+		Normals.reserve(aIndexCount / 3);
+		DirectX::XMFLOAT3 Axis = { 0.0f, 0.0f, 0.0f };
+		for (size_t i = 0; i + 3 <= aIndexCount; i += 3)
+		{
+			const DirectX::XMFLOAT3& P0 = aVertices[aIndices[i + 0]].Position;
+			DirectX::XMFLOAT3 Edge1 = Subtract(aVertices[aIndices[i + 1]].Position, P0);
+			DirectX::XMFLOAT3 Edge2 = Subtract(aVertices[aIndices[i + 2]].Position, P0);
+			DirectX::XMFLOAT3 Normal = { Edge1.y * Edge2.z - Edge1.z * Edge2.y, Edge1.z * Edge2.x - Edge1.x * Edge2.z,
+				Edge1.x * Edge2.y - Edge1.y * Edge2.x };
+			float Length = std::sqrt(Dot(Normal, Normal));
+			if (!(Length > 0.0f))
+				continue;
+			Normal = { Normal.x / Length, Normal.y / Length, Normal.z / Length };
+			Normals.push_back(Normal);
+			Axis = { Axis.x + Normal.x, Axis.y + Normal.y, Axis.z + Normal.z };
+		}
+
+		aMeshlet.Cone = { 0.0f, 0.0f, 0.0f, 1.0f };
+		float AxisLength = std::sqrt(Dot(Axis, Axis));
+		if (Normals.empty() || !(AxisLength > 0.0f))
+			return;
+		Axis = { Axis.x / AxisLength, Axis.y / AxisLength, Axis.z / AxisLength };
+
+		float MinDot = 1.0f;
+		for (const DirectX::XMFLOAT3& Normal : Normals)
+			MinDot = std::min(MinDot, Dot(Normal, Axis));
+		// Normals spreading over about a hemisphere leave no view direction that sees only back faces
+		if (MinDot <= 0.1f)
+		{
+			aMeshlet.Cone = { Axis.x, Axis.y, Axis.z, 1.0f };
+			return;
+		}
+		// Back facing for view directions within 90 - acos(MinDot) degrees of the axis: cos of that angle
+		aMeshlet.Cone = { Axis.x, Axis.y, Axis.z, std::sqrt(1.0f - MinDot * MinDot) };
+	}
+}
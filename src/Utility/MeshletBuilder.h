@@ -0,0 +1,45 @@
+//***************************************************************************************
+// MeshletBuilder.h
+//
+// Splits indexed triangle lists into small clusters with bounds for per cluster culling
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// A cluster of triangles stored contiguously in the index buffer of its submesh
+struct Meshlet
+{
+	// Bounding sphere in the space of the vertices: center (xyz) and radius (w)
+	DirectX::XMFLOAT4 Sphere = { 0.0f, 0.0f, 0.0f, 0.0f };
+	// Normal cone: axis (xyz) and cutoff (w). The cluster faces away from every eye E for which
+	// dot(normalize(C - E), Axis) >= Cutoff holds, with C the sphere center. A cutoff of 1 never culls.
+	DirectX::XMFLOAT4 Cone = { 0.0f, 0.0f, 0.0f, 1.0f };
+	std::uint32_t IndexStart = 0;	// Relative to the StartIndexLocation of the submesh
+	std::uint32_t IndexCount = 0;
+	std::uint32_t VertexCount = 0;	// Distinct vertices referenced
+	std::uint32_t Padding = 0;
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet is read as 16 byte rows by ClusterCuller and stored as is by MeshCache");
+
+namespace MeshletBuilder
+{
+	// Sizes of the mesh shader era, 124 triangles keep the primitive indices of a cluster in 128 * 3 bytes
+	constexpr std::uint32_t MaxVertices = 64;
+	constexpr std::uint32_t MaxTriangles = 124;
+
+	// Grows every meshlet from a seed triangle by the adjacent triangle adding the fewest new vertices,
+	// restarting from the next unused triangle of the input order when the cluster has no neighbour left.
+	// aIndices is reordered in place so that the triangles of every meshlet follow each other, the input
+	// order is kept inside a meshlet. Indices point into aVertices[0, aVertexCount).
+	std::vector<Meshlet> Build(const Vertex* aVertices, size_t aVertexCount, std::uint32_t* aIndices, size_t aIndexCount,
+		std::uint32_t aMaxVertices = MaxVertices, std::uint32_t aMaxTriangles = MaxTriangles);
+
+	// Bounding sphere and normal cone of the triangles aIndices[0, aIndexCount)
+	void ComputeBounds(const Vertex* aVertices, const std::uint32_t* aIndices, size_t aIndexCount, Meshlet& aMeshlet);
+}
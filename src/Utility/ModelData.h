@@ -0,0 +1,72 @@
+//***************************************************************************************
+// ModelData.h
+//
+// CPU side mesh data of imported models, shared by ModelImporter and MeshCache
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+#include "MeshletBuilder.h"
+
+namespace ModelImporter
+{
+    // Material information extracted from model
+    struct ModelMaterial
+    {
+        std::string Name;
+        DirectX::XMFLOAT4 DiffuseColor;
+        std::string DiffuseTexturePath;
+        std::string NormalTexturePath;
+        float Roughness;
+        float Metallic;
+    };
+
+    // Model loading result
+    struct ModelData
+    {
+        std::vector<Vertex> Vertices;
+        std::vector<uint16_t> Indices16;  // For submeshes with < 65536 vertices
+        std::vector<uint32_t> Indices32;  // For larger submeshes
+        std::vector<ModelMaterial> Materials;
+        std::string Name;
+        bool Use32BitIndices = false;
+
+        // Submesh information (if model contains multiple meshes)
+        // Indices of a submesh are relative to its BaseVertexLocation, like DrawIndexedInstanced reads them
+        struct Submesh
+        {
+            std::string Name;
+            uint32_t IndexCount;
+            uint32_t StartIndexLocation;
+            int32_t BaseVertexLocation;
+            uint32_t MaterialIndex;
+            std::vector<Meshlet> Meshlets;  // Empty until BuildMeshlets
+        };
+        std::vector<Submesh> Submeshes;
+    };
+
+    // Name the submesh at index is drawn by, models without submeshes are drawn as a single "Default" one
+    inline std::string GetSubmeshName(const ModelData& model, size_t index)
+    {
+        if (model.Submeshes.empty())
+            return "Default";
+        const std::string& name = model.Submeshes[index].Name;
+        return name.empty() ? "Submesh_" + std::to_string(index) : name;
+    }
+
+    // Vertex and index arrays owned elsewhere, e.g. by ModelData or a memory mapped MeshCache file
+    struct MeshView
+    {
+        const Vertex* Vertices = nullptr;
+        size_t VertexCount = 0;
+        const void* Indices = nullptr;  // uint32_t with Use32BitIndices, uint16_t otherwise
+        size_t IndexCount = 0;
+        bool Use32BitIndices = false;
+    };
+}
@@ -5,6 +5,10 @@
 //***************************************************************************************
 
 #include "ModelImporter.h"
+#include "GeometryPool.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cfloat>
 #include <filesystem>
 #include <iostream>
 #include <DirectXCollision.h>
@@ -61,28 +65,50 @@ namespace ModelImporter
         outModelData.Materials.clear();
         outModelData.Submeshes.clear();
 
-        // Temporary storage for 32-bit indices
-        std::vector<uint32_t> tempIndices;
-        std::vector<Vertex> tempVertices;
+        // Meshes in node order, a mesh referenced by several nodes is imported once per reference
+        std::vector<const aiMesh*> meshes;
+        ProcessNode(scene->mRootNode, scene, meshes);
 
-        // Process all meshes in the scene
-        ProcessNode(scene->mRootNode, scene, tempVertices, tempIndices, outModelData.Submeshes);
+        // Lay out the submeshes from the Assimp counts so every array is allocated once at its final size
+        size_t vertexCount = 0;
+        size_t indexCount = 0;
+        size_t largestMeshVertexCount = 0;
+        outModelData.Submeshes.reserve(meshes.size());
+        for (const aiMesh* mesh : meshes)
+        {
+            UINT meshIndexCount = 0;
+            for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+                meshIndexCount += mesh->mFaces[i].mNumIndices;
 
-        // Store vertices
-        outModelData.Vertices = tempVertices;
+            ModelData::Submesh submesh;
+            submesh.Name = mesh->mName.C_Str() + std::string("_") + std::to_string(outModelData.Submeshes.size());
+            submesh.BaseVertexLocation = static_cast<INT>(vertexCount);
+            submesh.StartIndexLocation = static_cast<UINT>(indexCount);
+            submesh.IndexCount = meshIndexCount;
+            submesh.MaterialIndex = mesh->mMaterialIndex;
+            outModelData.Submeshes.push_back(submesh);
 
-        // Determine if we need 32-bit indices
-        if (tempVertices.size() > 65535)
-        {
-            outModelData.Use32BitIndices = true;
-            outModelData.Indices32 = tempIndices;
+            vertexCount += mesh->mNumVertices;
+            indexCount += meshIndexCount;
+            largestMeshVertexCount = std::max<size_t>(largestMeshVertexCount, mesh->mNumVertices);
         }
+
+        // Indices are relative to the BaseVertexLocation of their submesh, so 16 bits do while every submesh fits
+        outModelData.Use32BitIndices = largestMeshVertexCount > 65535;
+        outModelData.Vertices.resize(vertexCount);
+        if (outModelData.Use32BitIndices)
+            outModelData.Indices32.resize(indexCount);
         else
+            outModelData.Indices16.resize(indexCount);
+
+        // Every mesh writes straight into its range of the final arrays
+        for (size_t i = 0; i < meshes.size(); i++)
         {
-            outModelData.Use32BitIndices = false;
-            outModelData.Indices16.reserve(tempIndices.size());
-            for (uint32_t idx : tempIndices)
-                outModelData.Indices16.push_back(static_cast<uint16_t>(idx));
+            const ModelData::Submesh& submesh = outModelData.Submeshes[i];
+            void* indices = outModelData.Use32BitIndices ?
+                static_cast<void*>(&outModelData.Indices32[submesh.StartIndexLocation]) :
+                static_cast<void*>(&outModelData.Indices16[submesh.StartIndexLocation]);
+            ProcessMesh(meshes[i], &outModelData.Vertices[submesh.BaseVertexLocation], indices, outModelData.Use32BitIndices);
         }
 
         // Process materials
@@ -94,7 +120,7 @@ namespace ModelImporter
 
         std::cout << "Model loaded successfully: " << filename << std::endl;
         std::cout << "  Vertices: " << outModelData.Vertices.size() << std::endl;
-        std::cout << "  Indices: " << tempIndices.size() << std::endl;
+        std::cout << "  Indices: " << indexCount << std::endl;
         std::cout << "  Submeshes: " << outModelData.Submeshes.size() << std::endl;
         std::cout << "  Materials: " << outModelData.Materials.size() << std::endl;
 
@@ -108,50 +134,31 @@ namespace ModelImporter
     void ProcessNode(
         const aiNode* node,
         const aiScene* scene,
-        std::vector<Vertex>& vertices,
-        std::vector<uint32_t>& indices,
-        std::vector<ModelData::Submesh>& submeshes)
+        std::vector<const aiMesh*>& meshes)
     {
-        // Process all meshes in this node
+        // Collect all meshes in this node
         for (unsigned int i = 0; i < node->mNumMeshes; i++)
         {
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-
-            UINT baseVertex = static_cast<UINT>(vertices.size());
-            UINT startIndex = static_cast<UINT>(indices.size());
-
-            ProcessMesh(mesh, scene, vertices, indices, baseVertex);
-
-            UINT indexCount = static_cast<UINT>(indices.size()) - startIndex;
-
-            // Store submesh info
-            ModelData::Submesh submesh;
-            submesh.Name = mesh->mName.C_Str() + std::string("_") + std::to_string(submeshes.size());
-            submesh.BaseVertexLocation = baseVertex;
-            submesh.StartIndexLocation = startIndex;
-            submesh.IndexCount = indexCount;
-            submesh.MaterialIndex = mesh->mMaterialIndex;
-            submeshes.push_back(submesh);
+            meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
         }
 
         // Recursively process child nodes
         for (unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            ProcessNode(node->mChildren[i], scene, vertices, indices, submeshes);
+            ProcessNode(node->mChildren[i], scene, meshes);
         }
     }
 
     void ProcessMesh(
         const aiMesh* mesh,
-        const aiScene* scene,
-        std::vector<Vertex>& vertices,
-        std::vector<uint32_t>& indices,
-        UINT& baseVertex)
+        Vertex* outVertices,
+        void* outIndices,
+        bool use32BitIndices)
     {
         // Process vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex& vertex = outVertices[i];
 
             // Position
             vertex.Position.x = mesh->mVertices[i].x;
@@ -193,19 +200,182 @@ namespace ModelImporter
                 // Default tangent pointing along X axis
                 vertex.Tangent = DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
             }
-
-            vertices.push_back(vertex);
         }
 
-        // Process indices
+        // Process indices, relative to the first vertex of the mesh
+        size_t index = 0;
         for (unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
-            for (unsigned int j = 0; j < face.mNumIndices; j++)
+            const aiFace& face = mesh->mFaces[i];
+            for (unsigned int j = 0; j < face.mNumIndices; j++, index++)
+            {
+                if (use32BitIndices)
+                    static_cast<uint32_t*>(outIndices)[index] = face.mIndices[j];
+                else
+                    static_cast<uint16_t*>(outIndices)[index] = static_cast<uint16_t>(face.mIndices[j]);
+            }
+        }
+    }
+
+    std::vector<LodData> GenerateLods(
+        const ModelData& source,
+        const std::vector<float>& triangleRatios,
+        const MeshSimplifier::Settings& settings)
+    {
+        // Models without submeshes are a single one
+        std::vector<ModelData::Submesh> submeshes = source.Submeshes;
+        size_t sourceIndexCount = source.Use32BitIndices ? source.Indices32.size() : source.Indices16.size();
+        if (submeshes.empty())
+            submeshes.push_back({ "Default", static_cast<UINT>(sourceIndexCount), 0, 0, 0 });
+
+        struct Job
+        {
+            size_t Level;
+            size_t Submesh;
+            UINT FirstVertex;  // Indices of the result are relative to it
+            MeshSimplifier::Result Result;
+        };
+        std::vector<Job> jobs;
+        for (size_t level = 0; level < triangleRatios.size(); level++)
+            for (size_t submesh = 0; submesh < submeshes.size(); submesh++)
+                jobs.push_back({ level, submesh, 0, {} });
+
+        ParallelFor(jobs.size(), 1, [&](size_t begin, size_t end)
+        {
+            std::vector<uint32_t> indices;
+            for (size_t i = begin; i < end; i++)
+            {
+                Job& job = jobs[i];
+                const ModelData::Submesh& submesh = submeshes[job.Submesh];
+
+                // Submesh indices are relative to its BaseVertexLocation, the simplifier gets the range they use
+                indices.resize(submesh.IndexCount);
+                for (UINT k = 0; k < submesh.IndexCount; k++)
+                {
+                    size_t index = submesh.StartIndexLocation + k;
+                    indices[k] = source.Use32BitIndices ? source.Indices32[index] : source.Indices16[index];
+                }
+                if (indices.empty())
+                    continue;
+                auto [minIndex, maxIndex] = std::minmax_element(indices.begin(), indices.end());
+                uint32_t firstIndex = *minIndex;
+                size_t vertexCount = size_t(*maxIndex) - firstIndex + 1;
+                job.FirstVertex = submesh.BaseVertexLocation + firstIndex;
+                for (uint32_t& index : indices)
+                    index -= firstIndex;
+
+                size_t targetIndexCount = size_t(indices.size() * triangleRatios[job.Level]) / 3 * 3;
+                job.Result = MeshSimplifier::Simplify(&source.Vertices[job.FirstVertex], vertexCount,
+                    indices.data(), indices.size(), targetIndexCount, FLT_MAX, settings);
+            }
+        });
+
+        std::vector<LodData> lods(triangleRatios.size());
+        std::vector<uint32_t> vertexRemap;
+        for (size_t level = 0; level < triangleRatios.size(); level++)
+        {
+            LodData& lod = lods[level];
+            ModelData& model = lod.Model;
+            model.Name = source.Name + "_LOD" + std::to_string(level + 1);
+            model.Materials = source.Materials;
+
+            // Each submesh keeps the vertices its triangles use, indices are laid out like LoadModel does
+            std::vector<uint32_t> levelIndices;
+            size_t largestSubmeshVertexCount = 0;
+            for (size_t submeshIndex = 0; submeshIndex < submeshes.size(); submeshIndex++)
+            {
+                const Job& job = jobs[level * submeshes.size() + submeshIndex];
+                UINT baseVertex = static_cast<UINT>(model.Vertices.size());
+                UINT startIndex = static_cast<UINT>(levelIndices.size());
+                vertexRemap.assign(job.Result.Indices.empty() ? 0 : *std::max_element(job.Result.Indices.begin(), job.Result.Indices.end()) + 1, UINT32_MAX);
+                for (uint32_t index : job.Result.Indices)
+                {
+                    if (vertexRemap[index] == UINT32_MAX)
+                    {
+                        vertexRemap[index] = static_cast<uint32_t>(model.Vertices.size()) - baseVertex;
+                        model.Vertices.push_back(source.Vertices[job.FirstVertex + index]);
+                    }
+                    levelIndices.push_back(vertexRemap[index]);
+                }
+                largestSubmeshVertexCount = std::max<size_t>(largestSubmeshVertexCount, model.Vertices.size() - baseVertex);
+
+                ModelData::Submesh submesh = submeshes[submeshIndex];
+                submesh.BaseVertexLocation = baseVertex;
+                submesh.StartIndexLocation = startIndex;
+                submesh.IndexCount = static_cast<UINT>(job.Result.Indices.size());
+                submesh.Meshlets.clear();
+                model.Submeshes.push_back(submesh);
+                lod.Error = std::max(lod.Error, job.Result.Error);
+            }
+
+            lod.TriangleRatio = sourceIndexCount > 0 ? float(levelIndices.size()) / sourceIndexCount : 1.0f;
+            model.Use32BitIndices = largestSubmeshVertexCount > 65535;
+            if (model.Use32BitIndices)
+                model.Indices32 = std::move(levelIndices);
+            else
             {
-                indices.push_back(baseVertex + face.mIndices[j]);
+                model.Indices16.reserve(levelIndices.size());
+                for (uint32_t index : levelIndices)
+                    model.Indices16.push_back(static_cast<uint16_t>(index));
             }
         }
+        return lods;
+    }
+
+    MeshOptimizer::Stats OptimizeModel(ModelData& model, const MeshOptimizer::Settings& settings)
+    {
+        std::vector<MeshOptimizer::SubmeshRange> submeshes;
+        for (const ModelData::Submesh& submesh : model.Submeshes)
+            submeshes.push_back({ submesh.IndexCount, submesh.StartIndexLocation, submesh.BaseVertexLocation });
+        size_t indexCount = model.Use32BitIndices ? model.Indices32.size() : model.Indices16.size();
+        if (submeshes.empty())
+            submeshes.push_back({ static_cast<uint32_t>(indexCount), 0, 0 });
+
+        if (model.Use32BitIndices)
+            return MeshOptimizer::OptimizeSubmeshes(model.Vertices.data(), model.Vertices.size(), model.Indices32.data(), submeshes, settings);
+        return MeshOptimizer::OptimizeSubmeshes(model.Vertices.data(), model.Vertices.size(), model.Indices16.data(), submeshes, settings);
+    }
+
+    size_t BuildMeshlets(ModelData& model, size_t minTriangles, uint32_t maxVertices, uint32_t maxTriangles)
+    {
+        // Submeshes own disjoint index ranges, each is rewritten in place by its worker
+        ParallelFor(model.Submeshes.size(), 1, [&](size_t begin, size_t end)
+        {
+            std::vector<uint32_t> indices;
+            for (size_t s = begin; s < end; s++)
+            {
+                ModelData::Submesh& submesh = model.Submeshes[s];
+                submesh.Meshlets.clear();
+                if (submesh.IndexCount == 0 || submesh.IndexCount / 3 < minTriangles)
+                    continue;
+
+                uint32_t vertexCount = 0;
+                indices.resize(submesh.IndexCount);
+                for (UINT k = 0; k < submesh.IndexCount; k++)
+                {
+                    size_t index = submesh.StartIndexLocation + k;
+                    indices[k] = model.Use32BitIndices ? model.Indices32[index] : model.Indices16[index];
+                    vertexCount = std::max(vertexCount, indices[k] + 1);
+                }
+
+                submesh.Meshlets = MeshletBuilder::Build(&model.Vertices[submesh.BaseVertexLocation], vertexCount,
+                    indices.data(), indices.size(), maxVertices, maxTriangles);
+
+                for (UINT k = 0; k < submesh.IndexCount; k++)
+                {
+                    size_t index = submesh.StartIndexLocation + k;
+                    if (model.Use32BitIndices)
+                        model.Indices32[index] = indices[k];
+                    else
+                        model.Indices16[index] = static_cast<uint16_t>(indices[k]);
+                }
+            }
+        });
+
+        size_t meshletCount = 0;
+        for (const ModelData::Submesh& submesh : model.Submeshes)
+            meshletCount += submesh.Meshlets.size();
+        return meshletCount;
     }
 
     ModelMaterial ProcessMaterial(const aiMaterial* material, const std::string& modelDirectory)
@@ -278,14 +448,14 @@ namespace ModelImporter
     {
         using namespace DirectX;
 
-        if (vertices.empty())
+        if (vertices.empty() || indexCount == 0)
         {
             return BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
         }
 
-        // Get the first vertex position for this submesh
+        // Get the first vertex position for this submesh, indices are relative to its base vertex
         UINT firstIndex = use32BitIndices ? indices32[startIndexLocation] : indices16[startIndexLocation];
-        XMVECTOR minBounds = XMLoadFloat3(&vertices[firstIndex].Position);
+        XMVECTOR minBounds = XMLoadFloat3(&vertices[baseVertexLocation + firstIndex].Position);
         XMVECTOR maxBounds = minBounds;
 
         // Iterate through all indices for this submesh
@@ -295,7 +465,7 @@ namespace ModelImporter
                 indices32[startIndexLocation + i] :
                 indices16[startIndexLocation + i];
 
-            XMVECTOR pos = XMLoadFloat3(&vertices[vertexIndex].Position);
+            XMVECTOR pos = XMLoadFloat3(&vertices[baseVertexLocation + vertexIndex].Position);
             minBounds = XMVectorMin(minBounds, pos);
             maxBounds = XMVectorMax(maxBounds, pos);
         }
@@ -311,85 +481,66 @@ namespace ModelImporter
         return BoundingBox(centerFloat, extentsFloat);
     }
 
-    std::unique_ptr<MeshGeometry> CreateMeshGeometry(
-        const ModelData& modelData,
-        ID3D12Device* device,
-        ID3D12GraphicsCommandList* cmdList,
-        const std::string& geometryName)
+    // Quantizes the positions of every submesh to its bounds, or to the bounds of the whole model when submeshes
+    // share vertices, and sets the dequantization of the submeshes
+    static std::vector<CompactVertex> EncodeCompactVertices(
+        const MeshView& mesh,
+        std::vector<std::pair<std::string, SubmeshGeometry>>& submeshes)
     {
-        auto meshGeometry = std::make_unique<MeshGeometry>();
-        meshGeometry->Name = geometryName;
-
-        // Convert vertices to raw float array (matching current vertex layout)
-        std::vector<float> vertexData;
-        vertexData.reserve(modelData.Vertices.size() * 11); // 11 floats per vertex
+        using namespace DirectX;
 
-        for (const auto& v : modelData.Vertices)
+        // Submesh of every vertex, read through the indices like CalculateBoundsForSubmesh does
+        std::vector<UINT> owners(mesh.VertexCount, UINT32_MAX);
+        bool sharedVertices = false;
+        for (UINT s = 0; s < submeshes.size(); s++)
         {
-            // Position (3 floats)
-            vertexData.push_back(v.Position.x);
-            vertexData.push_back(v.Position.y);
-            vertexData.push_back(v.Position.z);
-
-            // TexCoord (2 floats)
-            vertexData.push_back(v.TexCoord.x);
-            vertexData.push_back(v.TexCoord.y);
-
-            // Normal (3 floats)
-            vertexData.push_back(v.Normal.x);
-            vertexData.push_back(v.Normal.y);
-            vertexData.push_back(v.Normal.z);
-
-            // Tangent (3 floats)
-            vertexData.push_back(v.Tangent.x);
-            vertexData.push_back(v.Tangent.y);
-            vertexData.push_back(v.Tangent.z);
+            const SubmeshGeometry& submesh = submeshes[s].second;
+            for (UINT i = 0; i < submesh.IndexCount; i++)
+            {
+                UINT vertexIndex = submesh.BaseVertexLocation + (mesh.Use32BitIndices ?
+                    static_cast<const uint32_t*>(mesh.Indices)[submesh.StartIndexLocation + i] :
+                    static_cast<const uint16_t*>(mesh.Indices)[submesh.StartIndexLocation + i]);
+                if (owners[vertexIndex] == UINT32_MAX)
+                    owners[vertexIndex] = s;
+                else if (owners[vertexIndex] != s)
+                    sharedVertices = true;
+            }
         }
 
-        // Set vertex buffer properties
-        meshGeometry->VertexByteStride = 11 * sizeof(float);
-        meshGeometry->VertexBufferByteSize = static_cast<UINT>(vertexData.size() * sizeof(float));
-
-        ThrowIfFailed(D3DCreateBlob(meshGeometry->VertexBufferByteSize, &meshGeometry->VertexBufferCPU));
-        memcpy(meshGeometry->VertexBufferCPU->GetBufferPointer(), vertexData.data(), meshGeometry->VertexBufferByteSize);
-
-        meshGeometry->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(
-            device, cmdList,
-            vertexData.data(),
-            meshGeometry->VertexBufferByteSize,
-            meshGeometry->VertexBufferUploader);
-
-        // Set index buffer properties
-        if (modelData.Use32BitIndices)
+        XMVECTOR minBounds = XMVectorReplicate(FLT_MAX);
+        XMVECTOR maxBounds = XMVectorReplicate(-FLT_MAX);
+        for (size_t v = 0; v < mesh.VertexCount; v++)
         {
-            meshGeometry->IndexFormat = DXGI_FORMAT_R32_UINT;
-            meshGeometry->IndexBufferByteSize = static_cast<UINT>(modelData.Indices32.size() * sizeof(uint32_t));
-
-            ThrowIfFailed(D3DCreateBlob(meshGeometry->IndexBufferByteSize, &meshGeometry->IndexBufferCPU));
-            memcpy(meshGeometry->IndexBufferCPU->GetBufferPointer(), modelData.Indices32.data(), meshGeometry->IndexBufferByteSize);
-
-            meshGeometry->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(
-                device, cmdList,
-                modelData.Indices32.data(),
-                meshGeometry->IndexBufferByteSize,
-                meshGeometry->IndexBufferUploader);
+            XMVECTOR pos = XMLoadFloat3(&mesh.Vertices[v].Position);
+            minBounds = XMVectorMin(minBounds, pos);
+            maxBounds = XMVectorMax(maxBounds, pos);
         }
-        else
-        {
-            meshGeometry->IndexFormat = DXGI_FORMAT_R16_UINT;
-            meshGeometry->IndexBufferByteSize = static_cast<UINT>(modelData.Indices16.size() * sizeof(uint16_t));
+        BoundingBox modelBounds;
+        XMStoreFloat3(&modelBounds.Center, XMVectorScale(XMVectorAdd(minBounds, maxBounds), 0.5f));
+        XMStoreFloat3(&modelBounds.Extents, XMVectorScale(XMVectorSubtract(maxBounds, minBounds), 0.5f));
+        PositionQuantization modelQuantization = MakePositionQuantization(modelBounds);
 
-            ThrowIfFailed(D3DCreateBlob(meshGeometry->IndexBufferByteSize, &meshGeometry->IndexBufferCPU));
-            memcpy(meshGeometry->IndexBufferCPU->GetBufferPointer(), modelData.Indices16.data(), meshGeometry->IndexBufferByteSize);
+        std::vector<PositionQuantization> quantizations(submeshes.size(), modelQuantization);
+        for (size_t s = 0; s < submeshes.size(); s++)
+        {
+            if (!sharedVertices)
+                quantizations[s] = MakePositionQuantization(submeshes[s].second.Bounds);
+            submeshes[s].second.PositionDequant = quantizations[s].GetDequant();
+        }
 
-            meshGeometry->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(
-                device, cmdList,
-                modelData.Indices16.data(),
-                meshGeometry->IndexBufferByteSize,
-                meshGeometry->IndexBufferUploader);
+        std::vector<CompactVertex> compactData(mesh.VertexCount);
+        for (size_t v = 0; v < mesh.VertexCount; v++)
+        {
+            const PositionQuantization& quantization = owners[v] != UINT32_MAX ? quantizations[owners[v]] : modelQuantization;
+            compactData[v] = EncodeCompactVertex(mesh.Vertices[v], quantization);
         }
+        return compactData;
+    }
 
+    std::vector<std::pair<std::string, SubmeshGeometry>> BuildSubmeshGeometries(const ModelData& modelData)
+    {
         // Create submesh entries
+        std::vector<std::pair<std::string, SubmeshGeometry>> submeshes;
         if (modelData.Submeshes.empty())
         {
             // Single mesh, create default submesh
@@ -410,7 +561,7 @@ namespace ModelImporter
                 submesh.StartIndexLocation,
                 modelData.Use32BitIndices);
 
-            meshGeometry->DrawArgs["Default"] = submesh;
+            submeshes.emplace_back(GetSubmeshName(modelData, 0), submesh);
         }
         else
         {
@@ -421,6 +572,7 @@ namespace ModelImporter
                 submesh.IndexCount = sub.IndexCount;
                 submesh.StartIndexLocation = sub.StartIndexLocation;
                 submesh.BaseVertexLocation = sub.BaseVertexLocation;
+                submesh.Meshlets = sub.Meshlets;
 
                 // Calculate bounds for this submesh
                 submesh.Bounds = CalculateBoundsForSubmesh(
@@ -432,11 +584,74 @@ namespace ModelImporter
                     submesh.StartIndexLocation,
                     modelData.Use32BitIndices);
 
-                std::string submeshName = sub.Name.empty() ? ("Submesh_" + std::to_string(meshGeometry->DrawArgs.size())) : sub.Name;
-                meshGeometry->DrawArgs[submeshName] = submesh;
+                submeshes.emplace_back(GetSubmeshName(modelData, submeshes.size()), submesh);
             }
         }
 
+        return submeshes;
+    }
+
+    std::unique_ptr<MeshGeometry> CreateMeshGeometry(
+        const ModelData& modelData,
+        GeometryPool& pool,
+        ID3D12GraphicsCommandList* cmdList,
+        const std::string& geometryName,
+        bool compactVertices)
+    {
+        MeshView mesh;
+        mesh.Vertices = modelData.Vertices.data();
+        mesh.VertexCount = modelData.Vertices.size();
+        mesh.Use32BitIndices = modelData.Use32BitIndices;
+        mesh.Indices = modelData.Use32BitIndices ? static_cast<const void*>(modelData.Indices32.data()) : modelData.Indices16.data();
+        mesh.IndexCount = modelData.Use32BitIndices ? modelData.Indices32.size() : modelData.Indices16.size();
+        return CreateMeshGeometry(mesh, BuildSubmeshGeometries(modelData), pool, cmdList, geometryName, compactVertices);
+    }
+
+    std::unique_ptr<MeshGeometry> CreateMeshGeometry(
+        const MeshView& mesh,
+        std::vector<std::pair<std::string, SubmeshGeometry>> submeshes,
+        GeometryPool& pool,
+        ID3D12GraphicsCommandList* cmdList,
+        const std::string& geometryName,
+        bool compactVertices)
+    {
+        static_assert(sizeof(Vertex) == 11 * sizeof(float), "Vertex must match the full precision input layout");
+
+        auto meshGeometry = std::make_unique<MeshGeometry>();
+        meshGeometry->Name = geometryName;
+
+        // The CPU copy keeps full precision for picking and occluders
+        size_t vertexDataSize = mesh.VertexCount * sizeof(Vertex);
+        meshGeometry->VertexBufferCPUByteStride = sizeof(Vertex);
+        ThrowIfFailed(D3DCreateBlob(vertexDataSize, &meshGeometry->VertexBufferCPU));
+        memcpy(meshGeometry->VertexBufferCPU->GetBufferPointer(), mesh.Vertices, vertexDataSize);
+
+        // Set index buffer properties
+        meshGeometry->IndexFormat = mesh.Use32BitIndices ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+        meshGeometry->IndexBufferByteSize = static_cast<UINT>(mesh.IndexCount * (mesh.Use32BitIndices ? sizeof(uint32_t) : sizeof(uint16_t)));
+
+        ThrowIfFailed(D3DCreateBlob(meshGeometry->IndexBufferByteSize, &meshGeometry->IndexBufferCPU));
+        memcpy(meshGeometry->IndexBufferCPU->GetBufferPointer(), mesh.Indices, meshGeometry->IndexBufferByteSize);
+
+        // Set vertex buffer properties and copy both into the pool
+        if (compactVertices)
+        {
+            std::vector<CompactVertex> compactData = EncodeCompactVertices(mesh, submeshes);
+            meshGeometry->VertexByteStride = sizeof(CompactVertex);
+            meshGeometry->VertexBufferByteSize = static_cast<UINT>(compactData.size() * sizeof(CompactVertex));
+            pool.Add(*meshGeometry, compactData.data(), mesh.Indices, cmdList);
+        }
+        else
+        {
+            // Vertex already has the layout, the source is copied straight into the pool
+            meshGeometry->VertexByteStride = sizeof(Vertex);
+            meshGeometry->VertexBufferByteSize = static_cast<UINT>(vertexDataSize);
+            pool.Add(*meshGeometry, mesh.Vertices, mesh.Indices, cmdList);
+        }
+
+        for (auto& [submeshName, submesh] : submeshes)
+            meshGeometry->DrawArgs[submeshName] = submesh;
+
         return meshGeometry;
     }
 }
@@ -13,6 +13,11 @@
 
 #include "d3dUtil.h"
 #include "Vertex.h"  // Use global Vertex definition
+#include "ModelData.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "CompactVertex.h"
+#include "MeshletBuilder.h"
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -21,6 +26,8 @@
 #include <memory>
 #include <DirectXMath.h>
 
+class GeometryPool;
+
 namespace ModelImporter
 {
     // Call this before application shutdown to cleanup Assimp internal state
@@ -29,39 +36,12 @@ namespace ModelImporter
         aiDetachAllLogStreams();
     }
 
-    // Using global Vertex definition from Vertex.h
-
-    // Material information extracted from model
-    struct ModelMaterial
+    // One simplified level of a model, see GenerateLods
+    struct LodData
     {
-        std::string Name;
-        DirectX::XMFLOAT4 DiffuseColor;
-        std::string DiffuseTexturePath;
-        std::string NormalTexturePath;
-        float Roughness;
-        float Metallic;
-    };
-
-    // Model loading result
-    struct ModelData
-    {
-        std::vector<Vertex> Vertices;
-        std::vector<uint16_t> Indices16;  // For meshes with < 65536 vertices
-        std::vector<uint32_t> Indices32;  // For larger meshes
-        std::vector<ModelMaterial> Materials;
-        std::string Name;
-        bool Use32BitIndices = false;
-
-        // Submesh information (if model contains multiple meshes)
-        struct Submesh
-        {
-            std::string Name;
-            UINT IndexCount;
-            UINT StartIndexLocation;
-            INT BaseVertexLocation;
-            UINT MaterialIndex;
-        };
-        std::vector<Submesh> Submeshes;
+        ModelData Model;
+        float TriangleRatio = 1.0f;  // Triangles kept over the source's
+        float Error = 0.0f;          // Largest MeshSimplifier error over the submeshes
     };
 
     // Import a 3D model from file
@@ -74,29 +54,63 @@ namespace ModelImporter
         bool generateNormals = false,
         bool flipWindingOrder = false);
 
+    // Simplify every submesh of a loaded model to each ratio of its triangle count, finest first
+    // Levels keep the submeshes and materials of the source but only the vertices they use
+    // Every submesh of every level is simplified on its own worker thread
+    std::vector<LodData> GenerateLods(
+        const ModelData& source,
+        const std::vector<float>& triangleRatios,
+        const MeshSimplifier::Settings& settings = {});
+
+    // Reorder every submesh for the vertex cache, overdraw and vertex fetch, see MeshOptimizer::Optimize
+    // Vertices only move within the range of their submesh, submeshes sharing vertices keep the vertex order, see MeshOptimizer::OptimizeSubmeshes
+    // Returns the cache statistics summed over the submeshes
+    MeshOptimizer::Stats OptimizeModel(ModelData& model, const MeshOptimizer::Settings& settings = {});
+
+    // Split every submesh of at least minTriangles triangles into meshlets, see MeshletBuilder::Build
+    // Reorders the triangles of those submeshes, run it after OptimizeModel. Returns the number of meshlets built.
+    size_t BuildMeshlets(
+        ModelData& model,
+        size_t minTriangles = 0,
+        uint32_t maxVertices = MeshletBuilder::MaxVertices,
+        uint32_t maxTriangles = MeshletBuilder::MaxTriangles);
+
+    // Submesh entries of a model with their bounds, a single "Default" submesh when the model has none
+    std::vector<std::pair<std::string, SubmeshGeometry>> BuildSubmeshGeometries(const ModelData& modelData);
+
     // Convert ModelData to MeshGeometry for rendering
-    // Requires DirectX device and command list for GPU buffer creation
+    // The vertices and indices are added to the shared buffers of pool, the copies are recorded on cmdList
+    // compactVertices uploads CompactVertex data quantized to the submesh bounds, VertexBufferCPU stays full precision
     std::unique_ptr<MeshGeometry> CreateMeshGeometry(
         const ModelData& modelData,
-        ID3D12Device* device,
+        GeometryPool& pool,
+        ID3D12GraphicsCommandList* cmdList,
+        const std::string& geometryName,
+        bool compactVertices = false);
+
+    // Same for submeshes whose bounds are already known, e.g. read from a MeshCache file
+    // The arrays of mesh are copied straight into the CPU copies and the pool
+    std::unique_ptr<MeshGeometry> CreateMeshGeometry(
+        const MeshView& mesh,
+        std::vector<std::pair<std::string, SubmeshGeometry>> submeshes,
+        GeometryPool& pool,
         ID3D12GraphicsCommandList* cmdList,
-        const std::string& geometryName);
+        const std::string& geometryName,
+        bool compactVertices = false);
 
-    // Helper: Process a single Assimp mesh
+    // Helper: Write the vertices and the indices of a single Assimp mesh into their final ranges
+    // outIndices holds uint32_t with use32BitIndices, uint16_t otherwise, relative to the first vertex of the mesh
     void ProcessMesh(
         const aiMesh* mesh,
-        const aiScene* scene,
-        std::vector<Vertex>& vertices,
-        std::vector<uint32_t>& indices,
-        UINT& baseVertex);
+        Vertex* outVertices,
+        void* outIndices,
+        bool use32BitIndices);
 
-    // Helper: Process Assimp node recursively
+    // Helper: Collect the meshes of an Assimp node recursively
     void ProcessNode(
         const aiNode* node,
         const aiScene* scene,
-        std::vector<Vertex>& vertices,
-        std::vector<uint32_t>& indices,
-        std::vector<ModelData::Submesh>& submeshes);
+        std::vector<const aiMesh*>& meshes);
 
     // Helper: Extract material information
     ModelMaterial ProcessMaterial(const aiMaterial* material, const std::string& modelDirectory);
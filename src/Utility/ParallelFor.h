@@ -0,0 +1,62 @@
+//***************************************************************************************
+// ParallelFor.h
+//
+// Splits an index range over worker threads
+//***************************************************************************************
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace ParallelForDetail
+{
+	// Set while a thread runs chunks of a ParallelFor that started helper threads
+	inline thread_local bool bOnWorker = false;
+}
+
+// Calls aBody(Begin, End) on chunks of at most aGrainSize indices of [0, aCount) until the range is
+// consumed. Chunks are pulled from a shared counter by the calling thread and up to
+// hardware_concurrency - 1 helper threads, or aMaxThreads - 1 when it is not zero, so uneven chunks
+// balance themselves. Returns when every chunk is done. Without a second thread the range runs inline
+// as a single aBody(0, aCount) call, and so do nested calls from inside a parallel aBody: the outer loop
+// already occupies the cores, e.g. the per submesh loops of an import running on an import worker.
+template<typename BodyFunc>
+void ParallelFor(size_t aCount, size_t aGrainSize, BodyFunc&& aBody, size_t aMaxThreads = 0)
+{
+	if (aCount == 0)
+		return;
+	aGrainSize = std::max<size_t>(aGrainSize, 1);
+	size_t ChunkCount = (aCount + aGrainSize - 1) / aGrainSize;
+	size_t MaxThreads = aMaxThreads != 0 ? aMaxThreads : std::max(1u, std::thread::hardware_concurrency());
+	size_t ThreadCount = std::min(MaxThreads, ChunkCount);
+	if (ThreadCount <= 1 || ParallelForDetail::bOnWorker)
+	{
+		aBody(size_t(0), aCount);
+		return;
+	}
+
+	std::atomic<size_t> NextChunk{ 0 };
+	auto Worker = [&]()
+	{
+		bool bWasOnWorker = ParallelForDetail::bOnWorker;
+		ParallelForDetail::bOnWorker = true;
+		for (size_t Chunk = NextChunk++; Chunk < ChunkCount; Chunk = NextChunk++)
+		{
+			size_t Begin = Chunk * aGrainSize;
+			aBody(Begin, std::min(Begin + aGrainSize, aCount));
+		}
+		ParallelForDetail::bOnWorker = bWasOnWorker;
+	};
+
+	std::vector<std::thread> Helpers;
+	Helpers.reserve(ThreadCount - 1);
+	for (size_t i = 1; i < ThreadCount; i++)
+		Helpers.emplace_back(Worker);
+	Worker();
+	for (std::thread& Helper : Helpers)
+		Helper.join();
+}
@@ -0,0 +1,164 @@
+//***************************************************************************************
+// RangeAllocator.cpp
+//
+// Offset allocator for suballocating ranges of a larger buffer
+//***************************************************************************************
+
+#include "RangeAllocator.h"
+#include <cassert>
+
+RangeAllocator::RangeAllocator(std::uint64_t aCapacity)
+{
+	Reset(aCapacity);
+}
+
+void RangeAllocator::Reset(std::uint64_t aCapacity)
+{
+	Capacity = aCapacity;
+	UsedSize = 0;
+	Allocations.clear();
+	FreeByOffset.clear();
+	FreeBySize.clear();
+	if (aCapacity > 0)
+		InsertFree(0, aCapacity);
+}
+
+void RangeAllocator::Grow(std::uint64_t aNewCapacity)
+{
+	if (aNewCapacity <= Capacity)
+		return;
+	std::uint64_t Offset = Capacity;
+	std::uint64_t Size = aNewCapacity - Capacity;
+	Capacity = aNewCapacity;
+
+	// Extends the free range touching the old end
+	if (!FreeByOffset.empty())
+	{
+		auto Last = std::prev(FreeByOffset.end());
+		if (Last->first + Last->second == Offset)
+		{
+			Offset = Last->first;
+			Size += Last->second;
+			EraseFree(Last);
+		}
+	}
+	InsertFree(Offset, Size);
+}
+
+std::uint64_t RangeAllocator::Allocate(std::uint64_t aSize, std::uint64_t aAlignment)
+{
+	if (aSize == 0)
+		return InvalidOffset;
+	if (aAlignment == 0)
+		aAlignment = 1;
+
+	// Ranges of at least aSize, smallest first, until one still fits after aligning its start
+	for (auto It = FreeBySize.lower_bound({ aSize, 0 }); It != FreeBySize.end(); ++It)
+	{
+		auto [RangeSize, RangeOffset] = *It;
+		std::uint64_t Offset = (RangeOffset + aAlignment - 1) / aAlignment * aAlignment;
+		std::uint64_t Padding = Offset - RangeOffset;
+		if (Padding + aSize > RangeSize)
+			continue;
+
+		EraseFree(FreeByOffset.find(RangeOffset));
+		if (Padding > 0)
+			InsertFree(RangeOffset, Padding);
+		if (Padding + aSize < RangeSize)
+			InsertFree(Offset + aSize, RangeSize - Padding - aSize);
+		Allocations.emplace(Offset, aSize);
+		UsedSize += aSize;
+		return Offset;
+	}
+	return InvalidOffset;
+}
+
+void RangeAllocator::Free(std::uint64_t aOffset)
+{
+	auto It = Allocations.find(aOffset);
+	assert(It != Allocations.end() && "Freeing an offset that was not allocated");
+	if (It == Allocations.end())
+		return;
+
+	std::uint64_t Offset = It->first;
+	std::uint64_t Size = It->second;
+	UsedSize -= Size;
+	Allocations.erase(It);
+
+	// Merge with the free neighbours on both sides
+	auto Next = FreeByOffset.lower_bound(Offset);
+	if (Next != FreeByOffset.begin())
+	{
+		auto Previous = std::prev(Next);
+		if (Previous->first + Previous->second == Offset)
+		{
+			Offset = Previous->first;
+			Size += Previous->second;
+			EraseFree(Previous);
+		}
+	}
+	if (Next != FreeByOffset.end() && Offset + Size == Next->first)
+	{
+		Size += Next->second;
+		EraseFree(Next);
+	}
+	InsertFree(Offset, Size);
+}
+
+std::uint64_t RangeAllocator::GetAllocationSize(std::uint64_t aOffset) const
+{
+	auto It = Allocations.find(aOffset);
+	return It != Allocations.end() ? It->second : 0;
+}
+
+std::vector<RangeAllocator::Move> RangeAllocator::Defragment()
+{
+	std::vector<Move> Moves;
+	Moves.reserve(Allocations.size());
+	std::map<std::uint64_t, std::uint64_t> Packed;
+	std::uint64_t Cursor = 0;
+	for (const auto& [Offset, Size] : Allocations)
+	{
+		Moves.push_back({ Offset, Cursor, Size });
+		Packed.emplace_hint(Packed.end(), Cursor, Size);
+		Cursor += Size;
+	}
+
+	Allocations = std::move(Packed);
+	FreeByOffset.clear();
+	FreeBySize.clear();
+	if (Cursor < Capacity)
+		InsertFree(Cursor, Capacity - Cursor);
+	return Moves;
+}
+
+std::uint64_t RangeAllocator::GetLargestFreeRange() const
+{
+	return FreeBySize.empty() ? 0 : FreeBySize.rbegin()->first;
+}
+
+std::uint64_t RangeAllocator::GetUsedEnd() const
+{
+	if (Allocations.empty())
+		return 0;
+	auto Last = std::prev(Allocations.end());
+	return Last->first + Last->second;
+}
+
+float RangeAllocator::GetFragmentation() const
+{
+	std::uint64_t FreeSize = GetFreeSize();
+	return FreeSize > 0 ? 1.0f - float(GetLargestFreeRange()) / float(FreeSize) : 0.0f;
+}
+
+void RangeAllocator::InsertFree(std::uint64_t aOffset, std::uint64_t aSize)
+{
+	FreeByOffset.emplace(aOffset, aSize);
+	FreeBySize.emplace(aSize, aOffset);
+}
+
+void RangeAllocator::EraseFree(std::map<std::uint64_t, std::uint64_t>::iterator aIt)
+{
+	FreeBySize.erase({ aIt->second, aIt->first });
+	FreeByOffset.erase(aIt);
+}
@@ -0,0 +1,72 @@
+//***************************************************************************************
+// RangeAllocator.h
+//
+// Offset allocator for suballocating ranges of a larger buffer
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Hands out [Offset, Offset + Size) ranges of [0, Capacity) in arbitrary units, e.g. bytes or vertices.
+// Free ranges are kept in a list ordered by offset, coalesced with their neighbours on Free, and in a
+// second list ordered by size for best fit allocation. Nothing is read or written, the caller owns the
+// memory the offsets refer to.
+class RangeAllocator
+{
+public:
+	static constexpr std::uint64_t InvalidOffset = UINT64_MAX;
+
+	// An allocation moved by Defragment
+	struct Move
+	{
+		std::uint64_t OldOffset = 0;
+		std::uint64_t NewOffset = 0;
+		std::uint64_t Size = 0;
+	};
+
+	explicit RangeAllocator(std::uint64_t aCapacity = 0);
+
+	// Forgets every allocation
+	void Reset(std::uint64_t aCapacity);
+	// Appends free space at the end, existing allocations keep their offsets
+	void Grow(std::uint64_t aNewCapacity);
+
+	// Smallest free range that fits aSize at a multiple of aAlignment. Returns InvalidOffset when none does.
+	std::uint64_t Allocate(std::uint64_t aSize, std::uint64_t aAlignment = 1);
+	// aOffset must have been returned by Allocate
+	void Free(std::uint64_t aOffset);
+	std::uint64_t GetAllocationSize(std::uint64_t aOffset) const;
+
+	// Packs every allocation to the front in offset order, leaving a single free range at the end.
+	// Returns every allocation with its old and new offset in offset order. NewOffset <= OldOffset, so
+	// the moves can be applied front to back within the same memory as long as each copy allows overlap.
+	// Alignments are not kept, only use it for allocations of alignment 1.
+	std::vector<Move> Defragment();
+
+	std::uint64_t GetCapacity() const { return Capacity; }
+	std::uint64_t GetUsedSize() const { return UsedSize; }
+	std::uint64_t GetFreeSize() const { return Capacity - UsedSize; }
+	size_t GetAllocationCount() const { return Allocations.size(); }
+	size_t GetFreeRangeCount() const { return FreeByOffset.size(); }
+	std::uint64_t GetLargestFreeRange() const;
+	// End of the last allocation, the part of the capacity that has to be kept when copying
+	std::uint64_t GetUsedEnd() const;
+	// 1 - largest free range / free size: 0 while the free space is one range, towards 1 as it splinters
+	float GetFragmentation() const;
+
+private:
+	void InsertFree(std::uint64_t aOffset, std::uint64_t aSize);
+	void EraseFree(std::map<std::uint64_t, std::uint64_t>::iterator aIt);
+
+	std::uint64_t Capacity = 0;
+	std::uint64_t UsedSize = 0;
+	std::map<std::uint64_t, std::uint64_t> Allocations;		// Offset -> size
+	std::map<std::uint64_t, std::uint64_t> FreeByOffset;	// Offset -> size
+	std::set<std::pair<std::uint64_t, std::uint64_t>> FreeBySize;	// (Size, offset)
+};
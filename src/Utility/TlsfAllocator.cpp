@@ -0,0 +1,271 @@
+//***************************************************************************************
+// TlsfAllocator.cpp
+//
+// Two level segregated fit allocator for suballocating GPU heaps
+//***************************************************************************************
+
+#include "TlsfAllocator.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+TlsfAllocator::TlsfAllocator(std::uint64_t aCapacity)
+{
+	Reset(aCapacity);
+}
+
+void TlsfAllocator::Reset(std::uint64_t aCapacity)
+{
+	Capacity = aCapacity;
+	UsedSize = 0;
+	AllocationCount = 0;
+	FreeBlockCount = 0;
+	FirstLevelMask = 0;
+	std::fill(std::begin(SecondLevelMasks), std::end(SecondLevelMasks), 0u);
+	std::fill(&Bins[0][0], &Bins[0][0] + FirstLevelCount * SecondLevelCount, InvalidBlock);
+	Blocks.clear();
+	UnusedBlocks = InvalidBlock;
+
+	if (aCapacity > 0)
+	{
+		std::uint32_t Whole = NewBlock();
+		Blocks[Whole].Size = aCapacity;
+		InsertFree(Whole);
+	}
+}
+
+TlsfAllocator::Allocation TlsfAllocator::Allocate(std::uint64_t aSize, std::uint64_t aAlignment)
+{
+	assert(aAlignment > 0 && (aAlignment & (aAlignment - 1)) == 0 && "Alignment must be a power of two");
+	if (aSize == 0 || aSize > GetFreeSize())
+		return {};
+
+	auto AlignedPadding = [aAlignment](std::uint64_t aOffset) { return ((aOffset + aAlignment - 1) & ~(aAlignment - 1)) - aOffset; };
+
+	// A block of the bin fitting aSize usually is aligned already, else one fitting the worst case padding always is
+	std::uint32_t First, Second;
+	std::uint32_t Found = MapSearch(aSize, First, Second) ? FindFreeBlock(First, Second) : InvalidBlock;
+	if (Found != InvalidBlock && AlignedPadding(Blocks[Found].Offset) + aSize > Blocks[Found].Size)
+	{
+		Found = InvalidBlock;
+		if (aSize + aAlignment - 1 > aSize && MapSearch(aSize + aAlignment - 1, First, Second))
+			Found = FindFreeBlock(First, Second);
+	}
+	if (Found == InvalidBlock)
+	{
+		// The rounding skips the bin of aSize itself, its blocks may still fit when nothing larger is left
+		MapInsert(aSize, First, Second);
+		for (std::uint32_t It = Bins[First][Second]; It != InvalidBlock && Found == InvalidBlock; It = Blocks[It].NextFree)
+		{
+			if (AlignedPadding(Blocks[It].Offset) + aSize <= Blocks[It].Size)
+				Found = It;
+		}
+		if (Found == InvalidBlock)
+			return {};
+	}
+
+	RemoveFree(Found);
+	std::uint64_t Padding = AlignedPadding(Blocks[Found].Offset);
+	if (Padding > 0)
+	{
+		// The padding stays free in front, its physical predecessor is in use since free blocks are merged
+		SplitTail(Found, Padding);
+		std::uint32_t Front = Found;
+		Found = Blocks[Front].NextPhysical;
+		RemoveFree(Found);
+		InsertFree(Front);
+	}
+	if (Blocks[Found].Size > aSize)
+		SplitTail(Found, aSize);
+
+	UsedSize += aSize;
+	AllocationCount++;
+	return { Blocks[Found].Offset, Found };
+}
+
+void TlsfAllocator::Free(const Allocation& aAllocation)
+{
+	if (!aAllocation.IsValid())
+		return;
+	assert(aAllocation.Block < Blocks.size() && !Blocks[aAllocation.Block].bFree && Blocks[aAllocation.Block].Offset == aAllocation.Offset
+		&& "Freeing an allocation that is not live");
+
+	std::uint32_t Freed = aAllocation.Block;
+	UsedSize -= Blocks[Freed].Size;
+	AllocationCount--;
+
+	std::uint32_t Previous = Blocks[Freed].PreviousPhysical;
+	if (Previous != InvalidBlock && Blocks[Previous].bFree)
+	{
+		RemoveFree(Previous);
+		Freed = MergeIntoPrevious(Freed);
+	}
+	std::uint32_t Next = Blocks[Freed].NextPhysical;
+	if (Next != InvalidBlock && Blocks[Next].bFree)
+	{
+		RemoveFree(Next);
+		MergeIntoPrevious(Next);
+	}
+	InsertFree(Freed);
+}
+
+std::uint64_t TlsfAllocator::GetAllocationSize(const Allocation& aAllocation) const
+{
+	if (!aAllocation.IsValid() || aAllocation.Block >= Blocks.size() || Blocks[aAllocation.Block].bFree)
+		return 0;
+	return Blocks[aAllocation.Block].Size;
+}
+
+std::uint64_t TlsfAllocator::GetLargestFreeBlock() const
+{
+	if (FirstLevelMask == 0)
+		return 0;
+
+	// Only the highest non empty bin can hold the largest block, its blocks are not sorted
+	std::uint32_t First = 63 - std::countl_zero(FirstLevelMask);
+	std::uint32_t Second = 31 - std::countl_zero(SecondLevelMasks[First]);
+	std::uint64_t Largest = 0;
+	for (std::uint32_t It = Bins[First][Second]; It != InvalidBlock; It = Blocks[It].NextFree)
+		Largest = std::max(Largest, Blocks[It].Size);
+	return Largest;
+}
+
+float TlsfAllocator::GetFragmentation() const
+{
+	std::uint64_t FreeSize = GetFreeSize();
+	return FreeSize > 0 ? 1.0f - float(GetLargestFreeBlock()) / float(FreeSize) : 0.0f;
+}
+
+void TlsfAllocator::MapInsert(std::uint64_t aSize, std::uint32_t& aFirst, std::uint32_t& aSecond)
+{
+	if (aSize < SecondLevelCount)
+	{
+		aFirst = 0;
+		aSecond = static_cast<std::uint32_t>(aSize);
+		return;
+	}
+	std::uint32_t HighestBit = static_cast<std::uint32_t>(std::bit_width(aSize)) - 1;
+	aFirst = HighestBit - SecondLevelBits + 1;
+	aSecond = static_cast<std::uint32_t>(aSize >> (HighestBit - SecondLevelBits)) - SecondLevelCount;
+}
+
+bool TlsfAllocator::MapSearch(std::uint64_t aSize, std::uint32_t& aFirst, std::uint32_t& aSecond)
+{
+	if (aSize >= SecondLevelCount)
+	{
+		// Round up to the next bin boundary so every block of the bin is large enough
+		std::uint32_t HighestBit = static_cast<std::uint32_t>(std::bit_width(aSize)) - 1;
+		std::uint64_t Round = (std::uint64_t(1) << (HighestBit - SecondLevelBits)) - 1;
+		if (aSize + Round < aSize)
+			return false;
+		aSize += Round;
+	}
+	MapInsert(aSize, aFirst, aSecond);
+	return aFirst < FirstLevelCount;
+}
+
+std::uint32_t TlsfAllocator::FindFreeBlock(std::uint32_t aFirst, std::uint32_t aSecond) const
+{
+	std::uint32_t SecondMask = SecondLevelMasks[aFirst] & (~0u << aSecond);
+	if (SecondMask == 0)
+	{
+		std::uint64_t FirstMask = aFirst + 1 < 64 ? FirstLevelMask & (~std::uint64_t(0) << (aFirst + 1)) : 0;
+		if (FirstMask == 0)
+			return InvalidBlock;
+		aFirst = static_cast<std::uint32_t>(std::countr_zero(FirstMask));
+		SecondMask = SecondLevelMasks[aFirst];
+	}
+	return Bins[aFirst][std::countr_zero(SecondMask)];
+}
+
+std::uint32_t TlsfAllocator::NewBlock()
+{
+	std::uint32_t Index;
+	if (UnusedBlocks != InvalidBlock)
+	{
+		Index = UnusedBlocks;
+		UnusedBlocks = Blocks[Index].NextFree;
+		Blocks[Index] = Block();
+	}
+	else
+	{
+		Index = static_cast<std::uint32_t>(Blocks.size());
+		Blocks.emplace_back();
+	}
+	return Index;
+}
+
+void TlsfAllocator::ReleaseBlock(std::uint32_t aBlock)
+{
+	Blocks[aBlock].NextFree = UnusedBlocks;
+	Blocks[aBlock].Size = 0;
+	UnusedBlocks = aBlock;
+}
+
+void TlsfAllocator::InsertFree(std::uint32_t aBlock)
+{
+	std::uint32_t First, Second;
+	MapInsert(Blocks[aBlock].Size, First, Second);
+	std::uint32_t Head = Bins[First][Second];
+	Blocks[aBlock].bFree = true;
+	Blocks[aBlock].PreviousFree = InvalidBlock;
+	Blocks[aBlock].NextFree = Head;
+	if (Head != InvalidBlock)
+		Blocks[Head].PreviousFree = aBlock;
+	Bins[First][Second] = aBlock;
+	FirstLevelMask |= std::uint64_t(1) << First;
+	SecondLevelMasks[First] |= 1u << Second;
+	FreeBlockCount++;
+}
+
+void TlsfAllocator::RemoveFree(std::uint32_t aBlock)
+{
+	Block& Removed = Blocks[aBlock];
+	if (Removed.PreviousFree != InvalidBlock)
+		Blocks[Removed.PreviousFree].NextFree = Removed.NextFree;
+	else
+	{
+		std::uint32_t First, Second;
+		MapInsert(Removed.Size, First, Second);
+		Bins[First][Second] = Removed.NextFree;
+		if (Removed.NextFree == InvalidBlock)
+		{
+			SecondLevelMasks[First] &= ~(1u << Second);
+			if (SecondLevelMasks[First] == 0)
+				FirstLevelMask &= ~(std::uint64_t(1) << First);
+		}
+	}
+	if (Removed.NextFree != InvalidBlock)
+		Blocks[Removed.NextFree].PreviousFree = Removed.PreviousFree;
+	Removed.bFree = false;
+	Removed.PreviousFree = InvalidBlock;
+	Removed.NextFree = InvalidBlock;
+	FreeBlockCount--;
+}
+
+void TlsfAllocator::SplitTail(std::uint32_t aBlock, std::uint64_t aSize)
+{
+	std::uint32_t Tail = NewBlock();
+	Block& Head = Blocks[aBlock];
+	Blocks[Tail].Offset = Head.Offset + aSize;
+	Blocks[Tail].Size = Head.Size - aSize;
+	Blocks[Tail].PreviousPhysical = aBlock;
+	Blocks[Tail].NextPhysical = Head.NextPhysical;
+	if (Head.NextPhysical != InvalidBlock)
+		Blocks[Head.NextPhysical].PreviousPhysical = Tail;
+	Head.NextPhysical = Tail;
+	Head.Size = aSize;
+	InsertFree(Tail);
+}
+
+std::uint32_t TlsfAllocator::MergeIntoPrevious(std::uint32_t aBlock)
+{
+	std::uint32_t Previous = Blocks[aBlock].PreviousPhysical;
+	std::uint32_t Next = Blocks[aBlock].NextPhysical;
+	Blocks[Previous].Size += Blocks[aBlock].Size;
+	Blocks[Previous].NextPhysical = Next;
+	if (Next != InvalidBlock)
+		Blocks[Next].PreviousPhysical = Previous;
+	ReleaseBlock(aBlock);
+	return Previous;
+}
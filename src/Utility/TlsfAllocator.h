@@ -0,0 +1,94 @@
+//***************************************************************************************
+// TlsfAllocator.h
+//
+// Two level segregated fit allocator for suballocating GPU heaps
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hands out [Offset, Offset + Size) ranges of [0, Capacity) in arbitrary units, usually bytes of an ID3D12Heap.
+// Free blocks are binned by size: the first level is the power of two, the second level splits it into
+// SecondLevelCount linear steps. Bitmaps of the non empty bins find a fitting block in constant time, a freed
+// block is merged with its free physical neighbours. Nothing is read or written, the caller owns the memory.
+// Unlike RangeAllocator the cost of Allocate and Free does not grow with the number of free ranges.
+class TlsfAllocator
+{
+public:
+	static constexpr std::uint64_t InvalidOffset = UINT64_MAX;
+	static constexpr std::uint32_t InvalidBlock = UINT32_MAX;
+
+	struct Allocation
+	{
+		std::uint64_t Offset = InvalidOffset;
+		std::uint32_t Block = InvalidBlock;		// Pass to Free
+
+		bool IsValid() const { return Block != InvalidBlock; }
+	};
+
+	explicit TlsfAllocator(std::uint64_t aCapacity = 0);
+
+	// Forgets every allocation
+	void Reset(std::uint64_t aCapacity);
+
+	// aAlignment must be a power of two. Returns an invalid allocation when no free block fits.
+	Allocation Allocate(std::uint64_t aSize, std::uint64_t aAlignment = 1);
+	void Free(const Allocation& aAllocation);
+	std::uint64_t GetAllocationSize(const Allocation& aAllocation) const;
+
+	std::uint64_t GetCapacity() const { return Capacity; }
+	std::uint64_t GetUsedSize() const { return UsedSize; }
+	std::uint64_t GetFreeSize() const { return Capacity - UsedSize; }
+	size_t GetAllocationCount() const { return AllocationCount; }
+	size_t GetFreeBlockCount() const { return FreeBlockCount; }
+	bool IsEmpty() const { return AllocationCount == 0; }
+	std::uint64_t GetLargestFreeBlock() const;
+	// 1 - largest free block / free size: 0 while the free space is one block, towards 1 as it splinters
+	float GetFragmentation() const;
+
+private:
+	static constexpr std::uint32_t SecondLevelBits = 5;
+	static constexpr std::uint32_t SecondLevelCount = 1u << SecondLevelBits;
+	// Sizes below SecondLevelCount share first level 0, one bin per size
+	static constexpr std::uint32_t FirstLevelCount = 64 - SecondLevelBits + 1;
+
+	struct Block
+	{
+		std::uint64_t Offset = 0;
+		std::uint64_t Size = 0;
+		std::uint32_t PreviousPhysical = InvalidBlock;
+		std::uint32_t NextPhysical = InvalidBlock;
+		std::uint32_t PreviousFree = InvalidBlock;	// Within its bin, also links unused block records
+		std::uint32_t NextFree = InvalidBlock;
+		bool bFree = false;
+	};
+
+	// Bin holding blocks of aSize
+	static void MapInsert(std::uint64_t aSize, std::uint32_t& aFirst, std::uint32_t& aSecond);
+	// Smallest bin whose blocks all hold at least aSize, false when aSize is beyond the last bin
+	static bool MapSearch(std::uint64_t aSize, std::uint32_t& aFirst, std::uint32_t& aSecond);
+	// First non empty bin at or after (aFirst, aSecond)
+	std::uint32_t FindFreeBlock(std::uint32_t aFirst, std::uint32_t aSecond) const;
+
+	std::uint32_t NewBlock();
+	void ReleaseBlock(std::uint32_t aBlock);
+	void InsertFree(std::uint32_t aBlock);
+	void RemoveFree(std::uint32_t aBlock);
+	// Splits the part of aBlock past aSize off into a new free block
+	void SplitTail(std::uint32_t aBlock, std::uint64_t aSize);
+	// Merges aBlock into the physical neighbour in front of it, which survives
+	std::uint32_t MergeIntoPrevious(std::uint32_t aBlock);
+
+	std::uint64_t Capacity = 0;
+	std::uint64_t UsedSize = 0;
+	size_t AllocationCount = 0;
+	size_t FreeBlockCount = 0;
+	std::uint64_t FirstLevelMask = 0;
+	std::uint32_t SecondLevelMasks[FirstLevelCount] = {};
+	std::uint32_t Bins[FirstLevelCount][SecondLevelCount];
+	std::vector<Block> Blocks;
+	std::uint32_t UnusedBlocks = InvalidBlock;	// Records free for reuse, linked through NextFree
+};
@@ -1,5 +1,6 @@
 
 #include "d3dUtil.h"
+#include "GpuMemoryAllocator.h"
 #include <comdef.h>
 #include <fstream>
 
@@ -36,35 +37,18 @@ ComPtr<ID3DBlob> d3dUtil::LoadBinary(const std::wstring& filename)
 }
 
 Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
-    ID3D12Device* device,
+    GpuMemoryAllocator* allocator,
     ID3D12GraphicsCommandList* cmdList,
     const void* initData,
     UINT64 byteSize,
     Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer)
 {
-    ComPtr<ID3D12Resource> defaultBuffer;
-
     // Create the actual default buffer resource.
-    auto heapPropsDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
-    ThrowIfFailed(device->CreateCommittedResource(
-        &heapPropsDefault,
-        D3D12_HEAP_FLAG_NONE,
-        &resourceDesc,
-		D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(defaultBuffer.GetAddressOf())));
+    ComPtr<ID3D12Resource> defaultBuffer = allocator->CreateBuffer(D3D12_HEAP_TYPE_DEFAULT, byteSize, D3D12_RESOURCE_STATE_COMMON);
 
     // In order to copy CPU memory data into our default buffer, we need to create
     // an intermediate upload heap.
-    auto heapPropsUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    ThrowIfFailed(device->CreateCommittedResource(
-        &heapPropsUpload,
-		D3D12_HEAP_FLAG_NONE,
-        &resourceDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(uploadBuffer.GetAddressOf())));
+    uploadBuffer = allocator->CreateBuffer(D3D12_HEAP_TYPE_UPLOAD, byteSize, D3D12_RESOURCE_STATE_GENERIC_READ);
 
 
     // Describe the data we want to copy into the default buffer.
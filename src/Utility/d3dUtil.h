@@ -32,6 +32,7 @@
 #include "d3dx12.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
+#include "MeshletBuilder.h"
 
 extern const int gNumFrameResources;
 
@@ -92,6 +93,8 @@ inline std::wstring AnsiToWString(const std::string& str)
 #endif 		
     */
 
+class GpuMemoryAllocator;
+
 class d3dUtil
 {
 public:
@@ -118,8 +121,9 @@ public:
 
     static Microsoft::WRL::ComPtr<ID3DBlob> LoadBinary(const std::wstring& filename);
 
+    // Both buffers are placed by allocator
     static Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
-        ID3D12Device* device,
+        GpuMemoryAllocator* allocator,
         ID3D12GraphicsCommandList* cmdList,
         const void* initData,
         UINT64 byteSize,
@@ -152,6 +156,9 @@ public:
 // geometries are stored in one vertex and index buffer.  It provides the offsets
 // and data needed to draw a subset of geometry stores in the vertex and index 
 // buffers so that we can implement the technique described by Figure 6.3.
+class TriangleBVH;
+class GeometryBuffer;
+
 struct SubmeshGeometry
 {
 	UINT IndexCount = 0;
@@ -161,26 +168,41 @@ struct SubmeshGeometry
     // Bounding box of the geometry defined by this submesh. 
     // This is used in later chapters of the book.
 	DirectX::BoundingBox Bounds;
+
+	// Built once after import, shared by every render item drawing the submesh
+	std::shared_ptr<TriangleBVH> PickingBvh;
+
+	// Compact vertices: offset (xyz) and scale (w) of the quantized positions, see PositionQuantization
+	DirectX::XMFLOAT4 PositionDequant = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	// Clusters of the submesh for ClusterCuller, index ranges relative to StartIndexLocation. Empty when the
+	// submesh is drawn whole.
+	std::vector<Meshlet> Meshlets;
 };
 
 struct MeshGeometry
 {
 	// Give it a name so we can look it up by name.
 	std::string Name;
+	// Unique over the lifetime of the app, unlike the address a removed geometry leaves for the next one
+	UINT Id = 0;
 
 	// System memory copies.  Use Blobs because the vertex/index format can be generic.
 	// It is up to the client to cast appropriately.  
 	Microsoft::WRL::ComPtr<ID3DBlob> VertexBufferCPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3DBlob> IndexBufferCPU  = nullptr;
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferGPU = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferGPU = nullptr;
-
-	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferUploader = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferUploader = nullptr;
+	// Ranges of the shared buffers of a GeometryPool, in vertices and indices. The pool moves them when
+	// it grows or defragments, they are added to the locations of every submesh at draw time.
+	GeometryBuffer* VertexBuffer = nullptr;
+	GeometryBuffer* IndexBuffer = nullptr;
+	UINT BaseVertexLocation = 0;
+	UINT StartIndexLocation = 0;
 
     // Data about the buffers.
 	UINT VertexByteStride = 0;
+	// VertexBufferCPU holds full precision Vertex data for CPU queries even when the GPU buffer is compact
+	UINT VertexBufferCPUByteStride = 0;
 	UINT VertexBufferByteSize = 0;
 	DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
 	UINT IndexBufferByteSize = 0;
@@ -189,33 +211,6 @@ struct MeshGeometry
 	// Use this container to define the Submesh geometries so we can draw
 	// the Submeshes individually.
 	std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
-
-	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
-	{
-		D3D12_VERTEX_BUFFER_VIEW vbv;
-		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress();
-		vbv.StrideInBytes = VertexByteStride;
-		vbv.SizeInBytes = VertexBufferByteSize;
-
-		return vbv;
-	}
-
-	D3D12_INDEX_BUFFER_VIEW IndexBufferView()const
-	{
-		D3D12_INDEX_BUFFER_VIEW ibv;
-		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress();
-		ibv.Format = IndexFormat;
-		ibv.SizeInBytes = IndexBufferByteSize;
-
-		return ibv;
-	}
-
-	// We can free this memory after we finish upload to the GPU.
-	void DisposeUploaders()
-	{
-		VertexBufferUploader = nullptr;
-		IndexBufferUploader = nullptr;
-	}
 };
 
 struct Light
@@ -0,0 +1,225 @@
+//***************************************************************************************
+// CascadedShadowsTest.cpp
+//
+// Split scheme and cascade fitting of CascadedShadows
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "CascadedShadows.h"
+#include <initializer_list>
+#include <utility>
+
+namespace
+{
+	CascadedShadows::CameraFrustum MakeCamera(float aX, float aY, float aZ)
+	{
+		CascadedShadows::CameraFrustum Camera;
+		Camera.Position = DirectX::XMFLOAT3(aX, aY, aZ);
+		Camera.Right = DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
+		Camera.Up = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+		Camera.Look = DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f);
+		Camera.FovY = 0.25f * 3.14159265f;
+		Camera.Aspect = 16.0f / 9.0f;
+		Camera.NearZ = 1.0f;
+		Camera.FarZ = 1000.0f;
+		return Camera;
+	}
+
+	DirectX::XMFLOAT4 Transform(const DirectX::XMFLOAT3& P, const DirectX::XMFLOAT4X4& M)
+	{
+		return DirectX::XMFLOAT4(
+			P.x * M._11 + P.y * M._21 + P.z * M._31 + M._41,
+			P.x * M._12 + P.y * M._22 + P.z * M._32 + M._42,
+			P.x * M._13 + P.y * M._23 + P.z * M._33 + M._43,
+			P.x * M._14 + P.y * M._24 + P.z * M._34 + M._44);
+	}
+
+	// Corner of the camera frustum slice at aDepth, aSignX / aSignY select the side
+	DirectX::XMFLOAT3 SliceCorner(const CascadedShadows::CameraFrustum& aCamera, float aDepth, float aSignX, float aSignY)
+	{
+		float HalfHeight = aDepth * std::tan(aCamera.FovY * 0.5f);
+		float HalfWidth = HalfHeight * aCamera.Aspect;
+		return DirectX::XMFLOAT3(
+			aCamera.Position.x + aCamera.Right.x * HalfWidth * aSignX + aCamera.Up.x * HalfHeight * aSignY + aCamera.Look.x * aDepth,
+			aCamera.Position.y + aCamera.Right.y * HalfWidth * aSignX + aCamera.Up.y * HalfHeight * aSignY + aCamera.Look.y * aDepth,
+			aCamera.Position.z + aCamera.Right.z * HalfWidth * aSignX + aCamera.Up.z * HalfHeight * aSignY + aCamera.Look.z * aDepth);
+	}
+
+	bool SameMatrix(const DirectX::XMFLOAT4X4& A, const DirectX::XMFLOAT4X4& B)
+	{
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++)
+				if (A.m[r][c] != B.m[r][c])
+					return false;
+		return true;
+	}
+
+	void TestSplitsAreMonotonic()
+	{
+		for (std::uint32_t Count = 1; Count <= CascadedShadows::MaxCascades; Count++)
+		{
+			for (float Lambda : { 0.0f, 0.25f, 0.5f, 0.75f, 1.0f })
+			{
+				float Splits[CascadedShadows::MaxCascades + 1];
+				CascadedShadows::ComputeSplits(0.5f, 200.0f, Count, Lambda, Splits);
+				CHECK(Splits[0] == 0.5f);
+				CHECK(Splits[Count] == 200.0f);
+				for (std::uint32_t i = 1; i <= Count; i++)
+					CHECK(Splits[i] > Splits[i - 1]);
+			}
+		}
+	}
+
+	void TestSplitLambdaEndpoints()
+	{
+		const float Near = 1.0f;
+		const float Far = 81.0f;
+		const std::uint32_t Count = 4;
+		float Uniform[Count + 1];
+		float Logarithmic[Count + 1];
+		float Blend[Count + 1];
+		CascadedShadows::ComputeSplits(Near, Far, Count, 0.0f, Uniform);
+		CascadedShadows::ComputeSplits(Near, Far, Count, 1.0f, Logarithmic);
+		CascadedShadows::ComputeSplits(Near, Far, Count, 0.5f, Blend);
+		for (std::uint32_t i = 0; i <= Count; i++)
+		{
+			CHECK_NEAR(Uniform[i], Near + (Far - Near) * i / Count, 1e-4f);
+			// 81 = 3^4, so the logarithmic splits are the powers of 3
+			CHECK_NEAR(Logarithmic[i], std::pow(3.0f, (float)i), 1e-3f);
+			CHECK_NEAR(Blend[i], 0.5f * (Uniform[i] + Logarithmic[i]), 1e-3f);
+			// Logarithmic splits favour the near range
+			CHECK(Logarithmic[i] <= Uniform[i] + 1e-4f);
+		}
+	}
+
+	void TestSliceSphereContainsSlice()
+	{
+		CascadedShadows::CameraFrustum Camera = MakeCamera(3.0f, 2.0f, -7.0f);
+		for (auto [SliceNear, SliceFar] : { std::pair(1.0f, 4.0f), std::pair(4.0f, 15.0f), std::pair(15.0f, 60.0f), std::pair(1.0f, 60.0f) })
+		{
+			DirectX::XMFLOAT3 Center;
+			float Radius;
+			CascadedShadows::ComputeSliceSphere(Camera, SliceNear, SliceFar, Center, Radius);
+			for (float Depth : { SliceNear, SliceFar })
+			{
+				for (float SignX : { -1.0f, 1.0f })
+				{
+					for (float SignY : { -1.0f, 1.0f })
+					{
+						DirectX::XMFLOAT3 Corner = SliceCorner(Camera, Depth, SignX, SignY);
+						float Dx = Corner.x - Center.x, Dy = Corner.y - Center.y, Dz = Corner.z - Center.z;
+						CHECK(std::sqrt(Dx * Dx + Dy * Dy + Dz * Dz) <= Radius * 1.0001f);
+					}
+				}
+			}
+		}
+	}
+
+	void TestCascadesContainTheirSlices()
+	{
+		CascadedShadows Shadows;
+		CascadedShadows::Settings Settings;
+		Settings.CascadeCount = 4;
+		Shadows.SetSettings(Settings);
+		CascadedShadows::CameraFrustum Camera = MakeCamera(0.0f, 5.0f, -20.0f);
+		Shadows.Update(Camera, DirectX::XMFLOAT3(-0.57735f, -0.57735f, 0.57735f));
+
+		CHECK(Shadows.GetCascade(0).SplitNear == Camera.NearZ);
+		CHECK(Shadows.GetCascade(Settings.CascadeCount - 1).SplitFar == Settings.MaxShadowDistance);
+		for (std::uint32_t i = 0; i < Settings.CascadeCount; i++)
+		{
+			const CascadedShadows::Cascade& Current = Shadows.GetCascade(i);
+			if (i > 0)
+				CHECK(Current.SplitNear == Shadows.GetCascade(i - 1).SplitFar);
+			for (float Depth : { Current.SplitNear, Current.SplitFar })
+			{
+				for (float SignX : { -1.0f, 1.0f })
+				{
+					for (float SignY : { -1.0f, 1.0f })
+					{
+						DirectX::XMFLOAT4 Ndc = Transform(SliceCorner(Camera, Depth, SignX, SignY), Current.ViewProj);
+						CHECK(std::fabs(Ndc.x) <= 1.0f && std::fabs(Ndc.y) <= 1.0f);
+						CHECK(Ndc.z >= 0.0f && Ndc.z <= 1.0f);
+					}
+				}
+			}
+		}
+	}
+
+	void TestSubTexelMotionKeepsProjection()
+	{
+		CascadedShadows Shadows;
+		CascadedShadows::Settings Settings;
+		Shadows.SetSettings(Settings);
+		const DirectX::XMFLOAT3 LightDirection(-0.57735f, -0.57735f, 0.57735f);
+		Shadows.Update(MakeCamera(0.0f, 5.0f, -20.0f), LightDirection);
+		DirectX::XMFLOAT4X4 FirstViewProj[CascadedShadows::MaxCascades];
+		for (std::uint32_t i = 0; i < Settings.CascadeCount; i++)
+			FirstViewProj[i] = Shadows.GetCascade(i).ViewProj;
+
+		// A fraction of the finest cascade's texel
+		float TexelSize = 2.0f * Shadows.GetCascade(0).SphereRadius / Settings.Resolution;
+		Shadows.Update(MakeCamera(0.3f * TexelSize, 5.0f, -20.0f + 0.2f * TexelSize), LightDirection);
+		for (std::uint32_t i = 0; i < Settings.CascadeCount; i++)
+			CHECK(SameMatrix(FirstViewProj[i], Shadows.GetCascade(i).ViewProj));
+	}
+
+	void TestRefitsStayOnTheTexelGrid()
+	{
+		// Without slack every move refits, the projections must still only move by whole texels
+		CascadedShadows Shadows;
+		CascadedShadows::Settings Settings;
+		Settings.RefitSlack = 0.0f;
+		Shadows.SetSettings(Settings);
+		const DirectX::XMFLOAT3 LightDirection(-0.57735f, -0.57735f, 0.57735f);
+		const DirectX::XMFLOAT3 WorldPoint(1.0f, 0.0f, 4.0f);
+
+		Shadows.Update(MakeCamera(0.0f, 5.0f, -20.0f), LightDirection);
+		DirectX::XMFLOAT4 First[CascadedShadows::MaxCascades];
+		float Radius[CascadedShadows::MaxCascades];
+		for (std::uint32_t i = 0; i < Settings.CascadeCount; i++)
+		{
+			First[i] = Transform(WorldPoint, Shadows.GetCascade(i).ShadowTransform);
+			Radius[i] = Shadows.GetCascade(i).SphereRadius;
+		}
+
+		for (int Step = 1; Step <= 8; Step++)
+		{
+			Shadows.Update(MakeCamera(0.37f * Step, 5.0f + 0.11f * Step, -20.0f + 0.23f * Step), LightDirection);
+			for (std::uint32_t i = 0; i < Settings.CascadeCount; i++)
+			{
+				const CascadedShadows::Cascade& Current = Shadows.GetCascade(i);
+				// Translation only moves the slice sphere, its radius and so the texel size stay the same
+				CHECK(Current.SphereRadius == Radius[i]);
+				DirectX::XMFLOAT4 Moved = Transform(WorldPoint, Current.ShadowTransform);
+				float TexelsX = (Moved.x - First[i].x) * Settings.Resolution;
+				float TexelsY = (Moved.y - First[i].y) * Settings.Resolution;
+				CHECK_NEAR(TexelsX, std::round(TexelsX), 0.02f);
+				CHECK_NEAR(TexelsY, std::round(TexelsY), 0.02f);
+			}
+		}
+	}
+
+	void TestLightChangeRefits()
+	{
+		CascadedShadows Shadows;
+		Shadows.SetSettings(CascadedShadows::Settings());
+		CascadedShadows::CameraFrustum Camera = MakeCamera(0.0f, 5.0f, -20.0f);
+		Shadows.Update(Camera, DirectX::XMFLOAT3(-0.57735f, -0.57735f, 0.57735f));
+		DirectX::XMFLOAT4X4 Before = Shadows.GetCascade(0).ViewProj;
+		Shadows.Update(Camera, DirectX::XMFLOAT3(0.0f, -0.70711f, 0.70711f));
+		CHECK(!SameMatrix(Before, Shadows.GetCascade(0).ViewProj));
+	}
+}
+
+int main()
+{
+	TestUtil::Run("SplitsAreMonotonic", TestSplitsAreMonotonic);
+	TestUtil::Run("SplitLambdaEndpoints", TestSplitLambdaEndpoints);
+	TestUtil::Run("SliceSphereContainsSlice", TestSliceSphereContainsSlice);
+	TestUtil::Run("CascadesContainTheirSlices", TestCascadesContainTheirSlices);
+	TestUtil::Run("SubTexelMotionKeepsProjection", TestSubTexelMotionKeepsProjection);
+	TestUtil::Run("RefitsStayOnTheTexelGrid", TestRefitsStayOnTheTexelGrid);
+	TestUtil::Run("LightChangeRefits", TestLightChangeRefits);
+	return TestUtil::Finish();
+}
@@ -0,0 +1,243 @@
+//***************************************************************************************
+// ClusterCullerTest.cpp
+//
+// Meshlet limits, reordering and bounds of MeshletBuilder, and ClusterCuller against a brute force
+// per triangle frustum and back face test
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "BenchUtil.h"
+#include "ClusterCuller.h"
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <set>
+
+namespace
+{
+	using Triangle = std::array<std::uint32_t, 3>;
+
+	const float Pi = 3.14159265f;
+
+	// A dense sphere and a strip of disconnected triangles, so meshlets also have to restart without neighbours
+	void MakeMesh(std::vector<Vertex>& aVertices, std::vector<std::uint32_t>& aIndices)
+	{
+		BenchUtil::AppendBumpySphere(32, 64, 1.0f, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), aVertices, aIndices);
+		for (std::uint32_t i = 0; i < 300; i++)
+		{
+			std::uint32_t Base = static_cast<std::uint32_t>(aVertices.size());
+			float X = -1.5f + 0.01f * i;
+			aVertices.emplace_back(X, 1.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f);
+			aVertices.emplace_back(X, 1.6f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f);
+			aVertices.emplace_back(X + 0.01f, 1.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f);
+			aIndices.insert(aIndices.end(), { Base, Base + 1, Base + 2 });
+		}
+	}
+
+	std::vector<Triangle> GetTriangles(const std::vector<std::uint32_t>& aIndices)
+	{
+		std::vector<Triangle> Triangles;
+		for (size_t i = 0; i + 3 <= aIndices.size(); i += 3)
+			Triangles.push_back({ aIndices[i], aIndices[i + 1], aIndices[i + 2] });
+		std::sort(Triangles.begin(), Triangles.end());
+		return Triangles;
+	}
+
+	void TestMeshletBuild()
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<std::uint32_t> Indices;
+		MakeMesh(Vertices, Indices);
+
+		std::vector<std::uint32_t> Reordered = Indices;
+		std::vector<Meshlet> Meshlets = MeshletBuilder::Build(Vertices.data(), Vertices.size(), Reordered.data(), Reordered.size());
+		CHECK(Meshlets.size() > 1);
+
+		// Same triangles with the same winding, only their order changed
+		CHECK(GetTriangles(Reordered) == GetTriangles(Indices));
+
+		std::uint32_t IndexEnd = 0;
+		for (const Meshlet& Cluster : Meshlets)
+		{
+			// Back to back over the whole index range
+			CHECK(Cluster.IndexStart == IndexEnd);
+			CHECK(Cluster.IndexCount > 0 && Cluster.IndexCount % 3 == 0);
+			IndexEnd = Cluster.IndexStart + Cluster.IndexCount;
+
+			std::set<std::uint32_t> ClusterVertices(Reordered.begin() + Cluster.IndexStart, Reordered.begin() + IndexEnd);
+			CHECK(Cluster.VertexCount == ClusterVertices.size());
+			CHECK(Cluster.VertexCount <= MeshletBuilder::MaxVertices);
+			CHECK(Cluster.IndexCount / 3 <= MeshletBuilder::MaxTriangles);
+
+			for (std::uint32_t Index : ClusterVertices)
+			{
+				const DirectX::XMFLOAT3& P = Vertices[Index].Position;
+				float Dx = P.x - Cluster.Sphere.x, Dy = P.y - Cluster.Sphere.y, Dz = P.z - Cluster.Sphere.z;
+				CHECK(std::sqrt(Dx * Dx + Dy * Dy + Dz * Dz) <= Cluster.Sphere.w * (1.0f + 1e-5f) + 1e-6f);
+			}
+		}
+		CHECK(IndexEnd == Reordered.size());
+
+		// Smaller limits are respected too
+		Reordered = Indices;
+		Meshlets = MeshletBuilder::Build(Vertices.data(), Vertices.size(), Reordered.data(), Reordered.size(), 16, 20);
+		CHECK(GetTriangles(Reordered) == GetTriangles(Indices));
+		for (const Meshlet& Cluster : Meshlets)
+			CHECK(Cluster.VertexCount <= 16 && Cluster.IndexCount / 3 <= 20);
+	}
+
+	// Row vector world matrix: scale, rotation about Y, then translation
+	DirectX::XMFLOAT4X4 MakeWorld(const DirectX::XMFLOAT3& aScale, float aAngle, const DirectX::XMFLOAT3& aTranslation)
+	{
+		float C = std::cos(aAngle), S = std::sin(aAngle);
+		return DirectX::XMFLOAT4X4(
+			aScale.x * C, 0.0f, -aScale.x * S, 0.0f,
+			0.0f, aScale.y, 0.0f, 0.0f,
+			aScale.z * S, 0.0f, aScale.z * C, 0.0f,
+			aTranslation.x, aTranslation.y, aTranslation.z, 1.0f);
+	}
+
+	DirectX::XMFLOAT3 Transform(const DirectX::XMFLOAT3& aP, const DirectX::XMFLOAT4X4& aM)
+	{
+		return DirectX::XMFLOAT3(
+			aP.x * aM._11 + aP.y * aM._21 + aP.z * aM._31 + aM._41,
+			aP.x * aM._12 + aP.y * aM._22 + aP.z * aM._32 + aM._42,
+			aP.x * aM._13 + aP.y * aM._23 + aP.z * aM._33 + aM._43);
+	}
+
+	// A triangle is drawn when it faces the eye, clockwise as seen on screen, and no clip plane has all three
+	// vertices outside. Nearly edge on triangles are left to the culler, either answer is right for them.
+	bool IsTriangleDrawn(const DirectX::XMFLOAT3 aP[3], const DirectX::XMFLOAT4X4& aViewProj, const DirectX::XMFLOAT3& aEye)
+	{
+		DirectX::XMFLOAT3 E1(aP[1].x - aP[0].x, aP[1].y - aP[0].y, aP[1].z - aP[0].z);
+		DirectX::XMFLOAT3 E2(aP[2].x - aP[0].x, aP[2].y - aP[0].y, aP[2].z - aP[0].z);
+		DirectX::XMFLOAT3 N(E1.y * E2.z - E1.z * E2.y, E1.z * E2.x - E1.x * E2.z, E1.x * E2.y - E1.y * E2.x);
+		DirectX::XMFLOAT3 D(aP[0].x - aEye.x, aP[0].y - aEye.y, aP[0].z - aEye.z);
+		float NLength = std::sqrt(N.x * N.x + N.y * N.y + N.z * N.z);
+		float DLength = std::sqrt(D.x * D.x + D.y * D.y + D.z * D.z);
+		if (!(N.x * D.x + N.y * D.y + N.z * D.z < -1e-4f * NLength * DLength))
+			return false;
+
+		// Outside flags of -x, +x, -y, +y, near, far per vertex
+		int Outside = 0x3F;
+		for (int v = 0; v < 3; v++)
+		{
+			const DirectX::XMFLOAT4X4& M = aViewProj;
+			float X = aP[v].x * M._11 + aP[v].y * M._21 + aP[v].z * M._31 + M._41;
+			float Y = aP[v].x * M._12 + aP[v].y * M._22 + aP[v].z * M._32 + M._42;
+			float Z = aP[v].x * M._13 + aP[v].y * M._23 + aP[v].z * M._33 + M._43;
+			float W = aP[v].x * M._14 + aP[v].y * M._24 + aP[v].z * M._34 + M._44;
+			Outside &= int(X < -W) | int(X > W) << 1 | int(Y < -W) << 2 | int(Y > W) << 3 | int(Z < 0.0f) << 4 | int(Z > W) << 5;
+		}
+		return Outside == 0;
+	}
+
+	// Culls aMeshlets in chunks of aChunkSize, so the scalar tail of the last chunk is exercised, and checks
+	// that every meshlet with a drawn triangle is in the returned ranges
+	void CheckChunks(ClusterCuller& aCuller, const std::vector<Meshlet>& aMeshlets, const std::vector<std::uint8_t>& aDrawn,
+		const DirectX::XMFLOAT4X4& aWorld, size_t aChunkSize, size_t& aOutCulled)
+	{
+		const std::uint32_t IndexBase = 999;
+		for (size_t First = 0; First < aMeshlets.size(); First += aChunkSize)
+		{
+			size_t Count = std::min(aChunkSize, aMeshlets.size() - First);
+			std::vector<ClusterCuller::IndexRange> Ranges;
+			size_t Visible = aCuller.Cull(aMeshlets.data() + First, Count, aWorld, IndexBase, Ranges);
+
+			size_t VisibleIndices = 0, RangeIndices = 0;
+			for (size_t i = First; i < First + Count; i++)
+			{
+				const Meshlet& Cluster = aMeshlets[i];
+				bool bInRanges = std::any_of(Ranges.begin(), Ranges.end(), [&](const ClusterCuller::IndexRange& Range)
+				{
+					return Range.IndexStart <= IndexBase + Cluster.IndexStart
+						&& IndexBase + Cluster.IndexStart + Cluster.IndexCount <= Range.IndexStart + Range.IndexCount;
+				});
+				CHECK(bInRanges || !aDrawn[i]);
+				VisibleIndices += bInRanges ? Cluster.IndexCount : 0;
+				aOutCulled += !bInRanges;
+			}
+			for (const ClusterCuller::IndexRange& Range : Ranges)
+				RangeIndices += Range.IndexCount;
+			// Ranges hold the visible meshlets and nothing else
+			CHECK(RangeIndices == VisibleIndices);
+			CHECK(Visible <= Count);
+		}
+	}
+
+	void TestCullKeepsDrawnMeshlets()
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<std::uint32_t> Indices;
+		BenchUtil::AppendBumpySphere(32, 64, 1.0f, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), Vertices, Indices);
+		std::vector<Meshlet> Meshlets = MeshletBuilder::Build(Vertices.data(), Vertices.size(), Indices.data(), Indices.size());
+		CHECK(Meshlets.size() > 8);
+
+		struct WorldCase
+		{
+			const char* Name;
+			DirectX::XMFLOAT4X4 World;
+			bool bTestsCones;
+		};
+		const DirectX::XMFLOAT3 Translation(1.0f, -0.5f, 2.0f);
+		const WorldCase Worlds[] =
+		{
+			{ "identity", MakeWorld(DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f), 0.0f, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f)), true },
+			{ "rotated uniform scale", MakeWorld(DirectX::XMFLOAT3(2.0f, 2.0f, 2.0f), 0.7f, Translation), true },
+			{ "mirrored", MakeWorld(DirectX::XMFLOAT3(-1.5f, 1.5f, 1.5f), 0.7f, Translation), false },
+			{ "non uniform scale", MakeWorld(DirectX::XMFLOAT3(1.0f, 2.5f, 0.6f), 0.7f, Translation), false },
+		};
+
+		for (const WorldCase& Case : Worlds)
+		{
+			std::vector<Vertex> WorldVertices = Vertices;
+			for (Vertex& V : WorldVertices)
+				V.Position = Transform(V.Position, Case.World);
+
+			ClusterCuller Culler;
+			size_t Culled = 0;
+			size_t FailuresBefore = size_t(TestUtil::Failures);
+			for (int View = 0; View < 24; View++)
+			{
+				// Orbits at three distances, some views looking past the mesh so the frustum cuts through it
+				float Angle = 2.0f * Pi * View / 24.0f;
+				float Distance = View % 3 == 0 ? 2.5f : (View % 3 == 1 ? 6.0f : 30.0f);
+				DirectX::XMFLOAT3 Direction(std::cos(Angle), 0.4f * std::sin(2.0f * Angle), std::sin(Angle));
+				DirectX::XMFLOAT3 Eye(Translation.x + Distance * Direction.x, Translation.y + Distance * Direction.y,
+					Translation.z + Distance * Direction.z);
+				float LookAside = View % 2 == 0 ? 0.0f : 1.5f;
+				DirectX::XMFLOAT3 Target(Translation.x + LookAside * Direction.z, Translation.y, Translation.z - LookAside * Direction.x);
+				DirectX::XMFLOAT4X4 ViewProj = BenchUtil::LookAtPerspective(Eye, Target, 0.25f * Pi, 16.0f / 9.0f, 0.05f, 100.0f);
+				Culler.SetView(ViewProj, Eye, 0.0f);
+
+				std::vector<std::uint8_t> Drawn(Meshlets.size(), 0);
+				for (size_t i = 0; i < Meshlets.size(); i++)
+				{
+					for (std::uint32_t k = 0; k < Meshlets[i].IndexCount && !Drawn[i]; k += 3)
+					{
+						const std::uint32_t* Tri = &Indices[Meshlets[i].IndexStart + k];
+						DirectX::XMFLOAT3 P[3] = { WorldVertices[Tri[0]].Position, WorldVertices[Tri[1]].Position, WorldVertices[Tri[2]].Position };
+						Drawn[i] = IsTriangleDrawn(P, ViewProj, Eye);
+					}
+				}
+				for (size_t ChunkSize : { size_t(1), size_t(2), size_t(3), size_t(6), Meshlets.size() - 1, Meshlets.size() })
+					CheckChunks(Culler, Meshlets, Drawn, Case.World, ChunkSize, Culled);
+			}
+			if (size_t(TestUtil::Failures) != FailuresBefore)
+				std::printf("    culled drawn meshlets with the %s world\n", Case.Name);
+
+			// The cone test runs only where cones survive the world transform, and then actually culls
+			CHECK(Culled > 0);
+			CHECK((Culler.GetBackfaceCulledCount() > 0) == Case.bTestsCones);
+		}
+	}
+}
+
+int main()
+{
+	TestUtil::Run("MeshletBuild", TestMeshletBuild);
+	TestUtil::Run("CullKeepsDrawnMeshlets", TestCullKeepsDrawnMeshlets);
+	return TestUtil::Finish();
+}
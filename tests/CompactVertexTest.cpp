@@ -0,0 +1,175 @@
+//***************************************************************************************
+// CompactVertexTest.cpp
+//
+// Encode and decode round trip of CompactVertex: quantized positions, half UVs and octahedral normals
+// and tangents
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "CompactVertex.h"
+#include <algorithm>
+#include <random>
+
+namespace
+{
+	float Dot(const DirectX::XMFLOAT3& aA, const DirectX::XMFLOAT3& aB)
+	{
+		return aA.x * aB.x + aA.y * aB.y + aA.z * aB.z;
+	}
+
+	DirectX::XMFLOAT3 Cross(const DirectX::XMFLOAT3& aA, const DirectX::XMFLOAT3& aB)
+	{
+		return { aA.y * aB.z - aA.z * aB.y, aA.z * aB.x - aA.x * aB.z, aA.x * aB.y - aA.y * aB.x };
+	}
+
+	DirectX::XMFLOAT3 Normalize(const DirectX::XMFLOAT3& aV)
+	{
+		float InvLength = 1.0f / std::sqrt(Dot(aV, aV));
+		return { aV.x * InvLength, aV.y * InvLength, aV.z * InvLength };
+	}
+
+	DirectX::XMFLOAT3 RandomDirection(std::mt19937& aRng)
+	{
+		std::normal_distribution<float> Gaussian;
+		return Normalize({ Gaussian(aRng), Gaussian(aRng), Gaussian(aRng) });
+	}
+
+	Vertex MakeVertex(const DirectX::XMFLOAT3& aPosition, const DirectX::XMFLOAT3& aNormal, const DirectX::XMFLOAT3& aTangent)
+	{
+		Vertex Result;
+		Result.Position = aPosition;
+		Result.TexCoord = { 0.0f, 0.0f };
+		Result.Normal = aNormal;
+		Result.Tangent = aTangent;
+		return Result;
+	}
+
+	void TestPositionsInSubmeshBounds()
+	{
+		// An off centre box, the largest half extent is the scale of all three axes
+		DirectX::BoundingBox Bounds(DirectX::XMFLOAT3(10.0f, -3.0f, 0.5f), DirectX::XMFLOAT3(4.0f, 0.5f, 2.0f));
+		PositionQuantization Quantization = MakePositionQuantization(Bounds);
+		CHECK(Quantization.Scale == 4.0f);
+		CHECK(Quantization.Offset.x == 10.0f && Quantization.Offset.y == -3.0f && Quantization.Offset.z == 0.5f);
+
+		// Rounding to the nearest step is off by half a step at most
+		const float MaxError = 0.5f * Quantization.Scale / 32767.0f + 1e-5f;
+		std::mt19937 Rng(3);
+		std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+		for (int i = 0; i < 10000; i++)
+		{
+			DirectX::XMFLOAT3 P(Bounds.Center.x + Bounds.Extents.x * Unit(Rng), Bounds.Center.y + Bounds.Extents.y * Unit(Rng),
+				Bounds.Center.z + Bounds.Extents.z * Unit(Rng));
+			Vertex Decoded = DecodeCompactVertex(EncodeCompactVertex(MakeVertex(P, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }), Quantization), Quantization);
+			CHECK_NEAR(Decoded.Position.x, P.x, MaxError);
+			CHECK_NEAR(Decoded.Position.y, P.y, MaxError);
+			CHECK_NEAR(Decoded.Position.z, P.z, MaxError);
+		}
+
+		// The box faces along the largest extent use the full snorm range
+		CompactVertex Corner = EncodeCompactVertex(MakeVertex({ 14.0f, -3.0f, 0.5f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }), Quantization);
+		CHECK(Corner.Position[0] == 32767 && Corner.Position[1] == 0 && Corner.Position[2] == 0 && Corner.Position[3] == 0);
+		Corner = EncodeCompactVertex(MakeVertex({ 6.0f, -3.0f, 0.5f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }), Quantization);
+		CHECK(Corner.Position[0] == -32767);
+
+		// Outside the bounds clamps to the box instead of wrapping
+		CompactVertex Outside = EncodeCompactVertex(MakeVertex({ 20.0f, -30.0f, 0.5f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }), Quantization);
+		CHECK(Outside.Position[0] == 32767 && Outside.Position[1] == -32767);
+
+		// A submesh collapsed to a point keeps an invertible scale and decodes exactly
+		DirectX::BoundingBox Point(DirectX::XMFLOAT3(1.0f, 2.0f, 3.0f), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+		PositionQuantization PointQuantization = MakePositionQuantization(Point);
+		CHECK(PointQuantization.Scale == 1.0f);
+		Vertex Decoded = DecodeCompactVertex(EncodeCompactVertex(MakeVertex(Point.Center, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }),
+			PointQuantization), PointQuantization);
+		CHECK(Decoded.Position.x == 1.0f && Decoded.Position.y == 2.0f && Decoded.Position.z == 3.0f);
+	}
+
+	void TestHalfTexCoords()
+	{
+		PositionQuantization Quantization;
+		Vertex Source = MakeVertex({ 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f });
+
+		// Values with few mantissa bits are exact
+		for (float Value : { 0.0f, 0.5f, 1.0f, -3.25f, 1024.0f })
+		{
+			Source.TexCoord = { Value, -Value };
+			Vertex Decoded = DecodeCompactVertex(EncodeCompactVertex(Source, Quantization), Quantization);
+			CHECK(Decoded.TexCoord.x == Value && Decoded.TexCoord.y == -Value);
+		}
+
+		// Otherwise within half a unit in the last place of the 11 bit significand, tiled UVs included
+		std::mt19937 Rng(5);
+		std::uniform_real_distribution<float> Tiled(-8.0f, 8.0f);
+		for (int i = 0; i < 10000; i++)
+		{
+			Source.TexCoord = { Tiled(Rng), Tiled(Rng) * 0.01f };
+			Vertex Decoded = DecodeCompactVertex(EncodeCompactVertex(Source, Quantization), Quantization);
+			CHECK(std::fabs(Decoded.TexCoord.x - Source.TexCoord.x) <= std::fabs(Source.TexCoord.x) * 0.00049f + 1e-7f);
+			CHECK(std::fabs(Decoded.TexCoord.y - Source.TexCoord.y) <= std::fabs(Source.TexCoord.y) * 0.00049f + 1e-7f);
+		}
+	}
+
+	void TestOctahedralNormalsAndTangents()
+	{
+		PositionQuantization Quantization;
+		// 16 bit octahedral directions are within 0.04 degrees
+		const float MinCos = std::cos(0.05f * 3.14159265f / 180.0f);
+		std::vector<DirectX::XMFLOAT3> Directions = {
+			{ 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f },
+			{ 0.0f, 0.0f, -1.0f }, Normalize({ 1.0f, -1.0f, 0.0f }), Normalize({ -1.0f, 1.0f, -0.001f }), Normalize({ 1.0f, 1.0f, -1.0f }) };
+		std::mt19937 Rng(11);
+		for (int i = 0; i < 10000; i++)
+			Directions.push_back(RandomDirection(Rng));
+
+		float WorstNormal = 1.0f, WorstTangent = 1.0f;
+		for (size_t i = 0; i < Directions.size(); i++)
+		{
+			const DirectX::XMFLOAT3& Normal = Directions[i];
+			const DirectX::XMFLOAT3& Tangent = Directions[Directions.size() - 1 - i];
+			Vertex Decoded = DecodeCompactVertex(EncodeCompactVertex(MakeVertex({ 0.0f, 0.0f, 0.0f }, Normal, Tangent), Quantization), Quantization);
+			WorstNormal = std::min(WorstNormal, Dot(Decoded.Normal, Normal));
+			WorstTangent = std::min(WorstTangent, Dot(Decoded.Tangent, Tangent));
+			CHECK_NEAR(Dot(Decoded.Normal, Decoded.Normal), 1.0f, 1e-5f);
+		}
+		CHECK(WorstNormal >= MinCos);
+		CHECK(WorstTangent >= MinCos);
+
+		// A zero vector decodes to +Z instead of NaN
+		Vertex Zero = DecodeCompactVertex(EncodeCompactVertex(MakeVertex({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }),
+			Quantization), Quantization);
+		CHECK(Zero.Normal.x == 0.0f && Zero.Normal.y == 0.0f && Zero.Normal.z == 1.0f);
+	}
+
+	// Vertex stores no bitangent sign, the shaders rebuild the bitangent as cross(N, T). Its sign, the handedness
+	// of mirrored UVs, therefore has to survive the encoding of N and T, on both sides of the octahedral fold.
+	void TestBitangentSign()
+	{
+		PositionQuantization Quantization;
+		std::mt19937 Rng(13);
+		int Flipped = 0;
+		for (int i = 0; i < 20000; i++)
+		{
+			DirectX::XMFLOAT3 Normal = RandomDirection(Rng);
+			DirectX::XMFLOAT3 Tangent = Normalize(Cross(Normal, RandomDirection(Rng)));
+			// Every other frame has mirrored UVs, its tangent points the other way
+			if (i % 2)
+				Tangent = { -Tangent.x, -Tangent.y, -Tangent.z };
+			DirectX::XMFLOAT3 Bitangent = Cross(Normal, Tangent);
+
+			Vertex Decoded = DecodeCompactVertex(EncodeCompactVertex(MakeVertex({ 0.0f, 0.0f, 0.0f }, Normal, Tangent), Quantization), Quantization);
+			DirectX::XMFLOAT3 DecodedBitangent = Cross(Decoded.Normal, Decoded.Tangent);
+			Flipped += Dot(DecodedBitangent, Bitangent) <= 0.999f;
+		}
+		CHECK(Flipped == 0);
+	}
+}
+
+int main()
+{
+	TestUtil::Run("PositionsInSubmeshBounds", TestPositionsInSubmeshBounds);
+	TestUtil::Run("HalfTexCoords", TestHalfTexCoords);
+	TestUtil::Run("OctahedralNormalsAndTangents", TestOctahedralNormalsAndTangents);
+	TestUtil::Run("BitangentSign", TestBitangentSign);
+	return TestUtil::Finish();
+}
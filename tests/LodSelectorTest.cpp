@@ -0,0 +1,215 @@
+//***************************************************************************************
+// LodSelectorTest.cpp
+//
+// Level selection of LodSelector: thresholds, hysteresis, bias, an eye inside the bounds and item removal
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "LodSelector.h"
+#include <string>
+
+namespace
+{
+	const DirectX::XMFLOAT4X4 Identity(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	// Level l of item i starts its indices at l * 100 + i, so the swapped arguments tell both apart
+	std::vector<SceneStore::DrawArgs> MakeLevels(std::uint32_t aItem, std::uint32_t aLevelCount)
+	{
+		std::vector<SceneStore::DrawArgs> Levels(aLevelCount);
+		for (std::uint32_t Level = 0; Level < aLevelCount; Level++)
+		{
+			Levels[Level].GeometryId = 1;
+			Levels[Level].IndexCount = 3;
+			Levels[Level].IndexStartLocation = Level * 100 + aItem;
+		}
+		return Levels;
+	}
+
+	// A bounding sphere of radius 1 around aCenter
+	SceneStore::ItemId AddItem(SceneStore& aScene, LodSelector& aLods, LodSelector::GroupId aGroup, const DirectX::XMFLOAT3& aCenter)
+	{
+		std::uint32_t Index = static_cast<std::uint32_t>(aScene.GetItemCount());
+		std::vector<SceneStore::DrawArgs> Levels = MakeLevels(Index, aLods.GetLevelCount(aGroup));
+		SceneStore::ItemId Id = aScene.AddItem("Item" + std::to_string(Index), 0, Identity,
+			DirectX::BoundingBox(aCenter, DirectX::XMFLOAT3(0.6f, 0.8f, 0.0f)), Levels[0], 0);
+		aLods.AddItem(Id, aGroup, Levels);
+		return Id;
+	}
+
+	std::uint32_t GetDrawnLevel(const SceneStore& aScene, SceneStore::ItemId aId)
+	{
+		return aScene.GetDrawArgs(aId).IndexStartLocation / 100;
+	}
+
+	// With a projection scale of 1 the size of a unit sphere is 1 / distance
+	size_t SelectAt(SceneStore& aScene, LodSelector& aLods, float aDistance, float aProjectionScale = 1.0f)
+	{
+		return aLods.Select(aScene, DirectX::XMFLOAT3(0.0f, 0.0f, -aDistance), aProjectionScale);
+	}
+
+	void TestThresholds()
+	{
+		LodSelector Lods;
+		LodSelector::GroupId Group = Lods.AddGroup({ 0.5f, 0.25f });
+		CHECK(Lods.GetLevelCount(Group) == 3);
+		CHECK(Lods.GetLevelForSize(Group, 2.0f) == 0);
+		CHECK(Lods.GetLevelForSize(Group, 0.5f) == 0);
+		CHECK(Lods.GetLevelForSize(Group, 0.49f) == 1);
+		CHECK(Lods.GetLevelForSize(Group, 0.25f) == 1);
+		CHECK(Lods.GetLevelForSize(Group, 0.01f) == 2);
+
+		SceneStore Scene(1, 3);
+		Lods.SetHysteresis(0.0f);
+		SceneStore::ItemId Id = AddItem(Scene, Lods, Group, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+		CHECK(Lods.GetLevel(Id) == 0);
+		CHECK(SelectAt(Scene, Lods, 1.5f) == 0);
+		CHECK(Lods.GetChangedItems().empty());
+
+		CHECK(SelectAt(Scene, Lods, 3.0f) == 1);
+		CHECK(Lods.GetChangedItems().size() == 1 && Lods.GetChangedItems()[0] == Id);
+		CHECK(Lods.GetLevel(Id) == 1 && GetDrawnLevel(Scene, Id) == 1);
+
+		// Several levels are stepped in one selection
+		CHECK(SelectAt(Scene, Lods, 20.0f) == 1);
+		CHECK(Lods.GetLevel(Id) == 2 && GetDrawnLevel(Scene, Id) == 2);
+		CHECK(SelectAt(Scene, Lods, 1.0f) == 1);
+		CHECK(Lods.GetLevel(Id) == 0 && GetDrawnLevel(Scene, Id) == 0);
+
+		// A narrower field of view, a larger projection scale, keeps the finer level further away
+		SelectAt(Scene, Lods, 3.0f, 2.0f);
+		CHECK(Lods.GetLevel(Id) == 0);
+		SelectAt(Scene, Lods, 3.0f, 1.0f);
+		CHECK(Lods.GetLevel(Id) == 1);
+
+		// Items without a group are at level 0
+		CHECK(Lods.GetLevel(Id + 1) == 0);
+	}
+
+	void TestHysteresis()
+	{
+		LodSelector Lods;
+		LodSelector::GroupId Group = Lods.AddGroup({ 0.5f, 0.25f });
+		CHECK(Lods.GetHysteresis() == 0.1f);
+		SceneStore Scene(1, 3);
+		SceneStore::ItemId Id = AddItem(Scene, Lods, Group, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+
+		// Past the threshold at 2 but inside the band, coarser only below 0.45, a distance of 2.22
+		SelectAt(Scene, Lods, 2.1f);
+		CHECK(Lods.GetLevelForSize(Group, 1.0f / 2.1f) == 1);
+		CHECK(Lods.GetLevel(Id) == 0);
+		SelectAt(Scene, Lods, 2.3f);
+		CHECK(Lods.GetLevel(Id) == 1);
+
+		// Back over the threshold but inside the band, finer only from 0.55, a distance of 1.82
+		SelectAt(Scene, Lods, 1.9f);
+		CHECK(Lods.GetLevel(Id) == 1);
+		SelectAt(Scene, Lods, 1.7f);
+		CHECK(Lods.GetLevel(Id) == 0);
+
+		// Moving back and forth across the threshold inside the band never switches
+		size_t Switches = 0;
+		for (int i = 0; i < 20; i++)
+			Switches += SelectAt(Scene, Lods, i % 2 ? 1.9f : 2.1f);
+		CHECK(Switches == 0);
+
+		// Without hysteresis it switches every time
+		Lods.SetHysteresis(0.0f);
+		for (int i = 0; i < 20; i++)
+			Switches += SelectAt(Scene, Lods, i % 2 ? 1.9f : 2.1f);
+		CHECK(Switches == 20);
+	}
+
+	void TestBias()
+	{
+		LodSelector Lods;
+		LodSelector::GroupId Group = Lods.AddGroup({ 0.5f, 0.25f });
+		SceneStore Scene(1, 3);
+		SceneStore::ItemId Id = AddItem(Scene, Lods, Group, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+
+		// A bias of 1 halves every size: 0.67 becomes 0.33
+		SelectAt(Scene, Lods, 1.5f);
+		CHECK(Lods.GetLevel(Id) == 0);
+		Lods.SetBias(1.0f);
+		SelectAt(Scene, Lods, 1.5f);
+		CHECK(Lods.GetLevel(Id) == 1);
+
+		// A negative bias favours finer levels: 0.33 becomes 0.67
+		Lods.SetBias(0.0f);
+		SelectAt(Scene, Lods, 3.0f);
+		CHECK(Lods.GetLevel(Id) == 1);
+		Lods.SetBias(-1.0f);
+		SelectAt(Scene, Lods, 3.0f);
+		CHECK(Lods.GetLevel(Id) == 0);
+	}
+
+	void TestEyeInsideBounds()
+	{
+		LodSelector Lods;
+		LodSelector::GroupId Group = Lods.AddGroup({ 0.5f, 0.25f });
+		SceneStore Scene(1, 3);
+		SceneStore::ItemId Id = AddItem(Scene, Lods, Group, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+		SelectAt(Scene, Lods, 50.0f);
+		CHECK(Lods.GetLevel(Id) == 2);
+
+		// Inside the sphere, at its centre too, the item covers the view whatever the bias
+		Lods.SetBias(8.0f);
+		SelectAt(Scene, Lods, 0.9f);
+		CHECK(Lods.GetLevel(Id) == 0 && GetDrawnLevel(Scene, Id) == 0);
+		Lods.Select(Scene, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), 1.0f);
+		CHECK(Lods.GetLevel(Id) == 0);
+	}
+
+	void TestRemoveItem()
+	{
+		LodSelector Lods;
+		LodSelector::GroupId Two = Lods.AddGroup({ 0.5f });
+		LodSelector::GroupId Four = Lods.AddGroup({ 0.5f, 0.25f, 0.125f });
+		SceneStore Scene(1, 3);
+		Lods.SetHysteresis(0.0f);
+		// Items along the view axis at distances 2.5, 3.0 and 3.5 from the eye at the origin
+		SceneStore::ItemId A = AddItem(Scene, Lods, Four, DirectX::XMFLOAT3(0.0f, 0.0f, 2.5f));
+		SceneStore::ItemId B = AddItem(Scene, Lods, Two, DirectX::XMFLOAT3(0.0f, 0.0f, 3.0f));
+		SceneStore::ItemId C = AddItem(Scene, Lods, Four, DirectX::XMFLOAT3(0.0f, 0.0f, 3.5f));
+		CHECK(Lods.Select(Scene, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), 1.0f) == 3);
+		CHECK(Lods.GetItemCount() == 3);
+
+		// The first item goes, the others keep their own draw arguments when they switch again
+		Lods.RemoveItem(A);
+		CHECK(Lods.GetItemCount() == 2);
+		CHECK(Lods.GetLevel(A) == 0);
+		CHECK(GetDrawnLevel(Scene, A) == 1);
+		Lods.RemoveItem(A);
+		CHECK(Lods.GetItemCount() == 2);
+
+		CHECK(Lods.Select(Scene, DirectX::XMFLOAT3(0.0f, 0.0f, -10.0f), 1.0f) == 1);
+		CHECK(GetDrawnLevel(Scene, A) == 1);
+		CHECK(Scene.GetDrawArgs(B).IndexStartLocation == 100 + B);
+		CHECK(Scene.GetDrawArgs(C).IndexStartLocation == 300 + C);
+		CHECK(Lods.Select(Scene, DirectX::XMFLOAT3(0.0f, 0.0f, 2.0f), 1.0f) == 2);
+		CHECK(Scene.GetDrawArgs(B).IndexStartLocation == B);
+		CHECK(Scene.GetDrawArgs(C).IndexStartLocation == C);
+
+		// Removed items are dropped from the changed items and can be added again
+		Lods.Select(Scene, DirectX::XMFLOAT3(0.0f, 0.0f, -10.0f), 1.0f);
+		Lods.RemoveItem(C);
+		CHECK(Lods.GetChangedItems().size() == 1 && Lods.GetChangedItems()[0] == B);
+		Lods.AddItem(A, Two, MakeLevels(A, 2));
+		CHECK(Lods.GetLevel(A) == 0 && Lods.GetItemCount() == 2);
+		Lods.Select(Scene, DirectX::XMFLOAT3(0.0f, 0.0f, -10.0f), 1.0f);
+		CHECK(Lods.GetLevel(A) == 1 && Scene.GetDrawArgs(A).IndexStartLocation == 100 + A);
+	}
+}
+
+int main()
+{
+	TestUtil::Run("Thresholds", TestThresholds);
+	TestUtil::Run("Hysteresis", TestHysteresis);
+	TestUtil::Run("Bias", TestBias);
+	TestUtil::Run("EyeInsideBounds", TestEyeInsideBounds);
+	TestUtil::Run("RemoveItem", TestRemoveItem);
+	return TestUtil::Finish();
+}
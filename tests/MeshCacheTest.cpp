@@ -0,0 +1,209 @@
+//***************************************************************************************
+// MeshCacheTest.cpp
+//
+// Write and Open round trip of MeshCache files, and the files Open has to refuse
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "MeshCache.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+	const MeshCache::Key TestKey = { 0x1234, 0x5678 };
+
+	std::string GetTempPath(const std::string& aName)
+	{
+		return (std::filesystem::temp_directory_path() / "MeshCacheTest" / aName).string();
+	}
+
+	std::vector<char> ReadFile(const std::string& aPath)
+	{
+		std::ifstream In(aPath, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(In), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const std::string& aPath, const std::vector<char>& aBytes)
+	{
+		std::ofstream Out(aPath, std::ios::binary | std::ios::trunc);
+		Out.write(aBytes.data(), static_cast<std::streamsize>(aBytes.size()));
+	}
+
+	// Two submeshes behind each other in the vertex array, the second one unnamed and with meshlets
+	ModelImporter::ModelData MakeModel(bool b32BitIndices)
+	{
+		ModelImporter::ModelData Model;
+		Model.Name = "Test";
+		Model.Use32BitIndices = b32BitIndices;
+		for (int v = 0; v < 7; v++)
+			Model.Vertices.emplace_back(float(v), float(v * 2), float(v * 3), 0.25f * v, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+		std::vector<std::uint32_t> Indices = { 0, 1, 2, 0, 2, 3, 0, 1, 2 };
+		if (b32BitIndices)
+			Model.Indices32 = Indices;
+		else
+			Model.Indices16.assign(Indices.begin(), Indices.end());
+
+		Model.Submeshes.push_back({ "Body", 6, 0, 0, 1, {} });
+		Model.Submeshes.push_back({ "", 3, 6, 4, 0, {} });
+		Meshlet Cluster;
+		Cluster.Sphere = { 5.0f, 10.0f, 15.0f, 2.0f };
+		Cluster.Cone = { 0.0f, 1.0f, 0.0f, 0.5f };
+		Cluster.IndexCount = 3;
+		Cluster.VertexCount = 3;
+		Model.Submeshes[1].Meshlets.push_back(Cluster);
+
+		Model.Materials.push_back({ "Paint", DirectX::XMFLOAT4(1.0f, 0.5f, 0.25f, 1.0f), "paint.dds", "", 0.4f, 0.0f });
+		Model.Materials.push_back({ "Metal", DirectX::XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f), "", "metal_n.dds", 0.2f, 1.0f });
+		return Model;
+	}
+
+	const std::vector<DirectX::BoundingBox> TestBounds = {
+		DirectX::BoundingBox(DirectX::XMFLOAT3(1.5f, 3.0f, 4.5f), DirectX::XMFLOAT3(1.5f, 3.0f, 4.5f)),
+		DirectX::BoundingBox(DirectX::XMFLOAT3(5.0f, 10.0f, 15.0f), DirectX::XMFLOAT3(1.0f, 2.0f, 3.0f)) };
+
+	void CheckRoundTrip(bool b32BitIndices)
+	{
+		const std::string Path = GetTempPath(b32BitIndices ? "RoundTrip32.dxmesh" : "RoundTrip16.dxmesh");
+		ModelImporter::ModelData Model = MakeModel(b32BitIndices);
+		CHECK(MeshCache::Write(Path, Model, TestBounds, TestKey));
+		CHECK(!std::filesystem::exists(Path + ".tmp"));
+
+		MeshCache::CachedMesh Mesh;
+		CHECK(Mesh.Open(Path, TestKey));
+		const ModelImporter::MeshView& View = Mesh.GetMeshView();
+		CHECK(View.VertexCount == Model.Vertices.size());
+		CHECK(std::memcmp(View.Vertices, Model.Vertices.data(), Model.Vertices.size() * sizeof(Vertex)) == 0);
+		CHECK(View.Use32BitIndices == b32BitIndices);
+		CHECK(View.IndexCount == 9);
+		const void* Indices = b32BitIndices ? static_cast<const void*>(Model.Indices32.data()) : Model.Indices16.data();
+		CHECK(std::memcmp(View.Indices, Indices, 9 * (b32BitIndices ? 4 : 2)) == 0);
+
+		const auto& Submeshes = Mesh.GetSubmeshes();
+		CHECK(Submeshes.size() == 2 && Mesh.GetSubmeshBounds().size() == 2);
+		for (size_t i = 0; i < Submeshes.size() && i < Model.Submeshes.size(); i++)
+		{
+			CHECK(Submeshes[i].Name == ModelImporter::GetSubmeshName(Model, i));
+			CHECK(Submeshes[i].IndexCount == Model.Submeshes[i].IndexCount);
+			CHECK(Submeshes[i].StartIndexLocation == Model.Submeshes[i].StartIndexLocation);
+			CHECK(Submeshes[i].BaseVertexLocation == Model.Submeshes[i].BaseVertexLocation);
+			CHECK(Submeshes[i].MaterialIndex == Model.Submeshes[i].MaterialIndex);
+			CHECK(Submeshes[i].Meshlets.size() == Model.Submeshes[i].Meshlets.size());
+			CHECK(std::memcmp(Submeshes[i].Meshlets.data(), Model.Submeshes[i].Meshlets.data(), Submeshes[i].Meshlets.size() * sizeof(Meshlet)) == 0);
+			const DirectX::BoundingBox& Bounds = Mesh.GetSubmeshBounds()[i];
+			CHECK(std::memcmp(&Bounds.Center, &TestBounds[i].Center, sizeof(DirectX::XMFLOAT3)) == 0);
+			CHECK(std::memcmp(&Bounds.Extents, &TestBounds[i].Extents, sizeof(DirectX::XMFLOAT3)) == 0);
+		}
+		CHECK(Submeshes.size() == 2 && Submeshes[1].Name == "Submesh_1");
+
+		const auto& Materials = Mesh.GetMaterials();
+		CHECK(Materials.size() == 2);
+		for (size_t i = 0; i < Materials.size() && i < Model.Materials.size(); i++)
+		{
+			CHECK(Materials[i].Name == Model.Materials[i].Name);
+			CHECK(Materials[i].DiffuseTexturePath == Model.Materials[i].DiffuseTexturePath);
+			CHECK(Materials[i].NormalTexturePath == Model.Materials[i].NormalTexturePath);
+			CHECK(Materials[i].DiffuseColor.x == Model.Materials[i].DiffuseColor.x && Materials[i].DiffuseColor.w == Model.Materials[i].DiffuseColor.w);
+			CHECK(Materials[i].Roughness == Model.Materials[i].Roughness && Materials[i].Metallic == Model.Materials[i].Metallic);
+		}
+
+		// The arrays stay mapped when the mesh is moved
+		MeshCache::CachedMesh Moved = std::move(Mesh);
+		CHECK(Moved.GetMeshView().Vertices == View.Vertices);
+		CHECK(Moved.GetMeshView().Vertices[6].Position.z == 18.0f);
+	}
+
+	void TestRoundTrip()
+	{
+		CheckRoundTrip(false);
+		CheckRoundTrip(true);
+
+		// A model without submeshes is stored as the single submesh it is drawn as
+		const std::string Path = GetTempPath("Default.dxmesh");
+		ModelImporter::ModelData Model = MakeModel(false);
+		Model.Submeshes.clear();
+		CHECK(!MeshCache::Write(Path, Model, TestBounds, TestKey));
+		CHECK(MeshCache::Write(Path, Model, { TestBounds[0] }, TestKey));
+		MeshCache::CachedMesh Mesh;
+		CHECK(Mesh.Open(Path, TestKey));
+		CHECK(Mesh.GetSubmeshes().size() == 1);
+		CHECK(!Mesh.GetSubmeshes().empty() && Mesh.GetSubmeshes()[0].Name == "Default" && Mesh.GetSubmeshes()[0].IndexCount == 9);
+	}
+
+	void TestRefusedFiles()
+	{
+		const std::string Path = GetTempPath("Refused.dxmesh");
+		CHECK(MeshCache::Write(Path, MakeModel(true), TestBounds, TestKey));
+		const std::vector<char> Bytes = ReadFile(Path);
+		MeshCache::CachedMesh Mesh;
+
+		// Written for another source file or other import settings
+		CHECK(!Mesh.Open(Path, { TestKey.SourceHash + 1, TestKey.SettingsHash }));
+		CHECK(!Mesh.Open(Path, { TestKey.SourceHash, TestKey.SettingsHash + 1 }));
+		CHECK(Mesh.GetSubmeshes().empty() && Mesh.GetMeshView().Vertices == nullptr);
+		CHECK(Mesh.Open(Path, TestKey));
+
+		// Cut short anywhere, inside the header or the sections
+		const std::string Truncated = GetTempPath("Truncated.dxmesh");
+		for (size_t Size : { size_t(1), size_t(16), size_t(100), Bytes.size() / 2, Bytes.size() - 1 })
+		{
+			WriteFile(Truncated, std::vector<char>(Bytes.begin(), Bytes.begin() + Size));
+			CHECK(!Mesh.Open(Truncated, TestKey));
+		}
+		WriteFile(Truncated, {});
+		CHECK(!Mesh.Open(Truncated, TestKey));
+
+		// Another version, it follows the 4 byte magic
+		std::vector<char> OtherVersion = Bytes;
+		std::uint32_t Version = MeshCache::Version + 1;
+		std::memcpy(&OtherVersion[4], &Version, sizeof(Version));
+		const std::string VersionPath = GetTempPath("Version.dxmesh");
+		WriteFile(VersionPath, OtherVersion);
+		CHECK(!Mesh.Open(VersionPath, TestKey));
+
+		// Not a mesh file, or no file at all
+		std::vector<char> Garbage(Bytes.size(), 'x');
+		WriteFile(VersionPath, Garbage);
+		CHECK(!Mesh.Open(VersionPath, TestKey));
+		CHECK(!Mesh.Open(GetTempPath("Missing.dxmesh"), TestKey));
+	}
+
+	void TestIndicesOutOfRange()
+	{
+		const std::string Path = GetTempPath("Indices.dxmesh");
+		MeshCache::CachedMesh Mesh;
+
+		// The second submesh reads vertices 4 to 6 through its base vertex, index 3 would read vertex 7
+		ModelImporter::ModelData Model = MakeModel(false);
+		Model.Indices16[8] = 3;
+		CHECK(MeshCache::Write(Path, Model, TestBounds, TestKey));
+		CHECK(!Mesh.Open(Path, TestKey));
+		Model.Indices16[8] = 2;
+		CHECK(MeshCache::Write(Path, Model, TestBounds, TestKey));
+		CHECK(Mesh.Open(Path, TestKey));
+
+		// A negative base vertex reads before the array
+		Model.Submeshes[1].BaseVertexLocation = -1;
+		CHECK(MeshCache::Write(Path, Model, TestBounds, TestKey));
+		CHECK(!Mesh.Open(Path, TestKey));
+		Model.Submeshes[1].BaseVertexLocation = 4;
+
+		// Meshlets must lie inside their submesh
+		Model.Submeshes[1].Meshlets[0].IndexStart = 3;
+		CHECK(MeshCache::Write(Path, Model, TestBounds, TestKey));
+		CHECK(!Mesh.Open(Path, TestKey));
+		CHECK(Mesh.GetSubmeshes().empty() && Mesh.GetSubmeshBounds().empty());
+	}
+}
+
+int main()
+{
+	TestUtil::Run("RoundTrip", TestRoundTrip);
+	TestUtil::Run("RefusedFiles", TestRefusedFiles);
+	TestUtil::Run("IndicesOutOfRange", TestIndicesOutOfRange);
+	std::error_code Error;
+	std::filesystem::remove_all(std::filesystem::temp_directory_path() / "MeshCacheTest", Error);
+	return TestUtil::Finish();
+}
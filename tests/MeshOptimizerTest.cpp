@@ -0,0 +1,195 @@
+//***************************************************************************************
+// MeshOptimizerTest.cpp
+//
+// MeshOptimizer passes keep every triangle with its winding, lower the ACMR and keep submeshes
+// sharing vertices valid
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "BenchUtil.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <array>
+#include <random>
+
+namespace
+{
+	using Triangle = std::array<std::uint32_t, 3>;
+
+	// A sphere appended to aVertices, aIndices index all of aVertices. The source vertex index is stored in
+	// TexCoord.x, exact as a float, so triangles can be compared after the vertices moved.
+	void MakeMesh(std::uint32_t aStacks, std::vector<Vertex>& aVertices, std::vector<std::uint32_t>& aIndices, std::uint32_t aSeed)
+	{
+		std::uint32_t Base = static_cast<std::uint32_t>(aVertices.size());
+		BenchUtil::AppendBumpySphere(aStacks, aStacks * 2, 1.0f, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), aVertices, aIndices);
+		for (size_t v = Base; v < aVertices.size(); v++)
+			aVertices[v].TexCoord.x = float(v);
+		for (std::uint32_t& Index : aIndices)
+			Index += Base;
+
+		// Triangles in random order, the worst case for the cache
+		std::vector<Triangle> Triangles(aIndices.size() / 3);
+		for (size_t t = 0; t < Triangles.size(); t++)
+			Triangles[t] = { aIndices[t * 3], aIndices[t * 3 + 1], aIndices[t * 3 + 2] };
+		std::mt19937 Rng(aSeed);
+		std::shuffle(Triangles.begin(), Triangles.end(), Rng);
+		for (size_t t = 0; t < Triangles.size(); t++)
+			std::copy(Triangles[t].begin(), Triangles[t].end(), aIndices.begin() + t * 3);
+	}
+
+	// Triangles as source vertex ids, each rotated to start at its smallest id so the winding is kept
+	template<typename IndexType>
+	std::vector<Triangle> GetTriangles(const std::vector<Vertex>& aVertices, const IndexType* aIndices, size_t aIndexCount,
+		std::int32_t aBaseVertex = 0)
+	{
+		std::vector<Triangle> Triangles;
+		for (size_t i = 0; i + 3 <= aIndexCount; i += 3)
+		{
+			Triangle Ids;
+			for (int c = 0; c < 3; c++)
+				Ids[c] = static_cast<std::uint32_t>(aVertices[aBaseVertex + aIndices[i + c]].TexCoord.x);
+			std::rotate(Ids.begin(), std::min_element(Ids.begin(), Ids.end()), Ids.end());
+			Triangles.push_back(Ids);
+		}
+		std::sort(Triangles.begin(), Triangles.end());
+		return Triangles;
+	}
+
+	void TestPassesKeepTriangles()
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<std::uint32_t> Indices;
+		MakeMesh(32, Vertices, Indices, 7);
+		const std::vector<Triangle> Source = GetTriangles(Vertices, Indices.data(), Indices.size());
+		MeshOptimizer::CacheStats Before = MeshOptimizer::AnalyzeVertexCache(Indices.data(), Indices.size(), Vertices.size());
+		CHECK(Before.Triangles == Indices.size() / 3);
+		CHECK(Before.GetAcmr() > 1.5f);
+
+		std::vector<std::uint32_t> Clusters;
+		MeshOptimizer::OptimizeVertexCache(Indices.data(), Indices.size(), Vertices.size(), 16, &Clusters);
+		CHECK(GetTriangles(Vertices, Indices.data(), Indices.size()) == Source);
+		MeshOptimizer::CacheStats AfterCache = MeshOptimizer::AnalyzeVertexCache(Indices.data(), Indices.size(), Vertices.size());
+		CHECK(AfterCache.GetAcmr() < Before.GetAcmr() * 0.5f);
+		CHECK(!Clusters.empty() && Clusters[0] == 0);
+		CHECK(std::is_sorted(Clusters.begin(), Clusters.end()));
+
+		MeshOptimizer::OptimizeOverdraw(Indices.data(), Indices.size(), Vertices.data(), Vertices.size(), Clusters);
+		CHECK(GetTriangles(Vertices, Indices.data(), Indices.size()) == Source);
+		// Each cluster stays within the threshold of its Tipsify ACMR, the new cluster order adds misses where
+		// clusters meet
+		CHECK(MeshOptimizer::AnalyzeVertexCache(Indices.data(), Indices.size(), Vertices.size()).GetAcmr() <= AfterCache.GetAcmr() * 1.15f);
+
+		std::vector<std::uint32_t> CacheOrder = Indices;
+		size_t Used = MeshOptimizer::OptimizeVertexFetch(Vertices.data(), Vertices.size(), Indices.data(), Indices.size());
+		CHECK(GetTriangles(Vertices, Indices.data(), Indices.size()) == Source);
+		CHECK(Used <= Vertices.size());
+		// Vertices are numbered by first use
+		std::uint32_t Next = 0;
+		bool bFirstUseOrder = true;
+		for (std::uint32_t Index : Indices)
+		{
+			bFirstUseOrder &= Index <= Next;
+			Next = std::max(Next, Index + 1);
+		}
+		CHECK(bFirstUseOrder && Next == Used);
+		// Renaming vertices doesn't change the cache behaviour
+		CHECK(MeshOptimizer::AnalyzeVertexCache(Indices.data(), Indices.size(), Vertices.size()).Misses
+			== MeshOptimizer::AnalyzeVertexCache(CacheOrder.data(), CacheOrder.size(), Vertices.size()).Misses);
+	}
+
+	void TestOptimizeLowersAcmr()
+	{
+		for (std::uint32_t Stacks : { 4u, 16u, 48u })
+		{
+			std::vector<Vertex> Vertices;
+			std::vector<std::uint32_t> Indices;
+			MakeMesh(Stacks, Vertices, Indices, Stacks);
+			const std::vector<Triangle> Source = GetTriangles(Vertices, Indices.data(), Indices.size());
+
+			MeshOptimizer::Stats Stats = MeshOptimizer::Optimize(Vertices.data(), Vertices.size(), Indices.data(), Indices.size());
+			CHECK(GetTriangles(Vertices, Indices.data(), Indices.size()) == Source);
+			CHECK(Stats.After.GetAcmr() <= Stats.Before.GetAcmr());
+			CHECK(Stats.After.Misses == MeshOptimizer::AnalyzeVertexCache(Indices.data(), Indices.size(), Vertices.size()).Misses);
+
+			// A second run starts from a good order and must not make it worse
+			MeshOptimizer::Stats Again = MeshOptimizer::Optimize(Vertices.data(), Vertices.size(), Indices.data(), Indices.size());
+			CHECK(Again.Before.Misses == Stats.After.Misses);
+			CHECK(Again.After.Misses <= Again.Before.Misses);
+			CHECK(GetTriangles(Vertices, Indices.data(), Indices.size()) == Source);
+		}
+	}
+
+	// A model like the importer builds: A owns its vertices, B and C draw two halves of one vertex range and D
+	// owns vertices behind a base vertex, its indices relative to it
+	template<typename IndexType>
+	void CheckSharedSubmeshes()
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<std::uint32_t> A, Shared, D;
+		MakeMesh(12, Vertices, A, 1);
+		std::uint32_t SharedFirst = static_cast<std::uint32_t>(Vertices.size());
+		MakeMesh(12, Vertices, Shared, 2);
+		std::int32_t BaseD = static_cast<std::int32_t>(Vertices.size());
+		MakeMesh(12, Vertices, D, 3);
+		for (std::uint32_t& Index : D)
+			Index -= BaseD;
+
+		std::vector<IndexType> Indices;
+		std::vector<MeshOptimizer::SubmeshRange> Submeshes;
+		auto AddSubmesh = [&](const std::uint32_t* aIndices, size_t aCount, std::int32_t aBaseVertex)
+		{
+			Submeshes.push_back({ static_cast<std::uint32_t>(aCount), static_cast<std::uint32_t>(Indices.size()), aBaseVertex });
+			Indices.insert(Indices.end(), aIndices, aIndices + aCount);
+		};
+		size_t Half = Shared.size() / 6 * 3;
+		AddSubmesh(A.data(), A.size(), 0);
+		AddSubmesh(Shared.data(), Half, 0);
+		AddSubmesh(Shared.data() + Half, Shared.size() - Half, 0);
+		AddSubmesh(D.data(), D.size(), BaseD);
+
+		std::vector<std::vector<Triangle>> Source;
+		for (const MeshOptimizer::SubmeshRange& Submesh : Submeshes)
+			Source.push_back(GetTriangles(Vertices, &Indices[Submesh.StartIndex], Submesh.IndexCount, Submesh.BaseVertex));
+		const std::vector<Vertex> SourceVertices = Vertices;
+
+		MeshOptimizer::Stats Stats = MeshOptimizer::OptimizeSubmeshes(Vertices.data(), Vertices.size(), Indices.data(), Submeshes);
+		CHECK(Stats.After.GetAcmr() <= Stats.Before.GetAcmr());
+		CHECK(Stats.Before.Triangles == Indices.size() / 3);
+
+		// Every submesh draws its triangles through its own base vertex
+		for (size_t s = 0; s < Submeshes.size(); s++)
+		{
+			const MeshOptimizer::SubmeshRange& Submesh = Submeshes[s];
+			CHECK(GetTriangles(Vertices, &Indices[Submesh.StartIndex], Submesh.IndexCount, Submesh.BaseVertex) == Source[s]);
+		}
+
+		// The shared range keeps its vertex order, the owned ones were reordered for fetch
+		auto SameVertex = [&](size_t aVertex) { return Vertices[aVertex].TexCoord.x == SourceVertices[aVertex].TexCoord.x; };
+		bool bSharedKept = true, bAMoved = false, bDMoved = false;
+		for (size_t v = 0; v < Vertices.size(); v++)
+		{
+			if (v < SharedFirst)
+				bAMoved |= !SameVertex(v);
+			else if (v < size_t(BaseD))
+				bSharedKept &= SameVertex(v);
+			else
+				bDMoved |= !SameVertex(v);
+		}
+		CHECK(bSharedKept);
+		CHECK(bAMoved && bDMoved);
+	}
+
+	void TestSharedSubmeshes()
+	{
+		CheckSharedSubmeshes<std::uint32_t>();
+		CheckSharedSubmeshes<std::uint16_t>();
+	}
+}
+
+int main()
+{
+	TestUtil::Run("PassesKeepTriangles", TestPassesKeepTriangles);
+	TestUtil::Run("OptimizeLowersAcmr", TestOptimizeLowersAcmr);
+	TestUtil::Run("SharedSubmeshes", TestSharedSubmeshes);
+	return TestUtil::Finish();
+}
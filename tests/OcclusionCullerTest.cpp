@@ -0,0 +1,242 @@
+//***************************************************************************************
+// OcclusionCullerTest.cpp
+//
+// Software rasterizer and box tests of OcclusionCuller on synthetic scenes
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+
+namespace
+{
+	const DirectX::XMFLOAT4X4 Identity(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	// Camera at the origin looking down +Z with a 90 degree field of view, near 1, far 100
+	DirectX::XMFLOAT4X4 MakeViewProj()
+	{
+		const float Near = 1.0f, Far = 100.0f;
+		const float Range = Far / (Far - Near);
+		return DirectX::XMFLOAT4X4(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, Range, 1.0f,
+			0.0f, 0.0f, -Range * Near, 0.0f);
+	}
+
+	// Quad facing the camera at aDepth spanning [-aHalfSize, aHalfSize] in x and y
+	struct Wall
+	{
+		DirectX::XMFLOAT3 Positions[4];
+		std::uint32_t Indices32[6] = { 0, 1, 2, 0, 2, 3 };
+		std::uint16_t Indices16[6] = { 0, 1, 2, 0, 2, 3 };
+
+		Wall(float aHalfSize, float aDepth)
+			: Positions{ { -aHalfSize, -aHalfSize, aDepth }, { -aHalfSize, aHalfSize, aDepth },
+				{ aHalfSize, aHalfSize, aDepth }, { aHalfSize, -aHalfSize, aDepth } } {}
+	};
+
+	void RasterizeWall(OcclusionCuller& aCuller, const Wall& aWall, bool b32BitIndices = true)
+	{
+		aCuller.RasterizeOccluder(aWall.Positions, sizeof(DirectX::XMFLOAT3), 4,
+			b32BitIndices ? static_cast<const void*>(aWall.Indices32) : static_cast<const void*>(aWall.Indices16),
+			b32BitIndices, 6, 0, Identity);
+	}
+
+	bool IsVisible(const OcclusionCuller& aCuller, float aX, float aY, float aZ, float aExtent)
+	{
+		return aCuller.IsBoxVisible(DirectX::XMFLOAT3(aX, aY, aZ), DirectX::XMFLOAT3(aExtent, aExtent, aExtent));
+	}
+
+	void TestEmptyBufferOccludesNothing()
+	{
+		OcclusionCuller Culler;
+		Culler.Resize(64, 64);
+		Culler.BeginFrame(MakeViewProj());
+		Culler.EndOccluders();
+		CHECK(IsVisible(Culler, 0.0f, 0.0f, 50.0f, 1.0f));
+		CHECK(std::all_of(Culler.GetDepth().begin(), Culler.GetDepth().end(), [](float Depth) { return Depth == 1.0f; }));
+	}
+
+	void TestWallOccludesBoxesBehindIt()
+	{
+		OcclusionCuller Culler;
+		Culler.Resize(64, 64);
+		Culler.BeginFrame(MakeViewProj());
+		RasterizeWall(Culler, Wall(5.0f, 10.0f));
+		Culler.EndOccluders();
+		CHECK(Culler.GetRasterizedTriangleCount() == 2);
+
+		CHECK(!IsVisible(Culler, 0.0f, 0.0f, 20.0f, 1.0f));
+		CHECK(!IsVisible(Culler, 7.0f, -7.0f, 20.0f, 1.0f));	// Near the silhouette, still inside it
+		CHECK(IsVisible(Culler, 0.0f, 0.0f, 5.0f, 1.0f));		// In front of the wall
+		CHECK(IsVisible(Culler, 12.0f, 0.0f, 20.0f, 1.0f));	// Reaches past the silhouette
+		CHECK(IsVisible(Culler, 0.0f, 0.0f, 12.0f, 3.0f));		// Intersects the wall
+		CHECK(IsVisible(Culler, 0.0f, 0.0f, 1.0f, 1.0f));		// Crosses the near plane
+		CHECK(IsVisible(Culler, 0.0f, 0.0f, -20.0f, 1.0f));	// Behind the camera
+	}
+
+	void TestLargeBoxesUseTheHiZ()
+	{
+		// Boxes covering more than a few hundred pixels are tested against the tile hierarchy
+		OcclusionCuller Culler;
+		Culler.Resize(64, 64);
+		Culler.BeginFrame(MakeViewProj());
+		RasterizeWall(Culler, Wall(30.0f, 10.0f));
+		Culler.EndOccluders();
+		CHECK(!IsVisible(Culler, 0.0f, 0.0f, 50.0f, 20.0f));
+		CHECK(IsVisible(Culler, 0.0f, 0.0f, 25.0f, 20.0f));
+	}
+
+	void TestBothWindingsOcclude()
+	{
+		Wall Reversed(5.0f, 10.0f);
+		std::reverse(std::begin(Reversed.Indices32), std::end(Reversed.Indices32));
+		OcclusionCuller Culler;
+		Culler.Resize(64, 64);
+		Culler.BeginFrame(MakeViewProj());
+		RasterizeWall(Culler, Reversed);
+		Culler.EndOccluders();
+		CHECK(!IsVisible(Culler, 0.0f, 0.0f, 20.0f, 1.0f));
+	}
+
+	void TestIndexWidthsMatch()
+	{
+		OcclusionCuller Culler16, Culler32;
+		for (OcclusionCuller* Culler : { &Culler16, &Culler32 })
+		{
+			Culler->Resize(48, 40);
+			Culler->BeginFrame(MakeViewProj());
+			RasterizeWall(*Culler, Wall(4.0f, 8.0f), Culler == &Culler32);
+			Culler->EndOccluders();
+		}
+		CHECK(Culler16.GetDepth() == Culler32.GetDepth());
+	}
+
+	void TestClippedOccluderStillOccludes()
+	{
+		// A floor-like quad running from behind the camera to far away is clipped at the near plane
+		const DirectX::XMFLOAT3 Positions[4] = { { -50.0f, -50.0f, -10.0f }, { -50.0f, 50.0f, -10.0f }, { 50.0f, 50.0f, 60.0f }, { 50.0f, -50.0f, 60.0f } };
+		const std::uint32_t Indices[6] = { 0, 1, 2, 0, 2, 3 };
+		OcclusionCuller Culler;
+		Culler.Resize(64, 64);
+		Culler.BeginFrame(MakeViewProj());
+		Culler.RasterizeOccluder(Positions, sizeof(DirectX::XMFLOAT3), 4, Indices, true, 6, 0, Identity);
+		Culler.EndOccluders();
+		CHECK(Culler.GetRasterizedTriangleCount() == 2);
+		CHECK(!IsVisible(Culler, 0.0f, 0.0f, 80.0f, 1.0f));
+	}
+
+	void TestDepthMatchesTrianglePlanes()
+	{
+		// With an identity view-projection the positions are NDC, so the expected depth is the triangle's plane.
+		// Pixels clearly inside must hold it (raised by at most the half pixel slope), pixels clearly outside stay cleared.
+		const std::uint32_t Size = 64;
+		std::mt19937 Rng(7);
+		std::uniform_real_distribution<float> Coordinate(-1.2f, 1.2f);
+		std::uniform_real_distribution<float> DepthValue(0.05f, 0.95f);
+		for (int Iteration = 0; Iteration < 200; Iteration++)
+		{
+			DirectX::XMFLOAT3 Positions[3];
+			for (DirectX::XMFLOAT3& Position : Positions)
+				Position = DirectX::XMFLOAT3(Coordinate(Rng), Coordinate(Rng), DepthValue(Rng));
+			const std::uint32_t Indices[3] = { 0, 1, 2 };
+
+			OcclusionCuller Culler;
+			Culler.Resize(Size, Size);
+			Culler.BeginFrame(Identity);
+			Culler.RasterizeOccluder(Positions, sizeof(DirectX::XMFLOAT3), 3, Indices, true, 3, 0, Identity);
+
+			float X[3], Y[3], Z[3];
+			for (int i = 0; i < 3; i++)
+			{
+				X[i] = (Positions[i].x * 0.5f + 0.5f) * Size;
+				Y[i] = (0.5f - Positions[i].y * 0.5f) * Size;
+				Z[i] = Positions[i].z;
+			}
+			float Area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+			if (std::fabs(Area) < 1.0f)
+				continue;
+			float ZDx = ((Z[1] - Z[0]) * (Y[2] - Y[0]) - (Z[2] - Z[0]) * (Y[1] - Y[0])) / Area;
+			float ZDy = ((Z[2] - Z[0]) * (X[1] - X[0]) - (Z[1] - Z[0]) * (X[2] - X[0])) / Area;
+			float Slope = 0.5f * (std::fabs(ZDx) + std::fabs(ZDy));
+
+			bool bAllMatch = true;
+			for (std::uint32_t PixelY = 0; PixelY < Size; PixelY++)
+			{
+				for (std::uint32_t PixelX = 0; PixelX < Size; PixelX++)
+				{
+					float Px = PixelX + 0.5f, Py = PixelY + 0.5f;
+					// Signed distances in pixels to the three edges, positive inside
+					float MinDistance = FLT_MAX;
+					for (int i = 0; i < 3; i++)
+					{
+						int j = (i + 1) % 3;
+						float EdgeX = X[j] - X[i], EdgeY = Y[j] - Y[i];
+						float Cross = (EdgeX * (Py - Y[i]) - EdgeY * (Px - X[i])) * (Area > 0.0f ? 1.0f : -1.0f);
+						MinDistance = std::min(MinDistance, Cross / std::sqrt(EdgeX * EdgeX + EdgeY * EdgeY));
+					}
+					float Stored = Culler.GetDepth()[PixelY * Size + PixelX];
+					if (MinDistance > 0.01f)
+					{
+						float Expected = Z[0] + ZDx * (Px - X[0]) + ZDy * (Py - Y[0]);
+						bAllMatch &= Stored >= Expected - 1e-4f && Stored <= Expected + Slope + 1e-4f;
+					}
+					else if (MinDistance < -0.01f)
+						bAllMatch &= Stored == 1.0f;
+				}
+			}
+			CHECK(bAllMatch);
+		}
+	}
+
+	void TestCullKeepsInputVisibility()
+	{
+		OcclusionCuller Culler;
+		Culler.Resize(64, 64);
+		Culler.BeginFrame(MakeViewProj());
+		RasterizeWall(Culler, Wall(5.0f, 10.0f));
+		Culler.EndOccluders();
+
+		SceneStore::WorldBoundsStreams Bounds;
+		const float Boxes[4][3] = { { 0.0f, 0.0f, 20.0f }, { 0.0f, 0.0f, 5.0f }, { 0.0f, 0.0f, 30.0f }, { 20.0f, 0.0f, 20.0f } };
+		for (const auto& Box : Boxes)
+		{
+			Bounds.CenterX.push_back(Box[0]);
+			Bounds.CenterY.push_back(Box[1]);
+			Bounds.CenterZ.push_back(Box[2]);
+			Bounds.ExtentX.push_back(1.0f);
+			Bounds.ExtentY.push_back(1.0f);
+			Bounds.ExtentZ.push_back(1.0f);
+		}
+		// The third box was already culled by the frustum test
+		std::vector<std::uint8_t> InVisibility = { 1, 1, 0, 1 };
+		CHECK(Culler.Cull(Bounds, InVisibility) == 2);
+		CHECK(Culler.GetOccludedCount() == 1);
+		CHECK(!Culler.IsVisible(0));
+		CHECK(Culler.IsVisible(1));
+		CHECK(!Culler.IsVisible(2));
+		CHECK(Culler.IsVisible(3));
+	}
+}
+
+int main()
+{
+	TestUtil::Run("EmptyBufferOccludesNothing", TestEmptyBufferOccludesNothing);
+	TestUtil::Run("WallOccludesBoxesBehindIt", TestWallOccludesBoxesBehindIt);
+	TestUtil::Run("LargeBoxesUseTheHiZ", TestLargeBoxesUseTheHiZ);
+	TestUtil::Run("BothWindingsOcclude", TestBothWindingsOcclude);
+	TestUtil::Run("IndexWidthsMatch", TestIndexWidthsMatch);
+	TestUtil::Run("ClippedOccluderStillOccludes", TestClippedOccluderStillOccludes);
+	TestUtil::Run("DepthMatchesTrianglePlanes", TestDepthMatchesTrianglePlanes);
+	TestUtil::Run("CullKeepsInputVisibility", TestCullKeepsInputVisibility);
+	return TestUtil::Finish();
+}
@@ -0,0 +1,83 @@
+//***************************************************************************************
+// ParallelForTest.cpp
+//
+// Chunking of ParallelFor and inline execution of nested calls
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "ParallelFor.h"
+#include <atomic>
+#include <initializer_list>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	void TestEveryIndexRunsOnce()
+	{
+		for (size_t MaxThreads : { 1, 4 })
+		{
+			std::vector<std::atomic<int>> Visits(1000);
+			ParallelFor(Visits.size(), 7, [&](size_t aBegin, size_t aEnd)
+			{
+				CHECK(MaxThreads == 1 ? aEnd - aBegin == Visits.size() : aEnd - aBegin <= 7);
+				for (size_t i = aBegin; i < aEnd; i++)
+					Visits[i]++;
+			}, MaxThreads);
+			for (const std::atomic<int>& Count : Visits)
+				CHECK(Count == 1);
+		}
+	}
+
+	void TestThreadLimit()
+	{
+		std::mutex Lock;
+		std::set<std::thread::id> Threads;
+		ParallelFor(64, 1, [&](size_t, size_t)
+		{
+			std::lock_guard<std::mutex> Guard(Lock);
+			Threads.insert(std::this_thread::get_id());
+		}, 3);
+		CHECK(Threads.size() <= 3);
+
+		Threads.clear();
+		ParallelFor(64, 1, [&](size_t, size_t) { Threads.insert(std::this_thread::get_id()); }, 1);
+		CHECK(Threads.size() == 1);
+		CHECK(*Threads.begin() == std::this_thread::get_id());
+	}
+
+	// The import workers call the per submesh loops, which must not start threads of their own
+	void TestNestedCallsRunInline()
+	{
+		std::atomic<int> NestedOnOtherThread{ 0 };
+		std::atomic<int> NestedChunks{ 0 };
+		ParallelFor(8, 1, [&](size_t, size_t)
+		{
+			std::thread::id Outer = std::this_thread::get_id();
+			ParallelFor(16, 1, [&](size_t aBegin, size_t aEnd)
+			{
+				NestedOnOtherThread += std::this_thread::get_id() != Outer;
+				NestedChunks++;
+				CHECK(aBegin == 0 && aEnd == 16);
+			}, 4);
+		}, 4);
+		CHECK(NestedOnOtherThread == 0);
+		CHECK(NestedChunks == 8);
+
+		// Outside of a parallel body the calling thread starts helpers again
+		std::atomic<int> Chunks{ 0 };
+		ParallelFor(16, 1, [&](size_t, size_t) { Chunks++; }, 4);
+		CHECK(Chunks == 16);
+		CHECK(!ParallelForDetail::bOnWorker);
+	}
+}
+
+int main()
+{
+	TestUtil::Run("EveryIndexRunsOnce", TestEveryIndexRunsOnce);
+	TestUtil::Run("ThreadLimit", TestThreadLimit);
+	TestUtil::Run("NestedCallsRunInline", TestNestedCallsRunInline);
+	return TestUtil::Finish();
+}
@@ -0,0 +1,143 @@
+//***************************************************************************************
+// ProbeLookupTest.cpp
+//
+// ProbeLookup::Find against a brute force search over every probe
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "ProbeLookup.h"
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	float Distance(const DirectX::XMFLOAT3& aA, const DirectX::XMFLOAT3& aB)
+	{
+		float DX = aA.x - aB.x, DY = aA.y - aB.y, DZ = aA.z - aB.z;
+		return std::sqrt(DX * DX + DY * DY + DZ * DZ);
+	}
+
+	// The two deepest influences containing the position, or the nearest probe alone outside all of them
+	ProbeLookup::Assignment FindBruteForce(const std::vector<ProbeLookup::Probe>& aProbes, const DirectX::XMFLOAT3& aPosition)
+	{
+		float Weights[2] = { 0.0f, 0.0f };
+		std::uint32_t Best[2] = { UINT32_MAX, UINT32_MAX };
+		std::uint32_t Nearest = 0;
+		float NearestDistance = FLT_MAX;
+		for (std::uint32_t i = 0; i < aProbes.size(); i++)
+		{
+			float ToCenter = Distance(aPosition, aProbes[i].Center);
+			if (ToCenter < NearestDistance)
+			{
+				NearestDistance = ToCenter;
+				Nearest = i;
+			}
+			float Weight = 1.0f - ToCenter / aProbes[i].InfluenceRadius;
+			if (Weight > Weights[0])
+			{
+				Weights[1] = Weights[0];
+				Best[1] = Best[0];
+				Weights[0] = Weight;
+				Best[0] = i;
+			}
+			else if (Weight > Weights[1])
+			{
+				Weights[1] = Weight;
+				Best[1] = i;
+			}
+		}
+
+		ProbeLookup::Assignment Result;
+		if (Best[0] == UINT32_MAX)
+		{
+			Result.Probes[0] = Result.Probes[1] = Nearest;
+			return Result;
+		}
+		Result.Probes[0] = Best[0];
+		Result.Probes[1] = Best[1] == UINT32_MAX ? Best[0] : Best[1];
+		Result.Blend = Best[1] == UINT32_MAX ? 0.0f : Weights[1] / (Weights[0] + Weights[1]);
+		return Result;
+	}
+
+	// Probes of mixed sizes scattered through a room, with one far away so the grid has empty space
+	std::vector<ProbeLookup::Probe> MakeProbes()
+	{
+		std::mt19937 Rng(37);
+		std::uniform_real_distribution<float> Position(-40.0f, 40.0f);
+		std::uniform_real_distribution<float> Radius(2.0f, 15.0f);
+		std::vector<ProbeLookup::Probe> Probes;
+		for (int i = 0; i < 60; i++)
+			Probes.push_back({ DirectX::XMFLOAT3(Position(Rng), Position(Rng) * 0.25f, Position(Rng)), Radius(Rng) });
+		Probes.push_back({ DirectX::XMFLOAT3(300.0f, 0.0f, 0.0f), 5.0f });
+		return Probes;
+	}
+
+	void CheckAgainstBruteForce(const std::vector<ProbeLookup::Probe>& aProbes, float aCellSize)
+	{
+		ProbeLookup Lookup;
+		Lookup.Build(aProbes, aCellSize);
+		CHECK(Lookup.GetProbeCount() == aProbes.size());
+
+		// Inside the probes, between them and far outside the grid
+		std::mt19937 Rng(41);
+		std::uniform_real_distribution<float> Position(-60.0f, 60.0f);
+		int Outside = 0, Blended = 0;
+		for (int i = 0; i < 20000; i++)
+		{
+			float Spread = i % 10 == 0 ? 8.0f : 1.0f;
+			DirectX::XMFLOAT3 P(Position(Rng) * Spread, Position(Rng) * 0.3f * Spread, Position(Rng) * Spread);
+			ProbeLookup::Assignment Expected = FindBruteForce(aProbes, P);
+			ProbeLookup::Assignment Found = Lookup.Find(P);
+			CHECK(Found.Probes[0] == Expected.Probes[0]);
+			CHECK(Found.Probes[1] == Expected.Probes[1]);
+			CHECK(Found.Blend == Expected.Blend);
+			CHECK(Found.Blend >= 0.0f && Found.Blend <= 0.5f);
+			Outside += Expected.Blend == 0.0f && Distance(P, aProbes[Expected.Probes[0]].Center) >= aProbes[Expected.Probes[0]].InfluenceRadius;
+			Blended += Expected.Blend > 0.0f;
+		}
+		// Both cases are actually exercised
+		CHECK(Outside > 1000);
+		CHECK(Blended > 1000);
+	}
+
+	void TestMatchesBruteForce()
+	{
+		const std::vector<ProbeLookup::Probe> Probes = MakeProbes();
+		// The default cell, smaller and larger ones, and one small enough to be grown to the cell limit
+		for (float CellSize : { 0.0f, 3.0f, 50.0f, 0.01f })
+			CheckAgainstBruteForce(Probes, CellSize);
+	}
+
+	void TestSimpleCases()
+	{
+		ProbeLookup Lookup;
+		CHECK(Lookup.IsEmpty());
+		ProbeLookup::Assignment None = Lookup.Find(DirectX::XMFLOAT3(1.0f, 2.0f, 3.0f));
+		CHECK(None.Probes[0] == 0 && None.Probes[1] == 0 && None.Blend == 0.0f);
+
+		// Two equal probes overlapping: halfway between them both weigh the same
+		Lookup.Build({ { DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), 4.0f }, { DirectX::XMFLOAT3(4.0f, 0.0f, 0.0f), 4.0f } });
+		ProbeLookup::Assignment Middle = Lookup.Find(DirectX::XMFLOAT3(2.0f, 0.0f, 0.0f));
+		CHECK_NEAR(Middle.Blend, 0.5f, 1e-6f);
+		// At a center the other probe's influence ends, it gets no weight
+		ProbeLookup::Assignment AtCenter = Lookup.Find(DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+		CHECK(AtCenter.Probes[0] == 0 && AtCenter.Probes[1] == 0 && AtCenter.Blend == 0.0f);
+		ProbeLookup::Assignment Closer = Lookup.Find(DirectX::XMFLOAT3(3.0f, 0.0f, 0.0f));
+		CHECK(Closer.Probes[0] == 1 && Closer.Probes[1] == 0);
+		CHECK_NEAR(Closer.Blend, 0.25f / (0.25f + 0.75f), 1e-6f);
+
+		// Outside both the nearest one is used alone
+		ProbeLookup::Assignment Far = Lookup.Find(DirectX::XMFLOAT3(-100.0f, 5.0f, 0.0f));
+		CHECK(Far.Probes[0] == 0 && Far.Probes[1] == 0 && Far.Blend == 0.0f);
+		Far = Lookup.Find(DirectX::XMFLOAT3(9.0f, 0.0f, 0.0f));
+		CHECK(Far.Probes[0] == 1 && Far.Probes[1] == 1);
+	}
+}
+
+int main()
+{
+	TestUtil::Run("MatchesBruteForce", TestMatchesBruteForce);
+	TestUtil::Run("SimpleCases", TestSimpleCases);
+	return TestUtil::Finish();
+}
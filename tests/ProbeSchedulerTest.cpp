@@ -0,0 +1,230 @@
+//***************************************************************************************
+// ProbeSchedulerTest.cpp
+//
+// Face scheduling of ProbeScheduler: time slicing, the shared face budget and the faces a moved box dirties
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "ProbeScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <utility>
+
+namespace
+{
+	ProbeScheduler::ProbeDesc MakeProbe(const DirectX::XMFLOAT3& aCenter, float aInfluenceRadius,
+		ProbeScheduler::UpdatePolicy aPolicy = ProbeScheduler::UpdatePolicy::OnChange, std::uint32_t aFacesPerFrame = 1)
+	{
+		ProbeScheduler::ProbeDesc Desc;
+		Desc.Center = aCenter;
+		Desc.InfluenceRadius = aInfluenceRadius;
+		Desc.Policy = aPolicy;
+		Desc.FacesPerFrame = aFacesPerFrame;
+		return Desc;
+	}
+
+	// Renders the faces every new probe starts with
+	void Flush(ProbeScheduler& aScheduler)
+	{
+		std::uint32_t Budget = aScheduler.GetFaceBudget();
+		aScheduler.SetFaceBudget(0);
+		aScheduler.ScheduleFrame();
+		aScheduler.SetFaceBudget(Budget);
+	}
+
+	std::uint8_t GetDirtyFaces(const ProbeScheduler& aScheduler, ProbeScheduler::ProbeId aProbe)
+	{
+		std::uint8_t Faces = 0;
+		for (std::uint32_t Face = 0; Face < ProbeScheduler::FaceCount; Face++)
+			Faces |= aScheduler.IsFaceDirty(aProbe, Face) ? std::uint8_t(1u << Face) : 0;
+		return Faces;
+	}
+
+	void TestTimeSlicing()
+	{
+		ProbeScheduler Scheduler(3);
+		ProbeScheduler::ProbeId Probe = Scheduler.AddProbe(MakeProbe({ 0.0f, 0.0f, 0.0f }, 0.0f, ProbeScheduler::UpdatePolicy::Always, 1));
+		CHECK(GetDirtyFaces(Scheduler, Probe) == 0x3F);
+		Flush(Scheduler);
+		CHECK(Scheduler.GetScheduledFaces().size() == 6);
+		CHECK(GetDirtyFaces(Scheduler, Probe) == 0);
+
+		// One face per frame cycles through all six in six frames, in cube map order, then starts over
+		for (std::uint32_t Frame = 0; Frame < 12; Frame++)
+		{
+			const std::vector<ProbeScheduler::FaceUpdate>& Faces = Scheduler.ScheduleFrame();
+			CHECK(Faces.size() == 1);
+			CHECK(!Faces.empty() && Faces[0].Probe == Probe && Faces[0].Face == Frame % 6);
+		}
+
+		// Two faces per frame take three frames, the budget limits it to one again
+		Scheduler.SetPolicy(Probe, ProbeScheduler::UpdatePolicy::Always, 2);
+		Scheduler.SetFaceBudget(2);
+		std::set<std::uint32_t> Seen;
+		for (int Frame = 0; Frame < 3; Frame++)
+		{
+			for (const ProbeScheduler::FaceUpdate& Update : Scheduler.ScheduleFrame())
+				Seen.insert(Update.Face);
+		}
+		CHECK(Seen.size() == 6);
+		Scheduler.SetFaceBudget(1);
+		CHECK(Scheduler.ScheduleFrame().size() == 1);
+
+		// OnChange probes render nothing until invalidated
+		Scheduler.SetPolicy(Probe, ProbeScheduler::UpdatePolicy::OnChange, 1);
+		Flush(Scheduler);
+		CHECK(Scheduler.ScheduleFrame().empty());
+		Scheduler.InvalidateProbe(Probe);
+		CHECK(GetDirtyFaces(Scheduler, Probe) == 0x3F);
+	}
+
+	void TestSharedBudget()
+	{
+		ProbeScheduler Scheduler(3);
+		for (int i = 0; i < 3; i++)
+			Scheduler.AddProbe(MakeProbe({ float(i) * 10.0f, 0.0f, 0.0f }, 5.0f));
+		CHECK(Scheduler.GetFaceBudget() == 1);
+		Scheduler.SetFaceBudget(4);
+
+		// 18 dirty faces, 4 per frame over all probes: 4, 4, 4, 4, 2
+		std::set<std::pair<ProbeScheduler::ProbeId, std::uint32_t>> Rendered;
+		std::vector<size_t> FrameSizes;
+		std::vector<ProbeScheduler::ProbeId> FirstProbes;
+		for (int Frame = 0; Frame < 6; Frame++)
+		{
+			const std::vector<ProbeScheduler::FaceUpdate>& Faces = Scheduler.ScheduleFrame();
+			FrameSizes.push_back(Faces.size());
+			if (!Faces.empty())
+				FirstProbes.push_back(Faces[0].Probe);
+			for (const ProbeScheduler::FaceUpdate& Update : Faces)
+			{
+				CHECK(Rendered.insert({ Update.Probe, Update.Face }).second);
+				CHECK(!Scheduler.IsFaceDirty(Update.Probe, Update.Face));
+			}
+		}
+		CHECK(FrameSizes == std::vector<size_t>({ 4, 4, 4, 4, 2, 0 }));
+		CHECK(Rendered.size() == 18);
+		// Probes take turns going first, a busy one can't starve the others
+		CHECK(FirstProbes.size() >= 3 && FirstProbes[0] == 0 && FirstProbes[1] == 1 && FirstProbes[2] == 2);
+
+		// An Always probe shares the same budget with the OnChange ones
+		ProbeScheduler::ProbeId Always = Scheduler.AddProbe(MakeProbe({ 0.0f, 50.0f, 0.0f }, 0.0f, ProbeScheduler::UpdatePolicy::Always, 1));
+		Flush(Scheduler);
+		Scheduler.SetFaceBudget(1);
+		for (ProbeScheduler::ProbeId Probe = 0; Probe < 3; Probe++)
+			Scheduler.InvalidateProbe(Probe);
+		size_t AlwaysFaces = 0, Total = 0;
+		for (int Frame = 0; Frame < 40; Frame++)
+		{
+			const std::vector<ProbeScheduler::FaceUpdate>& Faces = Scheduler.ScheduleFrame();
+			CHECK(Faces.size() == 1);
+			Total += Faces.size();
+			AlwaysFaces += std::count_if(Faces.begin(), Faces.end(), [&](const ProbeScheduler::FaceUpdate& aUpdate) { return aUpdate.Probe == Always; });
+		}
+		CHECK(Total == 40);
+		// The other probes get their 18 faces through
+		for (ProbeScheduler::ProbeId Probe = 0; Probe < 3; Probe++)
+			CHECK(GetDirtyFaces(Scheduler, Probe) == 0);
+		CHECK(AlwaysFaces >= 10 && AlwaysFaces <= 22);
+
+		// No budget renders everything at once
+		Scheduler.SetFaceBudget(0);
+		for (ProbeScheduler::ProbeId Probe = 0; Probe < 4; Probe++)
+			Scheduler.InvalidateProbe(Probe);
+		CHECK(Scheduler.ScheduleFrame().size() == 24);
+	}
+
+	// Faces whose view contains a point, points on an edge between faces count for both
+	std::uint8_t GetFacesOfPoint(const DirectX::XMFLOAT3& aPoint)
+	{
+		const float P[3] = { aPoint.x, aPoint.y, aPoint.z };
+		float Largest = std::max({ std::fabs(P[0]), std::fabs(P[1]), std::fabs(P[2]) });
+		std::uint8_t Faces = 0;
+		for (int K = 0; K < 3; K++)
+		{
+			if (std::fabs(P[K]) >= Largest * 0.9999f)
+				Faces |= std::uint8_t(1u << (K * 2 + (P[K] < 0.0f ? 1 : 0)));
+		}
+		return Faces;
+	}
+
+	void TestMovedBoxFaces()
+	{
+		ProbeScheduler Scheduler(3);
+		ProbeScheduler::ProbeId Probe = Scheduler.AddProbe(MakeProbe({ 1.0f, 2.0f, 3.0f }, 20.0f));
+		ProbeScheduler::ProbeId Global = Scheduler.AddProbe(MakeProbe({ 1.0f, 2.0f, 3.0f }, 0.0f));
+		Flush(Scheduler);
+
+		// A box on +X of the probe is seen by the +X face only
+		Scheduler.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(6.0f, 2.0f, 3.0f), DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f)));
+		CHECK(GetDirtyFaces(Scheduler, Probe) == 0x01);
+		Flush(Scheduler);
+
+		// Across the diagonal between +X and -Z both faces see it
+		Scheduler.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(6.0f, 2.0f, -2.0f), DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f)));
+		CHECK(GetDirtyFaces(Scheduler, Probe) == 0x21);
+		Flush(Scheduler);
+
+		// Around the probe every face does
+		Scheduler.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(1.5f, 2.0f, 3.0f), DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f)));
+		CHECK(GetDirtyFaces(Scheduler, Probe) == 0x3F);
+		Flush(Scheduler);
+
+		// Outside the influence sphere only the probe covering the whole scene is affected
+		Scheduler.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(1.0f, -30.0f, 3.0f), DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f)));
+		CHECK(GetDirtyFaces(Scheduler, Probe) == 0);
+		CHECK(GetDirtyFaces(Scheduler, Global) == 0x08);
+		Flush(Scheduler);
+
+		// Random boxes never miss a face that sees one of their points
+		std::mt19937 Rng(31);
+		std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+		int Extra = 0;
+		for (int i = 0; i < 2000; i++)
+		{
+			DirectX::XMFLOAT3 Center(10.0f * Unit(Rng), 10.0f * Unit(Rng), 10.0f * Unit(Rng));
+			DirectX::XMFLOAT3 Extents(1.0f + Unit(Rng), 1.0f + Unit(Rng), 1.0f + Unit(Rng));
+			Scheduler.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(Center.x + 1.0f, Center.y + 2.0f, Center.z + 3.0f), Extents));
+			std::uint8_t Dirty = GetDirtyFaces(Scheduler, Global);
+			std::uint8_t Seen = 0;
+			for (int s = 0; s < 200; s++)
+				Seen |= GetFacesOfPoint({ Center.x + Extents.x * Unit(Rng), Center.y + Extents.y * Unit(Rng), Center.z + Extents.z * Unit(Rng) });
+			CHECK((Seen & ~Dirty) == 0);
+			Extra += Dirty != Seen;
+			Flush(Scheduler);
+		}
+		// Conservative, but not by much
+		CHECK(Extra < 400);
+	}
+
+	void TestPassConstants()
+	{
+		ProbeScheduler Scheduler(3);
+		ProbeScheduler::ProbeId Probe = Scheduler.AddProbe(MakeProbe({ 0.0f, 0.0f, 0.0f }, 0.0f));
+		// Every frame resource gets its own copy
+		for (int Frame = 0; Frame < 3; Frame++)
+		{
+			CHECK(Scheduler.ArePassConstantsDirty(Probe));
+			Scheduler.ConsumePassConstantsDirty(Probe);
+		}
+		CHECK(!Scheduler.ArePassConstantsDirty(Probe));
+
+		// Moving the probe dirties its faces and constants, staying put nothing
+		Flush(Scheduler);
+		Scheduler.SetProbeCenter(Probe, { 0.0f, 0.0f, 0.0f });
+		CHECK(!Scheduler.ArePassConstantsDirty(Probe) && GetDirtyFaces(Scheduler, Probe) == 0);
+		Scheduler.SetProbeCenter(Probe, { 0.0f, 1.0f, 0.0f });
+		CHECK(Scheduler.ArePassConstantsDirty(Probe) && GetDirtyFaces(Scheduler, Probe) == 0x3F);
+	}
+}
+
+int main()
+{
+	TestUtil::Run("TimeSlicing", TestTimeSlicing);
+	TestUtil::Run("SharedBudget", TestSharedBudget);
+	TestUtil::Run("MovedBoxFaces", TestMovedBoxFaces);
+	TestUtil::Run("PassConstants", TestPassConstants);
+	return TestUtil::Finish();
+}
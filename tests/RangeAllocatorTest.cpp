@@ -0,0 +1,198 @@
+//***************************************************************************************
+// RangeAllocatorTest.cpp
+//
+// Best fit allocation, coalescing, growth and defragmentation of RangeAllocator
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "RangeAllocator.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	void TestAllocateFree()
+	{
+		RangeAllocator Allocator(1000);
+		CHECK(Allocator.GetFreeRangeCount() == 1);
+		CHECK(Allocator.Allocate(0) == RangeAllocator::InvalidOffset);
+		CHECK(Allocator.Allocate(1001) == RangeAllocator::InvalidOffset);
+
+		std::uint64_t A = Allocator.Allocate(100);
+		std::uint64_t B = Allocator.Allocate(200);
+		std::uint64_t C = Allocator.Allocate(300);
+		CHECK(A == 0 && B == 100 && C == 300);
+		CHECK(Allocator.GetAllocationSize(B) == 200);
+		CHECK(Allocator.GetUsedSize() == 600 && Allocator.GetFreeSize() == 400);
+		CHECK(Allocator.GetAllocationCount() == 3);
+		CHECK(Allocator.GetUsedEnd() == 600);
+
+		// Best fit: the 100 unit hole of A is used before the 400 unit tail
+		Allocator.Free(A);
+		CHECK(Allocator.GetAllocationSize(A) == 0);
+		CHECK(Allocator.GetFreeRangeCount() == 2);
+		CHECK(Allocator.Allocate(80) == 0);
+		CHECK(Allocator.Allocate(50) == 600);
+		// The 20 left of the hole only takes what fits
+		CHECK(Allocator.Allocate(20) == 80);
+		CHECK(Allocator.GetFreeRangeCount() == 1);
+		CHECK(Allocator.Allocate(351) == RangeAllocator::InvalidOffset);
+		CHECK(Allocator.Allocate(350) == 650);
+		CHECK(Allocator.GetFreeSize() == 0 && Allocator.GetFreeRangeCount() == 0);
+		CHECK(Allocator.Allocate(1) == RangeAllocator::InvalidOffset);
+
+		Allocator.Reset(10);
+		CHECK(Allocator.GetAllocationCount() == 0 && Allocator.GetLargestFreeRange() == 10);
+	}
+
+	void TestAlignment()
+	{
+		RangeAllocator Allocator(1024);
+		CHECK(Allocator.Allocate(3) == 0);
+		std::uint64_t Aligned = Allocator.Allocate(100, 256);
+		CHECK(Aligned == 256);
+		// The padding in front stays free and is handed out again
+		CHECK(Allocator.GetFreeRangeCount() == 2);
+		CHECK(Allocator.Allocate(253) == 3);
+		// No start in the tail [356, 1024) is a multiple of 1024
+		CHECK(Allocator.Allocate(1, 1024) == RangeAllocator::InvalidOffset);
+		CHECK(Allocator.Allocate(10, 512) == 512);
+	}
+
+	void TestCoalescing()
+	{
+		RangeAllocator Allocator(500);
+		std::uint64_t Offsets[5];
+		for (std::uint64_t& Offset : Offsets)
+			Offset = Allocator.Allocate(100);
+		CHECK(Allocator.GetFreeRangeCount() == 0);
+
+		// Isolated holes stay apart
+		Allocator.Free(Offsets[1]);
+		Allocator.Free(Offsets[3]);
+		CHECK(Allocator.GetFreeRangeCount() == 2);
+		CHECK(Allocator.GetLargestFreeRange() == 100);
+		CHECK_NEAR(Allocator.GetFragmentation(), 0.5f, 1e-6f);
+
+		// Freeing the allocation between them merges both sides into one range
+		Allocator.Free(Offsets[2]);
+		CHECK(Allocator.GetFreeRangeCount() == 1);
+		CHECK(Allocator.GetLargestFreeRange() == 300);
+		CHECK(Allocator.GetFragmentation() == 0.0f);
+		CHECK(Allocator.Allocate(300) == 100);
+		Allocator.Free(100);
+
+		// Merging with the previous range only, then the next only
+		Allocator.Free(Offsets[0]);
+		CHECK(Allocator.GetFreeRangeCount() == 1 && Allocator.GetLargestFreeRange() == 400);
+		Allocator.Free(Offsets[4]);
+		CHECK(Allocator.GetFreeRangeCount() == 1 && Allocator.GetLargestFreeRange() == 500);
+		CHECK(Allocator.GetUsedSize() == 0 && Allocator.GetUsedEnd() == 0);
+	}
+
+	void TestGrow()
+	{
+		// A free tail is extended in place
+		RangeAllocator Allocator(100);
+		std::uint64_t A = Allocator.Allocate(60);
+		Allocator.Grow(200);
+		CHECK(Allocator.GetCapacity() == 200);
+		CHECK(Allocator.GetFreeRangeCount() == 1 && Allocator.GetLargestFreeRange() == 140);
+		CHECK(Allocator.GetAllocationSize(A) == 60);
+
+		// A full allocator gets a new range at the end
+		CHECK(Allocator.Allocate(140) == 60);
+		Allocator.Grow(300);
+		CHECK(Allocator.GetFreeRangeCount() == 1 && Allocator.GetLargestFreeRange() == 100);
+		CHECK(Allocator.Allocate(100) == 200);
+
+		// Shrinking is ignored, an empty allocator grows from nothing
+		Allocator.Grow(50);
+		CHECK(Allocator.GetCapacity() == 300);
+		RangeAllocator Empty;
+		CHECK(Empty.Allocate(1) == RangeAllocator::InvalidOffset);
+		Empty.Grow(16);
+		CHECK(Empty.Allocate(16) == 0);
+	}
+
+	// Fills random allocations with their own byte, frees half, defragments and applies the moves to the
+	// memory front to back: every allocation must keep its bytes at its new offset
+	void TestDefragmentMoves()
+	{
+		const std::uint64_t Capacity = 1 << 16;
+		RangeAllocator Allocator(Capacity);
+		std::vector<std::uint8_t> Memory(Capacity, 0);
+		std::mt19937 Rng(23);
+		std::vector<std::uint64_t> Live;
+		for (;;)
+		{
+			std::uint64_t Size = 1 + Rng() % 700;
+			std::uint64_t Offset = Allocator.Allocate(Size);
+			if (Offset == RangeAllocator::InvalidOffset)
+				break;
+			Live.push_back(Offset);
+		}
+		std::shuffle(Live.begin(), Live.end(), Rng);
+		Live.resize(Live.size() / 2);
+		std::vector<std::uint64_t> Freed;
+		for (std::uint64_t Offset = 0; Offset < Capacity; Offset++)
+		{
+			std::uint64_t Size = Allocator.GetAllocationSize(Offset);
+			if (Size > 0 && std::find(Live.begin(), Live.end(), Offset) == Live.end())
+				Freed.push_back(Offset);
+		}
+		for (std::uint64_t Offset : Freed)
+			Allocator.Free(Offset);
+		std::sort(Live.begin(), Live.end());
+		for (size_t i = 0; i < Live.size(); i++)
+			std::memset(&Memory[Live[i]], int(1 + i % 255), Allocator.GetAllocationSize(Live[i]));
+		CHECK(Allocator.GetFreeRangeCount() > 1);
+		std::uint64_t UsedSize = Allocator.GetUsedSize();
+
+		std::vector<RangeAllocator::Move> Moves = Allocator.Defragment();
+		CHECK(Moves.size() == Live.size());
+		std::uint64_t Cursor = 0;
+		for (size_t i = 0; i < Moves.size(); i++)
+		{
+			// Every allocation in offset order, packed, only ever moved towards the front
+			CHECK(Moves[i].OldOffset == Live[i]);
+			CHECK(Moves[i].NewOffset == Cursor);
+			CHECK(Moves[i].NewOffset <= Moves[i].OldOffset);
+			CHECK(Allocator.GetAllocationSize(Moves[i].NewOffset) == Moves[i].Size);
+			Cursor += Moves[i].Size;
+			std::memmove(&Memory[Moves[i].NewOffset], &Memory[Moves[i].OldOffset], Moves[i].Size);
+		}
+		for (size_t i = 0; i < Moves.size(); i++)
+		{
+			const std::uint8_t* Bytes = &Memory[Moves[i].NewOffset];
+			CHECK(std::all_of(Bytes, Bytes + Moves[i].Size, [&](std::uint8_t aByte) { return aByte == 1 + i % 255; }));
+		}
+
+		// One free range remains after the packed allocations
+		CHECK(Allocator.GetUsedSize() == UsedSize);
+		CHECK(Allocator.GetUsedEnd() == UsedSize);
+		CHECK(Allocator.GetFreeRangeCount() == 1);
+		CHECK(Allocator.GetLargestFreeRange() == Capacity - UsedSize);
+		CHECK(Allocator.Allocate(Capacity - UsedSize) == UsedSize);
+
+		// Nothing to move in an empty allocator, and a full one stays full
+		RangeAllocator Empty(100);
+		CHECK(Empty.Defragment().empty());
+		CHECK(Empty.GetFreeRangeCount() == 1 && Empty.GetLargestFreeRange() == 100);
+		RangeAllocator Full(100);
+		Full.Allocate(100);
+		CHECK(Full.Defragment().size() == 1 && Full.GetFreeRangeCount() == 0);
+	}
+}
+
+int main()
+{
+	TestUtil::Run("AllocateFree", TestAllocateFree);
+	TestUtil::Run("Alignment", TestAlignment);
+	TestUtil::Run("Coalescing", TestCoalescing);
+	TestUtil::Run("Grow", TestGrow);
+	TestUtil::Run("DefragmentMoves", TestDefragmentMoves);
+	return TestUtil::Finish();
+}
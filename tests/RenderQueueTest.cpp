@@ -0,0 +1,133 @@
+//***************************************************************************************
+// RenderQueueTest.cpp
+//
+// Sort key packing and radix sort order of RenderQueue
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "RenderQueue.h"
+#include <algorithm>
+#include <random>
+#include <utility>
+
+namespace
+{
+	void TestKeyFields()
+	{
+		std::uint64_t Key = RenderQueue::MakeKey(9, 200, 777777, 4000, 123456);
+		CHECK(RenderQueue::GetBucket(Key) == 9);
+		CHECK(RenderQueue::GetPso(Key) == 200);
+		CHECK(RenderQueue::GetMesh(Key) == 777777);
+		CHECK(RenderQueue::GetMaterial(Key) == 4000);
+		CHECK(Key != RenderQueue::InvalidKey);
+
+		// Fields order entries from the most significant down
+		CHECK(RenderQueue::MakeKey(1, 0, 0, 0, 0) > RenderQueue::MakeKey(0, 255, 1000, 4095, 1000));
+		CHECK(RenderQueue::MakeKey(0, 1, 0, 0, 0) > RenderQueue::MakeKey(0, 0, 1000, 4095, 1000));
+		CHECK(RenderQueue::MakeKey(0, 0, 1, 0, 0) > RenderQueue::MakeKey(0, 0, 0, 4095, 1000));
+		CHECK(RenderQueue::MakeKey(0, 0, 0, 1, 0) > RenderQueue::MakeKey(0, 0, 0, 0, 1000));
+		// The batch key ignores material and depth
+		CHECK(RenderQueue::GetBatchKey(RenderQueue::MakeKey(2, 3, 4, 5, 6)) == RenderQueue::GetBatchKey(RenderQueue::MakeKey(2, 3, 4, 4095, 0)));
+
+		// The largest valid key stays below InvalidKey
+		CHECK(RenderQueue::MakeKey(15, 255, (1u << RenderQueue::MeshBits) - 2, 4095, (1u << RenderQueue::DepthBits) - 1) < RenderQueue::InvalidKey);
+
+		CHECK(RenderQueue::QuantizeDepth(-1.0f, 100.0f) == 0);
+		CHECK(RenderQueue::QuantizeDepth(100.0f, 100.0f) == (1u << RenderQueue::DepthBits) - 1);
+		CHECK(RenderQueue::QuantizeDepth(25.0f, 100.0f) < RenderQueue::QuantizeDepth(50.0f, 100.0f));
+	}
+
+#ifdef NDEBUG
+	// Release builds only, out of range fields assert in debug builds
+	void TestOutOfRangeFields()
+	{
+		// An oversized material or depth is clamped and can't spill into the mesh field
+		std::uint64_t Key = RenderQueue::MakeKey(1, 2, 3, 5000, 1u << 21);
+		CHECK(RenderQueue::GetMesh(Key) == 3);
+		CHECK(RenderQueue::GetMaterial(Key) == 4095);
+		CHECK((Key & ((1u << RenderQueue::DepthBits) - 1)) == (1u << RenderQueue::DepthBits) - 1);
+
+		// Ids that select state are rejected
+		CHECK(RenderQueue::MakeKey(1, 2, 1u << RenderQueue::MeshBits, 0, 0) == RenderQueue::InvalidKey);
+		CHECK(RenderQueue::MakeKey(1, 2, (1u << RenderQueue::MeshBits) - 1, 0, 0) == RenderQueue::InvalidKey);
+		CHECK(RenderQueue::MakeKey(1, 256, 3, 0, 0) == RenderQueue::InvalidKey);
+		CHECK(RenderQueue::MakeKey(16, 2, 3, 0, 0) == RenderQueue::InvalidKey);
+	}
+#endif
+
+	// Sorts random keys and compares with a stable sort: keys ascending, items following their keys, and
+	// pushes of equal keys kept in order
+	void CheckSort(const std::vector<std::uint64_t>& aKeys)
+	{
+		RenderQueue Queue;
+		std::vector<std::pair<std::uint64_t, std::uint32_t>> Expected;
+		for (size_t i = 0; i < aKeys.size(); i++)
+		{
+			Queue.Push(aKeys[i], static_cast<std::uint32_t>(i));
+			Expected.emplace_back(aKeys[i], static_cast<std::uint32_t>(i));
+		}
+		Queue.Sort();
+		std::stable_sort(Expected.begin(), Expected.end(), [](const auto& aA, const auto& aB) { return aA.first < aB.first; });
+
+		CHECK(Queue.GetSize() == aKeys.size());
+		bool bSame = true;
+		for (size_t i = 0; i < Expected.size() && bSame; i++)
+			bSame = Queue.GetKeys()[i] == Expected[i].first && Queue.GetItems()[i] == Expected[i].second;
+		CHECK(bSame);
+	}
+
+	void TestRadixSortOrder()
+	{
+		std::mt19937_64 Rng(29);
+
+		// Every digit differs
+		std::vector<std::uint64_t> Keys(5000);
+		for (std::uint64_t& Key : Keys)
+			Key = Rng();
+		CheckSort(Keys);
+
+		// Few distinct keys from real fields, many ties whose push order must survive
+		for (std::uint64_t& Key : Keys)
+			Key = RenderQueue::MakeKey(Rng() % 3, Rng() % 4, Rng() % 16, Rng() % 8, 0);
+		CheckSort(Keys);
+
+		// Only some digits differ, the others are skipped: an odd and an even number of passes
+		for (std::uint64_t& Key : Keys)
+			Key = 0xABCD000000000000ull | (Rng() & 0xFF);
+		CheckSort(Keys);
+		for (std::uint64_t& Key : Keys)
+			Key = 0x1200000000003400ull | (Rng() & 0xFF) << 24 | (Rng() & 0xFF);
+		CheckSort(Keys);
+
+		// Already sorted, reversed, all equal, one and none
+		std::sort(Keys.begin(), Keys.end());
+		CheckSort(Keys);
+		std::reverse(Keys.begin(), Keys.end());
+		CheckSort(Keys);
+		CheckSort(std::vector<std::uint64_t>(100, 42));
+		CheckSort({ 7 });
+		CheckSort({});
+
+		// A queue is reused across frames: clearing keeps the sort correct
+		RenderQueue Queue;
+		Queue.Push(3, 0);
+		Queue.Push(1, 1);
+		Queue.Sort();
+		Queue.Clear();
+		Queue.Push(0x100, 0);
+		Queue.Push(0x001, 1);
+		Queue.Push(0x010, 2);
+		Queue.Sort();
+		CHECK(Queue.GetItems() == std::vector<std::uint32_t>({ 1, 2, 0 }));
+	}
+}
+
+int main()
+{
+	TestUtil::Run("KeyFields", TestKeyFields);
+#ifdef NDEBUG
+	TestUtil::Run("OutOfRangeFields", TestOutOfRangeFields);
+#endif
+	TestUtil::Run("RadixSortOrder", TestRadixSortOrder);
+	return TestUtil::Finish();
+}
@@ -0,0 +1,296 @@
+//***************************************************************************************
+// SceneBVHTest.cpp
+//
+// Frustum, sphere and ray queries of SceneBVH against brute force over every item, through builds,
+// moves, removals and re-insertions
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "BenchUtil.h"
+#include "FrustumCuller.h"
+#include "SceneBVH.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const size_t ItemCount = 3000;
+	const float WorldHalfSize = 100.0f;
+	const float Margin = 0.5f;
+
+	DirectX::BoundingBox GetBox(const SceneStore::WorldBoundsStreams& aBounds, size_t aItem)
+	{
+		return DirectX::BoundingBox(
+			DirectX::XMFLOAT3(aBounds.CenterX[aItem], aBounds.CenterY[aItem], aBounds.CenterZ[aItem]),
+			DirectX::XMFLOAT3(aBounds.ExtentX[aItem], aBounds.ExtentY[aItem], aBounds.ExtentZ[aItem]));
+	}
+
+	SceneStore::WorldBoundsStreams MakeBounds(BenchUtil::Random& aRng)
+	{
+		SceneStore::WorldBoundsStreams Bounds;
+		for (size_t i = 0; i < ItemCount; i++)
+		{
+			Bounds.CenterX.push_back(aRng.Range(-WorldHalfSize, WorldHalfSize));
+			Bounds.CenterY.push_back(aRng.Range(-10.0f, 10.0f));
+			Bounds.CenterZ.push_back(aRng.Range(-WorldHalfSize, WorldHalfSize));
+			Bounds.ExtentX.push_back(aRng.Range(0.2f, 3.0f));
+			Bounds.ExtentY.push_back(aRng.Range(0.2f, 3.0f));
+			Bounds.ExtentZ.push_back(aRng.Range(0.2f, 3.0f));
+		}
+		return Bounds;
+	}
+
+	float GetSphereBoxDistanceSq(const DirectX::XMFLOAT3& aCenter, const DirectX::BoundingBox& aBox, float aGrow)
+	{
+		const float Center[3] = { aCenter.x, aCenter.y, aCenter.z };
+		const float BoxCenter[3] = { aBox.Center.x, aBox.Center.y, aBox.Center.z };
+		const float Extent[3] = { aBox.Extents.x + aGrow, aBox.Extents.y + aGrow, aBox.Extents.z + aGrow };
+		float DistSq = 0.0f;
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			float D = std::max(std::fabs(Center[Axis] - BoxCenter[Axis]) - Extent[Axis], 0.0f);
+			DistSq += D * D;
+		}
+		return DistSq;
+	}
+
+	// Box against 6 inward planes, the test the tree runs on its nodes
+	bool IsBoxInFrustum(const DirectX::XMFLOAT4 aPlanes[6], const DirectX::BoundingBox& aBox, float aGrow)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			const DirectX::XMFLOAT4& Plane = aPlanes[p];
+			float Distance = Plane.x * aBox.Center.x + Plane.y * aBox.Center.y + Plane.z * aBox.Center.z + Plane.w;
+			float Radius = std::fabs(Plane.x) * (aBox.Extents.x + aGrow) + std::fabs(Plane.y) * (aBox.Extents.y + aGrow)
+				+ std::fabs(Plane.z) * (aBox.Extents.z + aGrow);
+			if (Distance + Radius < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	// Entry distance of the ray into the exact box, the hit test a picking caller would run on its leaves
+	bool IntersectBox(const SceneBVH::Ray& aRay, const DirectX::BoundingBox& aBox, float& aDistance)
+	{
+		const float Origin[3] = { aRay.Origin.x, aRay.Origin.y, aRay.Origin.z };
+		const float Direction[3] = { aRay.Direction.x, aRay.Direction.y, aRay.Direction.z };
+		const float Center[3] = { aBox.Center.x, aBox.Center.y, aBox.Center.z };
+		const float Extent[3] = { aBox.Extents.x, aBox.Extents.y, aBox.Extents.z };
+		float Enter = 0.0f;
+		float Exit = aDistance;
+		for (int Axis = 0; Axis < 3; Axis++)
+		{
+			float InvDirection = 1.0f / (Direction[Axis] != 0.0f ? Direction[Axis] : 1e-30f);
+			float T0 = (Center[Axis] - Extent[Axis] - Origin[Axis]) * InvDirection;
+			float T1 = (Center[Axis] + Extent[Axis] - Origin[Axis]) * InvDirection;
+			Enter = std::fmax(Enter, std::fmin(T0, T1));
+			Exit = std::fmin(Exit, std::fmax(T0, T1));
+		}
+		if (Enter > Exit)
+			return false;
+		aDistance = Enter;
+		return true;
+	}
+
+	// Queries return the items whose leaf box passes, so every item whose exact box passes has to be found,
+	// and nothing whose box grown by aSlack fails. Each item is reported once.
+	void CheckQueries(const SceneBVH& aTree, const SceneStore::WorldBoundsStreams& aBounds, const std::vector<bool>& aInTree,
+		float aSlack, BenchUtil::Random& aRng)
+	{
+		for (int Query = 0; Query < 20; Query++)
+		{
+			DirectX::XMFLOAT3 Center(aRng.Range(-WorldHalfSize, WorldHalfSize), aRng.Range(-10.0f, 10.0f), aRng.Range(-WorldHalfSize, WorldHalfSize));
+			float Radius = aRng.Range(0.5f, 30.0f);
+			std::vector<SceneBVH::ItemId> Items;
+			aTree.QuerySphere(Center, Radius, Items);
+			std::vector<int> Found(ItemCount, 0);
+			for (SceneBVH::ItemId Item : Items)
+				Found[Item]++;
+			for (size_t i = 0; i < ItemCount; i++)
+			{
+				bool bExact = aInTree[i] && GetSphereBoxDistanceSq(Center, GetBox(aBounds, i), 0.0f) <= Radius * Radius;
+				bool bGrown = aInTree[i] && GetSphereBoxDistanceSq(Center, GetBox(aBounds, i), aSlack) <= Radius * Radius * 1.0001f;
+				CHECK(Found[i] <= 1);
+				CHECK(!bExact || Found[i] == 1);
+				CHECK(bGrown || Found[i] == 0);
+			}
+
+			FrustumCuller Culler;
+			DirectX::XMFLOAT3 Eye(aRng.Range(-WorldHalfSize, WorldHalfSize), 20.0f, aRng.Range(-WorldHalfSize, WorldHalfSize));
+			Culler.SetViewProj(BenchUtil::LookAtPerspective(Eye, Center, 0.25f * 3.14159265f, 16.0f / 9.0f, 1.0f, 80.0f));
+			Items.clear();
+			aTree.QueryFrustum(Culler.GetPlanes(), Items);
+			std::fill(Found.begin(), Found.end(), 0);
+			for (SceneBVH::ItemId Item : Items)
+				Found[Item]++;
+			for (size_t i = 0; i < ItemCount; i++)
+			{
+				bool bExact = aInTree[i] && IsBoxInFrustum(Culler.GetPlanes(), GetBox(aBounds, i), 0.0f);
+				bool bGrown = aInTree[i] && IsBoxInFrustum(Culler.GetPlanes(), GetBox(aBounds, i), aSlack * 1.001f);
+				CHECK(Found[i] <= 1);
+				CHECK(!bExact || Found[i] == 1);
+				CHECK(bGrown || Found[i] == 0);
+			}
+		}
+	}
+
+	// The closest exact box hit of Raycast and RaycastBatch against testing every item
+	void CheckRays(const SceneBVH& aTree, const SceneStore::WorldBoundsStreams& aBounds, const std::vector<bool>& aInTree, BenchUtil::Random& aRng)
+	{
+		std::vector<SceneBVH::Ray> Rays(2000);
+		for (size_t i = 0; i < Rays.size(); i++)
+		{
+			SceneBVH::Ray& Ray = Rays[i];
+			Ray.Origin = DirectX::XMFLOAT3(aRng.Range(-WorldHalfSize, WorldHalfSize), aRng.Range(-20.0f, 20.0f), aRng.Range(-WorldHalfSize, WorldHalfSize));
+			Ray.Direction = DirectX::XMFLOAT3(aRng.Range(-1.0f, 1.0f), aRng.Range(-0.3f, 0.3f), aRng.Range(-1.0f, 1.0f));
+			// Some rays end early, some have a zero direction component
+			if (i % 4 == 0)
+				Ray.MaxDistance = aRng.Range(1.0f, 40.0f);
+			if (i % 7 == 0)
+				Ray.Direction.y = 0.0f;
+		}
+
+		std::vector<SceneBVH::RayHit> BatchHits(Rays.size());
+		aTree.RaycastBatch(Rays.data(), Rays.size(), BatchHits.data(), [&](size_t aRay, SceneBVH::ItemId aItem, float& aDistance)
+		{
+			return IntersectBox(Rays[aRay], GetBox(aBounds, aItem), aDistance);
+		}, 16);
+
+		size_t HitCount = 0;
+		for (size_t r = 0; r < Rays.size(); r++)
+		{
+			const SceneBVH::Ray& Ray = Rays[r];
+			SceneBVH::RayHit Expected;
+			float Closest = Ray.MaxDistance;
+			for (size_t i = 0; i < ItemCount; i++)
+			{
+				float Distance = Closest;
+				if (aInTree[i] && IntersectBox(Ray, GetBox(aBounds, i), Distance) && Distance < Closest)
+				{
+					Closest = Distance;
+					Expected.Item = static_cast<SceneBVH::ItemId>(i);
+					Expected.Distance = Distance;
+				}
+			}
+
+			SceneBVH::RayHit Hit = aTree.Raycast(Ray, [&](SceneBVH::ItemId aItem, float& aDistance)
+			{
+				return IntersectBox(Ray, GetBox(aBounds, aItem), aDistance);
+			});
+			// Boxes entered at the same distance may be reported either way
+			CHECK(Hit.Distance == Expected.Distance);
+			CHECK((Hit.Item == SceneStore::InvalidItem) == (Expected.Item == SceneStore::InvalidItem));
+			CHECK(BatchHits[r].Item == Hit.Item && BatchHits[r].Distance == Hit.Distance);
+			HitCount += Expected.Item != SceneStore::InvalidItem;
+		}
+		// Both hits and misses are exercised
+		CHECK(HitCount > Rays.size() / 10 && HitCount < Rays.size() * 9 / 10);
+	}
+
+	void TestBuild()
+	{
+		BenchUtil::Random Rng;
+		SceneStore::WorldBoundsStreams Bounds = MakeBounds(Rng);
+		SceneBVH Tree;
+		Tree.SetMargin(Margin);
+		Tree.Build(Bounds);
+		CHECK(Tree.GetItemCount() == ItemCount);
+		CHECK(Tree.GetNodeCount() == 2 * ItemCount - 1);
+		CHECK(Tree.GetDepth() <= 4 * std::log2(float(ItemCount)));
+
+		// Freshly built leaves are exactly the item boxes grown by the margin
+		std::vector<bool> InTree(ItemCount, true);
+		CheckQueries(Tree, Bounds, InTree, Margin, Rng);
+		CheckRays(Tree, Bounds, InTree, Rng);
+	}
+
+	void TestUpdates()
+	{
+		BenchUtil::Random Rng;
+		SceneStore::WorldBoundsStreams Bounds = MakeBounds(Rng);
+		SceneBVH Tree;
+		Tree.SetMargin(Margin);
+		Tree.Build(Bounds);
+		const float BuiltCost = Tree.GetSahCost();
+
+		// Moving within the margin keeps the leaf, leaving it re-inserts the item
+		Bounds.CenterX[0] += 0.5f * Margin;
+		CHECK(!Tree.Update(0, GetBox(Bounds, 0)));
+		Bounds.CenterX[0] += 2.0f * Margin;
+		CHECK(Tree.Update(0, GetBox(Bounds, 0)));
+
+		// Moves from within the margin to across the world, removals and items coming back
+		std::vector<bool> InTree(ItemCount, true);
+		size_t InTreeCount = ItemCount;
+		for (float Distance : { 0.1f, 2.0f, 20.0f, WorldHalfSize })
+		{
+			for (int Step = 0; Step < 2000; Step++)
+			{
+				size_t Item = Rng.Next() % ItemCount;
+				if (Rng.Next() % 8 == 0)
+				{
+					InTreeCount -= InTree[Item];
+					InTree[Item] = false;
+					Tree.Remove(static_cast<SceneBVH::ItemId>(Item));
+					continue;
+				}
+				Bounds.CenterX[Item] = std::clamp(Bounds.CenterX[Item] + Rng.Range(-Distance, Distance), -WorldHalfSize, WorldHalfSize);
+				Bounds.CenterZ[Item] = std::clamp(Bounds.CenterZ[Item] + Rng.Range(-Distance, Distance), -WorldHalfSize, WorldHalfSize);
+				bool bChanged = Tree.Update(static_cast<SceneBVH::ItemId>(Item), GetBox(Bounds, Item));
+				CHECK(InTree[Item] || bChanged);
+				InTreeCount += !InTree[Item];
+				InTree[Item] = true;
+			}
+			CHECK(Tree.GetItemCount() == InTreeCount);
+			CHECK(Tree.GetNodeCount() == 2 * InTreeCount - 1);
+			// With constant extents a leaf reaches at most twice the margin past the box it still contains
+			CheckQueries(Tree, Bounds, InTree, 2.0f * Margin, Rng);
+			CheckRays(Tree, Bounds, InTree, Rng);
+		}
+		// Re-insertion keeps the tree usable, not far worse than a fresh build
+		CHECK(Tree.GetSahCost() < 3.0f * BuiltCost);
+
+		// Removing an item twice or one never inserted changes nothing
+		Tree.Remove(0);
+		size_t Count = Tree.GetItemCount();
+		Tree.Remove(0);
+		Tree.Remove(static_cast<SceneBVH::ItemId>(ItemCount + 10));
+		CHECK(Tree.GetItemCount() == Count);
+
+		// Ids past the current count are inserted
+		SceneBVH Grown;
+		Grown.SetMargin(Margin);
+		for (size_t i = 0; i < ItemCount; i++)
+			CHECK(Grown.Update(static_cast<SceneBVH::ItemId>(i), GetBox(Bounds, i)));
+		std::fill(InTree.begin(), InTree.end(), true);
+		CHECK(Grown.GetItemCount() == ItemCount);
+		CheckQueries(Grown, Bounds, InTree, Margin, Rng);
+		CheckRays(Grown, Bounds, InTree, Rng);
+	}
+
+	void TestEmpty()
+	{
+		SceneBVH Tree;
+		BenchUtil::Random Rng;
+		Tree.Build(MakeBounds(Rng));
+		Tree.Clear();
+		CHECK(Tree.GetItemCount() == 0 && Tree.GetNodeCount() == 0);
+
+		std::vector<SceneBVH::ItemId> Items;
+		Tree.QuerySphere(DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f), 1000.0f, Items);
+		CHECK(Items.empty());
+		SceneBVH::Ray Ray;
+		Ray.Origin = DirectX::XMFLOAT3(0.0f, 50.0f, 0.0f);
+		Ray.Direction = DirectX::XMFLOAT3(0.0f, -1.0f, 0.0f);
+		SceneBVH::RayHit Hit = Tree.Raycast(Ray, [](SceneBVH::ItemId, float& aDistance) { aDistance = 0.0f; return true; });
+		CHECK(Hit.Item == SceneStore::InvalidItem && Hit.Distance == FLT_MAX);
+	}
+}
+
+int main()
+{
+	TestUtil::Run("Build", TestBuild);
+	TestUtil::Run("Updates", TestUpdates);
+	TestUtil::Run("Empty", TestEmpty);
+	return TestUtil::Finish();
+}
@@ -0,0 +1,95 @@
+//***************************************************************************************
+// SceneStoreTest.cpp
+//
+// Mesh ids of SceneStore across geometry removal and re-adding
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "SceneStore.h"
+#include <set>
+#include <string>
+
+namespace
+{
+	const DirectX::XMFLOAT4X4 Identity(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	// Stands in for the MeshGeometry of the app, only its address is stored
+	MeshGeometry* const Geometry = reinterpret_cast<MeshGeometry*>(std::uintptr_t(0x1000));
+
+	SceneStore::DrawArgs MakeDrawArgs(std::uint32_t aGeometryId, std::uint32_t aIndexStart, MeshGeometry* aGeometry = Geometry)
+	{
+		SceneStore::DrawArgs Args;
+		Args.MeshGeometryRef = aGeometry;
+		Args.GeometryId = aGeometryId;
+		Args.IndexCount = 36;
+		Args.IndexStartLocation = aIndexStart;
+		return Args;
+	}
+
+	SceneStore::ItemId AddItem(SceneStore& aStore, const std::string& aName, const SceneStore::DrawArgs& aArgs)
+	{
+		return aStore.AddItem(aName, 0, Identity, DirectX::BoundingBox(), aArgs, 0);
+	}
+
+	void TestMeshIdsFollowGeometryIds()
+	{
+		SceneStore Store(1, 3);
+		SceneStore::ItemId A = AddItem(Store, "A", MakeDrawArgs(1, 0));
+		SceneStore::ItemId B = AddItem(Store, "B", MakeDrawArgs(1, 0));
+		SceneStore::ItemId C = AddItem(Store, "C", MakeDrawArgs(1, 36));
+		// Same address and range, e.g. a geometry allocated where a removed one was
+		SceneStore::ItemId D = AddItem(Store, "D", MakeDrawArgs(2, 0));
+
+		CHECK(Store.GetMeshId(A) == Store.GetMeshId(B));
+		CHECK(Store.GetMeshId(A) != Store.GetMeshId(C));
+		CHECK(Store.GetMeshId(A) != Store.GetMeshId(D));
+		CHECK(Store.GetMeshCount() == 3);
+	}
+
+	void TestRemoveAndReAdd()
+	{
+		SceneStore Store(1, 3);
+		SceneStore::ItemId A = AddItem(Store, "A", MakeDrawArgs(1, 0));
+		SceneStore::ItemId B = AddItem(Store, "B", MakeDrawArgs(1, 36));
+		SceneStore::ItemId C = AddItem(Store, "C", MakeDrawArgs(2, 0));
+		std::uint32_t RemovedIds[2] = { Store.GetMeshId(A), Store.GetMeshId(B) };
+
+		// Geometry 1 is no longer drawn and removed
+		Store.SetDrawArgs(A, MakeDrawArgs(2, 0));
+		Store.SetDrawArgs(B, MakeDrawArgs(2, 0));
+		Store.RemoveGeometryMeshes(1);
+		CHECK(Store.GetMeshCount() == 1);
+		CHECK(Store.GetMeshId(A) == Store.GetMeshId(C));
+
+		// Removing it again, or a geometry that never had items, changes nothing
+		Store.RemoveGeometryMeshes(1);
+		Store.RemoveGeometryMeshes(7);
+		CHECK(Store.GetMeshCount() == 1);
+
+		// Its replacement reuses the address and ranges but gets its own meshes, on the freed ids
+		Store.SetDrawArgs(A, MakeDrawArgs(3, 0));
+		Store.SetDrawArgs(B, MakeDrawArgs(3, 36));
+		CHECK(Store.GetMeshCount() == 3);
+		CHECK(Store.GetMeshId(A) != Store.GetMeshId(B));
+		CHECK(Store.GetMeshId(A) != Store.GetMeshId(C));
+		std::set<std::uint32_t> Reused = { Store.GetMeshId(A), Store.GetMeshId(B) };
+		CHECK(Reused == std::set<std::uint32_t>(std::begin(RemovedIds), std::end(RemovedIds)));
+
+		// Ids stay dense, new meshes continue after the reused ones
+		SceneStore::ItemId E = AddItem(Store, "E", MakeDrawArgs(3, 72));
+		CHECK(Store.GetMeshId(E) == 3);
+		for (std::uint32_t MeshId : Store.GetMeshIds())
+			CHECK(MeshId < Store.GetMeshCount());
+	}
+}
+
+int main()
+{
+	TestUtil::Run("MeshIdsFollowGeometryIds", TestMeshIdsFollowGeometryIds);
+	TestUtil::Run("RemoveAndReAdd", TestRemoveAndReAdd);
+	return TestUtil::Finish();
+}
@@ -0,0 +1,172 @@
+//***************************************************************************************
+// ShadowCacheTest.cpp
+//
+// Dirty texel regions of ShadowCache and the projection narrowed to them
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "ShadowCache.h"
+#include <random>
+
+namespace
+{
+	const std::uint32_t Resolution = 1024;
+
+	// Light looking down +Z at x and y in [-10, 10], depth 0 to 20 mapped to 0 to 1
+	const DirectX::XMFLOAT4X4 OrthoViewProj(
+		0.1f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.1f, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.05f, 0.0f,
+		0.0f, 0.0f, 0.5f, 1.0f);
+
+	// Perspective with w = z, for the narrowed projection to keep working with a divide
+	const DirectX::XMFLOAT4X4 PerspectiveViewProj(
+		1.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, 2.0f, 0.0f, 0.0f,
+		0.3f, -0.2f, 1.01f, 1.0f,
+		0.0f, 0.0f, -0.1f, 0.0f);
+
+	DirectX::XMFLOAT3 ProjectToNdc(const DirectX::XMFLOAT4X4& aM, const DirectX::XMFLOAT3& aP)
+	{
+		float X = aP.x * aM._11 + aP.y * aM._21 + aP.z * aM._31 + aM._41;
+		float Y = aP.x * aM._12 + aP.y * aM._22 + aP.z * aM._32 + aM._42;
+		float Z = aP.x * aM._13 + aP.y * aM._23 + aP.z * aM._33 + aM._43;
+		float W = aP.x * aM._14 + aP.y * aM._24 + aP.z * aM._34 + aM._44;
+		return { X / W, Y / W, Z / W };
+	}
+
+	bool SameRegion(const ShadowCache::Region& aA, const ShadowCache::Region& aB)
+	{
+		return aA.Left == aB.Left && aA.Top == aB.Top && aA.Right == aB.Right && aA.Bottom == aB.Bottom;
+	}
+
+	void TestInvalidation()
+	{
+		ShadowCache Cache;
+		Cache.Resize(2, Resolution);
+		const ShadowCache::Region Full = { 0, 0, (std::int32_t)Resolution, (std::int32_t)Resolution };
+		CHECK(Cache.GetSliceCount() == 2);
+		CHECK(Cache.IsDirty(0) && SameRegion(Cache.GetDirtyRegion(1), Full));
+
+		// A slice without a projection ignores moved casters
+		Cache.MarkClean(0);
+		Cache.MarkClean(1);
+		Cache.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(0.0f, 0.0f, 5.0f), DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f)));
+		CHECK(!Cache.IsDirty(0) && !Cache.IsDirty(1));
+
+		// A new projection dirties the whole slice, the same one again nothing
+		Cache.SetSliceProjection(0, OrthoViewProj);
+		CHECK(SameRegion(Cache.GetDirtyRegion(0), Full) && !Cache.IsDirty(1));
+		Cache.MarkClean(0);
+		Cache.SetSliceProjection(0, OrthoViewProj);
+		CHECK(!Cache.IsDirty(0));
+
+		Cache.SetSliceProjection(1, PerspectiveViewProj);
+		Cache.MarkClean(1);
+		Cache.InvalidateAll();
+		CHECK(SameRegion(Cache.GetDirtyRegion(0), Full) && SameRegion(Cache.GetDirtyRegion(1), Full));
+		CHECK(Cache.GetDirtyRegion(0).GetArea() == std::uint64_t(Resolution) * Resolution);
+		Cache.MarkClean(0);
+		CHECK(Cache.GetDirtyRegion(0).IsEmpty() && Cache.GetDirtyRegion(0).GetArea() == 0);
+	}
+
+	void TestBoxFootprint()
+	{
+		ShadowCache Cache;
+		Cache.Resize(1, Resolution);
+		Cache.SetSliceProjection(0, OrthoViewProj);
+		Cache.MarkClean(0);
+
+		// x in [1, 3] and y in [-4, -2] are NDC [0.1, 0.3] and [-0.4, -0.2]: texels x [563.2, 665.6] and, y pointing
+		// down, [614.4, 716.8], widened to whole texels and by one texel around
+		Cache.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(2.0f, -3.0f, 10.0f), DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f)));
+		CHECK(SameRegion(Cache.GetDirtyRegion(0), { 562, 613, 667, 718 }));
+
+		// Depth doesn't matter to an orthographic light
+		Cache.MarkClean(0);
+		Cache.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(2.0f, -3.0f, 2.0f), DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f)));
+		CHECK(SameRegion(Cache.GetDirtyRegion(0), { 562, 613, 667, 718 }));
+
+		// A second box, texels [230.4, 281.6] on both axes, grows the region to the union of both
+		Cache.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(-5.0f, 5.0f, 10.0f), DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f)));
+		CHECK(SameRegion(Cache.GetDirtyRegion(0), { 229, 229, 667, 718 }));
+
+		// Clamped to the map, texels x [972.8, 1075.2] and y [-51.2, 51.2], and nothing for boxes entirely off it
+		Cache.MarkClean(0);
+		Cache.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(10.0f, 10.0f, 10.0f), DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f)));
+		CHECK(SameRegion(Cache.GetDirtyRegion(0), { 971, 0, 1024, 53 }));
+		Cache.MarkClean(0);
+		Cache.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(30.0f, 0.0f, 10.0f), DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f)));
+		CHECK(!Cache.IsDirty(0));
+	}
+
+	// The dirty texels must map to the whole [-1, 1] square of the narrowed projection, every other point
+	// by the same affine remap of NDC xy, with depth untouched
+	void CheckDirtyViewProj(const DirectX::XMFLOAT4X4& aViewProj, const DirectX::BoundingBox& aBox)
+	{
+		ShadowCache Cache;
+		Cache.Resize(1, Resolution);
+		Cache.SetSliceProjection(0, aViewProj);
+		Cache.MarkClean(0);
+		Cache.InvalidateBounds(aBox);
+		CHECK(Cache.IsDirty(0));
+		const ShadowCache::Region& Dirty = Cache.GetDirtyRegion(0);
+		DirectX::XMFLOAT4X4 DirtyViewProj = Cache.GetDirtyViewProj(0);
+
+		float X0 = 2.0f * Dirty.Left / Resolution - 1.0f, X1 = 2.0f * Dirty.Right / Resolution - 1.0f;
+		float Y0 = 1.0f - 2.0f * Dirty.Bottom / Resolution, Y1 = 1.0f - 2.0f * Dirty.Top / Resolution;
+		std::mt19937 Rng(19);
+		std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+		for (int i = 0; i < 1000; i++)
+		{
+			DirectX::XMFLOAT3 P(aBox.Center.x + 2.0f * aBox.Extents.x * Unit(Rng), aBox.Center.y + 2.0f * aBox.Extents.y * Unit(Rng),
+				aBox.Center.z + aBox.Extents.z * Unit(Rng));
+			DirectX::XMFLOAT3 Ndc = ProjectToNdc(aViewProj, P);
+			DirectX::XMFLOAT3 Narrowed = ProjectToNdc(DirtyViewProj, P);
+			CHECK_NEAR(Narrowed.x, 2.0f * (Ndc.x - X0) / (X1 - X0) - 1.0f, 1e-3f);
+			CHECK_NEAR(Narrowed.y, 2.0f * (Ndc.y - Y0) / (Y1 - Y0) - 1.0f, 1e-3f);
+			CHECK_NEAR(Narrowed.z, Ndc.z, 1e-5f);
+		}
+
+		// The box itself lies inside the narrowed square, one texel away from its edges
+		float TexelX = 2.0f / (X1 - X0) * 2.0f / Resolution, TexelY = 2.0f / (Y1 - Y0) * 2.0f / Resolution;
+		for (int Corner = 0; Corner < 8; Corner++)
+		{
+			DirectX::XMFLOAT3 P(aBox.Center.x + ((Corner & 1) ? aBox.Extents.x : -aBox.Extents.x),
+				aBox.Center.y + ((Corner & 2) ? aBox.Extents.y : -aBox.Extents.y), aBox.Center.z + ((Corner & 4) ? aBox.Extents.z : -aBox.Extents.z));
+			DirectX::XMFLOAT3 Narrowed = ProjectToNdc(DirtyViewProj, P);
+			CHECK(Narrowed.x >= -1.0f + TexelX * 0.99f && Narrowed.x <= 1.0f - TexelX * 0.99f);
+			CHECK(Narrowed.y >= -1.0f + TexelY * 0.99f && Narrowed.y <= 1.0f - TexelY * 0.99f);
+		}
+	}
+
+	void TestDirtyViewProj()
+	{
+		CheckDirtyViewProj(OrthoViewProj, DirectX::BoundingBox(DirectX::XMFLOAT3(2.0f, -3.0f, 10.0f), DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f)));
+		CheckDirtyViewProj(OrthoViewProj, DirectX::BoundingBox(DirectX::XMFLOAT3(-6.0f, 1.0f, 10.0f), DirectX::XMFLOAT3(0.2f, 3.0f, 1.0f)));
+		CheckDirtyViewProj(PerspectiveViewProj, DirectX::BoundingBox(DirectX::XMFLOAT3(0.5f, 0.5f, 8.0f), DirectX::XMFLOAT3(1.0f, 0.5f, 1.0f)));
+
+		// The corners of the dirty rectangle are the corners of the narrowed square
+		ShadowCache Cache;
+		Cache.Resize(1, Resolution);
+		Cache.SetSliceProjection(0, OrthoViewProj);
+		Cache.MarkClean(0);
+		Cache.InvalidateBounds(DirectX::BoundingBox(DirectX::XMFLOAT3(2.0f, -3.0f, 10.0f), DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f)));
+		DirectX::XMFLOAT4X4 DirtyViewProj = Cache.GetDirtyViewProj(0);
+		// Texel 562 is at x = (562 / 512 - 1) * 10, texel row 613 at y = (1 - 613 / 512) * 10
+		DirectX::XMFLOAT3 TopLeft = ProjectToNdc(DirtyViewProj, DirectX::XMFLOAT3((562.0f / 512.0f - 1.0f) * 10.0f, (1.0f - 613.0f / 512.0f) * 10.0f, 10.0f));
+		DirectX::XMFLOAT3 BottomRight = ProjectToNdc(DirtyViewProj, DirectX::XMFLOAT3((667.0f / 512.0f - 1.0f) * 10.0f, (1.0f - 718.0f / 512.0f) * 10.0f, 10.0f));
+		CHECK_NEAR(TopLeft.x, -1.0f, 1e-4f);
+		CHECK_NEAR(TopLeft.y, 1.0f, 1e-4f);
+		CHECK_NEAR(BottomRight.x, 1.0f, 1e-4f);
+		CHECK_NEAR(BottomRight.y, -1.0f, 1e-4f);
+	}
+}
+
+int main()
+{
+	TestUtil::Run("Invalidation", TestInvalidation);
+	TestUtil::Run("BoxFootprint", TestBoxFootprint);
+	TestUtil::Run("DirtyViewProj", TestDirtyViewProj);
+	return TestUtil::Finish();
+}
@@ -0,0 +1,45 @@
+//***************************************************************************************
+// TestUtil.h
+//
+// Minimal check macros shared by the headless tests. Every test is its own executable
+// registered with ctest; it returns non-zero when any check failed.
+//***************************************************************************************
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+namespace TestUtil
+{
+	inline int Failures = 0;
+
+	inline bool Check(bool bCondition, const char* aExpression, const char* aFile, int aLine)
+	{
+		if (!bCondition)
+		{
+			std::printf("%s(%d): check failed: %s\n", aFile, aLine, aExpression);
+			Failures++;
+		}
+		return bCondition;
+	}
+
+	// Runs a test function and reports it by name
+	template<typename TestFunc>
+	void Run(const char* aName, TestFunc&& aTest)
+	{
+		int FailuresBefore = Failures;
+		aTest();
+		std::printf("[%s] %s\n", Failures == FailuresBefore ? "  OK  " : " FAIL ", aName);
+	}
+
+	inline int Finish()
+	{
+		if (Failures > 0)
+			std::printf("%d check(s) failed\n", Failures);
+		return Failures > 0 ? 1 : 0;
+	}
+}
+
+#define CHECK(Condition) TestUtil::Check((Condition), #Condition, __FILE__, __LINE__)
+#define CHECK_NEAR(A, B, Epsilon) TestUtil::Check(std::fabs((A) - (B)) <= (Epsilon), #A " ~= " #B, __FILE__, __LINE__)
@@ -0,0 +1,204 @@
+//***************************************************************************************
+// TlsfAllocatorTest.cpp
+//
+// Allocation, merging, alignment and exhaustion of TlsfAllocator
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "TlsfAllocator.h"
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// Live allocations must lie inside the capacity without overlapping and add up to the used size
+	bool IsConsistent(const TlsfAllocator& aAllocator, const std::vector<TlsfAllocator::Allocation>& aLive)
+	{
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> Ranges;
+		std::uint64_t Used = 0;
+		for (const TlsfAllocator::Allocation& Allocation : aLive)
+		{
+			std::uint64_t Size = aAllocator.GetAllocationSize(Allocation);
+			Ranges.emplace_back(Allocation.Offset, Allocation.Offset + Size);
+			Used += Size;
+		}
+		std::sort(Ranges.begin(), Ranges.end());
+		for (size_t i = 0; i < Ranges.size(); i++)
+		{
+			if (Ranges[i].second > aAllocator.GetCapacity() || (i > 0 && Ranges[i].first < Ranges[i - 1].second))
+				return false;
+		}
+		return Used == aAllocator.GetUsedSize() && aLive.size() == aAllocator.GetAllocationCount()
+			&& aAllocator.GetLargestFreeBlock() <= aAllocator.GetFreeSize();
+	}
+
+	void TestAllocateFreeMerge()
+	{
+		TlsfAllocator Allocator(1024);
+		CHECK(Allocator.IsEmpty());
+		CHECK(Allocator.GetFreeBlockCount() == 1);
+
+		TlsfAllocator::Allocation A = Allocator.Allocate(100);
+		TlsfAllocator::Allocation B = Allocator.Allocate(200);
+		TlsfAllocator::Allocation C = Allocator.Allocate(300);
+		CHECK(A.IsValid() && B.IsValid() && C.IsValid());
+		CHECK(A.Offset == 0 && B.Offset == 100 && C.Offset == 300);
+		CHECK(Allocator.GetAllocationSize(B) == 200);
+		CHECK(Allocator.GetUsedSize() == 600);
+		CHECK(Allocator.GetAllocationCount() == 3);
+		CHECK(Allocator.GetFreeBlockCount() == 1);
+
+		// B leaves a hole, freeing A merges it into the hole, freeing C merges everything with the tail
+		Allocator.Free(B);
+		CHECK(Allocator.GetFreeBlockCount() == 2);
+		Allocator.Free(A);
+		CHECK(Allocator.GetFreeBlockCount() == 2);
+		CHECK(Allocator.GetLargestFreeBlock() == 424);
+		CHECK(Allocator.GetFragmentation() > 0.0f);
+		Allocator.Free(C);
+		CHECK(Allocator.IsEmpty());
+		CHECK(Allocator.GetFreeBlockCount() == 1);
+		CHECK(Allocator.GetLargestFreeBlock() == 1024);
+		CHECK(Allocator.GetFragmentation() == 0.0f);
+
+		// A freed block in the middle is reused once the rest is taken
+		TlsfAllocator::Allocation Whole[4];
+		for (TlsfAllocator::Allocation& Allocation : Whole)
+			Allocation = Allocator.Allocate(256);
+		Allocator.Free(Whole[2]);
+		TlsfAllocator::Allocation Reused = Allocator.Allocate(256);
+		CHECK(Reused.IsValid() && Reused.Offset == 512);
+	}
+
+	void TestAlignment()
+	{
+		TlsfAllocator Allocator(1 << 20);
+		std::vector<TlsfAllocator::Allocation> Live;
+		for (std::uint64_t Alignment = 1; Alignment <= 65536; Alignment *= 2)
+		{
+			// An odd sized allocation first, so the next aligned one needs padding
+			Live.push_back(Allocator.Allocate(3));
+			TlsfAllocator::Allocation Aligned = Allocator.Allocate(Alignment + 5, Alignment);
+			CHECK(Aligned.IsValid());
+			CHECK(Aligned.Offset % Alignment == 0);
+			Live.push_back(Aligned);
+		}
+		CHECK(IsConsistent(Allocator, Live));
+
+		// The padding in front of an aligned block stays free and can be allocated, here it is the only free block
+		TlsfAllocator Small(512);
+		TlsfAllocator::Allocation First = Small.Allocate(1);
+		TlsfAllocator::Allocation Aligned = Small.Allocate(256, 256);
+		CHECK(Aligned.IsValid() && Aligned.Offset == 256);
+		TlsfAllocator::Allocation Padding = Small.Allocate(255);
+		CHECK(Padding.IsValid() && Padding.Offset == 1);
+		CHECK(IsConsistent(Small, { First, Aligned, Padding }));
+
+		for (const TlsfAllocator::Allocation& Allocation : Live)
+			Allocator.Free(Allocation);
+		CHECK(Allocator.IsEmpty());
+		CHECK(Allocator.GetFreeBlockCount() == 1);
+	}
+
+	void TestExhaustion()
+	{
+		TlsfAllocator Allocator(1000);
+		CHECK(!Allocator.Allocate(0).IsValid());
+		CHECK(!Allocator.Allocate(1001).IsValid());
+		TlsfAllocator::Allocation All = Allocator.Allocate(1000);
+		CHECK(All.IsValid() && All.Offset == 0);
+		CHECK(Allocator.GetFreeSize() == 0);
+		CHECK(Allocator.GetFreeBlockCount() == 0);
+		CHECK(!Allocator.Allocate(1).IsValid());
+
+		// Failed allocations change nothing and freeing them is a no-op
+		TlsfAllocator::Allocation Failed = Allocator.Allocate(1);
+		Allocator.Free(Failed);
+		CHECK(Allocator.GetAllocationCount() == 1);
+		Allocator.Free(All);
+		CHECK(Allocator.Allocate(1000).IsValid());
+
+		// Enough free space, but not at the alignment
+		TlsfAllocator Aligned(100);
+		Aligned.Allocate(1);
+		CHECK(!Aligned.Allocate(64, 64).IsValid());
+		TlsfAllocator::Allocation Tail = Aligned.Allocate(36, 64);
+		CHECK(Tail.IsValid() && Tail.Offset == 64);
+
+		// Nothing is left after a reset
+		Allocator.Reset(0);
+		CHECK(!Allocator.Allocate(1).IsValid());
+		Allocator.Reset(64);
+		CHECK(Allocator.IsEmpty() && Allocator.Allocate(64).IsValid());
+	}
+
+	// Random sizes and alignments freed in random order: the free space splinters and must merge back into one block
+	void TestRandomFreeOrder()
+	{
+		std::mt19937 Rng(7);
+		TlsfAllocator Allocator(64ull << 20);
+		std::vector<TlsfAllocator::Allocation> Live;
+		for (;;)
+		{
+			std::uint64_t Size = 1 + Rng() % 70000;
+			std::uint64_t Alignment = std::uint64_t(1) << (Rng() % 13);
+			TlsfAllocator::Allocation Allocation = Allocator.Allocate(Size, Alignment);
+			if (!Allocation.IsValid())
+				break;
+			CHECK(Allocation.Offset % Alignment == 0);
+			CHECK(Allocator.GetAllocationSize(Allocation) == Size);
+			Live.push_back(Allocation);
+		}
+		CHECK(Live.size() > 100);
+		CHECK(IsConsistent(Allocator, Live));
+
+		std::shuffle(Live.begin(), Live.end(), Rng);
+		size_t Half = Live.size() / 2;
+		for (size_t i = Half; i < Live.size(); i++)
+			Allocator.Free(Live[i]);
+		Live.resize(Half);
+		CHECK(IsConsistent(Allocator, Live));
+		CHECK(Allocator.GetFreeBlockCount() > 1);
+		CHECK(Allocator.GetFragmentation() > 0.0f && Allocator.GetFragmentation() < 1.0f);
+
+		// The largest free block is exact: it can be allocated, one unit more cannot
+		std::uint64_t Largest = Allocator.GetLargestFreeBlock();
+		CHECK(!Allocator.Allocate(Largest + 1).IsValid());
+		TlsfAllocator::Allocation LargestAllocation = Allocator.Allocate(Largest);
+		CHECK(LargestAllocation.IsValid());
+		Live.push_back(LargestAllocation);
+		CHECK(IsConsistent(Allocator, Live));
+
+		// Refill the holes with small allocations, then free everything in random order
+		for (int i = 0; i < 2000; i++)
+		{
+			TlsfAllocator::Allocation Allocation = Allocator.Allocate(1 + Rng() % 4096, std::uint64_t(1) << (Rng() % 9));
+			if (Allocation.IsValid())
+				Live.push_back(Allocation);
+		}
+		CHECK(IsConsistent(Allocator, Live));
+		std::shuffle(Live.begin(), Live.end(), Rng);
+		while (!Live.empty())
+		{
+			Allocator.Free(Live.back());
+			Live.pop_back();
+			if (Live.size() % 256 == 0)
+				CHECK(IsConsistent(Allocator, Live));
+		}
+		CHECK(Allocator.IsEmpty());
+		CHECK(Allocator.GetFreeBlockCount() == 1);
+		CHECK(Allocator.GetLargestFreeBlock() == Allocator.GetCapacity());
+		CHECK(Allocator.GetFragmentation() == 0.0f);
+	}
+}
+
+int main()
+{
+	TestUtil::Run("AllocateFreeMerge", TestAllocateFreeMerge);
+	TestUtil::Run("Alignment", TestAlignment);
+	TestUtil::Run("Exhaustion", TestExhaustion);
+	TestUtil::Run("RandomFreeOrder", TestRandomFreeOrder);
+	return TestUtil::Finish();
+}
@@ -0,0 +1,200 @@
+//***************************************************************************************
+// TriangleBVHTest.cpp
+//
+// Closest hits of TriangleBVH against a brute force test of every triangle
+//***************************************************************************************
+
+#include "TestUtil.h"
+#include "BenchUtil.h"
+#include "TriangleBVH.h"
+#include <random>
+
+namespace
+{
+	DirectX::XMFLOAT3 Subtract(const DirectX::XMFLOAT3& aA, const DirectX::XMFLOAT3& aB)
+	{
+		return { aA.x - aB.x, aA.y - aB.y, aA.z - aB.z };
+	}
+
+	DirectX::XMFLOAT3 Cross(const DirectX::XMFLOAT3& aA, const DirectX::XMFLOAT3& aB)
+	{
+		return { aA.y * aB.z - aA.z * aB.y, aA.z * aB.x - aA.x * aB.z, aA.x * aB.y - aA.y * aB.x };
+	}
+
+	float Dot(const DirectX::XMFLOAT3& aA, const DirectX::XMFLOAT3& aB)
+	{
+		return aA.x * aB.x + aA.y * aB.y + aA.z * aB.z;
+	}
+
+	// Scalar copy of DirectX::TriangleTests::Intersects, which the SDK only provides for XMVECTOR: both sides
+	// count, divisions deferred to the end, and rays nearly parallel to the triangle miss
+	bool IntersectsTriangle(const DirectX::XMFLOAT3& aOrigin, const DirectX::XMFLOAT3& aDirection, const DirectX::XMFLOAT3& aV0,
+		const DirectX::XMFLOAT3& aV1, const DirectX::XMFLOAT3& aV2, float& aDistance)
+	{
+		const float Epsilon = 1e-20f;
+		DirectX::XMFLOAT3 E1 = Subtract(aV1, aV0);
+		DirectX::XMFLOAT3 E2 = Subtract(aV2, aV0);
+		DirectX::XMFLOAT3 P = Cross(aDirection, E2);
+		float Det = Dot(E1, P);
+		DirectX::XMFLOAT3 S = Subtract(aOrigin, aV0);
+		DirectX::XMFLOAT3 Q = Cross(S, E1);
+		float U = Dot(S, P), V = Dot(aDirection, Q), T = Dot(E2, Q);
+		if (Det >= Epsilon)
+		{
+			if (U < 0.0f || U > Det || V < 0.0f || U + V > Det || T < 0.0f)
+				return false;
+		}
+		else if (Det <= -Epsilon)
+		{
+			if (U > 0.0f || U < Det || V > 0.0f || U + V < Det || T > 0.0f)
+				return false;
+		}
+		else
+		{
+			return false;
+		}
+		aDistance = T / Det;
+		return true;
+	}
+
+	// Concentric bumpy spheres, so the closest hit is not the only one along most rays
+	void MakeMesh(std::vector<Vertex>& aVertices, std::vector<std::uint32_t>& aIndices)
+	{
+		for (float Radius : { 1.0f, 0.6f, 0.3f })
+		{
+			std::uint32_t Base = static_cast<std::uint32_t>(aVertices.size());
+			std::vector<std::uint32_t> Indices;
+			BenchUtil::AppendBumpySphere(24, 48, Radius, DirectX::XMFLOAT3(0.1f, -0.2f, 0.3f), aVertices, Indices);
+			for (std::uint32_t Index : Indices)
+				aIndices.push_back(Base + Index);
+		}
+	}
+
+	struct Ray
+	{
+		DirectX::XMFLOAT3 Origin;
+		DirectX::XMFLOAT3 Direction;
+	};
+
+	// From outside towards points around the mesh, some missing it, and from inside the spheres. Directions
+	// are not normalized, like the local space rays of ShapesApp::Pick.
+	std::vector<Ray> MakeRays()
+	{
+		std::mt19937 Rng(17);
+		std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+		std::vector<Ray> Rays;
+		for (int i = 0; i < 2000; i++)
+		{
+			float Spread = i % 2 ? 3.0f : 1.3f;
+			DirectX::XMFLOAT3 Origin = i % 4 == 3 ? DirectX::XMFLOAT3(0.1f * Unit(Rng), 0.1f * Unit(Rng), 0.1f * Unit(Rng))
+				: DirectX::XMFLOAT3(Spread * Unit(Rng), Spread * Unit(Rng), -4.0f);
+			DirectX::XMFLOAT3 Target(1.3f * Unit(Rng), 1.3f * Unit(Rng), 1.3f * Unit(Rng));
+			float Scale = 0.5f + 2.0f * (Unit(Rng) + 1.0f);
+			Rays.push_back({ Origin, { (Target.x - Origin.x) * Scale, (Target.y - Origin.y) * Scale, (Target.z - Origin.z) * Scale } });
+		}
+		return Rays;
+	}
+
+	// Builds the BVH over aIndices (relative to the first mesh vertex, aBaseVertex in aVertices) and checks every
+	// ray against every triangle
+	template<typename IndexType>
+	void CheckClosestHits(const std::vector<Vertex>& aVertices, const std::vector<IndexType>& aIndices, std::int32_t aBaseVertex)
+	{
+		TriangleBVH Bvh;
+		Bvh.Build(&aVertices[0].Position, sizeof(Vertex), aVertices.size(), aIndices.data(), sizeof(IndexType) == 4,
+			static_cast<std::uint32_t>(aIndices.size()), aBaseVertex);
+		CHECK(Bvh.GetTriangleCount() == aIndices.size() / 3);
+		CHECK(Bvh.GetNodeCount() > 1);
+
+		auto GetTriangle = [&](std::uint32_t aTriangle, DirectX::XMFLOAT3 aOut[3])
+		{
+			for (int c = 0; c < 3; c++)
+				aOut[c] = aVertices[aIndices[aTriangle * 3 + c] + aBaseVertex].Position;
+		};
+
+		size_t Hits = 0;
+		for (const Ray& R : MakeRays())
+		{
+			float Closest = FLT_MAX;
+			for (std::uint32_t t = 0; t < aIndices.size() / 3; t++)
+			{
+				DirectX::XMFLOAT3 P[3];
+				GetTriangle(t, P);
+				float Distance;
+				if (IntersectsTriangle(R.Origin, R.Direction, P[0], P[1], P[2], Distance) && Distance > 0.0f)
+					Closest = std::min(Closest, Distance);
+			}
+
+			TriangleBVH::Hit Hit;
+			bool bHit = Bvh.Intersect(R.Origin, R.Direction, Hit);
+			CHECK(bHit == (Closest != FLT_MAX));
+			if (!bHit || Closest == FLT_MAX)
+				continue;
+			Hits++;
+			CHECK_NEAR(Hit.Distance, Closest, 1e-5f * Closest);
+
+			// The reported triangle and barycentrics give the hit point
+			DirectX::XMFLOAT3 P[3];
+			GetTriangle(Hit.Triangle, P);
+			CHECK(Hit.U >= 0.0f && Hit.V >= 0.0f && Hit.U + Hit.V <= 1.0f);
+			for (int Axis = 0; Axis < 3; Axis++)
+			{
+				const float* V0 = &P[0].x, * V1 = &P[1].x, * V2 = &P[2].x;
+				float OnTriangle = V0[Axis] + Hit.U * (V1[Axis] - V0[Axis]) + Hit.V * (V2[Axis] - V0[Axis]);
+				float OnRay = (&R.Origin.x)[Axis] + Hit.Distance * (&R.Direction.x)[Axis];
+				CHECK_NEAR(OnTriangle, OnRay, 1e-4f);
+			}
+
+			// Nothing closer than the closest hit
+			TriangleBVH::Hit Unused;
+			CHECK(!Bvh.Intersect(R.Origin, R.Direction, Unused, Closest * 0.999f));
+		}
+		// Most rays hit, some miss
+		CHECK(Hits > 1000 && Hits < 2000);
+	}
+
+	void TestClosestHits32()
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<std::uint32_t> Indices;
+		MakeMesh(Vertices, Indices);
+		CheckClosestHits(Vertices, Indices, 0);
+	}
+
+	void TestClosestHits16WithBaseVertex()
+	{
+		// The mesh sits behind other vertices of a shared buffer, its indices are relative to its first vertex
+		const std::int32_t BaseVertex = 5000;
+		std::vector<Vertex> Vertices(BaseVertex, Vertex(DirectX::XMFLOAT3(100.0f, 100.0f, 100.0f), DirectX::XMFLOAT2(0.0f, 0.0f),
+			DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f), DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f)));
+		std::vector<Vertex> MeshVertices;
+		std::vector<std::uint32_t> Indices;
+		MakeMesh(MeshVertices, Indices);
+		Vertices.insert(Vertices.end(), MeshVertices.begin(), MeshVertices.end());
+
+		std::vector<std::uint16_t> Indices16(Indices.begin(), Indices.end());
+		CHECK(MeshVertices.size() <= 65536);
+		CheckClosestHits(Vertices, Indices16, BaseVertex);
+		// The same mesh with 32 bit indices through the base vertex too
+		CheckClosestHits(Vertices, Indices, BaseVertex);
+	}
+
+	void TestEmpty()
+	{
+		TriangleBVH Bvh;
+		std::vector<DirectX::XMFLOAT3> Positions(3, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+		std::uint32_t Indices[2] = { 0, 1 };
+		Bvh.Build(Positions.data(), sizeof(DirectX::XMFLOAT3), Positions.size(), Indices, true, 2, 0);
+		CHECK(Bvh.IsEmpty());
+		TriangleBVH::Hit Hit;
+		CHECK(!Bvh.Intersect(DirectX::XMFLOAT3(0.0f, 0.0f, -1.0f), DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f), Hit));
+	}
+}
+
+int main()
+{
+	TestUtil::Run("ClosestHits32", TestClosestHits32);
+	TestUtil::Run("ClosestHits16WithBaseVertex", TestClosestHits16WithBaseVertex);
+	TestUtil::Run("Empty", TestEmpty);
+	return TestUtil::Finish();
+}
@@ -0,0 +1,21 @@
+//***************************************************************************************
+// DirectXCollision.h
+//
+// Headless stand-in for the Windows SDK header, see DirectXMath.h in this directory
+//***************************************************************************************
+
+#pragma once
+
+#include "DirectXMath.h"
+
+namespace DirectX
+{
+	struct BoundingBox
+	{
+		XMFLOAT3 Center;
+		XMFLOAT3 Extents;
+
+		BoundingBox() : Center(0.0f, 0.0f, 0.0f), Extents(1.0f, 1.0f, 1.0f) {}
+		constexpr BoundingBox(const XMFLOAT3& center, const XMFLOAT3& extents) : Center(center), Extents(extents) {}
+	};
+}
@@ -0,0 +1,86 @@
+//***************************************************************************************
+// DirectXPackedVector.h
+//
+// Headless stand-in for the Windows SDK header, see DirectXMath.h in this directory.
+// Only the half float conversions, with the rounding of the SDK's scalar path.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace DirectX
+{
+	namespace PackedVector
+	{
+		using HALF = std::uint16_t;
+
+		inline HALF XMConvertFloatToHalf(float Value)
+		{
+			std::uint32_t IValue;
+			std::memcpy(&IValue, &Value, sizeof(IValue));
+			std::uint32_t Sign = (IValue & 0x80000000U) >> 16U;
+			IValue = IValue & 0x7FFFFFFFU;
+			std::uint32_t Result;
+			if (IValue >= 0x47800000U)
+			{
+				// Too large for a half: infinity, or NaN keeping the top mantissa bits
+				Result = 0x7C00U | ((IValue > 0x7F800000U) ? (0x200U | ((IValue >> 13U) & 0x3FFU)) : 0U);
+			}
+			else if (IValue <= 0x33000000U)
+			{
+				Result = 0;
+			}
+			else if (IValue < 0x38800000U)
+			{
+				// Too small for a normalized half, round to nearest even denormal
+				std::uint32_t Shift = 125U - (IValue >> 23U);
+				IValue = 0x800000U | (IValue & 0x7FFFFFU);
+				Result = IValue >> (Shift + 1);
+				std::uint32_t Sticky = (IValue & ((1U << Shift) - 1)) != 0;
+				Result += (Result | Sticky) & ((IValue >> Shift) & 1U);
+			}
+			else
+			{
+				// Rebias the exponent, round to nearest even
+				IValue += 0xC8000000U;
+				Result = ((IValue + 0x0FFFU + ((IValue >> 13U) & 1U)) >> 13U) & 0x7FFFU;
+			}
+			return static_cast<HALF>(Result | Sign);
+		}
+
+		inline float XMConvertHalfToFloat(HALF Value)
+		{
+			std::uint32_t Mantissa = static_cast<std::uint32_t>(Value & 0x03FF);
+			std::uint32_t Exponent = (Value & 0x7C00);
+			if (Exponent == 0x7C00)
+			{
+				Exponent = 0x8F;
+			}
+			else if (Exponent != 0)
+			{
+				Exponent = static_cast<std::uint32_t>((Value >> 10) & 0x1F);
+			}
+			else if (Mantissa != 0)
+			{
+				// Denormal, normalize it
+				Exponent = 1;
+				do
+				{
+					Exponent--;
+					Mantissa <<= 1;
+				} while ((Mantissa & 0x0400) == 0);
+				Mantissa &= 0x03FF;
+			}
+			else
+			{
+				Exponent = static_cast<std::uint32_t>(-112);
+			}
+			std::uint32_t Result = ((static_cast<std::uint32_t>(Value) & 0x8000) << 16) | ((Exponent + 112) << 23) | (Mantissa << 13);
+			float Out;
+			std::memcpy(&Out, &Result, sizeof(Out));
+			return Out;
+		}
+	}
+}